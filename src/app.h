@@ -50,7 +50,21 @@
  *
  * The project is implemetented by means of Unix processes. Their interconnection is done through an
  * abract object of type channel_t. The latter can be updated to change the underlying communication mechanism.
- * So far, the implementation of a channel_t is done through Unix message queues.
+ * By default, the implementation of a channel_t is done through Unix message queues. With the option '-s' the
+ * channels are lock-free rings in POSIX shared memory instead: the rings are mapped once at creation time, after
+ * which messages are exchanged without system calls unless a process has to sleep waiting for a peer.
+ *
+ * Sensor messages carry a typed, fixed-layout frame per sensor class (see @ref header_frame "frame.h"): angular
+ * rates and accelerations for the IMU, position and velocity for the GNSS, an attitude quaternion for the star
+ * tracker. On the shared-memory channels the sensors write their frame straight into the ring and control reads it
+ * in place, so a frame is never copied on its way.
+ *
+ * On the shared-memory channels control broadcasts the thruster commands: every actuator reads every command
+ * in place, through a cursor of its own over a single-writer ring, and control only reuses a slot once the
+ * slowest actuator is past it. The lag of each actuator and the time control spent waiting for it are
+ * printed at shutdown. With message queues control sends a copy of each command to every actuator, addressed to
+ * its slot. A command frame carries the thrust of every thruster and its control cycle, and each actuator only
+ * fires the newest command it has for its own thruster, dropping the ones it superseded.
  *
  * Following is a diagram of the architecture:
  *
@@ -61,13 +75,107 @@
  * \subsection doc_arch_tmr TMR architecture
  *
  * The solution provides TMR configuration by specifying the option '-t' when calling the mail executable. The voter
- * executes a 2-out-of-3 voting mechanism. The architecture uses one message queue for the messages between sensors
+ * executes an M-out-of-N voting mechanism, 2-out-of-3 by default (options '-n' and '-m'). Replica values are matched
+ * on the sequence number of their sample, and each sample is voted as soon as a quorum agrees or at the latest when
+ * its deadline (option '-d') expires, so a slow or dead replica cannot stall the voter. The architecture uses one message queue for the messages between sensors
  * and control and another queue between control and actuators. The selection of specific sources is done through usage
  * of differen message types. Please refer to the code documentation for the IDs used.
  *
  * \anchor img_tmr_arch
  * \image html tmr_architecture.png "architecture with TMR"
  *
+ * \subsection doc_watchdog Watchdog and failover
+ *
+ * With TMR the sensor replicas beat on a heartbeat table in shared memory, which the driver checks every control
+ * period. A replica that crashed or missed its heartbeat is left out by its voter, which votes among the replicas
+ * left, and is restarted; the failover and recovery times of every fault are printed at shutdown (see
+ * @ref header_watchdog "watchdog.h").
+ *
+ * \subsection doc_startup Startup
+ *
+ * The processes of the chain inherit their channels from the driver and check in at a readiness gate, which the
+ * driver opens once all of them are ready: the chain starts at once, without fixed delays, and the time to the first
+ * actuation is printed at shutdown (see @ref header_startup "startup.h").
+ *
+ * \subsection doc_shutdown Shutdown
+ *
+ * Once the sensors are done, or on SIGINT, the driver stops the voters, control and the actuators in turn with a
+ * termination message on their data channel, which reaches each stage behind everything queued there: nothing in
+ * flight is lost, each stage is reaped before the next one is stopped and the teardown time is printed at the end.
+ *
+ * \section doc_board State board
+ *
+ * With the option '-b' the sensors, or the voters with TMR, overwrite the latest sample of their class on a
+ * seqlock-protected state board in shared memory instead of queueing it, and control reads a consistent copy of
+ * all of them without blocking: it never works through stale samples and memory stays bounded however far ahead the
+ * sensors get (see @ref header_board "board.h").
+ *
+ * \section doc_fusion Sensor fusion
+ *
+ * Control fuses the latest state of the three sensors into the thrust of each thruster. The law is split in input
+ * groups, one per sensor, so a sample only computes again the contribution of the sensor that sent it, which is what
+ * most cycles do when the IMU runs far faster than the GNSS and the star tracker (see @ref header_fusion "fusion.h").
+ *
+ * \section doc_record Record and replay
+ *
+ * With the option '-o' every message pushed on a channel is appended to a memory-mapped recording file, which logdump
+ * prints with '-r'. With '-x' or '-X' a recording is replayed in place of the sensors, as fast as possible or at its
+ * original timing, so control-law changes can be run against captured sessions (see @ref header_record "record.h").
+ *
+ * \section doc_sim Simulation mode
+ *
+ * With the option '-v' all the timing of the chain goes through a virtual clock: the processes take turns, and the
+ * clock jumps to the next wake-up as soon as they all wait, so a run takes no longer than the CPU needs and always
+ * gives the same order of events (see @ref header_vclock "vclock.h").
+ *
+ * \section doc_waits Wait strategies
+ *
+ * With the option '-w' voters, control and actuators wait on their channels by blocking, yielding, spinning, spinning
+ * briefly before blocking (the default) or adaptively, spinning only while the recent waits of the channel were short.
+ * The waits that ended spinning or sleeping are printed at shutdown (see channel_set_wait()).
+ *
+ * \section doc_topology Topology
+ *
+ * With the option '-T' the sensor classes, their replication and timing, the actuators and the samples per sensor
+ * are loaded from a file instead of being the demo ones. Every voter group gets a channel of its own, numbered past
+ * the fixed channels (see @ref header_topology "topology.h").
+ *
+ * \section doc_campaign Campaigns
+ *
+ * Every run of the driver claims a channel namespace of its own (see channel_claim_namespace()), so runs can go side
+ * by side. The campaign runner starts many of them across all the CPUs, e.g. a fault-injection sweep over a range of
+ * seeds given with '-S', and gathers their exit status, simulated time and delivered commands in JSON.
+ *
+ * \section doc_metrics Live metrics
+ *
+ * Every run counts the traffic, drops and blocked time of its channels and processes in a shared-memory segment
+ * named after its namespace (see @ref header_metrics "metrics.h"), which controlx-top maps read-only to show the
+ * rates of a running chain.
+ *
+ * \section doc_log Logging
+ *
+ * The processes log fixed-size binary records into per-process shared-memory rings, which a dedicated logger
+ * process drains to stdout or, with the option '-f', to a binary log file readable with logdump. The option
+ * '-l' sets the log level, which SIGUSR1 and SIGUSR2 raise and lower at runtime (see @ref header_logger "logger.h").
+ *
+ * \section doc_law Control law plugins
+ *
+ * With the option '-p' the control law is loaded from a shared object through a small versioned ABI (see
+ * @ref header_law_plugin "law_plugin.h"). On SIGHUP the control process reloads it between two control cycles,
+ * keeping the running law if the new one cannot be loaded, and logs the cycle-time statistics of each law.
+ *
+ * \section doc_periodic Periodic tasks
+ *
+ * With the options '-r' and '-c' sensors, actuators and control run as periodic tasks on absolute release times,
+ * optionally at the SCHED_FIFO priority given with '-P', and log their deadline misses, overruns and release
+ * jitter at shutdown (see @ref header_periodic "periodic.h").
+ *
+ * \section doc_placement CPU placement
+ *
+ * With the option '-a' every role is pinned to its own CPUs, e.g. control alone on an isolated CPU, and at shutdown
+ * the driver reports the CPUs, migrations and context switches of every process (see
+ * @ref header_placement "placement.h").
+ *
  * \section install_deps Dependencies
  *
  * The project requires the following dependencies to be compiled and executed:
@@ -98,6 +206,20 @@
  * 1. cd src
  * 2. make
  * 3. ./driver
+ *
+ * \section install_bench Running the benchmark
+ *
+ * The benchmark sweeps topology scales, channel backends, TMR configuration and batch sizes over the demo
+ * chain, or a topology file given with '-T', and writes the results to bench.json:
+ *
+ * 1. cd src
+ * 2. make bench
+ *
+ * The batch control law (see @ref header_claw "control_law.h") is timed against the per-sample path, and the
+ * incremental sensor fusion against the full one, with:
+ *
+ * 1. cd src
+ * 2. make bench-law
  */
 
 /***************************** Include Files ********************************/
@@ -106,35 +228,51 @@
 #include <sys/ipc.h>
 #include <fcntl.h>
 #include <wait.h>
+#include <signal.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
 
 #include "channel.h"
 #include "control.h"
+#include "topology.h"
 
 /************************** Constant Definitions *****************************/
 /**
- * @name Processes configuration
- * @brief Number of processes composing the demo
+ * @name Default topology
+ * @brief Processes composing the demo when no topology file is given (see @ref header_topology "topology.h")
  * @{
  */
 #define TOT_IMU         1
 #define TOT_GNSS        1
 #define TOT_STRTRK      1
-#define TOT_VOTERS      3
 #define TOT_ACTUATORS   6
 /* @} */
 
 /**
- * @name Dummy processes configuration
- * @brief Configuration of the total number of acquisition and actuation
- * @{
+ * @brief Number of samples each sensor acquires in the demo
  */
 #define TOT_SENSING      20
-#define TOT_ACTUATING    10
+
+/**
+ * @brief Maximum number of messages moved by a single batched channel operation
+ */
+#define BATCH_SIZE       32
+
+/**
+ * @name Voting policy
+ * @brief Defaults of the M-out-of-N voting when @ref sec_tmr_arch "TMR" is enabled
+ * @{
+ */
+#define VOTE_REPLICAS      3     /**< replicas of each sensor, N */
+#define VOTE_QUORUM        2     /**< agreeing replicas needed for consensus, M */
+#define VOTE_DEADLINE_MS   100   /**< longest wait for the replicas of a sample */
+#define VOTE_MAX_REPLICAS  8
 /* @} */
 
 /**
@@ -148,6 +286,7 @@
 #define ID_STRTRK       3
 #define ID_ACT          4
 #define ID_CTR          5
+#define ID_ACT_SLOT(i)  (ID_ACT + (i))   /**< commands for the actuator of slot i on a message queue */
 /* @} */
 
 /**
@@ -155,19 +294,34 @@
  * @brief Needed to couple each process to the right channel
  * @{
  */
-#define CH1             '1'
-#define CH2             '2'
-#define CHIMUTMR        '3'
-#define CHGNSSTMR       '4'
-#define CHSTRTRKTMR     '5'
-#define CHCMD           '6'
+#define CH1             1     /**< sensors, or voters, to control */
+#define CH2             2     /**< control to actuators */
+#define CHCMD           3     /**< service commands */
+#define CHTMR           16    /**< replicas to the voter of the first group, one channel per further group */
 /* @} */
 
 /**
- * @brief Termination message sent to the stand-alone processes
+ * @name Waiting roles
+ * @brief Processes waiting on the channels of the chain, whose wait strategy is set with '-w'
+ * @{
+ */
+#define WAIT_VOTER      0     /**< voters, on the channels of their groups */
+#define WAIT_CONTROL    1     /**< control, on CH1 */
+#define WAIT_ACTUATOR   2     /**< actuators, on CH2 */
+#define WAIT_ROLES      3
+#define WAIT_ROLE_NAMES { "voter", "control", "actuator" }
+/* @} */
+
+/**
+ * @brief Termination message, which ends the stream of a data channel or aborts on the service channel
  */
 #define TERMINATE       10000
 
+/**
+ * @brief Time given to each stage to exit at shutdown before it is killed, in ms
+ */
+#define SHUTDOWN_GRACE_MS  100
+
 /**
  * @brief Mark the procedure with file visibility
  */
@@ -0,0 +1,749 @@
+/**
+* @file bench.c
+* @brief Throughput and latency benchmark of the sensor-to-actuator chain.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+
+#include "app.h"
+#include "trace.h"
+#include "placement.h"
+#include "ring.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Roles
+ * @brief Process roles, used to account CPU time per stage
+ * @{
+ */
+#define ROLE_SENSOR      0
+#define ROLE_VOTER       1
+#define ROLE_CONTROL     2
+#define ROLE_ACTUATOR    3
+#define ROLE_TOT         4
+/* @} */
+
+/**
+ * @name Benchmark configuration
+ * @{
+ */
+#define BENCH_MESSAGES   1000     /**< default number of samples per sensor */
+#define BENCH_MAX_BATCH  8        /**< maximum number of batch sizes in a sweep */
+#define BENCH_MAX_SCALES 8        /**< maximum number of topology scales in a sweep */
+#define BENCH_MAX_SCALE  64       /**< largest topology scale */
+#define BENCH_QUIET_MS   200      /**< the chain is drained after this long without actuations */
+#define BENCH_GRACE_MS   100      /**< time given to a process to exit before it is killed */
+/* @} */
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Parameters of one run of the chain.
+ */
+typedef struct
+{
+   bool shm;                  /**< shared-memory channels instead of message queues */
+   bool tmr;                  /**< sensors in TMR configuration, with voters */
+   int batch;                 /**< messages per wake-up in control and voters */
+   int messages;              /**< samples produced by each sensor */
+   int rate_hz;               /**< samples per second of each sensor, 0 for unpaced */
+   int scale;                 /**< times the sensors and actuators of the topology are replicated */
+   const topology_t* topo;    /**< topology of the chain, already scaled */
+   const channel_wait_t* waits; /**< wait strategies of control and the actuators, by @ref WAIT_VOTER "waiting role" */
+} scenario_t;
+
+/**
+ * @brief Progress of the actuators, shared with the benchmark process.
+ */
+typedef struct
+{
+   _Atomic uint64_t delivered;   /**< commands received, by every actuator */
+   _Atomic uint64_t last_ns;     /**< monotonic time of the last command received */
+} progress_t;
+
+/**
+ * @brief A process of the chain.
+ */
+typedef struct
+{
+   pid_t pid;                 /**< process identifier */
+   int role;                  /**< role of the process */
+   bool reaped;               /**< the process has been waited for */
+} child_t;
+
+/************************** Variable Definitions *****************************/
+PRIVATE const char* role_names[ROLE_TOT] = { "sensor", "voter", "control", "actuator" };
+PRIVATE const int role_placement[ROLE_TOT] = { PLACE_SENSOR, PLACE_VOTER, PLACE_CONTROL, PLACE_ACTUATOR };
+
+// channel namespace of the benchmark, where each scenario also keeps its metrics
+PRIVATE int bench_ns;
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Sensor code for the benchmark.
+*
+* @details Produces the samples at a fixed rate, or as fast as the channel accepts them.
+*
+* @param[in] data_ch_tx channel where the data is sent
+* @param[in] id_sens    class identifier according to @ref def_ids "this" classification
+* @param[in] id_replica identifier of the replica in @ref sec_tmr_arch "TMR" configuration
+* @param[in] messages   number of samples to produce
+* @param[in] rate_hz    samples per second, 0 for unpaced
+*
+* @return none
+*/
+PRIVATE void bench_sense(channel_t* data_ch_tx, int id_sens, int id_replica, int messages, int rate_hz);
+
+/**
+* @brief Actuator code for the benchmark.
+*
+* @details Accounts every command received until a termination message arrives.
+*
+* @param[in] data_ch_rx channel where the data is received
+* @param[in] slot       slot of the actuator, its commands are addressed to on a message queue
+* @param[in] progress   counters shared with the benchmark process
+*
+* @return none
+*/
+PRIVATE void bench_actuate(channel_t* data_ch_rx, int slot, progress_t* progress);
+
+/**
+* @brief Runs one scenario and appends its results to the JSON report.
+*
+* @param[in] scenario parameters of the run
+* @param[in] progress counters shared with the actuators
+* @param[in] json     stream where the results are written
+*
+* @return none
+*/
+PRIVATE void bench_run(const scenario_t* scenario, progress_t* progress, FILE* json);
+
+/**
+* @brief Forks a process of the chain, whose standard output is discarded.
+*
+* @param[inout] children processes forked so far, with room for every process of the scenario
+* @param[inout] count    number of processes forked so far
+* @param[in]    role     role of the new process
+* @param[in]    batch    messages per wake-up in control and voters
+*
+* @return 0 in the new process, its pid in the benchmark process
+*/
+PRIVATE pid_t bench_fork(child_t* children, int* count, int role, int batch);
+
+/**
+* @brief Waits for a process and adds its CPU time to its role.
+*
+* @param[inout] child   process to wait for
+* @param[inout] cpu_s   CPU time per role, in seconds
+* @param[in]    nohang  do not wait if the process is still running
+*
+* @return true if the process has been waited for
+*/
+PRIVATE bool bench_reap(child_t* child, double* cpu_s, bool nohang);
+
+/**
+* @brief Parses a comma-separated list of values, e.g. batch sizes.
+*
+* @param[in]  list      text to be parsed
+* @param[out] values    parsed values
+* @param[in]  capacity  most values to be parsed
+* @param[in]  max_value largest value allowed, the smallest is 1
+*
+* @return number of values parsed
+*/
+PRIVATE int bench_parse_list(char* list, int* values, int capacity, int max_value);
+
+/**
+* @brief Replicates the sensors and actuators of a topology.
+*
+* @param[out] scaled topology with every class and the actuators scale times larger
+* @param[in]  topo   topology to be scaled
+* @param[in]  scale  times the sensors and actuators are replicated
+*
+* @return none
+*/
+PRIVATE void bench_scale(topology_t* scaled, const topology_t* topo, int scale);
+
+/**
+*
+* @brief Sweeps topology scales, channel backends, TMR and batch sizes over the demo chain
+*
+* @details Every scenario runs the sensors, the voters (in TMR configuration),
+*   control and the actuators of a topology, the demo one or one loaded from a file
+*   (see @ref header_topology "topology.h"), but with the sensors producing a
+*   configurable number of samples at a configurable rate and with no simulated work.
+*   The topology can be scaled up, replicating its sensors and actuators, to show how
+*   the chain copes with more nodes. For each scenario the benchmark reports, in JSON,
+*   the throughput at the actuators, the latency percentiles of each hop and the CPU
+*   time spent by each stage.
+*/
+int main(int argc, char* argv[])
+{
+   scenario_t scenario;
+   topology_t topo;
+   topology_t scaled;
+   topo_class_t defaults;
+   progress_t* progress;
+   FILE* json = stdout;
+   int batches[BENCH_MAX_BATCH] = { 1, 8, BATCH_SIZE };
+   int tot_batches = 3;
+   int scales[BENCH_MAX_SCALES] = { 1 };
+   int tot_scales = 1;
+   const char* topo_path = NULL;
+   int messages = BENCH_MESSAGES;
+   int rate_hz = 0;
+   int log_level = LOGGER_OFF;
+   const char* placement = "none";
+   const char* wait_roles[WAIT_ROLES] = WAIT_ROLE_NAMES;
+   channel_wait_t waits[WAIT_ROLES] = { CHANNEL_WAIT_HYBRID, CHANNEL_WAIT_HYBRID, CHANNEL_WAIT_HYBRID };
+   const char* wait_spec = "hybrid";
+   bool first = true;
+   int shm;
+   int tmr;
+   int b;
+   int s;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "hn:r:b:s:T:l:a:w:o:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'n':
+         messages = atoi(optarg);
+         break;
+      case 'r':
+         rate_hz = atoi(optarg);
+         break;
+      case 'b':
+         tot_batches = bench_parse_list(optarg, batches, BENCH_MAX_BATCH, BATCH_SIZE);
+         break;
+      case 's':
+         tot_scales = bench_parse_list(optarg, scales, BENCH_MAX_SCALES, BENCH_MAX_SCALE);
+         break;
+      case 'T':
+         topo_path = optarg;
+         break;
+      case 'l':
+         log_level = logger_parse_level(optarg);
+         break;
+      case 'a':
+         if (placement_parse(optarg) == -1)
+         {
+            fprintf(stderr, "invalid placement %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         placement = optarg;
+         break;
+      case 'w':
+         if (channel_parse_waits(optarg, wait_roles, WAIT_ROLES, waits) == -1)
+         {
+            fprintf(stderr, "invalid waits %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         wait_spec = optarg;
+         break;
+      case 'o':
+         if ((json = fopen(optarg, "w")) == NULL)
+         {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-n COUNT] [-r HZ] [-b SIZES] [-s SCALES] [-T PATH] [-l LEVEL] [-a PLACEMENT] [-w WAITS] [-o PATH]\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -n samples produced by each sensor (default %i)\n", BENCH_MESSAGES);
+         fprintf(stderr, "............ -r samples per second of each sensor, 0 for unpaced (default)\n");
+         fprintf(stderr, "............ -b comma-separated batch sizes to sweep (default 1,8,%i)\n", BATCH_SIZE);
+         fprintf(stderr, "............ -s comma-separated topology scales to sweep, up to %i (default 1)\n", BENCH_MAX_SCALE);
+         fprintf(stderr, "............ -T topology file, whose rates, delays and samples are not used (default the demo one)\n");
+         fprintf(stderr, "............ -l log level of the stages, off (default) to info\n");
+         fprintf(stderr, "............ -a CPUs of each role, auto or e.g. control=3:sensor=0-1 (default none)\n");
+         fprintf(stderr, "............ -w how voter, control and actuator wait, e.g. control=spin:voter=adaptive (default hybrid)\n");
+         fprintf(stderr, "............ -o path of the JSON report (default stdout)\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if ((messages <= 0) || (rate_hz < 0) || (tot_batches == 0) || (tot_scales == 0) || (log_level < 0))
+   {
+      fprintf(stderr, "invalid benchmark configuration\n");
+      exit(EXIT_FAILURE);
+   }
+
+   memset(&defaults, 0, sizeof(defaults));
+   defaults.replicas = VOTE_REPLICAS;
+   defaults.quorum = VOTE_QUORUM;
+   defaults.deadline_ms = VOTE_DEADLINE_MS;
+   defaults.wait = waits[WAIT_VOTER];
+   if (topo_path == NULL)
+   {
+      topology_default(&topo, &defaults);
+   }
+   else if (topology_load(&topo, topo_path, &defaults) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   // every scale runs on both backends, with and without TMR
+   for (s = 0; s < tot_scales; s++)
+   {
+      bench_scale(&scaled, &topo, scales[s]);
+      if ((topology_check(&scaled, false, RING_READERS_MAX) == -1) || (topology_check(&scaled, true, RING_READERS_MAX) == -1))
+      {
+         fprintf(stderr, "topology does not run at scale %i\n", scales[s]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // by default the hot path logs nothing at all
+   logger_set_level(log_level);
+
+   // a driver or another benchmark running meanwhile keeps to channels of its own
+   if ((bench_ns = channel_claim_namespace()) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   progress = mmap(NULL, sizeof(progress_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (progress == MAP_FAILED)
+   {
+      perror("mmap");
+      exit(EXIT_FAILURE);
+   }
+
+   fprintf(json, "{\n  \"messages_per_sensor\": %i,\n  \"rate_hz\": %i,\n  \"log_level\": %i,\n  \"placement\": \"%s\",\n  \"waits\": \"%s\",\n  \"scenarios\": [",
+      messages, rate_hz, log_level, placement, wait_spec);
+
+   for (s = 0; s < tot_scales; s++)
+   {
+      bench_scale(&scaled, &topo, scales[s]);
+      for (shm = 0; shm < 2; shm++)
+      {
+         for (tmr = 0; tmr < 2; tmr++)
+         {
+            for (b = 0; b < tot_batches; b++)
+            {
+               scenario.shm = shm;
+               scenario.tmr = tmr;
+               scenario.batch = batches[b];
+               scenario.messages = messages;
+               scenario.rate_hz = rate_hz;
+               scenario.scale = scales[s];
+               scenario.topo = &scaled;
+               scenario.waits = waits;
+
+               fprintf(stderr, "[%i] bench: scale %i, backend %s, TMR %s, batch %i...\n", getpid(),
+                  scales[s], shm ? "shm" : "msgq", tmr ? "on" : "off", batches[b]);
+
+               fprintf(json, "%s\n", first ? "" : ",");
+               bench_run(&scenario, progress, json);
+               first = false;
+            }
+         }
+      }
+   }
+
+   fprintf(json, "\n  ]\n}\n");
+
+   if (json != stdout)
+   {
+      fclose(json);
+   }
+   munmap(progress, sizeof(progress_t));
+   channel_release_namespace();
+
+   return EXIT_SUCCESS;
+}
+
+PRIVATE void bench_run(const scenario_t* scenario, progress_t* progress, FILE* json)
+{
+   static histogram_t hist;
+   const topology_t* topo = scenario->topo;
+   const topo_class_t* cls;
+   channel_t* ch_tmr;
+   channel_t ch_sens;
+   channel_t ch_act;
+   channel_t ch_cmd;
+   child_t* children;
+   double cpu_s[ROLE_TOT] = { 0 };
+   int tot_sensors = topology_sensors(topo, scenario->tmr);
+   int tot_voters = scenario->tmr ? topology_groups(topo) : 0;
+   int nodes = tot_sensors + tot_voters + topo->actuators + 1;
+   int tot = 0;
+   int group;
+   int running;
+   message_t exit_msg;
+   uint64_t t_start;
+   uint64_t t_end;
+   uint64_t t_quiet;
+   uint64_t delivered;
+   double elapsed;
+   int hop;
+   int c;
+   int i;
+   int j;
+
+   ch_tmr = calloc((tot_voters > 0) ? tot_voters : 1, sizeof(channel_t));
+   children = calloc(nodes, sizeof(child_t));
+   if ((ch_tmr == NULL) || (children == NULL))
+   {
+      perror("calloc");
+      exit(EXIT_FAILURE);
+   }
+   memset(&ch_sens, 0, sizeof(ch_sens));
+   memset(&ch_act, 0, sizeof(ch_act));
+   memset(&ch_cmd, 0, sizeof(ch_cmd));
+
+   // the chain counts its traffic as in the demo, so the cost of the metrics is measured too
+   if (metrics_init(bench_ns, nodes) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   // same channel layout as the demo driver
+   for (i = 0; i < tot_voters; i++)
+   {
+      channel_create_backend(&ch_tmr[i], topology_channel(i), scenario->shm ? CHANNEL_SHM_MPSC : CHANNEL_MSGQ);
+   }
+   channel_create_backend(&ch_sens, CH1, scenario->shm ? CHANNEL_SHM_MPSC : CHANNEL_MSGQ);
+   if (scenario->shm)
+   {
+      channel_create_broadcast(&ch_act, CH2, topo->actuators);
+   }
+   else
+   {
+      channel_create_backend(&ch_act, CH2, CHANNEL_MSGQ);
+   }
+   channel_create_backend(&ch_cmd, CHCMD, scenario->shm ? CHANNEL_SHM_MPMC : CHANNEL_MSGQ);
+   for (c = 0, group = 0; scenario->tmr && (c < topo->classes); c++)
+   {
+      for (i = 0; i < topo->cls[c].sensors; i++, group++)
+      {
+         channel_set_wait(&ch_tmr[group], (channel_wait_t)topo->cls[c].wait);
+      }
+   }
+   channel_set_wait(&ch_cmd, CHANNEL_WAIT_BLOCK);
+   channel_set_wait(&ch_sens, scenario->waits[WAIT_CONTROL]);
+   channel_set_wait(&ch_act, scenario->waits[WAIT_ACTUATOR]);
+
+   // leftovers of an aborted run would be counted as this run's traffic; draining the
+   // broadcast channel would take a reader away from the actuators
+   while (channel_drain(&ch_sens, &exit_msg, 1) + (scenario->shm ? 0 : channel_drain(&ch_act, &exit_msg, 1)) +
+      channel_drain(&ch_cmd, &exit_msg, 1) > 0);
+
+   trace_init(nodes);
+   atomic_store(&progress->delivered, 0);
+   atomic_store(&progress->last_ns, 0);
+
+   t_start = trace_now();
+
+   for (c = 0, group = 0; c < topo->classes; c++)
+   {
+      cls = &topo->cls[c];
+      for (i = 0; i < cls->sensors; i++, group++)
+      {
+         for (j = 0; j < (scenario->tmr ? cls->replicas : 1); j++)
+         {
+            if (bench_fork(children, &tot, ROLE_SENSOR, scenario->batch) == 0)
+            {
+               bench_sense(scenario->tmr ? &ch_tmr[group] : &ch_sens, cls->kind, scenario->tmr ? j : i,
+                  scenario->messages, scenario->rate_hz);
+               exit(EXIT_SUCCESS);
+            }
+         }
+      }
+   }
+
+   for (c = 0, group = 0; scenario->tmr && (c < topo->classes); c++)
+   {
+      cls = &topo->cls[c];
+      for (i = 0; i < cls->sensors; i++, group++)
+      {
+         if (bench_fork(children, &tot, ROLE_VOTER, scenario->batch) == 0)
+         {
+            vote_set_policy(cls->replicas, cls->quorum, cls->deadline_ms);
+            vote(&ch_cmd, &ch_tmr[group], &ch_sens, cls->kind);
+            exit(EXIT_SUCCESS);
+         }
+      }
+   }
+
+   for (i = 0; i < topo->actuators; i++)
+   {
+      if (bench_fork(children, &tot, ROLE_ACTUATOR, scenario->batch) == 0)
+      {
+         bench_actuate(&ch_act, i, progress);
+         exit(EXIT_SUCCESS);
+      }
+   }
+
+   if (bench_fork(children, &tot, ROLE_CONTROL, scenario->batch) == 0)
+   {
+      control_set_actuators(topo->actuators);
+      control(&ch_cmd, &ch_sens, &ch_act);
+      exit(EXIT_SUCCESS);
+   }
+
+   // the sensors are done first, then the chain drains
+   for (i = 0; i < tot; i++)
+   {
+      if (children[i].role == ROLE_SENSOR)
+      {
+         bench_reap(&children[i], cpu_s, false);
+      }
+   }
+
+   t_quiet = trace_now();
+   do
+   {
+      usleep(10000);
+      t_end = atomic_load(&progress->last_ns);
+   } while (trace_now() - ((t_end > t_quiet) ? t_end : t_quiet) < BENCH_QUIET_MS * 1000000ULL);
+
+   // stop control, voters and actuators
+   exit_msg.mtype = TERMINATE;
+   exit_msg.mvalue = TERMINATE;
+   for (i = 0; i < 1 + tot_voters; i++)
+   {
+      channel_push_block(&ch_cmd, &exit_msg);
+   }
+   // control has been quiet long enough for this process to take over as the single
+   // producer of the broadcast channel, where one message reaches every actuator
+   for (i = 0; i < (scenario->shm ? 1 : topo->actuators); i++)
+   {
+      channel_push_block(&ch_act, &exit_msg);
+   }
+
+   t_quiet = trace_now();
+   do
+   {
+      running = 0;
+      for (i = 0; i < tot; i++)
+      {
+         running += !children[i].reaped && !bench_reap(&children[i], cpu_s, true);
+      }
+      usleep(1000);
+   } while ((running > 0) && (trace_now() - t_quiet < BENCH_GRACE_MS * 1000000ULL));
+
+   for (i = 0; i < tot; i++)
+   {
+      if (!children[i].reaped)
+      {
+         kill(children[i].pid, SIGKILL);
+         bench_reap(&children[i], cpu_s, false);
+      }
+   }
+
+   delivered = atomic_load(&progress->delivered);
+   elapsed = (t_end > t_start) ? (t_end - t_start) / 1e9 : 0.0;
+
+   fprintf(json, "    {\n");
+   fprintf(json, "      \"backend\": \"%s\",\n", scenario->shm ? "shm" : "msgq");
+   fprintf(json, "      \"tmr\": %s,\n", scenario->tmr ? "true" : "false");
+   fprintf(json, "      \"batch\": %i,\n", scenario->batch);
+   fprintf(json, "      \"scale\": %i,\n", scenario->scale);
+   fprintf(json, "      \"nodes\": %i,\n", nodes);
+   fprintf(json, "      \"samples_sent\": %ld,\n", (long)tot_sensors * scenario->messages);
+   fprintf(json, "      \"commands_delivered\": %lu,\n", (unsigned long)delivered);
+   fprintf(json, "      \"fanout\": %i,\n", topo->actuators);
+   fprintf(json, "      \"elapsed_s\": %.6f,\n", elapsed);
+   fprintf(json, "      \"msgs_per_s\": %.1f,\n", (elapsed > 0.0) ? delivered / elapsed : 0.0);
+   fprintf(json, "      \"latency_us\": {");
+   for (hop = 0; hop < TRACE_HOPS; hop++)
+   {
+      trace_merge(hop, &hist);
+      fprintf(json, "%s\n        \"%s\": { \"count\": %lu, \"p50\": %.3f, \"p99\": %.3f, \"p99_9\": %.3f, \"max\": %.3f }",
+         (hop == 0) ? "" : ",", trace_hop_name(hop), (unsigned long)hist.count,
+         histogram_percentile(&hist, 50.0) / 1000.0, histogram_percentile(&hist, 99.0) / 1000.0,
+         histogram_percentile(&hist, 99.9) / 1000.0, hist.max / 1000.0);
+   }
+   fprintf(json, "\n      },\n");
+   fprintf(json, "      \"cpu_s\": {");
+   for (i = 0; i < ROLE_TOT; i++)
+   {
+      fprintf(json, "%s \"%s\": %.6f", (i == 0) ? "" : ",", role_names[i], cpu_s[i]);
+   }
+   fprintf(json, " }\n    }");
+   fflush(json);
+
+   trace_release();
+   for (i = 0; i < tot_voters; i++)
+   {
+      channel_delete(&ch_tmr[i]);
+   }
+   free(ch_tmr);
+   free(children);
+   channel_delete(&ch_sens);
+   channel_delete(&ch_act);
+   channel_delete(&ch_cmd);
+   metrics_release();
+}
+
+PRIVATE pid_t bench_fork(child_t* children, int* count, int role, int batch)
+{
+   pid_t pid;
+
+   fflush(NULL);
+   pid = fork();
+   if (pid == -1)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+
+   if (pid == 0)
+   {
+      // the stages log as in the demo when asked to, but nobody reads it here
+      if (freopen("/dev/null", "w", stdout) == NULL)
+      {
+         perror("freopen");
+      }
+      trace_attach(*count);
+      metrics_attach(*count, role_placement[role]);
+      placement_apply(role_placement[role]);
+      control_set_batch(batch);
+      return 0;
+   }
+
+   children[*count].pid = pid;
+   children[*count].role = role;
+   children[*count].reaped = false;
+   (*count)++;
+
+   return pid;
+}
+
+PRIVATE bool bench_reap(child_t* child, double* cpu_s, bool nohang)
+{
+   struct rusage usage;
+   pid_t pid;
+
+   pid = wait4(child->pid, NULL, nohang ? WNOHANG : 0, &usage);
+   if (pid <= 0)
+   {
+      return false;
+   }
+
+   cpu_s[child->role] += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+   child->reaped = true;
+   return true;
+}
+
+PRIVATE int bench_parse_list(char* list, int* values, int capacity, int max_value)
+{
+   char* token;
+   int count = 0;
+
+   for (token = strtok(list, ","); (token != NULL) && (count < capacity); token = strtok(NULL, ","))
+   {
+      values[count] = atoi(token);
+      if ((values[count] < 1) || (values[count] > max_value))
+      {
+         fprintf(stderr, "values shall be in the range [1, %i]\n", max_value);
+         exit(EXIT_FAILURE);
+      }
+      count++;
+   }
+   return count;
+}
+
+PRIVATE void bench_scale(topology_t* scaled, const topology_t* topo, int scale)
+{
+   int c;
+
+   *scaled = *topo;
+   for (c = 0; c < scaled->classes; c++)
+   {
+      scaled->cls[c].sensors *= scale;
+   }
+   scaled->actuators *= scale;
+}
+
+PRIVATE void bench_sense(channel_t* data_ch_tx, int id_sens, int id_replica, int messages, int rate_hz)
+{
+   struct timespec next;
+   message_t* data_msg;
+   int value;
+   int i;
+
+   channel_create(data_ch_tx, data_ch_tx->seed);
+   clock_gettime(CLOCK_MONOTONIC, &next);
+
+   for (i = 0; i < messages; i++)
+   {
+      if (rate_hz > 0)
+      {
+         next.tv_nsec += 1000000000L / rate_hz;
+         if (next.tv_nsec >= 1000000000L)
+         {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+         }
+         clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+      }
+
+      // replicas share the generator state inherited from the benchmark process
+      value = rand() % 100;
+      data_msg = channel_reserve(data_ch_tx);
+      data_msg->mtype = id_sens;
+      data_msg->mvalue = value;
+      data_msg->source = id_replica;
+      frame_simulate(&data_msg->frame, id_sens, value);
+      trace_origin(data_msg, i);
+      channel_commit(data_ch_tx, data_msg);
+   }
+}
+
+PRIVATE void bench_actuate(channel_t* data_ch_rx, int slot, progress_t* progress)
+{
+   message_t data_msg[BATCH_SIZE];
+   bool stop = false;
+   bool broadcast;
+   int count;
+   int i;
+
+   channel_create(data_ch_rx, CH2);
+   broadcast = channel_subscribe(data_ch_rx);
+
+   while (!stop)
+   {
+      count = broadcast ? channel_retrieve_batch(data_ch_rx, data_msg, BATCH_SIZE) :
+         channel_retrieve_cat_batch(data_ch_rx, data_msg, BATCH_SIZE, ID_ACT_SLOT(slot));
+
+      for (i = 0; i < count; i++)
+      {
+         if (control_terminates(&data_msg[i]))
+         {
+            stop = true;
+            continue;
+         }
+
+         trace_hop(TRACE_HOP_ACTUATOR, &data_msg[i]);
+         trace_record(TRACE_END_TO_END, data_msg[i].t_hop - data_msg[i].t_origin);
+         atomic_fetch_add(&progress->delivered, 1);
+         atomic_store(&progress->last_ns, data_msg[i].t_hop);
+      }
+   }
+
+   channel_unsubscribe(data_ch_rx);
+}
@@ -0,0 +1,244 @@
+/**
+* @file board.c
+* @brief Functions implementation of @ref header_board "board.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "sysdep.h"
+#include "vclock.h"
+
+/************************** Constant Definitions *****************************/
+// size of a cache line, to keep the slots of different sensors apart
+#define BOARD_CACHE_LINE   64
+
+// event the board raises on the virtual clock, no channel has seed 0
+#define BOARD_EVENT        VCLOCK_EVENT(0)
+
+/**************************** Type Definitions ******************************/
+// latest sample of a sensor class: copy[version & 1] holds sample number version
+typedef struct
+{
+   _Alignas(BOARD_CACHE_LINE) _Atomic uint64_t seq;   // twice the version, odd while a writer is busy
+   message_t copy[2];
+} board_slot_t;
+
+struct board_s
+{
+   _Atomic uint32_t generation;                       // futex bumped on every publish
+   _Atomic uint32_t waiters;                          // readers sleeping on generation
+   board_slot_t slot[BOARD_SLOTS];
+};
+
+/**
+* @brief Creates an empty board in shared memory.
+*
+* @details The board is inherited by the processes forked afterwards.
+*
+* @return the board, NULL if it could not be mapped
+*/
+board_t* board_create(void)
+{
+   board_t* board;
+
+   board = mmap(NULL, sizeof(board_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (board == MAP_FAILED)
+   {
+      perror("mmap");
+      return NULL;
+   }
+
+   // anonymous mappings are zero-filled: every slot starts empty
+   return board;
+}
+
+/**
+* @brief Unmaps a board from the calling process.
+*
+* @param[in] board board returned by board_create()
+*
+* @return none
+*/
+void board_destroy(board_t* board)
+{
+   if (board != NULL)
+   {
+      munmap(board, sizeof(board_t));
+   }
+}
+
+/**
+* @brief Replaces the sample of a sensor class with a newer one.
+*
+* @details The slot is chosen by the mtype of the sample. Writers of the same slot
+*     take turns; readers are never held up.
+*
+* @param[inout] board  board returned by board_create()
+* @param[in]    sample sample to be published, ignored if its mtype is not below BOARD_SLOTS
+*
+* @return none
+*/
+void board_publish(board_t* board, const message_t* sample)
+{
+   board_slot_t* slot;
+   uint64_t seq;
+
+   if ((sample->mtype < 0) || (sample->mtype >= BOARD_SLOTS))
+   {
+      return;
+   }
+
+   slot = &board->slot[sample->mtype];
+   seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+   while ((seq & 1) || !atomic_compare_exchange_weak_explicit(&slot->seq, &seq, seq + 1,
+         memory_order_acquire, memory_order_relaxed))
+   {
+      // another writer of the same sensor class is busy with the slot
+      sched_yield();
+      seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+   }
+
+   // the copy being overwritten is two versions old, readers have moved on from it
+   memcpy(&slot->copy[(seq / 2 + 1) & 1], sample, sizeof(message_t));
+   atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+
+   board_wake(board);
+}
+
+/**
+* @brief Wakes the readers sleeping in board_wait() up, without publishing anything.
+*
+* @details Lets a reader that also watches a channel, e.g. for the end of the
+*     stream, see it at once instead of on its next timeout.
+*
+* @param[inout] board board returned by board_create()
+*
+* @return none
+*/
+void board_wake(board_t* board)
+{
+   atomic_fetch_add_explicit(&board->generation, 1, memory_order_seq_cst);
+   if (atomic_load_explicit(&board->waiters, memory_order_seq_cst) > 0)
+   {
+      sysdep_futex_wake(&board->generation);
+   }
+   vclock_notify(BOARD_EVENT);
+}
+
+/**
+* @brief Copies the latest sample of a sensor class. The caller is never blocked.
+*
+* @details The copy is retried only if writers published twice while it was being
+*     taken, so it always ends with a consistent sample.
+*
+* @param[in]  board  board returned by board_create()
+* @param[in]  id     sensor class identifier, the mtype of its samples
+* @param[out] sample buffer receiving the sample, untouched if none was published
+*
+* @return number of samples published so far on the slot, 0 if none
+*/
+uint64_t board_read(board_t* board, int id, message_t* sample)
+{
+   board_slot_t* slot;
+   uint64_t before;
+   uint64_t after;
+   uint64_t version;
+
+   if ((id < 0) || (id >= BOARD_SLOTS))
+   {
+      return 0;
+   }
+
+   slot = &board->slot[id];
+   do
+   {
+      before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+      version = before / 2;
+      if (version == 0)
+      {
+         return 0;
+      }
+      memcpy(sample, &slot->copy[version & 1], sizeof(message_t));
+      atomic_thread_fence(memory_order_acquire);
+      after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+      // the copy just taken is only reused by the writer of version + 2
+   } while (after > 2 * version + 2);
+
+   return version;
+}
+
+/**
+* @brief Returns a counter bumped on every publish, to be passed to board_wait().
+*
+* @param[in] board board returned by board_create()
+*
+* @return current generation of the board
+*/
+uint32_t board_generation(board_t* board)
+{
+   return atomic_load_explicit(&board->generation, memory_order_acquire);
+}
+
+/**
+* @brief Sleeps until a sample is published after a given generation, or a timeout expires.
+*
+* @param[inout] board      board returned by board_create()
+* @param[in]    generation value of board_generation() taken before the last reads
+* @param[in]    timeout_ms maximum waiting time in milliseconds, negative to wait forever
+*
+* @return none
+*/
+void board_wait(board_t* board, uint32_t generation, int timeout_ms)
+{
+   struct timespec timeout;
+   uint64_t deadline;
+   uint32_t clock_generation;
+
+   // in a simulation the timeout is virtual and the wait is on the clock, which every publish wakes up
+   if (vclock_enabled())
+   {
+      deadline = (timeout_ms >= 0) ? vclock_now() + (uint64_t)timeout_ms * 1000000ULL : VCLOCK_NEVER;
+      for (;;)
+      {
+         clock_generation = vclock_generation();
+         if ((atomic_load_explicit(&board->generation, memory_order_acquire) != generation)
+            || (vclock_now() >= deadline))
+         {
+            return;
+         }
+         vclock_wait(BOARD_EVENT, clock_generation, deadline);
+      }
+   }
+
+   timeout.tv_sec = timeout_ms / 1000;
+   timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+   atomic_fetch_add_explicit(&board->waiters, 1, memory_order_seq_cst);
+   if (atomic_load_explicit(&board->generation, memory_order_seq_cst) == generation)
+   {
+      sysdep_futex_wait(&board->generation, generation, (timeout_ms >= 0) ? &timeout : NULL);
+   }
+   atomic_fetch_sub_explicit(&board->waiters, 1, memory_order_relaxed);
+}
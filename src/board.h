@@ -0,0 +1,70 @@
+/**
+* @file board.h
+* @brief Functions and data definitions for the latest-value state board of the sensors
+* @anchor header_board
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef BOARD_H
+#define BOARD_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "channel.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Number of slots of a board, one per sensor class identifier
+ */
+#define BOARD_SLOTS     8
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Latest sample of each sensor class, in shared memory.
+ *
+ * @details Unlike a channel, a board does not queue: publishing a sample overwrites
+ *       the previous one of the same class, so memory stays bounded and a reader
+ *       always gets the freshest sample, however far ahead the producers are.
+ *       Each slot is a seqlock over two copies of the sample: a writer fills the copy
+ *       readers are not looking at, then publishes it by bumping the sequence number,
+ *       so a reader never waits for a writer, not even one preempted half-way.
+ *
+ */
+typedef struct board_s board_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+board_t* board_create(void);
+void board_destroy(board_t* board);
+/* @} */
+
+/**
+ * @name Access
+ * @{
+ */
+void board_publish(board_t* board, const message_t* sample);
+uint64_t board_read(board_t* board, int id, message_t* sample);
+uint32_t board_generation(board_t* board);
+void board_wait(board_t* board, uint32_t generation, int timeout_ms);
+void board_wake(board_t* board);
+/* @} */
+
+#endif /*BOARD_H*/
@@ -0,0 +1,394 @@
+/**
+* @file campaign.c
+* @brief Runner of simulation campaigns, many independent runs of the driver side by side.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/************************** Constant Definitions *****************************/
+#define CAMPAIGN_LINE      512         // longest line of a campaign file, and of an output line
+#define CAMPAIGN_MAX_ARGS  64          // most arguments of a run
+#define CAMPAIGN_PATH      256         // longest path of a run output
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief A run of the campaign and what it gave.
+ */
+typedef struct
+{
+   char args[CAMPAIGN_LINE];  /**< arguments of the driver, as in the campaign file */
+   unsigned int seed;         /**< seed given with -S, 0 for the driver default */
+   pid_t pid;                 /**< driver process, 0 while not running */
+   int cpu;                   /**< CPU the run is pinned to */
+   uint64_t start_ns;         /**< monotonic time the run started */
+   int status;                /**< exit status of the driver, -1 if it did not exit */
+   double wall_s;             /**< real time taken by the run */
+   double simulated_s;        /**< virtual time simulated, 0 outside the simulation mode */
+   long commands;             /**< commands that reached the actuators */
+} run_t;
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Reads the runs of a campaign file, each line once per seed.
+*
+* @param[in]  path  path of the campaign file
+* @param[in]  seeds seeds each line is run with, 0 to run it once as written
+* @param[out] runs  runs read, to be freed by the caller
+*
+* @return number of runs, -1 if the file cannot be read
+*/
+static int campaign_load(const char* path, int seeds, run_t** runs);
+
+/**
+* @brief Starts a run, with its output going to a file of its own.
+*
+* @param[inout] run    run to be started
+* @param[in]    id     index of the run, which names its output
+* @param[in]    driver path of the driver
+* @param[in]    dir    directory of the outputs
+*
+* @return none
+*/
+static void campaign_start(run_t* run, int id, const char* driver, const char* dir);
+
+/**
+* @brief Collects the simulated time and the delivered commands from the output of a run.
+*
+* @param[inout] run  finished run
+* @param[in]    path path of its output
+*
+* @return none
+*/
+static void campaign_collect(run_t* run, const char* path);
+
+/**
+* @brief Returns the monotonic time in ns.
+*/
+static uint64_t campaign_now(void);
+
+/**
+*
+* @brief Runs a campaign of simulations side by side and gathers their results
+*
+* @details Every line of the campaign file holds the arguments of a run of the driver,
+*   e.g. -v -t -i; blank lines and what follows a '#' are ignored. With -n each line
+*   is run once per seed, from 1 to SEEDS, passed to the driver with -S. Up to JOBS runs
+*   go at a time, each pinned to a CPU of its own and in a channel namespace of its own,
+*   so they do not disturb each other. The output of every run goes to DIR/run-N.txt;
+*   the exit status, real and simulated time and delivered commands of all the runs are
+*   written, in JSON, to stdout or to the path given with -o.
+*/
+int main(int argc, char* argv[])
+{
+   char path[CAMPAIGN_PATH];
+   const char* driver = "./driver";
+   const char* dir = "campaign.out";
+   FILE* json = stdout;
+   run_t* runs;
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   int jobs = (int)cpus;
+   int seeds = 0;
+   int tot_runs;
+   int next = 0;
+   int running = 0;
+   int failed = 0;
+   bool* busy;
+   pid_t pid;
+   int status;
+   int opt;
+   int i;
+
+   while ((opt = getopt(argc, argv, "hj:n:e:d:o:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'j':
+         jobs = atoi(optarg);
+         break;
+      case 'n':
+         seeds = atoi(optarg);
+         break;
+      case 'e':
+         driver = optarg;
+         break;
+      case 'd':
+         dir = optarg;
+         break;
+      case 'o':
+         if ((json = fopen(optarg, "w")) == NULL)
+         {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-j JOBS] [-n SEEDS] [-e DRIVER] [-d DIR] [-o PATH] FILE\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -j runs at a time (default one per CPU, %li)\n", cpus);
+         fprintf(stderr, "............ -n run every line with the seeds 1 to SEEDS (default once, as written)\n");
+         fprintf(stderr, "............ -e path of the driver (default ./driver)\n");
+         fprintf(stderr, "............ -d directory of the run outputs (default campaign.out)\n");
+         fprintf(stderr, "............ -o path of the JSON report (default stdout)\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if ((optind >= argc) || (jobs < 1) || (seeds < 0) || (cpus < 1))
+   {
+      fprintf(stderr, "Usage %s [-h] [-j JOBS] [-n SEEDS] [-e DRIVER] [-d DIR] [-o PATH] FILE\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+
+   if ((tot_runs = campaign_load(argv[optind], seeds, &runs)) <= 0)
+   {
+      fprintf(stderr, "%s: no runs\n", argv[optind]);
+      exit(EXIT_FAILURE);
+   }
+   if ((mkdir(dir, 0755) == -1) && (errno != EEXIST))
+   {
+      perror("mkdir");
+      exit(EXIT_FAILURE);
+   }
+
+   // a CPU is busy while a run pinned to it goes on
+   busy = calloc(cpus, sizeof(bool));
+
+   while ((next < tot_runs) || (running > 0))
+   {
+      for (; (next < tot_runs) && (running < jobs); next++, running++)
+      {
+         for (i = 0; (i < cpus - 1) && busy[i]; i++)
+         {
+         }
+         runs[next].cpu = i;
+         busy[i] = true;
+         campaign_start(&runs[next], next, driver, dir);
+      }
+
+      if ((pid = wait(&status)) == -1)
+      {
+         perror("wait");
+         break;
+      }
+      for (i = 0; (i < tot_runs) && (runs[i].pid != pid); i++)
+      {
+      }
+      if (i == tot_runs)
+      {
+         continue;
+      }
+
+      runs[i].wall_s = (campaign_now() - runs[i].start_ns) / 1e9;
+      runs[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+      runs[i].pid = 0;
+      busy[runs[i].cpu] = false;
+      running--;
+      failed += (runs[i].status != 0);
+
+      snprintf(path, sizeof(path), "%s/run-%i.txt", dir, i);
+      campaign_collect(&runs[i], path);
+      fprintf(stderr, "[%i] campaign: run %i (%s) done with status %i in %.3f s, %i of %i left\n", getpid(), i,
+         runs[i].args, runs[i].status, runs[i].wall_s, tot_runs - next + running, tot_runs);
+   }
+
+   fprintf(json, "{\n  \"driver\": \"%s\",\n  \"jobs\": %i,\n  \"failed\": %i,\n  \"runs\": [", driver, jobs, failed);
+   for (i = 0; i < tot_runs; i++)
+   {
+      fprintf(json, "%s\n    { \"id\": %i, \"args\": \"%s\", \"seed\": %u, \"status\": %i, \"wall_s\": %.6f, "
+         "\"simulated_s\": %.3f, \"commands\": %li, \"output\": \"%s/run-%i.txt\" }", (i == 0) ? "" : ",", i,
+         runs[i].args, runs[i].seed, runs[i].status, runs[i].wall_s, runs[i].simulated_s, runs[i].commands, dir, i);
+   }
+   fprintf(json, "\n  ]\n}\n");
+
+   if (json != stdout)
+   {
+      fclose(json);
+   }
+   free(busy);
+   free(runs);
+
+   return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int campaign_load(const char* path, int seeds, run_t** runs)
+{
+   char line[CAMPAIGN_LINE];
+   FILE* file;
+   run_t* grown;
+   char* args;
+   char* end;
+   int count = 0;
+   int capacity = 0;
+   int s;
+
+   if ((file = fopen(path, "r")) == NULL)
+   {
+      perror("fopen");
+      return -1;
+   }
+
+   *runs = NULL;
+   while (fgets(line, sizeof(line), file) != NULL)
+   {
+      line[strcspn(line, "#\r\n")] = '\0';
+      for (args = line; (*args == ' ') || (*args == '\t'); args++)
+      {
+      }
+      for (end = args + strlen(args); (end > args) && ((end[-1] == ' ') || (end[-1] == '\t')); end--)
+      {
+      }
+      *end = '\0';
+      if (*args == '\0')
+      {
+         continue;
+      }
+
+      for (s = (seeds > 0) ? 1 : 0; s <= seeds; s++)
+      {
+         if (count == capacity)
+         {
+            capacity = (capacity == 0) ? 16 : 2 * capacity;
+            if ((grown = realloc(*runs, capacity * sizeof(run_t))) == NULL)
+            {
+               perror("realloc");
+               fclose(file);
+               return -1;
+            }
+            *runs = grown;
+         }
+         memset(&(*runs)[count], 0, sizeof(run_t));
+         strcpy((*runs)[count].args, args);
+         (*runs)[count].seed = s;
+         (*runs)[count].status = -1;
+         count++;
+      }
+   }
+   fclose(file);
+
+   return count;
+}
+
+static void campaign_start(run_t* run, int id, const char* driver, const char* dir)
+{
+   char path[CAMPAIGN_PATH];
+   char args[CAMPAIGN_LINE];
+   char seed[16];
+   char* argv[CAMPAIGN_MAX_ARGS + 4];
+   cpu_set_t cpus;
+   int argc = 0;
+   int fd;
+
+   fflush(NULL);
+   run->start_ns = campaign_now();
+   run->pid = fork();
+   if (run->pid == -1)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+   if (run->pid > 0)
+   {
+      return;
+   }
+
+   // the driver and every process it forks stay on the CPU of the run
+   CPU_ZERO(&cpus);
+   CPU_SET(run->cpu, &cpus);
+   if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1)
+   {
+      perror("sched_setaffinity");
+   }
+
+   snprintf(path, sizeof(path), "%s/run-%i.txt", dir, id);
+   if ((fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644)) == -1)
+   {
+      perror("open");
+      _exit(EXIT_FAILURE);
+   }
+   dup2(fd, STDOUT_FILENO);
+   dup2(fd, STDERR_FILENO);
+   close(fd);
+
+   strcpy(args, run->args);
+   argv[argc++] = (char*)driver;
+   for (argv[argc] = strtok(args, " \t"); (argv[argc] != NULL) && (argc < CAMPAIGN_MAX_ARGS); argv[argc] = strtok(NULL, " \t"))
+   {
+      argc++;
+   }
+   if (run->seed > 0)
+   {
+      snprintf(seed, sizeof(seed), "%u", run->seed);
+      argv[argc++] = "-S";
+      argv[argc++] = seed;
+   }
+   argv[argc] = NULL;
+
+   execv(driver, argv);
+   perror("execv");
+   _exit(EXIT_FAILURE);
+}
+
+static void campaign_collect(run_t* run, const char* path)
+{
+   char line[CAMPAIGN_LINE];
+   FILE* file;
+   char* text;
+   double seconds;
+   long samples;
+
+   if ((file = fopen(path, "r")) == NULL)
+   {
+      perror("fopen");
+      return;
+   }
+
+   // the driver reports both at shutdown, see vclock_report() and trace_report()
+   while (fgets(line, sizeof(line), file) != NULL)
+   {
+      if (((text = strstr(line, "vclock: ")) != NULL) && (sscanf(text, "vclock: %lf s simulated", &seconds) == 1))
+      {
+         run->simulated_s = seconds;
+      }
+      else if (((text = strstr(line, "latency sensor->actuator")) != NULL) &&
+         (sscanf(text, "latency sensor->actuator samples %li", &samples) == 1))
+      {
+         run->commands = samples;
+      }
+   }
+   fclose(file);
+}
+
+static uint64_t campaign_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,222 @@
+/**
+* @file chancheck.c
+* @brief Check of the command channel on message queues against the signals its
+*     consumers catch while blocked on it.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "channel.h"
+#include "control.h"
+#include "app.h"
+
+/************************** Constant Definitions *****************************/
+#define CHANCHECK_COMMANDS    50          // default number of commands sent to the actuator
+#define CHANCHECK_SIGNALS     4           // signals caught by the actuator before each command
+#define CHANCHECK_PAUSE_NS    2000000L    // time the actuator is left blocked before a signal
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Handler of the signal the actuator catches, which does nothing.
+*
+* @param[in] sig signal received
+*
+* @return none
+*/
+static void chancheck_caught(int sig);
+
+/**
+* @brief Leaves the actuator blocked on the channel for a while.
+*
+* @return none
+*/
+static void chancheck_pause(void);
+
+/**
+* @brief Actuator of slot 0, which takes its commands as the one of the driver does.
+*
+* @details Each command shall come once and in order, whatever the signals caught
+*     while waiting for it.
+*
+* @param[in] channel  command channel
+* @param[in] commands number of commands sent before the termination
+*
+* @return EXIT_SUCCESS if every command was taken once and in order
+*/
+static int chancheck_actuate(channel_t* channel, int commands);
+
+/**
+*
+* @brief Checks that an actuator blocked on a message queue takes every command once
+*
+* @details An actuator is forked on a message-queue command channel. Before each
+*   command it is sent signals, as SIGUSR1 and SIGUSR2 reach every process of the
+*   driver, while it is blocked waiting. A signal caught shall neither be taken for
+*   a command nor make a command be executed twice or out of order.
+*/
+int main(int argc, char* argv[])
+{
+   struct sigaction sa;
+   channel_t channel;
+   message_t msg;
+   pid_t pid;
+   int commands = CHANCHECK_COMMANDS;
+   int status;
+   int opt;
+   int i;
+   int s;
+
+   while ((opt = getopt(argc, argv, "hn:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'n':
+         commands = atoi(optarg);
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-n COUNT]\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -n commands sent to the actuator (default %i)\n", CHANCHECK_COMMANDS);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if (commands <= 0)
+   {
+      fprintf(stderr, "invalid check configuration\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (channel_claim_namespace() == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   // the handler is installed as the driver does, restarting what it can
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = chancheck_caught;
+   sa.sa_flags = SA_RESTART;
+   sigaction(SIGUSR1, &sa, NULL);
+
+   memset(&channel, 0, sizeof(channel));
+   channel_create_backend(&channel, CH2, CHANNEL_MSGQ);
+
+   if ((pid = fork()) == -1)
+   {
+      perror("fork");
+      channel_delete(&channel);
+      channel_release_namespace();
+      exit(EXIT_FAILURE);
+   }
+   if (pid == 0)
+   {
+      exit(chancheck_actuate(&channel, commands));
+   }
+
+   memset(&msg, 0, sizeof(msg));
+   msg.mtype = ID_ACT_SLOT(0);
+   for (i = 1; i <= commands; i++)
+   {
+      for (s = 0; s < CHANCHECK_SIGNALS; s++)
+      {
+         chancheck_pause();
+         kill(pid, SIGUSR1);
+      }
+      chancheck_pause();
+      msg.mvalue = i;
+      msg.frame.cmd.cycle = i;
+      channel_push_block(&channel, &msg);
+   }
+
+   // the termination of a queue, addressed to the slot with no control cycle
+   chancheck_pause();
+   kill(pid, SIGUSR1);
+   memset(&msg, 0, sizeof(msg));
+   msg.mtype = ID_ACT_SLOT(0);
+   msg.mvalue = TERMINATE;
+   channel_push_block(&channel, &msg);
+
+   waitpid(pid, &status, 0);
+   channel_delete(&channel);
+   channel_release_namespace();
+
+   fprintf(stdout, "%-12s %10s %10s %10s\n", "backend", "commands", "signals", "result");
+   fprintf(stdout, "%-12s %10i %10i %10s\n", "msgq", commands, commands * CHANCHECK_SIGNALS + 1,
+      (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS)) ? "ok" : "FAILED");
+   return (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void chancheck_caught(int sig)
+{
+   (void)sig;
+}
+
+static void chancheck_pause(void)
+{
+   const struct timespec pause = { 0, CHANCHECK_PAUSE_NS };
+
+   nanosleep(&pause, NULL);
+}
+
+static int chancheck_actuate(channel_t* channel, int commands)
+{
+   message_t data_msg[BATCH_SIZE];
+   uint32_t last = 0;
+   bool stop = false;
+   int taken = 0;
+   int count;
+   int j;
+
+   channel_create(channel, CH2);
+
+   while (!stop)
+   {
+      count = channel_retrieve_cat_batch(channel, data_msg, BATCH_SIZE, ID_ACT_SLOT(0));
+
+      for (j = 0; j < count; j++)
+      {
+         if (control_terminates(&data_msg[j]))
+         {
+            stop = true;
+            continue;
+         }
+
+         if (data_msg[j].frame.cmd.cycle <= last)
+         {
+            fprintf(stderr, "actuator: command %lu after command %lu\n",
+               (unsigned long)data_msg[j].frame.cmd.cycle, (unsigned long)last);
+            return EXIT_FAILURE;
+         }
+         last = data_msg[j].frame.cmd.cycle;
+         taken++;
+      }
+   }
+
+   if (taken != commands)
+   {
+      fprintf(stderr, "actuator: %i commands taken out of %i\n", taken, commands);
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
@@ -22,147 +22,1635 @@
 #include <sys/msg.h>
 #include <sys/sem.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 
 #include "channel.h"
+#include "ring.h"
+#include "record.h"
+#include "vclock.h"
+#include "metrics.h"
+#include "sysdep.h"
 
 /************************** Constant Definitions *****************************/
 // support for ftok()
 #define PATH      "."
+#define PROJ      'x'
 
 // support for msgrcv()
 #define FCFS       0
 
+// number of messages a shared-memory channel can hold
+#define RING_CAPACITY   1024
+
+// length of the POSIX shared-memory object names
+#define SHM_NAME_LEN    32
+
+// channel namespaces: the marker a run holds while it owns one, and the bit that keeps
+// their keys apart from the ftok() ones
+#define NS_COUNT        0x10000
+#define NS_MARKER       "/controlx-ns-%04x"
+#define NS_KEY_BIT      0x80000000U
+
+// readers a broadcast channel gets when created through channel_create_backend()
+#define BCAST_READERS   1
+
+// lag, as a fraction of the capacity, past which a broadcast reader is reported as slow
+#define BCAST_SLOW_LAG_DIV    2
+
+// the wait strategies of a channel are those of its ring
+_Static_assert((CHANNEL_WAIT_HYBRID == RING_WAIT_HYBRID) && (CHANNEL_WAIT_BLOCK == RING_WAIT_BLOCK) &&
+   (CHANNEL_WAIT_YIELD == RING_WAIT_YIELD) && (CHANNEL_WAIT_SPIN == RING_WAIT_SPIN) &&
+   (CHANNEL_WAIT_ADAPTIVE == RING_WAIT_ADAPTIVE), "channel and ring wait strategies differ");
+
+// polling period of channel_select() on kernels without futex_waitv()
+#define SELECT_POLL_NS  100000L
+
+// events a channel raises on the virtual clock: a message pushed, a message taken
+#define DATA_EVENT(channel_ptr)     VCLOCK_EVENT(2 * (channel_ptr)->seed)
+#define ROOM_EVENT(channel_ptr)     VCLOCK_EVENT(2 * (channel_ptr)->seed + 1)
+
+/**************************** Type Definitions ******************************/
+// bell of a message queue, in shared memory: every push rings it, channel_select() sleeps on it
+struct channel_bell_s
+{
+   _Atomic uint32_t seq;         /**< futex bumped by a push while someone sleeps on it */
+   _Atomic uint32_t waiters;     /**< processes sleeping on seq */
+};
+
+/************************** Variable Definitions *****************************/
+// namespace claimed by the run, inherited by the processes it forks, -1 for none
+static int channel_ns = -1;
+
+static const char* channel_wait_names[] = { "hybrid", "block", "yield", "spin", "adaptive" };
+
+// how eagerly each strategy waits: channel_select() waits as the most eager of its channels
+static const int channel_wait_rank[] = { 1, 0, 3, 4, 2 };
+
+/************************** Private Functions *****************************/
+static void channel_shm_name(const channel_t* channel_ptr, char* name)
+{
+   // derive the name from the System V key so both backends share a namespace
+   snprintf(name, SHM_NAME_LEN, "/controlx-%08x", (unsigned int)channel_ptr->ch_key);
+}
+
+// in a simulation the producers waiting for room on the channel look again once a message is taken
+static inline int channel_taken(const channel_t* channel_ptr, int taken)
+{
+   if (taken > 0)
+   {
+      metrics_channel_out(channel_ptr->seed, taken);
+      vclock_notify(ROOM_EVENT(channel_ptr));
+   }
+   return taken;
+}
+
+// a message pushed on a queue wakes up the processes selecting on it
+static inline void channel_ring_bell(const channel_t* channel_ptr)
+{
+   struct channel_bell_s* bell = channel_ptr->bell;
+
+   if (bell == NULL)
+   {
+      return;
+   }
+
+   // pairs with the fence of channel_sleep(): either the sleeper sees the message or the bell sees the sleeper
+   atomic_thread_fence(memory_order_seq_cst);
+   if (atomic_load_explicit(&bell->waiters, memory_order_relaxed) > 0)
+   {
+      atomic_fetch_add_explicit(&bell->seq, 1, memory_order_release);
+      sysdep_futex_wake(&bell->seq);
+   }
+}
+
+// a message pushed wakes up the consumers waiting on the virtual clock
+static inline void channel_pushed(const channel_t* channel_ptr, int count)
+{
+   metrics_channel_in(channel_ptr->seed, count);
+   vclock_notify(DATA_EVENT(channel_ptr));
+}
+
+// pushes without blocking, a full channel is not a drop yet
+static bool channel_push_try(channel_t* channel_ptr, message_t* data)
+{
+   bool pushed;
+
+   if (channel_ptr->ring != NULL)
+   {
+      pushed = ring_push(channel_ptr->ring, data);
+   }
+   else if ((pushed = msgsnd(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), IPC_NOWAIT) != -1))
+   {
+      channel_ring_bell(channel_ptr);
+   }
+
+   if (pushed)
+   {
+      record_append(channel_ptr->seed, data);
+      channel_pushed(channel_ptr, 1);
+   }
+   return pushed;
+}
+
+// on a message queue every look is a system call: only the strategies that never sleep poll it
+static inline bool channel_msgq_polls(const channel_t* channel_ptr)
+{
+   return (channel_ptr->wait == CHANNEL_WAIT_SPIN) || (channel_ptr->wait == CHANNEL_WAIT_YIELD);
+}
+
+// a signal caught while waiting on a queue, e.g. a change of log level, is not a failure
+static bool channel_msgq_receive(channel_t* channel_ptr, message_t* data, long category)
+{
+   while (channel_msgq_polls(channel_ptr))
+   {
+      if (msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), category, IPC_NOWAIT) != -1)
+      {
+         return true;
+      }
+      if ((errno != ENOMSG) && (errno != EINTR))
+      {
+         return false;
+      }
+      if (channel_ptr->wait == CHANNEL_WAIT_YIELD)
+      {
+         sched_yield();
+      }
+   }
+
+   while (msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), category, 0) == -1)
+   {
+      if (errno != EINTR)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+static bool channel_msgq_send(channel_t* channel_ptr, message_t* data)
+{
+   while (channel_msgq_polls(channel_ptr))
+   {
+      if (msgsnd(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), IPC_NOWAIT) != -1)
+      {
+         channel_ring_bell(channel_ptr);
+         return true;
+      }
+      if ((errno != EAGAIN) && (errno != EINTR))
+      {
+         return false;
+      }
+      if (channel_ptr->wait == CHANNEL_WAIT_YIELD)
+      {
+         sched_yield();
+      }
+   }
+
+   while (msgsnd(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), 0) == -1)
+   {
+      if (errno != EINTR)
+      {
+         return false;
+      }
+   }
+   channel_ring_bell(channel_ptr);
+   return true;
+}
+
+static unsigned int channel_ring_flags(channel_backend_t backend)
+{
+   switch (backend)
+   {
+   case CHANNEL_SHM_MPSC:
+      return RING_MULTI_PRODUCER;
+   case CHANNEL_SHM_MPMC:
+      return RING_MULTI_PRODUCER | RING_MULTI_CONSUMER;
+   case CHANNEL_SHM_SPSC:
+   default:
+      return RING_SINGLE;
+   }
+}
+
+/**
+* @brief Maps the ring of a shared-memory channel, creating it when it does not exist yet.
+*/
+static void channel_shm_attach(channel_t* channel_ptr, int readers)
+{
+   char name[SHM_NAME_LEN];
+   struct stat shm_stat;
+   bool creator = true;
+   size_t size;
+   void* ptr;
+   int fd;
+
+   channel_shm_name(channel_ptr, name);
+   size = ring_footprint(RING_CAPACITY, sizeof(message_t), _Alignof(message_t));
+
+   if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0664)) == -1)
+   {
+      creator = false;
+      if ((errno != EEXIST) || ((fd = shm_open(name, O_RDWR, 0)) == -1))
+      {
+         perror("shm_open");
+         return;
+      }
+   }
+
+   if (creator)
+   {
+      if (ftruncate(fd, size) == -1)
+      {
+         perror("ftruncate");
+         close(fd);
+         return;
+      }
+   }
+   else
+   {
+      // the creator may not have sized the object yet
+      do
+      {
+         if (fstat(fd, &shm_stat) == -1)
+         {
+            perror("fstat");
+            close(fd);
+            return;
+         }
+         sched_yield();
+      } while (shm_stat.st_size == 0);
+
+      if ((size_t)shm_stat.st_size < size)
+      {
+         fprintf(stderr, "channel %i: shared-memory object %s has an unexpected size\n",
+            channel_ptr->seed, name);
+         close(fd);
+         return;
+      }
+   }
+
+   ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (ptr == MAP_FAILED)
+   {
+      perror("mmap");
+      return;
+   }
+
+   if (creator && (channel_ptr->backend == CHANNEL_SHM_BCAST))
+   {
+      ring_init_broadcast(ptr, RING_CAPACITY, sizeof(message_t), _Alignof(message_t), readers);
+   }
+   else if (creator)
+   {
+      ring_init(ptr, RING_CAPACITY, sizeof(message_t), _Alignof(message_t),
+         channel_ring_flags(channel_ptr->backend));
+   }
+   else
+   {
+      while (!ring_ready(ptr))
+      {
+         sched_yield();
+      }
+   }
+
+   channel_ptr->ring = ptr;
+   channel_ptr->ring_size = size;
+}
+
+/**
+* @brief Maps the bell of a message-queue channel, creating it when it does not exist yet.
+*
+* @details The bell takes the shared-memory name a ring of the channel would have. A new
+*     object is zero-filled, which is a bell nobody sleeps on; sizing it again to the same
+*     length leaves it as it is, so the processes opening it together need no handshake.
+*/
+static void channel_bell_attach(channel_t* channel_ptr)
+{
+   char name[SHM_NAME_LEN];
+   void* ptr;
+   int fd;
+
+   channel_shm_name(channel_ptr, name);
+   if ((fd = shm_open(name, O_RDWR | O_CREAT, 0664)) == -1)
+   {
+      perror("shm_open");
+      return;
+   }
+
+   if (ftruncate(fd, sizeof(struct channel_bell_s)) == -1)
+   {
+      perror("ftruncate");
+      close(fd);
+      return;
+   }
+
+   ptr = mmap(NULL, sizeof(struct channel_bell_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (ptr == MAP_FAILED)
+   {
+      perror("mmap");
+      return;
+   }
+
+   channel_ptr->bell = ptr;
+}
+
+/**
+* @brief Sleeps until a message is pushed on any of the channels or a deadline expires.
+*
+* @details The caller is counted among the sleepers of every ring and of the bell of
+*     every message queue, then sleeps on all of their futexes at once, so the first
+*     push wakes it up. Spurious wake-ups are possible: the caller shall check again
+*     the channels. Without futex_waitv() support, or without the bell of a queue, the
+*     channels are polled instead. At most CHANNEL_SELECT_MAX channels, as channel_select()
+*     makes sure.
+*/
+static void channel_sleep(channel_t** channels, int count, const struct timespec* deadline)
+{
+   _Atomic uint32_t* words[CHANNEL_SELECT_MAX];
+   uint32_t values[CHANNEL_SELECT_MAX];
+   const struct timespec poll = { 0, SELECT_POLL_NS };
+   struct channel_bell_s* bell;
+   bool ready = false;
+   bool blind = false;
+   int armed = 0;
+   int i;
+
+   for (i = 0; i < count; i++)
+   {
+      if (channels[i]->ring != NULL)
+      {
+         ready = ring_wait_arm(channels[i]->ring, channels[i]->reader, &words[armed], &values[armed]) || ready;
+         armed++;
+      }
+      else if ((bell = channels[i]->bell) != NULL)
+      {
+         atomic_fetch_add_explicit(&bell->waiters, 1, memory_order_seq_cst);
+         atomic_thread_fence(memory_order_seq_cst);
+         words[armed] = &bell->seq;
+         values[armed++] = atomic_load_explicit(&bell->seq, memory_order_acquire);
+         ready = channel_ready(channels[i]) || ready;
+      }
+      else
+      {
+         blind = true;
+      }
+   }
+
+   if (!ready && (blind || (sysdep_futex_waitv(words, values, armed, deadline) == -1)))
+   {
+      nanosleep(&poll, NULL);
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      if (channels[i]->ring != NULL)
+      {
+         ring_wait_disarm(channels[i]->ring);
+      }
+      else if (channels[i]->bell != NULL)
+      {
+         atomic_fetch_sub_explicit(&channels[i]->bell->waiters, 1, memory_order_relaxed);
+      }
+   }
+}
+
+/**
+* @brief Returns the per-process buffer standing in for a ring slot on a message queue.
+*/
+static message_t* channel_stage(channel_t* channel_ptr)
+{
+   if (channel_ptr->stage == NULL)
+   {
+      channel_ptr->stage = aligned_alloc(_Alignof(message_t), sizeof(message_t));
+   }
+   return channel_ptr->stage;
+}
+
+/**
+* @brief Returns the cursor of the process on a broadcast channel, claiming one on first use.
+*/
+static int channel_reader(channel_t* channel_ptr)
+{
+   if ((channel_ptr->reader < 0) && !channel_subscribe(channel_ptr))
+   {
+      fprintf(stderr, "channel %i: no broadcast reader left for process %i\n", channel_ptr->seed, getpid());
+   }
+   return channel_ptr->reader;
+}
+
+static bool channel_match_category(const void* elem, long category)
+{
+   long mtype = ((const message_t*)elem)->mtype;
+
+   // same selection rules as msgrcv(), applied to the oldest message only
+   if (category > 0)
+   {
+      return mtype == category;
+   }
+   return (category == 0) || (mtype <= -category);
+}
+
+static int channel_key(int seed)
+{
+   if (channel_ns >= 0)
+   {
+      return (int)(NS_KEY_BIT | ((unsigned int)(seed & CHANNEL_ID_MAX) << 16) | (unsigned int)channel_ns);
+   }
+
+   // ftok() only keeps 8 bits of the project identifier: the seed takes the bits of
+   // the project and of the device instead, and the inode keeps apart the trees
+   return (int)(((unsigned int)ftok(PATH, PROJ) & 0xffffU) | ((unsigned int)(seed & CHANNEL_ID_MAX) << 16));
+}
+
+static void channel_open(channel_t* channel_ptr, int seed, channel_backend_t backend, int readers)
+{
+   // a descriptor inherited through fork() is open already, the queue or ring is not looked up again
+   if ((channel_ptr->seed == seed) && (channel_ptr->backend == backend)
+      && ((channel_ptr->ring != NULL) || ((backend == CHANNEL_MSGQ) && (channel_ptr->ch_id != -1))))
+   {
+      return;
+   }
+
+   channel_ptr->ch_key = channel_key(seed);
+   channel_ptr->seed = seed;
+   channel_ptr->backend = backend;
+   channel_ptr->ring = NULL;
+   channel_ptr->ring_size = 0;
+   channel_ptr->bell = NULL;
+   channel_ptr->reader = -1;
+   metrics_channel_open(seed, backend, readers);
+
+   if (backend != CHANNEL_MSGQ)
+   {
+      channel_ptr->ch_id = -1;
+      channel_shm_attach(channel_ptr, readers);
+      return;
+   }
+
+   if((channel_ptr->ch_id = msgget(channel_ptr->ch_key, IPC_CREAT | IPC_EXCL | 0664)) == -1)
+   {
+      if(errno == EEXIST)
+      {
+         channel_ptr->ch_id = msgget(channel_ptr->ch_key, 0);
+      }
+   }
+
+   channel_bell_attach(channel_ptr);
+}
+
+/**
+* @brief Creates a channel.
+*
+* @details If the descriptor already refers to the channel identified by seed (e.g. it
+*     was created before a fork()), it is used as it is, with the same backend.
+*     Otherwise a message-queue channel is created. The descriptor shall be
+*     zero-initialised before its first use.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in]     seed        identifier used to connect to a shared channel, 1 to CHANNEL_ID_MAX
+*
+* @return none
+*/
+void channel_create(channel_t* channel_ptr, int seed)
+{
+   channel_create_backend(channel_ptr, seed,
+      (channel_ptr->seed == seed) ? channel_ptr->backend : CHANNEL_MSGQ);
+}
+
+/**
+* @brief Creates a channel on top of the specified communication mechanism.
+*
+* @details All processes sharing a channel shall use the same backend. A descriptor
+*     already open on the channel, its ring mapped or its queue looked up (e.g. inherited
+*     through fork()), is left untouched.
+*     A broadcast channel created here has a single consumer, see channel_create_broadcast().
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in]     seed        identifier used to connect to a shared channel, 1 to CHANNEL_ID_MAX
+* @param[in]     backend     communication mechanism backing the channel
+*
+* @return none
+*/
+void channel_create_backend(channel_t* channel_ptr, int seed, channel_backend_t backend)
+{
+   channel_open(channel_ptr, seed, backend, BCAST_READERS);
+}
+
+/**
+* @brief Creates a broadcast channel, on which every consumer gets every message.
+*
+* @details The consumers are fixed at creation: the producer waits for all of them,
+*     even for those that have not retrieved anything yet, so none misses a message.
+*     Each consumer process takes one of them with channel_subscribe(), or on its
+*     first retrieve. A consumer leaving early shall call channel_unsubscribe().
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in]     seed        identifier used to connect to a shared channel, 1 to CHANNEL_ID_MAX
+* @param[in]     readers     number of consumers, at most RING_READERS_MAX
+*
+* @return none
+*/
+void channel_create_broadcast(channel_t* channel_ptr, int seed, int readers)
+{
+   channel_open(channel_ptr, seed, CHANNEL_SHM_BCAST, readers);
+}
+
+/**
+* @brief Deletes a channel.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+*
+* @return none
+*/
+void channel_delete(channel_t* channel_ptr)
+{
+   char name[SHM_NAME_LEN];
+
+   free(channel_ptr->stage);
+   channel_ptr->stage = NULL;
+
+   if (channel_ptr->ring != NULL)
+   {
+      channel_unsubscribe(channel_ptr);
+      channel_shm_name(channel_ptr, name);
+      shm_unlink(name);
+      munmap(channel_ptr->ring, channel_ptr->ring_size);
+      channel_ptr->ring = NULL;
+      return;
+   }
+
+   if (channel_ptr->bell != NULL)
+   {
+      channel_shm_name(channel_ptr, name);
+      shm_unlink(name);
+      munmap(channel_ptr->bell, sizeof(struct channel_bell_s));
+      channel_ptr->bell = NULL;
+   }
+
+   msgctl(channel_ptr->ch_id, IPC_RMID, NULL);
+   channel_ptr->ch_id = -1;
+}
+
+/**
+* @brief Claims a channel namespace of its own for the run.
+*
+* @details Without a namespace, channels are keyed on the working directory, so two
+*     runs started in the same one share their channels. A namespace is held through a
+*     marker in the shared-memory file system, created exclusively, starting from the
+*     pid of the caller and moving on while taken. Shall be called before the channels
+*     are created; the processes forked afterwards inherit it.
+*
+* @return the namespace, -1 if none is left
+*/
+int channel_claim_namespace(void)
+{
+   char name[SHM_NAME_LEN];
+   int ns;
+   int i;
+   int fd;
+
+   for (i = 0; i < NS_COUNT; i++)
+   {
+      ns = (getpid() + i) % NS_COUNT;
+      snprintf(name, SHM_NAME_LEN, NS_MARKER, ns);
+      if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0664)) != -1)
+      {
+         close(fd);
+         channel_ns = ns;
+         return ns;
+      }
+      if (errno != EEXIST)
+      {
+         perror("shm_open");
+         return -1;
+      }
+   }
+
+   fprintf(stderr, "no channel namespace left, remove the stale /dev/shm/controlx-ns-* markers\n");
+   return -1;
+}
+
+/**
+* @brief Gives back the namespace of the run, once its channels are deleted.
+*
+* @return none
+*/
+void channel_release_namespace(void)
+{
+   char name[SHM_NAME_LEN];
+
+   if (channel_ns < 0)
+   {
+      return;
+   }
+   snprintf(name, SHM_NAME_LEN, NS_MARKER, channel_ns);
+   shm_unlink(name);
+   channel_ns = -1;
+}
+
+/**
+* @brief Connects to an existing channel.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+*
+* @return none
+*/
+void channel_connect(channel_t* channel_ptr)
+{
+   return;
+}
+
+/**
+* @brief Retrieves the first message from a channel. The calling process is not blocked
+*     if there are no messages available on the channel.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        pointer to a user-allocated message_t structure
+*
+* @return true if a message was retrieved
+*/
+bool channel_retrieve_nonblock(channel_t* channel_ptr, message_t* data)
+{
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      return channel_taken(channel_ptr, (channel_reader(channel_ptr) >= 0) &&
+         ring_read_if(channel_ptr->ring, channel_ptr->reader, data, NULL, 0));
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      return channel_taken(channel_ptr, ring_pop(channel_ptr->ring, data));
+   }
+
+   return channel_taken(channel_ptr,
+      msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), FCFS, IPC_NOWAIT) != -1);
+}
+
+/**
+* @brief Retrieves the first message from a channel. The calling process is blocked
+*     until a message is delivered to the channel.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        pointer to a user-allocated message_t structure
+*
+* @return true if a message was retrieved, false if the channel failed
+*/
+bool channel_retrieve_block(channel_t* channel_ptr, message_t* data)
+{
+   uint32_t generation;
+   uint64_t since;
+   bool retrieved = false;
+
+   // in a simulation the process waits on the virtual clock, which every push wakes up
+   while (vclock_enabled())
+   {
+      generation = vclock_generation();
+      if (channel_retrieve_nonblock(channel_ptr, data))
+      {
+         return true;
+      }
+      vclock_wait(DATA_EVENT(channel_ptr), generation, VCLOCK_NEVER);
+   }
+
+   // with the metrics on, the channel is tried first so that only a real wait is timed
+   if (((since = metrics_clock()) != 0) && channel_retrieve_nonblock(channel_ptr, data))
+   {
+      return true;
+   }
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      if (channel_reader(channel_ptr) >= 0)
+      {
+         ring_read_if_wait(channel_ptr->ring, channel_ptr->reader, data, NULL, 0);
+         retrieved = true;
+      }
+   }
+   else if (channel_ptr->ring != NULL)
+   {
+      ring_pop_wait(channel_ptr->ring, data);
+      retrieved = true;
+   }
+   else
+   {
+      retrieved = channel_msgq_receive(channel_ptr, data, FCFS);
+   }
+
+   if (retrieved)
+   {
+      metrics_channel_out(channel_ptr->seed, 1);
+   }
+   metrics_channel_blocked(channel_ptr->seed, false, since);
+   return retrieved;
+}
+
+/**
+* @brief Retrieves the first message with the specified category. The calling process is not blocked
+*     if there are no messages available on the channel.
+*
+* @details On the shared-memory backends the channel keeps a strict FIFO order and
+*     only the oldest message is matched against the category.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        pointer to a user-allocated message_t structure
+* @param[in]     category    message category to retrieve
+*
+* @return true if a message was retrieved
+*/
+bool channel_retrieve_cat_nonblock(channel_t* channel_ptr, message_t* data, long category)
+{
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      return channel_taken(channel_ptr, (channel_reader(channel_ptr) >= 0) &&
+         ring_read_if(channel_ptr->ring, channel_ptr->reader, data, channel_match_category, category));
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      return channel_taken(channel_ptr, ring_pop_if(channel_ptr->ring, data, channel_match_category, category));
+   }
+
+   return channel_taken(channel_ptr,
+      msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), category, IPC_NOWAIT) != -1);
+}
+
+/**
+* @brief Retrieves the first message with the specified category. The calling process is blocked
+*     until a message is delivered to the channel.
+*
+* @details On the shared-memory backends the channel keeps a strict FIFO order and
+*     only the oldest message is matched against the category.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        pointer to a user-allocated message_t structure
+* @param[in]     category    message category to retrieve
+*
+* @return true if a message was retrieved, false if the channel failed
+*/
+bool channel_retrieve_cat_block(channel_t* channel_ptr, message_t* data, long category)
+{
+   uint32_t generation;
+   uint64_t since;
+   bool retrieved = false;
+
+   while (vclock_enabled())
+   {
+      generation = vclock_generation();
+      if (channel_retrieve_cat_nonblock(channel_ptr, data, category))
+      {
+         return true;
+      }
+      vclock_wait(DATA_EVENT(channel_ptr), generation, VCLOCK_NEVER);
+   }
+
+   if (((since = metrics_clock()) != 0) && channel_retrieve_cat_nonblock(channel_ptr, data, category))
+   {
+      return true;
+   }
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      if (channel_reader(channel_ptr) >= 0)
+      {
+         ring_read_if_wait(channel_ptr->ring, channel_ptr->reader, data, channel_match_category, category);
+         retrieved = true;
+      }
+   }
+   else if (channel_ptr->ring != NULL)
+   {
+      ring_pop_if_wait(channel_ptr->ring, data, channel_match_category, category);
+      retrieved = true;
+   }
+   else
+   {
+      retrieved = channel_msgq_receive(channel_ptr, data, category);
+   }
+
+   if (retrieved)
+   {
+      metrics_channel_out(channel_ptr->seed, 1);
+   }
+   metrics_channel_blocked(channel_ptr->seed, false, since);
+   return retrieved;
+}
+
+/**
+* @brief Pushes data to a channel. The calling process is not blocked
+*     if the channel is full: in that case the message is dropped.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in ]    data        pointer to a user-allocated message_t structure
+*
+* @return true if the message was pushed
+*/
+bool channel_push_nonblock(channel_t* channel_ptr, message_t* data)
+{
+   if (channel_push_try(channel_ptr, data))
+   {
+      return true;
+   }
+   metrics_channel_drop(channel_ptr->seed);
+   return false;
+}
+
+/**
+* @brief Pushes data to a channel. The calling process is blocked
+*     while the channel is full.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in ]    data        pointer to a user-allocated message_t structure
+*
+* @return none
+*/
+void channel_push_block(channel_t* channel_ptr, message_t* data)
+{
+   uint32_t generation;
+   uint64_t since;
+
+   // a producer blocked for real would hold the virtual clock, and the consumers with it
+   while (vclock_enabled())
+   {
+      generation = vclock_generation();
+      if (channel_push_try(channel_ptr, data))
+      {
+         return;
+      }
+      vclock_wait(ROOM_EVENT(channel_ptr), generation, VCLOCK_NEVER);
+   }
+
+   if (((since = metrics_clock()) != 0) && channel_push_try(channel_ptr, data))
+   {
+      return;
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      record_append(channel_ptr->seed, data);
+      ring_push_wait(channel_ptr->ring, data);
+   }
+   else if (channel_msgq_send(channel_ptr, data))
+   {
+      record_append(channel_ptr->seed, data);
+   }
+   else
+   {
+      // a send that failed, or was interrupted, delivered nothing a replay could inject
+      return;
+   }
+
+   metrics_channel_in(channel_ptr->seed, 1);
+   metrics_channel_blocked(channel_ptr->seed, true, since);
+}
+
+/**
+* @brief Pushes several messages to a channel. The calling process is blocked
+*     while the channel is full.
+*
+* @details On the shared-memory backends the messages are published with a single
+*     update of the ring; a message queue still needs one msgsnd() per message.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in ]    data        array of user-allocated message_t structures
+* @param[in]     count       number of messages to push
+*
+* @return number of messages pushed
+*/
+int channel_push_batch(channel_t* channel_ptr, message_t* data, int count)
+{
+   uint64_t since;
+   int pushed;
+   int i;
+
+   if (count <= 0)
+   {
+      return 0;
+   }
+
+   if (vclock_enabled())
+   {
+      for (i = 0; i < count; i++)
+      {
+         channel_push_block(channel_ptr, &data[i]);
+      }
+      return count;
+   }
+
+   since = metrics_clock();
+
+   if (channel_ptr->ring != NULL)
+   {
+      for (i = 0; i < count; i++)
+      {
+         record_append(channel_ptr->seed, &data[i]);
+      }
+      // only the part that does not fit right away is a wait
+      pushed = (since != 0) ? (int)ring_push_batch(channel_ptr->ring, data, count) : 0;
+      if (pushed < count)
+      {
+         since = (pushed > 0) ? metrics_clock() : since;
+         ring_push_batch_wait(channel_ptr->ring, data + pushed, count - pushed);
+         metrics_channel_blocked(channel_ptr->seed, true, since);
+      }
+      metrics_channel_in(channel_ptr->seed, count);
+      return count;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      if (!channel_msgq_send(channel_ptr, &data[i]))
+      {
+         break;
+      }
+      record_append(channel_ptr->seed, &data[i]);
+   }
+   metrics_channel_in(channel_ptr->seed, i);
+   return i;
+}
+
+/**
+* @brief Retrieves up to max messages from a channel. The calling process is blocked
+*     until at least one message is delivered to the channel.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        array of at least max user-allocated message_t structures
+* @param[in]     max         maximum number of messages to retrieve
+*
+* @return number of messages retrieved, in FIFO order, 0 if the channel failed
+*/
+int channel_retrieve_batch(channel_t* channel_ptr, message_t* data, int max)
+{
+   uint32_t generation;
+   uint64_t since;
+   int count;
+
+   if (max <= 0)
+   {
+      return 0;
+   }
+
+   while (vclock_enabled())
+   {
+      generation = vclock_generation();
+      if ((count = channel_drain(channel_ptr, data, max)) > 0)
+      {
+         return count;
+      }
+      vclock_wait(DATA_EVENT(channel_ptr), generation, VCLOCK_NEVER);
+   }
+
+   if (((since = metrics_clock()) != 0) && ((count = channel_drain(channel_ptr, data, max)) > 0))
+   {
+      return count;
+   }
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      count = (channel_reader(channel_ptr) >= 0) ?
+         (int)ring_read_batch_wait(channel_ptr->ring, channel_ptr->reader, data, max) : 0;
+   }
+   else if (channel_ptr->ring != NULL)
+   {
+      count = ring_pop_batch_wait(channel_ptr->ring, data, max);
+   }
+   else
+   {
+      count = channel_msgq_receive(channel_ptr, data, FCFS) ? 1 : 0;
+   }
+
+   metrics_channel_out(channel_ptr->seed, count);
+   metrics_channel_blocked(channel_ptr->seed, false, since);
+   if ((count == 1) && (channel_ptr->ring == NULL))
+   {
+      count += channel_drain(channel_ptr, data + 1, max - 1);
+   }
+   return count;
+}
+
 /**
-* @brief Creates a channel.
+* @brief Retrieves all the messages available on a channel, up to max. The calling
+*     process is not blocked if there are no messages available on the channel.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[in]     seed        identifier used to connect to a shared channel
+* @param[out]    data        array of at least max user-allocated message_t structures
+* @param[in]     max         maximum number of messages to retrieve
 *
-* @return none
+* @return number of messages retrieved, in FIFO order
 */
-void channel_create(channel_t* channel_ptr, char seed)
+int channel_drain(channel_t* channel_ptr, message_t* data, int max)
 {
-   channel_ptr->ch_key = ftok(PATH, seed);
-   channel_ptr->seed = seed;
+   int i;
 
-   if(channel_ptr->ch_id = msgget(channel_ptr->ch_key, IPC_CREAT | IPC_EXCL | 0664) == -1)
+   if (max <= 0)
    {
-      if(errno == EEXIST)
+      return 0;
+   }
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      i = (channel_reader(channel_ptr) >= 0) ? (int)ring_read_batch(channel_ptr->ring, channel_ptr->reader, data, max) : 0;
+   }
+   else if (channel_ptr->ring != NULL)
+   {
+      i = ring_pop_batch(channel_ptr->ring, data, max);
+   }
+   else
+   {
+      for (i = 0; i < max; i++)
       {
-         channel_ptr->ch_id = msgget(channel_ptr->ch_key, 0);
+         if (msgrcv(channel_ptr->ch_id, (void*)&data[i], sizeof(message_t)-sizeof(long), FCFS, IPC_NOWAIT) == -1)
+         {
+            break;
+         }
       }
    }
+   channel_taken(channel_ptr, i);
+   return i;
 }
 
 /**
-* @brief Deletes a channel.
+* @brief Retrieves up to max messages with the specified category. The calling process
+*     is blocked until at least one of them is delivered to the channel.
+*
+* @details On the shared-memory backends the channel keeps a strict FIFO order and
+*     only the oldest message is matched against the category.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        array of at least max user-allocated message_t structures
+* @param[in]     max         maximum number of messages to retrieve
+* @param[in]     category    message category to retrieve
 *
-* @return none
+* @return number of messages retrieved, in FIFO order, 0 if the channel failed
 */
-void channel_delete(channel_t* channel_ptr)
+int channel_retrieve_cat_batch(channel_t* channel_ptr, message_t* data, int max, long category)
 {
-   msgctl(channel_ptr->ch_id, IPC_RMID, NULL);
+   if (max <= 0)
+   {
+      return 0;
+   }
+
+   if (!channel_retrieve_cat_block(channel_ptr, data, category))
+   {
+      return 0;
+   }
+   return 1 + channel_drain_cat(channel_ptr, data + 1, max - 1, category);
 }
 
 /**
-* @brief Connects to an existing channel.
+* @brief Retrieves all the messages with the specified category available on a channel,
+*     up to max. The calling process is not blocked if there are none.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[out]    data        array of at least max user-allocated message_t structures
+* @param[in]     max         maximum number of messages to retrieve
+* @param[in]     category    message category to retrieve
 *
-* @return none
+* @return number of messages retrieved, in FIFO order
 */
-void channel_connect(channel_t* channel_ptr)
+int channel_drain_cat(channel_t* channel_ptr, message_t* data, int max, long category)
 {
-   return;
+   int i;
+
+   for (i = 0; i < max; i++)
+   {
+      if (!channel_retrieve_cat_nonblock(channel_ptr, &data[i], category))
+      {
+         break;
+      }
+   }
+   return i;
 }
 
 /**
-* @brief Retrieves the first message from a channel. The calling process is not blocked
-*     if there are no messages available on the channel.
+* @brief Reserves room for a message, to be filled in place and pushed with
+*     channel_commit(). The calling process is blocked while the channel is full.
+*
+* @details On the shared-memory backends the message is written straight into the
+*     ring, so it is never copied; a message queue hands out a staging buffer
+*     instead. Only one message per channel can be reserved at a time.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[out]    data        pointer to a user-allocated message_t structure
 *
-* @return none
+* @return message to be filled, owned by the channel
 */
-void channel_retrieve_nonblock(channel_t* channel_ptr, message_t* data)
+message_t* channel_reserve(channel_t* channel_ptr)
 {
-   msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), FCFS, IPC_NOWAIT);
+   message_t* data;
+   uint32_t generation;
+   uint64_t since;
+
+   if (channel_ptr->ring != NULL)
+   {
+      while (vclock_enabled())
+      {
+         generation = vclock_generation();
+         if ((data = ring_reserve(channel_ptr->ring)) != NULL)
+         {
+            return data;
+         }
+         vclock_wait(ROOM_EVENT(channel_ptr), generation, VCLOCK_NEVER);
+      }
+      if (((since = metrics_clock()) != 0) && ((data = ring_reserve(channel_ptr->ring)) != NULL))
+      {
+         return data;
+      }
+      data = ring_reserve_wait(channel_ptr->ring);
+      metrics_channel_blocked(channel_ptr->seed, true, since);
+      return data;
+   }
+
+   return channel_stage(channel_ptr);
 }
 
 /**
-* @brief Retrieves the first message from a channel. The calling process is blocked
-*     until a message is delivered to the channel.
+* @brief Pushes a message obtained from channel_reserve().
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[out]    data        pointer to a user-allocated message_t structure
+* @param[in]     data        message returned by channel_reserve()
 *
 * @return none
 */
-void channel_retrieve_block(channel_t* channel_ptr, message_t* data)
+void channel_commit(channel_t* channel_ptr, message_t* data)
 {
-   msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), FCFS, 0);
+   if (channel_ptr->ring != NULL)
+   {
+      // once committed, a slot of the ring may be taken and reused at any time
+      record_append(channel_ptr->seed, data);
+      ring_commit(channel_ptr->ring, data);
+      channel_pushed(channel_ptr, 1);
+      return;
+   }
+
+   channel_push_block(channel_ptr, data);
 }
 
 /**
-* @brief Retrieves the first message with the specified category. The calling process is not blocked
-*     if there are no messages available on the channel.
+* @brief Retrieves the first message from a channel, to be read in place and handed
+*     back with channel_release(). The calling process is not blocked if there are
+*     no messages available on the channel.
+*
+* @details On the shared-memory backends the message is read straight from the ring,
+*     whose slot is not reused until it is released. Only one message per channel
+*     can be acquired at a time. On a broadcast channel the message is shared with
+*     the other consumers and shall not be modified.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[out]    data        pointer to a user-allocated message_t structure
-* @param[in]     category    message category to retrieve
+*
+* @return message owned by the channel, NULL if the channel is empty
+*/
+message_t* channel_acquire_nonblock(channel_t* channel_ptr)
+{
+   message_t* data;
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      return (channel_reader(channel_ptr) >= 0) ? ring_read_acquire(channel_ptr->ring, channel_ptr->reader) : NULL;
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      return ring_acquire(channel_ptr->ring);
+   }
+
+   data = channel_stage(channel_ptr);
+   if (!channel_taken(channel_ptr,
+      msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), FCFS, IPC_NOWAIT) != -1))
+   {
+      return NULL;
+   }
+   return data;
+}
+
+/**
+* @brief Hands back a message obtained from channel_acquire_nonblock().
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in]     data        message returned by channel_acquire_nonblock()
 *
 * @return none
 */
-void channel_retrieve_cat_nonblock(channel_t* channel_ptr, message_t* data, long category)
+void channel_release(channel_t* channel_ptr, message_t* data)
 {
-   msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), category, IPC_NOWAIT);
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      ring_read_release(channel_ptr->ring, channel_ptr->reader);
+      channel_taken(channel_ptr, true);
+      return;
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      ring_release(channel_ptr->ring, data);
+      channel_taken(channel_ptr, true);
+   }
 }
 
 /**
-* @brief Retrieves the first message with the specified category. The calling process is blocked
-*     until a message is delivered to the channel.
+* @brief Tells whether a message is available on a channel.
+*
+* @details The answer is a snapshot: another process sharing the channel may
+*     retrieve the message first.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+*
+* @return true if a retrieve would not find the channel empty
+*/
+bool channel_ready(channel_t* channel_ptr)
+{
+   struct msqid_ds queue_stat;
+
+   if (channel_ptr->backend == CHANNEL_SHM_BCAST)
+   {
+      return (channel_reader(channel_ptr) >= 0) && ring_reader_has_data(channel_ptr->ring, channel_ptr->reader);
+   }
+
+   if (channel_ptr->ring != NULL)
+   {
+      return ring_has_data(channel_ptr->ring);
+   }
+
+   if (msgctl(channel_ptr->ch_id, IPC_STAT, &queue_stat) == -1)
+   {
+      return false;
+   }
+   return queue_stat.msg_qnum > 0;
+}
+
+/**
+* @brief Waits until at least one of several channels has a message available.
+*
+* @details The caller sleeps on all the channels at once and is woken up by the first
+*     push, or at the timeout: on a shared-memory ring it sleeps on the futex of the
+*     ring, on a message queue on a bell in shared memory that every push on the queue
+*     rings. The caller waits as the most eager wait strategy of
+*     the channels asks: with a channel that spins, it never sleeps. The wait is
+*     accounted to the first channel found ready.
+*
+* @param[in]  channels   array of pointers to the channels to wait on
+* @param[in]  count      number of channels, at most CHANNEL_SELECT_MAX
+* @param[out] ready      array of count flags, set for the channels with a message available
+* @param[in]  timeout_ms maximum waiting time in milliseconds, negative to wait forever
+*
+* @return number of channels with a message available, 0 when the timeout expired,
+*     -1 with errno set to EINVAL when count is past CHANNEL_SELECT_MAX
+*/
+int channel_select(channel_t** channels, int count, bool* ready, int timeout_ms)
+{
+   struct ring_s* rings[CHANNEL_SELECT_MAX];
+   int readers[CHANNEL_SELECT_MAX];
+   channel_wait_t wait = CHANNEL_WAIT_BLOCK;
+   ring_spin_t spin = { 0 };
+   struct timespec deadline;
+   struct timespec now;
+   bool all_rings = true;
+   long left_ns;
+   uint64_t sim_deadline;
+   uint64_t sim_events = 0;
+   uint32_t generation;
+   int lead = 0;
+   int found;
+   int i;
+
+   // the channels past the limit could be neither polled nor slept on
+   if ((count < 0) || (count > CHANNEL_SELECT_MAX))
+   {
+      errno = EINVAL;
+      return -1;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      if (channels[i]->backend == CHANNEL_SHM_BCAST)
+      {
+         channel_reader(channels[i]);
+      }
+      rings[i] = channels[i]->ring;
+      readers[i] = channels[i]->reader;
+      all_rings = all_rings && (rings[i] != NULL);
+      sim_events |= DATA_EVENT(channels[i]);
+      if (channel_wait_rank[channel_get_wait(channels[i])] > channel_wait_rank[wait])
+      {
+         wait = channel_get_wait(channels[i]);
+         lead = i;
+      }
+   }
+
+   if (timeout_ms > 0)
+   {
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += timeout_ms / 1000;
+      deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L)
+      {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000L;
+      }
+   }
+
+   sim_deadline = (timeout_ms > 0) ? vclock_now() + (uint64_t)timeout_ms * 1000000ULL : VCLOCK_NEVER;
+
+   for (;;)
+   {
+      generation = vclock_generation();
+      found = 0;
+      for (i = 0; i < count; i++)
+      {
+         ready[i] = channel_ready(channels[i]);
+         found += ready[i];
+      }
+
+      if ((found > 0) || (timeout_ms == 0))
+      {
+         // the wait is accounted to the channel it ended on
+         for (i = 0; (spin.ring != NULL) && (i < count); i++)
+         {
+            if (ready[i] && (rings[i] != NULL))
+            {
+               spin.ring = rings[i];
+               break;
+            }
+         }
+         ring_spin_end(&spin);
+         return found;
+      }
+
+      // in a simulation the timeout is virtual and the wait is on the clock, which every push wakes up
+      if (vclock_enabled())
+      {
+         if (vclock_now() >= sim_deadline)
+         {
+            return 0;
+         }
+         vclock_wait(sim_events, generation, sim_deadline);
+         continue;
+      }
+
+      if (timeout_ms > 0)
+      {
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         left_ns = (deadline.tv_sec - now.tv_sec) * 1000000000L + (deadline.tv_nsec - now.tv_nsec);
+         if (left_ns <= 0)
+         {
+            ring_spin_end(&spin);
+            return 0;
+         }
+      }
+
+      // the rings spin as the most eager of them; on message queues every look is a
+      // system call, only a strategy that never sleeps polls them
+      if (all_rings)
+      {
+         if (!ring_spin(&spin, rings[lead], false))
+         {
+            // a poll in place of the futexes, on older kernels, only makes the loop look again
+            (void)ring_wait_any(rings, readers, count, (timeout_ms > 0) ? &deadline : NULL);
+         }
+      }
+      else if (wait == CHANNEL_WAIT_YIELD)
+      {
+         sched_yield();
+      }
+      else if (wait != CHANNEL_WAIT_SPIN)
+      {
+         channel_sleep(channels, count, (timeout_ms > 0) ? &deadline : NULL);
+      }
+   }
+}
+
+/**
+* @brief Claims a consumer cursor on a broadcast channel for the calling process.
+*
+* @details Retrieving from a broadcast channel claims one as well, so calling this
+*     function is only needed to fail early when all the cursors are taken. Processes
+*     forked after the claim share the cursor of their parent.
+*
+* @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
+*
+* @return true if the process has a cursor on the channel
+*/
+bool channel_subscribe(channel_t* channel_ptr)
+{
+   if ((channel_ptr->backend != CHANNEL_SHM_BCAST) || (channel_ptr->ring == NULL))
+   {
+      return false;
+   }
+   if (channel_ptr->reader < 0)
+   {
+      channel_ptr->reader = ring_subscribe(channel_ptr->ring);
+   }
+   return channel_ptr->reader >= 0;
+}
+
+/**
+* @brief Gives back the consumer cursor of the calling process on a broadcast channel,
+*     so the producer no longer waits for it.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[out]    data        pointer to a user-allocated message_t structure
-* @param[in]     category    message category to retrieve
 *
 * @return none
 */
-void channel_retrieve_cat_block(channel_t* channel_ptr, message_t* data, long category)
+void channel_unsubscribe(channel_t* channel_ptr)
 {
-   msgrcv(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), category, 0);
+   if ((channel_ptr->backend == CHANNEL_SHM_BCAST) && (channel_ptr->reader >= 0))
+   {
+      ring_unsubscribe(channel_ptr->ring, channel_ptr->reader);
+      channel_ptr->reader = -1;
+   }
 }
 
 /**
-* @brief Pushes data to a channel. The calling process is not blocked
-*     if there are no messages available on the channel.
+* @brief Prints the progress of every consumer of a broadcast channel.
+*
+* @details A consumer is reported as slow when the producer had to wait for it, or
+*     when it fell behind by more than half the capacity of the channel. Nothing is
+*     printed for the other backends.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[in ]    data        pointer to a user-allocated message_t structure
+* @param[in]     out         stream the report is printed on
 *
 * @return none
 */
-void channel_push_nonblock(channel_t* channel_ptr, message_t* data)
+void channel_report_readers(channel_t* channel_ptr, FILE* out)
 {
-   msgsnd(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), 0);
+   static const char* states[] = { "never subscribed", "subscribed", "detached" };
+   ring_reader_stats_t stats;
+   uint32_t slow_lag;
+   int i;
+
+   if ((channel_ptr->backend != CHANNEL_SHM_BCAST) || (channel_ptr->ring == NULL))
+   {
+      return;
+   }
+
+   slow_lag = ring_capacity(channel_ptr->ring) / BCAST_SLOW_LAG_DIV;
+   for (i = 0; ring_reader_stats(channel_ptr->ring, i, &stats); i++)
+   {
+      fprintf(out, "channel %i: reader %i %s, %lu received, lag %lu (max %lu), "
+         "producer stalled %lu times for %.3f ms%s\n", channel_ptr->seed, i,
+         states[stats.state], (unsigned long)stats.received, (unsigned long)stats.lag,
+         (unsigned long)stats.max_lag, (unsigned long)stats.stalls, stats.stall_ns / 1e6,
+         ((stats.stalls > 0) || (stats.max_lag > slow_lag)) ? ", slow consumer" : "");
+   }
 }
 
 /**
-* @brief Retrieves the first message with the specified category. The calling process is blocked
-*     until a message is delivered to the channel.
+* @brief Sets how the processes blocked on a channel wait.
+*
+* @details On the shared-memory backends the strategy is kept in the ring and holds
+*     for all the processes of the channel from their next wait on; on a message queue
+*     it only holds for the calling process and those it forks afterwards. In
+*     channel_select() a process waits as the most eager of the channels it selects.
 *
 * @param[inout] channel_ptr pointer to a struct channel_t with channel configuration
-* @param[in ]    data        pointer to a user-allocated message_t structure
+* @param[in]     wait        wait strategy
 *
 * @return none
 */
-void channel_push_block(channel_t* channel_ptr, message_t* data)
+void channel_set_wait(channel_t* channel_ptr, channel_wait_t wait)
+{
+   channel_ptr->wait = wait;
+   if (channel_ptr->ring != NULL)
+   {
+      ring_set_wait(channel_ptr->ring, (uint32_t)wait);
+   }
+}
+
+/**
+* @brief Returns how the processes blocked on a channel wait.
+*
+* @param[in] channel_ptr pointer to a struct channel_t with channel configuration
+*
+* @return wait strategy of the channel
+*/
+channel_wait_t channel_get_wait(const channel_t* channel_ptr)
+{
+   return (channel_ptr->ring != NULL) ? (channel_wait_t)ring_get_wait(channel_ptr->ring) : channel_ptr->wait;
+}
+
+/**
+* @brief Parses the name of a wait strategy: hybrid, block, yield, spin or adaptive.
+*
+* @param[in] name name of the strategy
+*
+* @return the strategy, -1 if the name is not known
+*/
+int channel_parse_wait(const char* name)
+{
+   int wait;
+
+   for (wait = CHANNEL_WAIT_HYBRID; wait <= CHANNEL_WAIT_ADAPTIVE; wait++)
+   {
+      if (strcmp(name, channel_wait_names[wait]) == 0)
+      {
+         return wait;
+      }
+   }
+   return -1;
+}
+
+/**
+* @brief Parses the wait strategies of several channels, e.g. "control=spin:voter=adaptive".
+*
+* @param[in]  spec  list of name=strategy entries separated by ':'
+* @param[in]  names names the entries may use, of the channels or of the processes waiting on them
+* @param[in]  count number of names
+* @param[out] waits strategy of each name, left untouched for the names the list omits
+*
+* @return 0 on success, -1 if the list is not valid
+*/
+int channel_parse_waits(const char* spec, const char* const* names, int count, channel_wait_t* waits)
+{
+   char entry[SHM_NAME_LEN];
+   const char* cursor = spec;
+   char* strategy;
+   size_t length;
+   int wait;
+   int i;
+
+   while (*cursor != '\0')
+   {
+      length = strcspn(cursor, ":");
+      if ((length == 0) || (length >= sizeof(entry)))
+      {
+         return -1;
+      }
+      memcpy(entry, cursor, length);
+      entry[length] = '\0';
+      cursor += length + ((cursor[length] == ':') ? 1 : 0);
+
+      if ((strategy = strchr(entry, '=')) == NULL)
+      {
+         return -1;
+      }
+      *strategy++ = '\0';
+
+      for (i = 0; (i < count) && (strcmp(entry, names[i]) != 0); i++)
+      {
+      }
+      if ((i == count) || ((wait = channel_parse_wait(strategy)) == -1))
+      {
+         return -1;
+      }
+      waits[i] = (channel_wait_t)wait;
+   }
+   return 0;
+}
+
+/**
+* @brief Gives the name of a wait strategy, as accepted by channel_parse_wait().
+*
+* @param[in] wait wait strategy
+*
+* @return name of the strategy
+*/
+const char* channel_wait_name(channel_wait_t wait)
+{
+   return ((wait >= CHANNEL_WAIT_HYBRID) && (wait <= CHANNEL_WAIT_ADAPTIVE)) ? channel_wait_names[wait] : "?";
+}
+
+/**
+* @brief Prints how often the processes waited on a shared-memory channel, and how.
+*
+* @details For each side of the channel, the waits over while spinning and those that
+*     slept; with the adaptive strategy, the usual wait and whether the next one spins.
+*     Nothing is printed for a message queue.
+*
+* @param[in] channel_ptr pointer to a struct channel_t with channel configuration
+* @param[in] out         stream the report is written to
+*
+* @return none
+*/
+void channel_report_waits(channel_t* channel_ptr, FILE* out)
 {
-   msgsnd(channel_ptr->ch_id, (void*)data, sizeof(message_t)-sizeof(long), IPC_NOWAIT);
+   static const char* sides[] = { "data", "room" };
+   ring_wait_stats_t stats;
+   int side;
+
+   if (channel_ptr->ring == NULL)
+   {
+      return;
+   }
+
+   for (side = 0; side < 2; side++)
+   {
+      ring_wait_stats(channel_ptr->ring, side == 1, &stats);
+      fprintf(out, "channel %i: %s wait for %s, %lu waits spun through, %lu slept", channel_ptr->seed,
+         channel_wait_name((channel_wait_t)stats.strategy), sides[side], (unsigned long)stats.spun,
+         (unsigned long)stats.slept);
+      if (stats.strategy == RING_WAIT_ADAPTIVE)
+      {
+         fprintf(out, ", usually %.1f us, %s", stats.avg_ns / 1e3, stats.spinning ? "spinning" : "sleeping");
+      }
+      fprintf(out, "\n");
+   }
 }
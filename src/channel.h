@@ -20,32 +20,111 @@
 #ifndef CHANNEL_H
 #define CHANNEL_H
 
+/***************************** Include Files ********************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "frame.h"
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Maximum number of channels passed to a single channel_select(), which fails
+ *       with EINVAL on more rather than leave some of them out of the wait
+ */
+#define CHANNEL_SELECT_MAX    SYSDEP_WAITV_MAX
+
+/**
+ * @brief Largest seed of a channel
+ */
+#define CHANNEL_ID_MAX        0x7fff
+
 /**************************** Type Definitions ******************************/
 /**
  * @brief Abstract representation of data exchanged in a channel.
  *
- * @details The user shall use this format to exchange data on a channel.
+ * @details The user shall use this format to exchange data on a channel. Sensor
+ *       messages carry a whole frame (see @ref header_frame "frame.h") on its own
+ *       cache line, after the header.
  *
  */
 typedef struct
 {
    long mtype;             /**< header of a message */
    int mvalue;             /**< data value of a message */
+   unsigned int seq;       /**< sequence number of the sample the message derives from */
+   int source;             /**< replica that produced the sample, 0 when not replicated */
+   uint64_t t_origin;      /**< monotonic time the sample was produced, in ns */
+   uint64_t t_hop;         /**< monotonic time the message left the previous stage, in ns */
+   _Alignas(FRAME_ALIGN) frame_t frame; /**< sensor frame, according to mtype */
 } message_t;
 
+/**
+ * @brief Communication mechanism backing a channel.
+ *
+ * @details The shared-memory backends map a lock-free ring (see @ref header_ring "ring.h")
+ *       in every process using the channel: once the channel is set up, pushing and
+ *       retrieving only issue a system call to wake up a peer that is sleeping on it.
+ *       The variant shall match the number of processes writing and reading the channel.
+ *       On a broadcast channel each consumer reads through a cursor of its own, claimed
+ *       on its first retrieve, and the producer waits for the slowest of them.
+ *       Whatever the backend, a message pushed while a recording is open (see
+ *       @ref header_record "record.h") is also appended to the recording.
+ *
+ */
+typedef enum
+{
+   CHANNEL_MSGQ = 0,       /**< System V message queue */
+   CHANNEL_SHM_SPSC,       /**< shared-memory ring, single producer and single consumer */
+   CHANNEL_SHM_MPSC,       /**< shared-memory ring, many producers and single consumer */
+   CHANNEL_SHM_MPMC,       /**< shared-memory ring, many producers and many consumers */
+   CHANNEL_SHM_BCAST       /**< shared-memory ring, single producer, every consumer gets every message */
+} channel_backend_t;
+
+/**
+ * @brief How a process blocked on a channel waits for a message, or for room.
+ *
+ * @details Set per channel with channel_set_wait(). On the shared-memory backends the
+ *       strategy is kept in the ring, so it holds for every process of the channel (see
+ *       ring_set_wait()). On a message queue every look is a system call, so only the
+ *       strategies that never sleep poll it; the others sleep in the kernel right away,
+ *       and the strategy only holds for the processes forked after it was set. In a
+ *       simulation the processes always wait on the virtual clock.
+ *
+ */
+typedef enum
+{
+   CHANNEL_WAIT_HYBRID = 0, /**< spin for a while, then sleep (default) */
+   CHANNEL_WAIT_BLOCK,      /**< sleep right away */
+   CHANNEL_WAIT_YIELD,      /**< spin for a while, then yield the CPU until done: never sleeps */
+   CHANNEL_WAIT_SPIN,       /**< busy-spin until done: never sleeps, takes a whole CPU for the lowest latency */
+   CHANNEL_WAIT_ADAPTIVE    /**< spin through the waits while they are usually short, sleep right away otherwise */
+} channel_wait_t;
+
 /**
  * @brief Abstract representation of a channel.
  *
  * @details The user shall initialise a structure of this type before using a channel.
  *       Process wanting to share a channel shall use same seed, which is then used to
- *       derive an identical ch_key.
+ *       derive an identical ch_key; every seed from 1 to CHANNEL_ID_MAX names a channel
+ *       of its own. The key also depends on the namespace of the run, see
+ *       channel_claim_namespace(), so runs in parallel do not share their channels.
  *
  */
 typedef struct
 {
    int ch_key;              /**< system-wide channel identifier */
    int ch_id;               /**< process-wide channel identifier */
-   char seed;               /**< parameter for connecting to an aleardy existing channel */
+   int seed;                /**< parameter for connecting to an aleardy existing channel */
+   channel_backend_t backend; /**< communication mechanism in use */
+   struct ring_s* ring;     /**< mapped ring for the shared-memory backends */
+   size_t ring_size;        /**< length of the ring mapping */
+   message_t* stage;        /**< message reserved or acquired on a message queue */
+   struct channel_bell_s* bell; /**< bell every push on a message queue rings, see channel_select() */
+   int reader;              /**< cursor of the process on a broadcast channel, -1 if none */
+   channel_wait_t wait;     /**< wait strategy on a message queue, the ring keeps its own */
 } channel_t;
 
 /************************** Function Prototypes *****************************/
@@ -54,27 +133,81 @@ typedef struct
  * @name Init functions
  * @{
  */
-void channel_create(channel_t* channel_ptr, char seed);
+void channel_create(channel_t* channel_ptr, int seed);
+void channel_create_backend(channel_t* channel_ptr, int seed, channel_backend_t backend);
+void channel_create_broadcast(channel_t* channel_ptr, int seed, int readers);
 void channel_delete(channel_t* channel_ptr);
 void channel_connect(channel_t* channel_ptr);
+int channel_claim_namespace(void);
+void channel_release_namespace(void);
 /* @} */
 
 /**
- * @name Blocking I/O operations
+ * @name Non-blocking I/O operations
  * @{
  */
-void channel_retrieve_nonblock(channel_t* channel_ptr, message_t* data);
-void channel_retrieve_cat_nonblock(channel_t* channel_ptr, message_t* data, long category);
-void channel_push_nonblock(channel_t* channel_ptr, message_t* data);
+bool channel_retrieve_nonblock(channel_t* channel_ptr, message_t* data);
+bool channel_retrieve_cat_nonblock(channel_t* channel_ptr, message_t* data, long category);
+bool channel_push_nonblock(channel_t* channel_ptr, message_t* data);
 /* @} */
 
 /**
- * @name Non-blocking I/O operations
+ * @name Blocking I/O operations
  * @{
  */
-void channel_retrieve_block(channel_t* channel_ptr, message_t* data);
-void channel_retrieve_cat_block(channel_t* channel_ptr, message_t* data, long category);
+bool channel_retrieve_block(channel_t* channel_ptr, message_t* data);
+bool channel_retrieve_cat_block(channel_t* channel_ptr, message_t* data, long category);
 void channel_push_block(channel_t* channel_ptr, message_t* data);
 /* @} */
 
+/**
+ * @name Batched I/O operations
+ * @{
+ */
+int channel_push_batch(channel_t* channel_ptr, message_t* data, int count);
+int channel_retrieve_batch(channel_t* channel_ptr, message_t* data, int max);
+int channel_drain(channel_t* channel_ptr, message_t* data, int max);
+int channel_retrieve_cat_batch(channel_t* channel_ptr, message_t* data, int max, long category);
+int channel_drain_cat(channel_t* channel_ptr, message_t* data, int max, long category);
+/* @} */
+
+/**
+ * @name Zero-copy I/O operations
+ * @{
+ */
+message_t* channel_reserve(channel_t* channel_ptr);
+void channel_commit(channel_t* channel_ptr, message_t* data);
+message_t* channel_acquire_nonblock(channel_t* channel_ptr);
+void channel_release(channel_t* channel_ptr, message_t* data);
+/* @} */
+
+/**
+ * @name Multiplexing
+ * @{
+ */
+bool channel_ready(channel_t* channel_ptr);
+int channel_select(channel_t** channels, int count, bool* ready, int timeout_ms);
+/* @} */
+
+/**
+ * @name Broadcast consumers
+ * @{
+ */
+bool channel_subscribe(channel_t* channel_ptr);
+void channel_unsubscribe(channel_t* channel_ptr);
+void channel_report_readers(channel_t* channel_ptr, FILE* out);
+/* @} */
+
+/**
+ * @name Wait strategies
+ * @{
+ */
+void channel_set_wait(channel_t* channel_ptr, channel_wait_t wait);
+channel_wait_t channel_get_wait(const channel_t* channel_ptr);
+int channel_parse_wait(const char* name);
+int channel_parse_waits(const char* spec, const char* const* names, int count, channel_wait_t* waits);
+const char* channel_wait_name(channel_wait_t wait);
+void channel_report_waits(channel_t* channel_ptr, FILE* out);
+/* @} */
+
 #endif /*CHANNEL_H*/
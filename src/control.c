@@ -18,122 +18,850 @@
 */
 #include "control.h"
 
+/************************** Constant Definitions *****************************/
+/**
+ * @name Wait set
+ * @brief Positions of the channels in the wait set of the event loops
+ * @{
+ */
+#define WAIT_CMD        0
+#define WAIT_DATA       1
+#define WAIT_TOT        2
+/* @} */
+
+/**
+ * @brief Longest sleep of an event-driven control() on the state board, so commands are still handled
+ */
+#define BOARD_WAIT_MS   100
+
+/**
+ * @brief Number of samples a voter can have open votes on at once, as many as a channel holds
+ */
+#define VOTE_WINDOW     1024
+
+/**
+ * @name Vote states
+ * @{
+ */
+#define ROUND_FREE      0     /**< never used */
+#define ROUND_OPEN      1     /**< waiting for replicas */
+#define ROUND_CLOSED    2     /**< decided, later replicas are discarded */
+/* @} */
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Vote on one sample of the replicated sensor.
+ */
+typedef struct
+{
+   int state;                                /**< according to ROUND_* */
+   unsigned int seq;                         /**< sample being voted on */
+   int received;                             /**< number of replicas heard from */
+   uint32_t heard;                           /**< mask of the replicas heard from */
+   int values[VOTE_MAX_REPLICAS];            /**< replica values, in arrival order */
+   frame_t frames[VOTE_MAX_REPLICAS];        /**< replica frames, in arrival order */
+   uint64_t t_origin;                        /**< oldest origin among the replicas */
+   uint64_t deadline;                        /**< time the vote is decided anyway, in ns */
+   int prev;                                 /**< previous open vote, -1 for the first */
+   int next;                                 /**< next open vote, -1 for the last */
+} vote_round_t;
+
+/************************** Variable Definitions *****************************/
+// number of messages taken from a channel per wake-up
+PRIVATE int batch_size = BATCH_SIZE;
+
+// plugin the control law is loaded from, NULL for the built-in law
+PRIVATE const char* law_path = NULL;
+
+// set by SIGHUP, the law is reloaded before the next control cycle
+PRIVATE volatile sig_atomic_t reload_requested = 0;
+
+// control cycles per second, 0 to run whenever data arrives, and their SCHED_FIFO priority
+PRIVATE int control_rate_hz = 0;
+PRIVATE int control_priority = 0;
+
+// M-of-N policy of vote()
+PRIVATE int vote_replicas = VOTE_REPLICAS;
+PRIVATE int vote_quorum = VOTE_QUORUM;
+
+// replicas voted on and agreeing replicas needed among them, fewer while replicas are failed
+PRIVATE int vote_live = VOTE_REPLICAS;
+PRIVATE int vote_live_quorum = VOTE_QUORUM;
+
+// heartbeat table the voter follows the replicas of its group on, NULL if none, and how often it looks
+PRIVATE watchdog_t* watchdog = NULL;
+PRIVATE int watchdog_group = 0;
+PRIVATE int watchdog_period_ms = WATCHDOG_PERIOD_MS;
+PRIVATE uint32_t watchdog_mask = 0;
+
+_Static_assert(WATCHDOG_REPLICAS >= VOTE_MAX_REPLICAS, "the watchdog shall watch every replica of a voter");
+PRIVATE int vote_deadline_ms = VOTE_DEADLINE_MS;
+
+// latest-value board the sensors, or the voters, publish on instead of the data channel
+PRIVATE board_t* state_board = NULL;
+
+// actuators fed by control
+PRIVATE int tot_actuators = TOT_ACTUATORS;
+
+// control cycles that produced a command, numbering the command frames
+PRIVATE uint32_t command_cycle = 0;
+
+// time spent fusing each sample into the thrust commands, in ns
+PRIVATE histogram_t fusion_time;
+
+// open and recently decided votes, indexed by sample sequence number
+PRIVATE vote_round_t rounds[VOTE_WINDOW];
+
+// open votes in the order they were opened, which is the order of their deadlines
+PRIVATE int open_first = -1;
+PRIVATE int open_last = -1;
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Checks the service channel for a termination command.
+*
+* @param[in] cmd_ch service channel where commands are exchanged
+*
+* @return true if the termination command was received
+*/
+PRIVATE bool terminate_requested(channel_t* cmd_ch);
+
+/**
+* @brief Reload handler, asks control() to reload the control law plugin.
+*
+* @param[in] sig signal received
+*
+* @return none
+*/
+PRIVATE void request_reload(int sig);
+
+/**
+* @brief Runs the control law on a sample and prepares the resulting command.
+*
+* @details The sample is fused with the latest state of the other sensors into the
+*     thrust of each thruster by the active law, carried by the command frame along
+*     with the number of the control cycle.
+*
+* @param[inout] mex_rx sample received, stamped at the control hop
+* @param[inout] fusion latest state of all the sensors
+* @param[out]   mex_tx command for the actuators
+*
+* @return none
+*/
+PRIVATE void control_step(message_t* mex_rx, fusion_t* fusion, message_t* mex_tx);
+
+/**
+* @brief Takes the samples published on the state board since the previous cycle.
+*
+* @details Only the latest sample of each sensor is handled, the older ones it
+*     replaced are counted as superseded.
+*
+* @param[inout] fusion     latest state of all the sensors
+* @param[out]   mex_tx     commands for the actuators, one per fresh sample
+* @param[inout] versions   version of the board slots at the previous cycle
+* @param[inout] superseded samples replaced on the board before being read
+*
+* @return number of commands prepared
+*/
+PRIVATE int control_board(fusion_t* fusion, message_t* mex_tx, uint64_t* versions, uint64_t* superseded);
+
+/**
+* @brief Sends the commands of a control cycle to the actuators.
+*
+* @details A broadcast channel hands every command to every actuator. On a message
+*     queue a message goes to a single reader, so each command is pushed once per
+*     actuator, addressed to its slot.
+*
+* @param[in] data_ch_tx channel where data is transmitted
+* @param[in] mex_tx     commands to send
+* @param[in] count      number of commands
+*
+* @return none
+*/
+PRIVATE void control_send(channel_t* data_ch_tx, message_t* mex_tx, int count);
+
+/**
+* @brief Sends the termination command to the actuators.
+*
+* @details Sent behind the last command, once the end of the stream reached control,
+*     so the actuators stop after executing everything it sent. A broadcast channel
+*     needs a single message to reach all of them, a message queue one per slot.
+*
+* @param[in] data_ch_tx channel where data is transmitted
+*
+* @return none
+*/
+PRIVATE void control_stop_actuators(channel_t* data_ch_tx);
+
+/**
+* @brief Decides a vote if possible.
+*
+* @details A vote is decided as soon as quorum replicas agree. Otherwise it is
+*     decided for no consensus, with a value of 0, once all the replicas are in
+*     or, when expired is set, with the replicas heard so far.
+*
+* @param[inout] round   vote to be decided
+* @param[in]    expired true if the vote shall not wait for more replicas
+* @param[out]   mex_tx  message receiving the outcome, if decided
+* @param[in]    id_sens class identifier according to @ref def_ids "this" classification
+*
+* @return true if the vote was decided and mex_tx filled
+*/
+PRIVATE bool vote_decide(vote_round_t* round, bool expired, message_t* mex_tx, int id_sens);
+
+/**
+* @brief Sends the outcome of the decided votes to control.
+*
+* @param[in] data_ch_tx channel where data is transmitted
+* @param[in] mex_tx     outcomes of the votes
+* @param[in] votes      number of outcomes
+*
+* @return number of outcomes left to send, i.e. 0
+*/
+PRIVATE int vote_flush(channel_t* data_ch_tx, message_t* mex_tx, int votes);
+
+/**
+* @brief Opens a vote, behind the open votes with an earlier deadline.
+*
+* @param[inout] round vote being opened
+*
+* @return none
+*/
+PRIVATE void vote_open(vote_round_t* round);
+
+/**
+* @brief Takes a decided vote out of the open votes.
+*
+* @param[inout] round vote being closed
+*
+* @return none
+*/
+PRIVATE void vote_close(vote_round_t* round);
+
+/**
+* @brief Computes how long the voter can wait before a vote has to be decided.
+*
+* @param[in] now current time, in ns
+*
+* @return time to the earliest deadline in ms, -1 if no vote is open
+*/
+PRIVATE int vote_timeout(uint64_t now);
+
+/**
+* @brief Switches the voting policy to the replicas of the group that are alive.
+*
+* @details With M-out-of-N voting and k replicas failed, the voter waits for the
+*     N - k replicas left and needs min(M, N - k) of them to agree, e.g. 2-out-of-2
+*     when a replica of three is gone, or passes the last one through. The policy
+*     goes back to M-out-of-N as the replicas come back.
+*
+* @return true if the policy changed
+*/
+PRIVATE bool vote_follow(void);
+
 void control(channel_t* cmd_ch, channel_t* data_ch_rx, channel_t* data_ch_tx)
 {
-   message_t mex_rx;
-   message_t mex_tx;
+   // latest state of each sensor, the input of the guidance and navigation
+   fusion_t fusion;
+   message_t* mex_rx;
+   message_t mex_tx[BATCH_SIZE];
+   channel_t* wait_set[WAIT_TOT];
+   bool ready[WAIT_TOT];
+   struct sigaction sa;
+   periodic_t task;
+   uint64_t versions[ID_STRTRK + 1] = { 0 };
+   uint64_t superseded[ID_STRTRK + 1] = { 0 };
+   uint32_t generation = 0;
+   bool stop = false;
+   int count;
    int i;
 
    channel_create(data_ch_rx, CH1);
    channel_create(data_ch_tx, CH2);
    channel_create(cmd_ch, CHCMD);
 
-   mex_tx.mtype = ID_CTR;
+   law_init(law_path);
+   fusion_init(&fusion, true);
+   fusion_set_law(&fusion, law_current());
+   histogram_reset(&fusion_time);
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = request_reload;
+   sa.sa_flags = SA_RESTART;
+   sigaction(SIGHUP, &sa, NULL);
+
+   wait_set[WAIT_CMD] = cmd_ch;
+   wait_set[WAIT_DATA] = data_ch_rx;
 
-   while (true)
+   if (control_rate_hz > 0)
    {
-      fprintf(stdout, "[%i] control: waiting for messages...\n", getpid());
+      periodic_init(&task, ID_CTR, control_rate_hz, control_priority);
+   }
+
+   while (!stop)
+   {
+      LOG(LOGGER_DEBUG, EV_CONTROL_WAIT);
 
-      channel_retrieve_nonblock(cmd_ch, &mex_rx);
-      if((mex_rx.mtype == TERMINATE) && (mex_rx.mvalue == TERMINATE))
+      // a periodic cycle handles whatever arrived since the previous one; the board
+      // is not a channel, so an event-driven control sleeps on it and polls the channels
+      if (control_rate_hz > 0)
+      {
+         periodic_wait(&task);
+         channel_select(wait_set, WAIT_TOT, ready, 0);
+      }
+      else if (state_board != NULL)
       {
-         fprintf(stdout, "[%i] control: received termination command, SHUTTING DOWN...\n",
-            getpid());
-         sleep(5);
-         exit(EXIT_SUCCESS);
+         board_wait(state_board, generation, BOARD_WAIT_MS);
+         channel_select(wait_set, WAIT_TOT, ready, 0);
+      }
+      else
+      {
+         channel_select(wait_set, WAIT_TOT, ready, -1);
       }
 
-      channel_retrieve_block(data_ch_rx, &mex_rx);
-      fprintf(stdout, "[%i] control: received data: type %li, value %i \n",
-         getpid(), mex_rx.mtype, mex_rx.mvalue);
+      // a termination on the service channel aborts, whatever is still queued
+      if (ready[WAIT_CMD] && terminate_requested(cmd_ch))
+      {
+         break;
+      }
 
-      control_law(&mex_rx.mvalue, &mex_tx.mvalue);
+      // a new law only ever takes over between two cycles
+      if (reload_requested)
+      {
+         reload_requested = 0;
+         if (law_reload())
+         {
+            fusion_set_law(&fusion, law_current());
+         }
+      }
 
-      channel_push_nonblock(data_ch_tx, &mex_tx);
-      fprintf(stdout, "[%i] control: transmit data: type %li, value %i\n",
-         getpid(), mex_tx.mtype, mex_tx.mvalue);
+      if (state_board != NULL)
+      {
+         // the samples are on the board, only the end of the stream comes on the channel
+         if (ready[WAIT_DATA] && ((mex_rx = channel_acquire_nonblock(data_ch_rx)) != NULL))
+         {
+            stop = (mex_rx->mtype == TERMINATE);
+            channel_release(data_ch_rx, mex_rx);
+         }
 
-      channel_retrieve_block(data_ch_rx, &mex_rx);
-      fprintf(stdout, "[%i] control: received data: type %li, value %i \n",
-         getpid(), mex_rx.mtype, mex_rx.mvalue);
+         // a publish from now on wakes the next cycle up
+         generation = board_generation(state_board);
+         count = control_board(&fusion, mex_tx, versions, superseded);
+      }
+      else if (!ready[WAIT_DATA])
+      {
+         continue;
+      }
+      else
+      {
+         // every sample available is handled now, whichever sensor it comes from;
+         // on the shared-memory path the frames are read in place, never copied out
+         for (count = 0; count < batch_size; count++)
+         {
+            if ((mex_rx = channel_acquire_nonblock(data_ch_rx)) == NULL)
+            {
+               break;
+            }
 
-      control_law(&mex_rx.mvalue, &mex_tx.mvalue);
+            // the end of the stream comes behind the last sample, which are all handled by now
+            if (mex_rx->mtype == TERMINATE)
+            {
+               channel_release(data_ch_rx, mex_rx);
+               stop = true;
+               break;
+            }
+            control_step(mex_rx, &fusion, &mex_tx[count]);
+            channel_release(data_ch_rx, mex_rx);
+         }
+      }
 
-      channel_push_nonblock(data_ch_tx, &mex_tx);
-      fprintf(stdout, "[%i] control: transmit data: type %li, value %i\n",
-         getpid(), mex_tx.mtype, mex_tx.mvalue);
+      control_send(data_ch_tx, mex_tx, count);
 
-      channel_retrieve_block(data_ch_rx, &mex_rx);
-      fprintf(stdout, "[%i] control: received data: type %li, value %i \n",
-         getpid(), mex_rx.mtype, mex_rx.mvalue);
+      for (i = 0; i < count; i++)
+      {
+         LOG(LOGGER_INFO, EV_CONTROL_TRANSMIT, mex_tx[i].mtype, mex_tx[i].mvalue);
+      }
+   }
 
-      control_law(&mex_rx.mvalue, &mex_tx.mvalue);
+   // the actuators stop behind the last command, when the stream ended here
+   if (stop)
+   {
+      control_stop_actuators(data_ch_tx);
+   }
 
-      channel_push_nonblock(data_ch_tx, &mex_tx);
-      fprintf(stdout, "[%i] control: transmit data: type %li, value %i\n",
-         getpid(),mex_tx.mtype, mex_tx.mvalue);
+   LOG(LOGGER_INFO, EV_CONTROL_TERMINATE);
+   if (control_rate_hz > 0)
+   {
+      periodic_report(&task);
+   }
+   law_report();
+   LOG(LOGGER_INFO, EV_FUSION_STATS, fusion.updates[0] + fusion.updates[1] + fusion.updates[2],
+      fusion.terms, histogram_percentile(&fusion_time, 50.0), histogram_percentile(&fusion_time, 99.0));
+   for (i = ID_IMU; (state_board != NULL) && (i <= ID_STRTRK); i++)
+   {
+      LOG(LOGGER_INFO, EV_BOARD_STATS, i, versions[i], superseded[i]);
    }
+   exit(EXIT_SUCCESS);
 }
 
 void vote(channel_t* cmd_ch, channel_t* data_ch_rx, channel_t* data_ch_tx, int id_sens)
 {
-   message_t mex_rx1, mex_rx2, mex_rx3;
-   message_t mex_tx;
+   message_t mex_rx[BATCH_SIZE];
+   message_t mex_tx[BATCH_SIZE];
+   vote_round_t* round;
+   channel_t* wait_set[WAIT_TOT];
+   bool ready[WAIT_TOT];
+   uint64_t now;
+   int timeout;
+   int count;
+   int votes;
+   bool stop = false;
+   bool idle = false;
+   bool failover = false;
+   int next;
    int i;
 
-   mex_tx.mtype = id_sens;
-
    channel_create(data_ch_rx, data_ch_rx->seed);
    channel_create(data_ch_tx, CH1);
    channel_create(cmd_ch, CHCMD);
 
-   while (true)
+   wait_set[WAIT_CMD] = cmd_ch;
+   wait_set[WAIT_DATA] = data_ch_rx;
+
+   while (!stop)
    {
-      fprintf(stdout, "[%i] voter: waiting for messages...\n", getpid());
+      // logged once the voter runs out of messages, not on every look at the replicas after that
+      if (!idle)
+      {
+         LOG(LOGGER_DEBUG, EV_VOTER_WAIT);
+      }
 
-      channel_retrieve_nonblock(cmd_ch, &mex_rx1);
-      if((mex_rx1.mtype == TERMINATE) && (mex_rx1.mvalue == TERMINATE))
+      // the wait never outlasts the earliest deadline of the open votes, nor a look at the replicas
+      timeout = vote_timeout(vclock_now());
+      if ((watchdog != NULL) && ((timeout < 0) || (timeout > watchdog_period_ms)))
       {
-         fprintf(stdout, "[%i] voter: received termination command, SHUTTING DOWN...\n", getpid());
-         exit(EXIT_SUCCESS);
+         timeout = watchdog_period_ms;
       }
+      channel_select(wait_set, WAIT_TOT, ready, timeout);
 
-      channel_retrieve_block(data_ch_rx, &mex_rx1);
-      fprintf(stdout, "[%i] voter: received data: type %li, value %i \n",
-         getpid(), mex_rx1.mtype, mex_rx1.mvalue);
+      // a termination on the service channel aborts, leaving the open votes undecided
+      if (ready[WAIT_CMD] && terminate_requested(cmd_ch))
+      {
+         break;
+      }
+
+      failover = (watchdog != NULL) && vote_follow();
 
-      channel_retrieve_block(data_ch_rx, &mex_rx2);
-      fprintf(stdout, "[%i] voter: received data: type %li, value %i \n",
-         getpid(), mex_rx2.mtype, mex_rx2.mvalue);
+      count = ready[WAIT_DATA] ? channel_drain(data_ch_rx, mex_rx, batch_size) : 0;
+      idle = (count == 0);
+      votes = 0;
+      now = vclock_now();
 
-      if(mex_rx1.mvalue != mex_rx2.mvalue)
+      for (i = 0; i < count; i++)
       {
-         channel_retrieve_block(data_ch_rx, &mex_rx3);
-         fprintf(stdout, "[%i] voter: received data: type %li, value %i \n",
-            getpid(), mex_rx3.mtype, mex_rx3.mvalue);
+         // the end of the stream comes behind the last replica sample
+         if (mex_rx[i].mtype == TERMINATE)
+         {
+            stop = true;
+            continue;
+         }
 
-         if(mex_rx2.mvalue == mex_rx3.mvalue)
+         trace_hop(TRACE_HOP_VOTER, &mex_rx[i]);
+         LOG(LOGGER_DEBUG, EV_VOTER_RECEIVED, mex_rx[i].mtype, mex_rx[i].mvalue);
+
+         if ((mex_rx[i].source < 0) || (mex_rx[i].source >= vote_replicas))
+         {
+            LOG(LOGGER_DEBUG, EV_VOTER_LATE, mex_rx[i].seq, mex_rx[i].source);
+            continue;
+         }
+
+         // replicas are aligned on the sample they measured, not on their arrival order
+         round = &rounds[mex_rx[i].seq % VOTE_WINDOW];
+         if ((round->state != ROUND_FREE) && (round->seq != mex_rx[i].seq))
+         {
+            if ((int)(mex_rx[i].seq - round->seq) < 0)
+            {
+               LOG(LOGGER_DEBUG, EV_VOTER_LATE, mex_rx[i].seq, mex_rx[i].source);
+               continue;
+            }
+
+            // the window moved past an open vote: it is decided on what it has
+            if (vote_decide(round, true, &mex_tx[votes], id_sens) && (++votes == BATCH_SIZE))
+            {
+               votes = vote_flush(data_ch_tx, mex_tx, votes);
+            }
+            round->state = ROUND_FREE;
+         }
+
+         // a replica sample after its vote, or twice for the same vote, is not counted
+         if ((round->state == ROUND_CLOSED)
+            || ((round->state == ROUND_OPEN) && (round->heard & (1u << mex_rx[i].source))))
+         {
+            LOG(LOGGER_DEBUG, EV_VOTER_LATE, mex_rx[i].seq, mex_rx[i].source);
+            continue;
+         }
+
+         if (round->state == ROUND_FREE)
          {
-            fprintf(stdout, "[%i] voter: 2-out-3 consensus reached, values 1:%i, 2:%i, 3:%i\n",
-               getpid(), mex_rx1.mvalue, mex_rx2.mvalue, mex_rx3.mvalue);
-            mex_tx.mvalue = mex_rx3.mvalue;
+            round->seq = mex_rx[i].seq;
+            round->received = 0;
+            round->heard = 0;
+            round->t_origin = mex_rx[i].t_origin;
+            round->deadline = (vote_deadline_ms > 0) ? now + (uint64_t)vote_deadline_ms * 1000000ULL : UINT64_MAX;
+            vote_open(round);
          }
-         else
+
+         // the vote is as old as the oldest replica value it is based on
+         if (mex_rx[i].t_origin < round->t_origin)
          {
-            fprintf(stdout, "[%i] voter: NO consensus reached, sending 0. values 1:%i, 2:%i, 3:%i\n",
-               getpid(), mex_rx1.mvalue, mex_rx2.mvalue, mex_rx3.mvalue);
-            mex_tx.mtype = 0;
+            round->t_origin = mex_rx[i].t_origin;
+         }
+         round->values[round->received] = mex_rx[i].mvalue;
+         round->frames[round->received] = mex_rx[i].frame;
+         round->heard |= 1u << mex_rx[i].source;
+         round->received++;
+
+         if (vote_decide(round, false, &mex_tx[votes], id_sens) && (++votes == BATCH_SIZE))
+         {
+            votes = vote_flush(data_ch_tx, mex_tx, votes);
          }
       }
-      else
+
+      // votes whose deadline expired are decided on the replicas heard so far, and
+      // after a failover the votes that have all the replicas left too; at the end
+      // of the stream no replica is coming any more, every open vote is decided.
+      // Otherwise only the expired votes, at the front of the open ones, are looked at
+      for (i = open_first; i != -1; i = next)
       {
-         fprintf(stdout, "[%i] voter: 3-out-3 consensus reached, values 1:%i, 2:%i\n",
-            getpid(), mex_rx1.mvalue, mex_rx2.mvalue);
-         mex_tx.mvalue = mex_rx1.mvalue;
+         next = rounds[i].next;
+         if (!stop && !failover && (rounds[i].deadline > now))
+         {
+            break;
+         }
+         if (vote_decide(&rounds[i], stop || (rounds[i].deadline <= now), &mex_tx[votes], id_sens)
+            && (++votes == BATCH_SIZE))
+         {
+            votes = vote_flush(data_ch_tx, mex_tx, votes);
+         }
+      }
+
+      vote_flush(data_ch_tx, mex_tx, votes);
+   }
+
+   LOG(LOGGER_INFO, EV_VOTER_TERMINATE);
+   exit(EXIT_SUCCESS);
+}
+
+PRIVATE bool terminate_requested(channel_t* cmd_ch)
+{
+   message_t mex_cmd;
+
+   if (!channel_retrieve_nonblock(cmd_ch, &mex_cmd))
+   {
+      return false;
+   }
+   return (mex_cmd.mtype == TERMINATE) && (mex_cmd.mvalue == TERMINATE);
+}
+
+PRIVATE bool vote_decide(vote_round_t* round, bool expired, message_t* mex_tx, int id_sens)
+{
+   int best = 0;
+   int best_count = 0;
+   int agree;
+   int i;
+   int j;
+
+   if (round->state != ROUND_OPEN)
+   {
+      return false;
+   }
+
+   for (i = 0; i < round->received; i++)
+   {
+      for (agree = 0, j = 0; j < round->received; j++)
+      {
+         agree += (round->values[j] == round->values[i]);
+      }
+      if (agree > best_count)
+      {
+         best = i;
+         best_count = agree;
+      }
+   }
+
+   // a replica out of the majority, or no majority at all, shows on the live metrics
+   if ((best_count < round->received) && ((best_count >= vote_live_quorum) || (round->received >= vote_live) || expired))
+   {
+      metrics_disagreement();
+   }
+
+   if (best_count >= vote_live_quorum)
+   {
+      LOG(LOGGER_INFO, EV_VOTER_CONSENSUS, best_count, vote_live, round->seq, round->values[best]);
+      mex_tx->mvalue = round->values[best];
+      mex_tx->frame = round->frames[best];
+   }
+   else if ((round->received >= vote_live) || expired)
+   {
+      // no quorum can be reached anymore, or no longer waited for
+      LOG(LOGGER_WARN, (round->received >= vote_live) ? EV_VOTER_NO_CONSENSUS : EV_VOTER_DEADLINE,
+         round->seq, round->received, vote_live);
+      mex_tx->mvalue = 0;
+      memset(&mex_tx->frame, 0, sizeof(frame_t));
+   }
+   else
+   {
+      return false;
+   }
+
+   mex_tx->mtype = id_sens;
+   mex_tx->seq = round->seq;
+   mex_tx->source = 0;
+   mex_tx->t_origin = round->t_origin;
+   trace_stamp(mex_tx);
+   vote_close(round);
+   return true;
+}
+
+PRIVATE int vote_flush(channel_t* data_ch_tx, message_t* mex_tx, int votes)
+{
+   int i;
+
+   if (state_board != NULL)
+   {
+      for (i = 0; i < votes; i++)
+      {
+         board_publish(state_board, &mex_tx[i]);
+      }
+   }
+   else
+   {
+      channel_push_batch(data_ch_tx, mex_tx, votes);
+   }
+
+   for (i = 0; i < votes; i++)
+   {
+      LOG(LOGGER_INFO, EV_VOTER_SENT, mex_tx[i].mtype, mex_tx[i].mvalue);
+   }
+   return 0;
+}
+
+PRIVATE void vote_open(vote_round_t* round)
+{
+   int i = (int)(round - rounds);
+
+   round->state = ROUND_OPEN;
+   round->prev = open_last;
+   round->next = -1;
+   if (open_last != -1)
+   {
+      rounds[open_last].next = i;
+   }
+   else
+   {
+      open_first = i;
+   }
+   open_last = i;
+}
+
+PRIVATE void vote_close(vote_round_t* round)
+{
+   if (round->prev != -1)
+   {
+      rounds[round->prev].next = round->next;
+   }
+   else
+   {
+      open_first = round->next;
+   }
+   if (round->next != -1)
+   {
+      rounds[round->next].prev = round->prev;
+   }
+   else
+   {
+      open_last = round->prev;
+   }
+   round->state = ROUND_CLOSED;
+}
+
+PRIVATE int vote_timeout(uint64_t now)
+{
+   // every vote waits as long, the first one opened is the first to expire
+   uint64_t earliest = (open_first != -1) ? rounds[open_first].deadline : UINT64_MAX;
+
+   if (earliest == UINT64_MAX)
+   {
+      return -1;
+   }
+   return (earliest <= now) ? 0 : (int)((earliest - now + 999999) / 1000000);
+}
+
+PRIVATE bool vote_follow(void)
+{
+   uint32_t alive = watchdog_alive(watchdog, watchdog_group) & ((1u << vote_replicas) - 1);
+
+   if (alive == watchdog_mask)
+   {
+      return false;
+   }
+
+   // with no replica left the votes wait for their deadline, as without a watchdog
+   watchdog_mask = alive;
+   vote_live = (alive != 0) ? __builtin_popcount(alive) : vote_replicas;
+   vote_live_quorum = (vote_quorum < vote_live) ? vote_quorum : vote_live;
+   watchdog_applied(watchdog, watchdog_group, alive, vote_live_quorum);
+   LOG(LOGGER_WARN, EV_VOTER_FAILOVER, vote_live_quorum, vote_live, vote_replicas);
+   return true;
+}
+
+PRIVATE void request_reload(int sig)
+{
+   (void)sig;
+   reload_requested = 1;
+}
+
+PRIVATE void control_step(message_t* mex_rx, fusion_t* fusion, message_t* mex_tx)
+{
+   uint64_t elapsed;
+   uint64_t start;
+
+   trace_hop(TRACE_HOP_CONTROL, mex_rx);
+   LOG(LOGGER_DEBUG, EV_CONTROL_RECEIVED, mex_rx->mtype, mex_rx->mvalue);
+
+   // only the contribution of the sensor that sent the sample is computed again
+   start = trace_now();
+   if (!fusion_update(fusion, mex_rx->mtype, &mex_rx->frame, mex_tx->frame.cmd.thrust))
+   {
+      memset(&mex_tx->frame, 0, sizeof(frame_t));
+   }
+   elapsed = trace_now() - start;
+   histogram_record(&fusion_time, elapsed);
+   law_record(elapsed);
+   mex_tx->frame.cmd.cycle = ++command_cycle;
+
+   // the command carries the sample identity along to the actuators
+   mex_tx->mtype = ID_CTR;
+   mex_tx->mvalue = mex_rx->mvalue;
+   mex_tx->seq = mex_rx->seq;
+   mex_tx->source = 0;
+   mex_tx->t_origin = mex_rx->t_origin;
+   trace_stamp(mex_tx);
+}
+
+PRIVATE int control_board(fusion_t* fusion, message_t* mex_tx, uint64_t* versions, uint64_t* superseded)
+{
+   message_t sample;
+   uint64_t version;
+   int count = 0;
+   int id;
+
+   for (id = ID_IMU; id <= ID_STRTRK; id++)
+   {
+      version = board_read(state_board, id, &sample);
+      if (version <= versions[id])
+      {
+         continue;
       }
 
-      channel_push_nonblock(data_ch_tx, &mex_tx);
-      fprintf(stdout, "[%i] voter: sent data to control: type %li, value %i\n",
-         getpid(), mex_tx.mtype, mex_tx.mvalue);
+      superseded[id] += version - versions[id] - 1;
+      versions[id] = version;
+      control_step(&sample, fusion, &mex_tx[count++]);
+   }
+   return count;
+}
+
+PRIVATE void control_send(channel_t* data_ch_tx, message_t* mex_tx, int count)
+{
+   int slot;
+   int i;
+
+   if (data_ch_tx->backend != CHANNEL_MSGQ)
+   {
+      channel_push_batch(data_ch_tx, mex_tx, count);
+      return;
+   }
+
+   for (slot = 0; slot < tot_actuators; slot++)
+   {
+      for (i = 0; i < count; i++)
+      {
+         mex_tx[i].mtype = ID_ACT_SLOT(slot);
+      }
+      channel_push_batch(data_ch_tx, mex_tx, count);
    }
+
+   for (i = 0; i < count; i++)
+   {
+      mex_tx[i].mtype = ID_CTR;
+   }
+}
+
+PRIVATE void control_stop_actuators(channel_t* data_ch_tx)
+{
+   message_t exit_msg;
+   int i;
+
+   memset(&exit_msg, 0, sizeof(exit_msg));
+   exit_msg.mtype = TERMINATE;
+   exit_msg.mvalue = TERMINATE;
+   if (data_ch_tx->backend != CHANNEL_MSGQ)
+   {
+      channel_push_block(data_ch_tx, &exit_msg);
+      return;
+   }
+
+   // the frame carries no control cycle, which no command has
+   for (i = 0; i < tot_actuators; i++)
+   {
+      exit_msg.mtype = ID_ACT_SLOT(i);
+      channel_push_block(data_ch_tx, &exit_msg);
+   }
+}
+
+void control_set_batch(int size)
+{
+   batch_size = (size < 1) ? 1 : (size > BATCH_SIZE) ? BATCH_SIZE : size;
+}
+
+void control_set_law(const char* path)
+{
+   law_path = path;
+}
+
+void control_set_rate(int rate_hz, int priority)
+{
+   control_rate_hz = (rate_hz > 0) ? rate_hz : 0;
+   control_priority = (priority > 0) ? priority : 0;
+}
+
+void vote_set_policy(int replicas, int quorum, int deadline_ms)
+{
+   vote_replicas = (replicas < 1) ? 1 : (replicas > VOTE_MAX_REPLICAS) ? VOTE_MAX_REPLICAS : replicas;
+   vote_quorum = (quorum < 1) ? 1 : (quorum > vote_replicas) ? vote_replicas : quorum;
+   vote_live = vote_replicas;
+   vote_live_quorum = vote_quorum;
+   vote_deadline_ms = deadline_ms;
+}
+
+void vote_set_watchdog(watchdog_t* table, int group, int period_ms)
+{
+   watchdog = table;
+   watchdog_group = group;
+   watchdog_period_ms = (period_ms > 0) ? period_ms : WATCHDOG_PERIOD_MS;
+   watchdog_mask = (1u << vote_replicas) - 1;
+}
+
+void control_set_board(board_t* board)
+{
+   state_board = board;
+}
+
+void control_set_actuators(int count)
+{
+   tot_actuators = (count > 0) ? count : TOT_ACTUATORS;
+}
+
+bool control_terminates(const message_t* msg)
+{
+   return (msg->mtype == TERMINATE) || ((msg->mvalue == TERMINATE) && (msg->frame.cmd.cycle == 0));
 }
@@ -21,8 +21,17 @@
 #define CONTROL_H
 
 /***************************** Include Files ********************************/
+#include "board.h"
 #include "channel.h"
 #include "control_law.h"
+#include "fusion.h"
+#include "law.h"
+#include "metrics.h"
+#include "periodic.h"
+#include "trace.h"
+#include "vclock.h"
+#include "logger.h"
+#include "watchdog.h"
 #include "app.h"
 
 /************************** Function Prototypes *****************************/
@@ -31,6 +40,12 @@
 *
 * @details Gets data from sensors or voter (for @ref sec_tmr_arch "TMR" configuration),
 *     elaborate then by applying the control law and sends them to actuators.
+*     The control law can be replaced at runtime (see control_set_law()).
+*     The process waits on the service and data channels at once, so a sample is
+*     handled as soon as it arrives and a command never waits behind sensor data.
+*     A termination message on the data channel ends the stream: control handles
+*     the samples queued before it, sends the termination on to the actuators behind
+*     its last command and exits. One on the service channel exits at once.
 *
 * @param[in] cmd_ch     service channel where commands are exchanged
 * @param[in] data_ch_rx channel where data is received
@@ -43,10 +58,18 @@ void control(channel_t* cmd_ch, channel_t* data_ch_rx, channel_t* data_ch_tx);
 /**
 * @brief Voter code.
 *
-* @details Implement 2-ou-of-3 voting when @ref sec_tmr_arch "TMR" is enabled.
+* @details Implement M-out-of-N voting when @ref sec_tmr_arch "TMR" is enabled.
+*     Like control(), the voter is an event loop on the service and data channels.
+*     Replica messages are aligned on the sequence number of the sample they measured,
+*     so only values of the same sample are compared, and each sample is voted once:
+*     as soon as a quorum of replicas agrees, or when its deadline expires. A slow or
+*     dead replica therefore delays a vote by at most the deadline (see vote_set_policy()),
+*     and not at all once a watchdog declared it failed (see vote_set_watchdog()).
+*     A termination message on the data channel ends the stream: the votes still open
+*     are decided on the replicas heard and sent to control before the voter exits.
 * @sa @ref driver_details "main()"
-* @note when no consensus cannot be reached, i.e. all three values are different, a default
-*     value of 0 is sent.
+* @note when no consensus can be reached, i.e. all replicas are in without a quorum
+*     agreeing or the deadline expired first, a default value of 0 is sent.
 *
 * @param[in] cmd_ch     service channel where commands are exchanged
 * @param[in] data_ch_rx channel where data is received
@@ -57,4 +80,123 @@ void control(channel_t* cmd_ch, channel_t* data_ch_rx, channel_t* data_ch_tx);
 */
 void vote(channel_t* cmd_ch, channel_t* data_ch_rx, channel_t* data_ch_tx, int id_sens);
 
+/**
+* @brief Sets how many messages control() and vote() take from a channel per wake-up.
+*
+* @details Shall be called before control() or vote(). Values are clamped to
+*     the range [1, BATCH_SIZE], which is also the default.
+*
+* @param[in] size maximum number of messages per batch
+*
+* @return none
+*/
+void control_set_batch(int size);
+
+/**
+* @brief Sets the plugin control() loads its control law from.
+*
+* @details Shall be called before control(). Sending SIGHUP to the control process
+*     reloads the plugin from the same path before the next control cycle, without
+*     restarting the process; if the new plugin cannot be loaded the running law is
+*     kept. The active law computes the thrust the sensors are fused into; without a
+*     plugin, or until one loads, the built-in gain-matrix law is used.
+* @sa @ref header_law_plugin "law_plugin.h"
+*
+* @param[in] path path of the plugin shared object, NULL for the built-in law
+*
+* @return none
+*/
+void control_set_law(const char* path);
+
+/**
+* @brief Makes control() a periodic task.
+*
+* @details Shall be called before control(). At each release the control cycle takes
+*     the samples arrived since the previous one, at most a batch, instead of waiting
+*     for data; deadline misses, overruns and release jitter are logged at shutdown.
+* @sa @ref header_periodic "periodic.h"
+*
+* @param[in] rate_hz  control cycles per second, 0 to run whenever data arrives (default)
+* @param[in] priority SCHED_FIFO priority, 0 for the default policy
+*
+* @return none
+*/
+void control_set_rate(int rate_hz, int priority);
+
+/**
+* @brief Sets the M-out-of-N policy of vote().
+*
+* @details Shall be called before vote(). Replicas are clamped to [1, VOTE_MAX_REPLICAS]
+*     and quorum to [1, replicas]; the defaults are the 2-out-of-3 of @ref sec_tmr_arch "TMR".
+*     Replicas that report after the vote on their sample was decided are discarded.
+*
+* @param[in] replicas    number of replicas of each sensor, N
+* @param[in] quorum      number of agreeing replicas needed for consensus, M
+* @param[in] deadline_ms time a vote waits for the replicas after the first one arrived,
+*                        0 or less to wait for all of them
+*
+* @return none
+*/
+void vote_set_policy(int replicas, int quorum, int deadline_ms);
+
+/**
+* @brief Makes vote() follow the replicas of its group on a heartbeat table.
+*
+* @details Shall be called after vote_set_policy() and before vote(). At least every
+*     period the voter looks at the replicas alive in its group: while some are failed it
+*     votes among the others, M-out-of-N becoming min(M, N - k)-out-of-(N - k) with k
+*     replicas failed, so a dead replica no longer holds every vote up to its deadline.
+*     The voter acknowledges every switch on the table, which times the failover.
+* @sa @ref header_watchdog "watchdog.h"
+*
+* @param[in] table     heartbeat table the replicas beat on, NULL to always vote on all of them (default)
+* @param[in] group     voter group of the voter
+* @param[in] period_ms longest time between two looks at the table, WATCHDOG_PERIOD_MS if 0 or less
+*
+* @return none
+*/
+void vote_set_watchdog(watchdog_t* table, int group, int period_ms);
+
+/**
+* @brief Makes control() read the sensor samples from a state board instead of its data channel.
+*
+* @details Shall be called before control() and vote(). The voters then publish their
+*     outcomes on the board too. Each control cycle handles the latest sample of every
+*     sensor published since the previous cycle and never works through a backlog: the
+*     samples replaced before control read them are logged at shutdown as superseded.
+*     The data channel then only carries the end of the stream.
+* @sa @ref header_board "board.h"
+*
+* @param[in] board state board shared with the sensors, NULL for the data channel (default)
+*
+* @return none
+*/
+void control_set_board(board_t* board);
+
+/**
+* @brief Sets how many actuators control() feeds.
+*
+* @details Shall be called before control(). On a message queue every command, and the
+*     termination when control stops the actuators, is sent once per actuator, addressed
+*     to its slot with ID_ACT_SLOT(); a broadcast channel carries a single copy.
+*
+* @param[in] count number of actuators, TOT_ACTUATORS by default
+*
+* @return none
+*/
+void control_set_actuators(int count);
+
+/**
+* @brief Tells whether a command an actuator retrieved ends the stream of commands.
+*
+* @details The termination is a TERMINATE message on a broadcast channel. On a message
+*     queue it is addressed to the slot of the actuator, like its commands, and told
+*     apart by its TERMINATE value and a command frame of no control cycle.
+*
+* @param[in] msg command retrieved from the data channel
+*
+* @return true if the actuator shall stop
+*/
+bool control_terminates(const message_t* msg);
+
 # endif /*CONTROL_H*/
@@ -17,11 +17,315 @@
 *
 */
 /***************************** Include Files ********************************/
-#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LAW_X86
+#endif
 
 #include "control_law.h"
 
-void control_law(int* data_in, int* data_out)
+/************************** Constant Definitions *****************************/
+#define LAW_KP          2.0f     // proportional gain on the attitude error
+#define LAW_KD          0.8f     // derivative gain on the angular rate
+
+/************************** Variable Definitions *****************************/
+// thruster 2k pushes around +k, thruster 2k+1 around -k: saturation keeps one of them off
+static float law_gains[LAW_OUTPUTS][LAW_INPUTS] =
+{
+   {  LAW_KP,    0.0f,    0.0f,  LAW_KD,    0.0f,    0.0f },
+   { -LAW_KP,    0.0f,    0.0f, -LAW_KD,    0.0f,    0.0f },
+   {    0.0f,  LAW_KP,    0.0f,    0.0f,  LAW_KD,    0.0f },
+   {    0.0f, -LAW_KP,    0.0f,    0.0f, -LAW_KD,    0.0f },
+   {    0.0f,    0.0f,  LAW_KP,    0.0f,    0.0f,  LAW_KD },
+   {    0.0f,    0.0f, -LAW_KP,    0.0f,    0.0f, -LAW_KD }
+};
+static float law_bias[LAW_OUTPUTS] = { 0.0f };
+
+// batch law picked by control_law_select()
+static void (*law_batch)(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS],
+   size_t first, size_t count) = NULL;
+
+/************************** Private Functions *****************************/
+static inline float law_saturate(float thrust)
+{
+   return (thrust < 0.0f) ? 0.0f : ((thrust > LAW_THRUST_MAX) ? LAW_THRUST_MAX : thrust);
+}
+
+/**
+* @brief Plain C batch law, also used for the samples left over by the vector paths.
+*/
+static void law_batch_scalar(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS],
+   size_t first, size_t count)
+{
+   float x[LAW_INPUTS];
+   float thrust;
+   size_t n;
+   int i;
+   int j;
+
+   for (n = first; n < count; n++)
+   {
+      for (j = 0; j < LAW_INPUTS; j++)
+      {
+         x[j] = in[j][n];
+      }
+      for (i = 0; i < LAW_OUTPUTS; i++)
+      {
+         thrust = 0.0f;
+         for (j = 0; j < LAW_INPUTS; j++)
+         {
+            thrust += law_gains[i][j] * x[j];
+         }
+         out[i][n] = law_saturate(thrust + law_bias[i]);
+      }
+   }
+}
+
+#ifdef LAW_X86
+/**
+* @brief SSE batch law, one sample per lane.
+*
+* @details Products and sums are done in the same order as the scalar law and
+*     without fused multiply-add, so every path gives bit-identical commands.
+*/
+__attribute__((target("sse2")))
+static void law_batch_sse(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS],
+   size_t first, size_t count)
+{
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 max = _mm_set1_ps(LAW_THRUST_MAX);
+   __m128 x[LAW_INPUTS];
+   __m128 thrust;
+   size_t n;
+   int i;
+   int j;
+
+   for (n = first; n + 4 <= count; n += 4)
+   {
+      for (j = 0; j < LAW_INPUTS; j++)
+      {
+         x[j] = _mm_loadu_ps(&in[j][n]);
+      }
+      for (i = 0; i < LAW_OUTPUTS; i++)
+      {
+         thrust = zero;
+         for (j = 0; j < LAW_INPUTS; j++)
+         {
+            thrust = _mm_add_ps(thrust, _mm_mul_ps(_mm_set1_ps(law_gains[i][j]), x[j]));
+         }
+         thrust = _mm_add_ps(thrust, _mm_set1_ps(law_bias[i]));
+         _mm_storeu_ps(&out[i][n], _mm_min_ps(_mm_max_ps(thrust, zero), max));
+      }
+   }
+
+   law_batch_scalar(in, out, n, count);
+}
+
+/**
+* @brief AVX2 batch law, one sample per lane.
+*
+* @details Same operation order as law_batch_sse(), eight samples at a time.
+*/
+__attribute__((target("avx2")))
+static void law_batch_avx2(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS],
+   size_t first, size_t count)
+{
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 max = _mm256_set1_ps(LAW_THRUST_MAX);
+   __m256 x[LAW_INPUTS];
+   __m256 thrust;
+   size_t n;
+   int i;
+   int j;
+
+   for (n = first; n + 8 <= count; n += 8)
+   {
+      for (j = 0; j < LAW_INPUTS; j++)
+      {
+         x[j] = _mm256_loadu_ps(&in[j][n]);
+      }
+      for (i = 0; i < LAW_OUTPUTS; i++)
+      {
+         thrust = zero;
+         for (j = 0; j < LAW_INPUTS; j++)
+         {
+            thrust = _mm256_add_ps(thrust, _mm256_mul_ps(_mm256_set1_ps(law_gains[i][j]), x[j]));
+         }
+         thrust = _mm256_add_ps(thrust, _mm256_set1_ps(law_bias[i]));
+         _mm256_storeu_ps(&out[i][n], _mm256_min_ps(_mm256_max_ps(thrust, zero), max));
+      }
+   }
+
+   law_batch_sse(in, out, n, count);
+}
+#endif
+
+/**
+* @brief Applies the gain-matrix law to a single sample.
+*
+* @param[in]  in  inputs according to @ref def_law_dims "this" layout
+* @param[out] out thrust of each thruster
+*
+* @return none
+*/
+void control_law_sample(const float in[LAW_INPUTS], float out[LAW_OUTPUTS])
+{
+   const float* in_soa[LAW_INPUTS];
+   float* out_soa[LAW_OUTPUTS];
+   int i;
+
+   for (i = 0; i < LAW_INPUTS; i++)
+   {
+      in_soa[i] = &in[i];
+   }
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      out_soa[i] = &out[i];
+   }
+   law_batch_scalar(in_soa, out_soa, 0, 1);
+}
+
+/**
+* @brief Applies the gain-matrix law to count samples.
+*
+* @details Input and output are structs of arrays: in[j][n] is input j of sample n
+*     and out[i][n] the thrust of thruster i for sample n. The instruction set is
+*     picked at the first call (see control_law_select()); all of them give the
+*     same commands as control_law_sample().
+*
+* @param[in]  in    LAW_INPUTS arrays of count inputs
+* @param[out] out   LAW_OUTPUTS arrays of count thrusts
+* @param[in]  count number of samples
+*
+* @return none
+*/
+void control_law_batch(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS], size_t count)
+{
+   if (law_batch == NULL)
+   {
+      control_law_select(LAW_ISA_AUTO);
+   }
+   law_batch(in, out, 0, count);
+}
+
+/**
+* @brief Computes the contribution of one input group to the thrust of each thruster.
+*
+* @param[in]  group   input group according to @ref def_law_groups "this" layout
+* @param[in]  in      inputs of the group
+* @param[out] partial contribution to each thruster, before bias and saturation
+*
+* @return none
+*/
+void control_law_partial(int group, const float in[LAW_GROUP_INPUTS], float partial[LAW_OUTPUTS])
+{
+   const int first = group * LAW_GROUP_INPUTS;
+   int i;
+   int j;
+
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      partial[i] = 0.0f;
+      for (j = 0; j < LAW_GROUP_INPUTS; j++)
+      {
+         partial[i] += law_gains[i][first + j] * in[j];
+      }
+   }
+}
+
+/**
+* @brief Adds up contributions computed with control_law_partial() into the thruster commands.
+*
+* @details The contributions are added in the order given, so the same partials
+*     always give the same commands, whichever of them was computed last.
+*
+* @param[in]  partials contributions to add up
+* @param[in]  count    number of contributions
+* @param[out] out      thrust of each thruster
+*
+* @return none
+*/
+void control_law_combine(const float (*partials)[LAW_OUTPUTS], int count, float out[LAW_OUTPUTS])
+{
+   float thrust;
+   int i;
+   int k;
+
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      thrust = 0.0f;
+      for (k = 0; k < count; k++)
+      {
+         thrust += partials[k][i];
+      }
+      out[i] = law_saturate(thrust + law_bias[i]);
+   }
+}
+
+/**
+* @brief Replaces the gain matrix and the bias of the law.
+*
+* @param[in] gains gains[i][j] weighs input j in the thrust of thruster i
+* @param[in] bias  thrust added to each thruster before saturation
+*
+* @return none
+*/
+void control_law_gains(const float gains[LAW_OUTPUTS][LAW_INPUTS], const float bias[LAW_OUTPUTS])
+{
+   memcpy(law_gains, gains, sizeof(law_gains));
+   memcpy(law_bias, bias, sizeof(law_bias));
+}
+
+/**
+* @brief Selects the instruction set used by control_law_batch().
+*
+* @details An instruction set the CPU does not support falls back to the next
+*     narrower one.
+*
+* @param[in] isa requested instruction set, LAW_ISA_AUTO for the best available
+*
+* @return instruction set in use
+*/
+law_isa_t control_law_select(law_isa_t isa)
+{
+#ifdef LAW_X86
+   if (((isa == LAW_ISA_AUTO) || (isa == LAW_ISA_AVX2)) && __builtin_cpu_supports("avx2"))
+   {
+      law_batch = law_batch_avx2;
+      return LAW_ISA_AVX2;
+   }
+   if ((isa != LAW_ISA_SCALAR) && __builtin_cpu_supports("sse2"))
+   {
+      law_batch = law_batch_sse;
+      return LAW_ISA_SSE;
+   }
+#endif
+   law_batch = law_batch_scalar;
+   return LAW_ISA_SCALAR;
+}
+
+/**
+* @brief Returns a printable name for an instruction set.
+*
+* @param[in] isa instruction set
+*
+* @return name of the instruction set
+*/
+const char* control_law_isa_name(law_isa_t isa)
 {
-   *data_out = (*data_in) + (rand() % 100);
+   switch (isa)
+   {
+   case LAW_ISA_SCALAR:
+      return "scalar";
+   case LAW_ISA_SSE:
+      return "sse";
+   case LAW_ISA_AVX2:
+      return "avx2";
+   case LAW_ISA_AUTO:
+   default:
+      return "auto";
+   }
 }
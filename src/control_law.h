@@ -20,18 +20,67 @@
 #ifndef CONTROL_LAW
 #define CONTROL_LAW
 
+/***************************** Include Files ********************************/
+#include <stddef.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Batch law dimensions
+ * @anchor def_law_dims
+ * @{
+ */
+#define LAW_INPUTS         6     /**< attitude error x, y, z (rad), angular rate x, y, z (rad/s) */
+#define LAW_OUTPUTS        6     /**< thrust of each thruster, in N */
+#define LAW_THRUST_MAX     10.0f /**< saturation of a thruster, in N */
+/* @} */
+
+/**
+ * @name Input groups
+ * @anchor def_law_groups
+ * @brief Inputs of the gain-matrix law coming from the same measurement
+ * @details Before saturation the law is linear, so the thrust is the sum of the
+ *       contributions of each group: when only one measurement changes, only its
+ *       contribution has to be computed again (see control_law_partial()).
+ * @{
+ */
+#define LAW_GROUP_ATTITUDE 0     /**< inputs 0-2, attitude error */
+#define LAW_GROUP_RATE     1     /**< inputs 3-5, angular rate */
+#define LAW_GROUPS         2
+#define LAW_GROUP_INPUTS   3     /**< inputs in each group */
+/* @} */
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Instruction set used by control_law_batch().
+ */
+typedef enum
+{
+   LAW_ISA_AUTO = 0,       /**< best one supported by the CPU */
+   LAW_ISA_SCALAR,         /**< plain C */
+   LAW_ISA_SSE,            /**< 4 samples per step */
+   LAW_ISA_AVX2            /**< 8 samples per step */
+} law_isa_t;
+
 /************************** Function Prototypes *****************************/
 /**
-* @brief Control law for the GNC code.
-*
-* @details Dummy control law. Takes input data, sums a random quantity and returns.
-*     Can be easily swappable with different implementations that respect this interface.
-*
-* @param[in]  data_in  input data
-* @param[out] data_out output data
-*
-* @return none
-*/
-void control_law(int* data_in, int* data_out);
+ * @name Batch control law
+ * @brief Gain-matrix law mapping the attitude state to six thruster commands
+ * @{
+ */
+void control_law_sample(const float in[LAW_INPUTS], float out[LAW_OUTPUTS]);
+void control_law_batch(const float* const in[LAW_INPUTS], float* const out[LAW_OUTPUTS], size_t count);
+void control_law_gains(const float gains[LAW_OUTPUTS][LAW_INPUTS], const float bias[LAW_OUTPUTS]);
+law_isa_t control_law_select(law_isa_t isa);
+const char* control_law_isa_name(law_isa_t isa);
+/* @} */
+
+/**
+ * @name Incremental control law
+ * @brief Same gain-matrix law, split into the contributions of its input groups
+ * @{
+ */
+void control_law_partial(int group, const float in[LAW_GROUP_INPUTS], float partial[LAW_OUTPUTS]);
+void control_law_combine(const float (*partials)[LAW_OUTPUTS], int count, float out[LAW_OUTPUTS]);
+/* @} */
 
 #endif /*CONTROL LAW*/
@@ -17,37 +17,213 @@
 *
 */
 /***************************** Include Files ********************************/
+#include <sys/signalfd.h>
+#include <poll.h>
 #include "app.h"
+#include "trace.h"
+#include "logger.h"
+#include "metrics.h"
+#include "placement.h"
+#include "record.h"
+#include "ring.h"
+#include "startup.h"
 
 /************************** Function Prototypes *****************************/
 /**
 * @brief Sensor code.
 *
 * @details Sends data to the GNC or to the voter (when in TMR more) at intervals
-*     that varies randomly between 0-10 seconds.
+*     that varies randomly between 0-10 seconds or, with a sensor rate, as a
+*     periodic task (see @ref header_periodic "periodic.h"). With a watchdog, the
+*     sensor beats on it after every sample (see @ref header_watchdog "watchdog.h").
 *
 * @param[in] data_ch_tx   channel where the data is sent
-* @param[in] id_sens      class identifier according to @ref def_ids "this" classification
+* @param[in] cls          class of the sensor, which sets its type and rate
+* @param[in] group        voter group of the sensor, or its index without TMR
 * @param[in] id_replica   identifier of the replica in @ref sec_tmr_arch "TMR" configuration
+* @param[in] first        sequence number of the first sample, past 0 when the replica is restarted
 * @param[in] inject_errors when true the sensor injects faulty data
 *
 * @return none
 */
-PRIVATE void sense(channel_t *data_ch_tx, int id_sens, int id_replica, bool inject_errors);
+PRIVATE void sense(channel_t *data_ch_tx, const topo_class_t* cls, int group, int id_replica, unsigned int first,
+   bool inject_errors);
+
+/**
+* @brief Starts the process of a sensor.
+*
+* @details With a watchdog the replica is watched from before it starts, so its voter
+*     counts on it from the beginning.
+*
+* @param[in] data_ch_tx    channel where the data is sent
+* @param[in] cls           class of the sensor
+* @param[in] group         voter group of the sensor, or its index without TMR
+* @param[in] id_replica    identifier of the replica in @ref sec_tmr_arch "TMR" configuration
+* @param[in] slot          latency, log and placement slot of the process
+* @param[in] first         sequence number of the first sample
+* @param[in] inject_errors when true the sensor injects faulty data
+*
+* @return pid of the process, -1 if it could not be started
+*/
+PRIVATE pid_t start_sensor(channel_t* data_ch_tx, const topo_class_t* cls, int group, int id_replica, int slot,
+   unsigned int first, bool inject_errors);
+
+/**
+* @brief Waits for the sensors, or the replay, to terminate, watching the sensor replicas meanwhile.
+*
+* @details Sleeps on the signal descriptor of the driver, which a terminating child or
+*     an interruption wakes up. With a watchdog, every period the heartbeats of the
+*     replicas are checked too. A replica that crashed or missed its heartbeat is
+*     declared failed, which makes its voter vote among the replicas left, and is started
+*     again from the sample its group is at; a late replica is killed first. A failed
+*     replica is replaced rather than counted as terminated. On SIGINT or SIGTERM the
+*     sensors are asked to stop after their current sample and none is restarted any more.
+*
+* @param[in] count         number of processes to wait for, those of the first slots
+* @param[in] ch_tmr        channels of the voter groups
+* @param[in] inject_errors when true the restarted sensors inject faulty data too
+* @param[in] period_ms     period of the checks
+* @param[in] out           stream the terminations and restarts are printed on
+*
+* @return none
+*/
+PRIVATE void supervise(int count, channel_t* ch_tmr, bool inject_errors, int period_ms, FILE* out);
+
+/**
+* @brief Waits for the processes of a stage to terminate.
+*
+* @details Sleeps on the signal descriptor of the driver; a process still running
+*     SHUTDOWN_GRACE_MS later is killed. In a simulation the processes first leave
+*     the virtual clock, which keeps running until they did.
+*
+* @param[in] first slot of the first process of the stage
+* @param[in] count number of processes of the stage
+* @param[in] out   stream the terminations are printed on
+*
+* @return number of processes that had to be killed
+*/
+PRIVATE int reap(int first, int count, FILE* out);
 
 /**
 * @brief Actuator code.
 *
 * @details Gets data from the GNC every time there is one available and simulates
-*     a random delay between 0-10 seconds.
+*     a random delay between 0-10 seconds or, with an actuator rate, takes the
+*     commands arrived since its previous cycle as a periodic task. Of the commands
+*     taken at once only the newest is executed, driving the thruster of the actuator;
+*     the others are superseded and dropped rather than executed late.
 *
 * @param[in] data_ch_rx channel where the data is received
-* @param[in] id_replica identifier of the replica
+* @param[in] id_replica identifier of the replica, whose thruster is id_replica % FRAME_THRUSTERS
 *
 * @return none
 */
 PRIVATE void actuate(channel_t *data_ch_rx, int id_replica);
 
+/**
+* @brief Replay code.
+*
+* @details Takes the place of all the sensors and feeds the first stage of the chain
+*     with the messages of a recording, in the order they were recorded: the sensor
+*     samples, which go to the voters, with @ref sec_tmr_arch "TMR", otherwise the
+*     samples control received. The messages are pushed as fast as the chain takes
+*     them or, when asked for, at their original timing.
+*
+* @param[in] channels channels a recorded message can be fed to, the first one is control's
+* @param[in] count    number of channels
+* @param[in] tmr      true when the voters are replayed too
+*
+* @return none
+*/
+PRIVATE void replay(channel_t** channels, int count, bool tmr);
+
+/**
+* @brief Makes a sensor, or the replay, stop after its current sample on SIGTERM,
+*     and an actuator stop simulating the firing of its thruster.
+*
+* @details The driver blocks the signals it waits on, a child forked afterwards
+*     unblocks them. A wait on a channel the signal interrupts is resumed, so the
+*     request is only acted on between two messages, never on one not received.
+*
+* @return none
+*/
+PRIVATE void stop_on_request(void);
+
+/**
+* @brief Stop handler, asks sense() or replay() to stop after the current sample,
+*     actuate() to stop simulating work.
+*
+* @param[in] sig signal received
+*
+* @return none
+*/
+PRIVATE void request_stop(int sig);
+
+/**
+* @brief Log level handler.
+*
+* @details SIGUSR1 makes the log one level more verbose, SIGUSR2 one level less.
+*     Every process shares the level, so the signal can be sent to any of them.
+*
+* @param[in] sig signal received
+*
+* @return none
+*/
+PRIVATE void change_log_level(int sig);
+
+/**
+* @brief Law reload handler.
+*
+* @details Forwards SIGHUP to the control process, which reloads its control law plugin.
+*
+* @param[in] sig signal received
+*
+* @return none
+*/
+PRIVATE void forward_reload(int sig);
+
+// control process, target of the law reload requests
+PRIVATE volatile pid_t control_pid = 0;
+
+// latest-value board the sensors publish on instead of queueing their samples, NULL if none
+PRIVATE board_t* state_board = NULL;
+
+// recording fed to the chain in place of the sensors, NULL if none, and whether at its original timing
+PRIVATE const char* replay_path = NULL;
+PRIVATE bool replay_timed = false;
+
+// cycles per second of each sensor and actuator, 0 for random intervals, and SCHED_FIFO priority of the periodic tasks
+PRIVATE int device_rate_hz = 0;
+PRIVATE int task_priority = 0;
+
+// processes of the chain and their channels
+PRIVATE topology_t topo;
+
+// process in each slot, stage after stage, 0 once it was waited for
+PRIVATE pid_t* slot_pids = NULL;
+PRIVATE int tot_slots = 0;
+
+// heartbeat table of the sensor replicas with TMR, NULL if they are not watched
+PRIVATE watchdog_t* watchdog = NULL;
+
+// class and first slot of each voter group, for the restarts
+PRIVATE int* group_class = NULL;
+PRIVATE int* group_slot = NULL;
+
+// signals the driver waits on, as a descriptor, and whether the run was interrupted
+PRIVATE int signal_fd = -1;
+PRIVATE bool interrupted = false;
+
+// set in a sensor or the replay asked to stop early, in an actuator asked to cut its firing short
+PRIVATE volatile sig_atomic_t stop_requested = 0;
+
+// gate every process of the chain waits at until all of them are ready
+PRIVATE startup_t* startup = NULL;
+
+// sample at which replica 0 of the first sensor crashes, or hangs, -1 for never
+PRIVATE int crash_sample = -1;
+PRIVATE int hang_sample = -1;
+
 /**
 *
 * @brief Creates the infrastructure showed in the \ref img_basic_arch "architecture" section
@@ -56,43 +232,125 @@ PRIVATE void actuate(channel_t *data_ch_rx, int id_replica);
 * @details  This code creates all necessary processes and IPC needed to simulate
 *   the various parts of the data-gathering system (sensors, actuators, control).
 *
-*   If enable_tmr = true the code creates the TMR configuration as shown \ref img_tmr_arch "here"
+*   If enable_tmr = true the code creates the TMR configuration as shown \ref img_tmr_arch "here",
+*   and watches the sensor replicas on a heartbeat table, restarting those that crash or hang
+*   while their voters fail over to the replicas left (see @ref header_watchdog "watchdog.h")
 *
 *   If inject_errors = true the sensors simulate a stuck-at-N error condition
+*
+*   If enable_shm = true the channels are shared-memory rings instead of message queues
+*
+*   If enable_board = true control reads the latest sample of each sensor from a state
+*   board instead of queueing them (see @ref header_board "board.h")
+*
+*   Every sample is stamped when produced and at each stage it crosses; at shutdown the
+*   driver prints the latency percentiles of each hop (see @ref header_trace "trace.h")
+*
+*   If rates are given, sensors, actuators and control run as periodic tasks, optionally at a
+*   SCHED_FIFO priority, and log their deadline misses and jitter (see @ref header_periodic "periodic.h")
+*
+*   The sensor classes, their replication, the actuators and the rates are those of the demo
+*   or, if a topology file is given, loaded from it (see @ref header_topology "topology.h")
+*
+*   If a law plugin is given, control loads its control law from it and reloads it
+*   whenever the driver receives SIGHUP (see @ref header_law "law.h")
+*
+*   Each process can be pinned to the CPUs of its role; at shutdown the driver prints where
+*   every process ran and how often it migrated and was switched out (see @ref header_placement "placement.h")
+*
+*   The processes log binary records into per-process rings, a dedicated logger
+*   process drains them either to the log file or, decoded, to stdout (see
+*   @ref header_logger "logger.h")
+*
+*   If enable_sim = true every sleep, period and deadline runs on a virtual clock, which jumps
+*   to the next wake-up as soon as all the processes wait; the processes take turns in a fixed
+*   order, so every run gives the same events (see @ref header_vclock "vclock.h")
+*
+*   Every message pushed on a channel can be recorded to a file, and a recording can be
+*   replayed in place of the sensors, as fast as possible or at its original timing
+*   (see @ref header_record "record.h")*
+*   The channels of a run live in a namespace of its own, so runs can go side by side,
+*   e.g. the simulations of a campaign (see channel_claim_namespace())
+*
+*   The processes wait at a readiness gate until all of them are ready, and the chain starts
+*   from the same instant (see @ref header_startup "startup.h"); at shutdown the stages are
+*   stopped in turn, each behind the last message of the stage before
 */
 int main (int argc, char* argv[])
 {
    int i;
+   int j;
+   int c;
+   int group;
    pid_t pid;
    int status;
    int opt;
-   int log_fd;
+   int log_fd = -1;
+   int log_level = LOGGER_DEBUG;
+   int processes;
+   int slot = 0;
+   int ns;
+   int ready;
+   unsigned int seed = 1;
+   uint64_t t_launch = trace_now();
+   pid_t logger_pid;
+   struct sigaction sa;
+   sigset_t mask;
 
    // log file configuration
    FILE* actual_log_file = stdout;
    char log_file_path[100];
+   char* law_file_path = NULL;
+   char* record_path = NULL;
+   char* topology_path = NULL;
 
    // CLI flags configuration
    bool change_log_file = false;
    bool enable_tmr = false;
    bool inject_errors = false;
+   bool enable_shm = false;
+   bool enable_board = false;
+   bool enable_sim = false;
 
-   // number of sensors and voters for the non-TMR configuration
-   int tot_imu = TOT_IMU;
-   int tot_gnss = TOT_GNSS;
-   int tot_strtrk = TOT_STRTRK;
+   // number of sensor, voter and replay processes, from the topology
+   int tot_sensors;
    int tot_voters = 0;
+   int tot_replay = 0;
+
+   // M-out-of-N voting policy of the classes that do not set their own
+   int vote_replicas = VOTE_REPLICAS;
+   int vote_quorum = VOTE_QUORUM;
+   int vote_deadline_ms = VOTE_DEADLINE_MS;
+   topo_class_t defaults;
+
+   // how the voters, control and the actuators wait on their channels
+   const char* wait_roles[WAIT_ROLES] = WAIT_ROLE_NAMES;
+   channel_wait_t waits[WAIT_ROLES] = { CHANNEL_WAIT_HYBRID, CHANNEL_WAIT_HYBRID, CHANNEL_WAIT_HYBRID };
+
+   // control cycles per second, 0 to run whenever data arrives
+   int control_rate_hz = 0;
 
-   channel_t* ch_imu = NULL;
-   channel_t* ch_gnss = NULL;
-   channel_t* ch_strtrk = NULL;
+   // how often the replicas are checked and their voters look at them
+   int watchdog_period_ms = WATCHDOG_PERIOD_MS;
+
+   channel_t* ch_tmr = NULL;
    channel_t* ch_sens = NULL;
    channel_t* ch_act = NULL;
    channel_t* ch_cmd = NULL;
+   channel_t** inputs;
+   int tot_inputs = 1;
    message_t exit_msg;
 
+   // teardown, from the end of the inputs to the last IPC object removed, in ns
+   uint64_t t_stop;
+   uint64_t t_voters;
+   uint64_t t_control;
+   uint64_t t_actuators;
+   uint64_t t_release;
+   int killed;
+
    // CLI arguments parsing
-   while ((opt = getopt(argc, argv, "hf:ti")) != -1)
+   while ((opt = getopt(argc, argv, "hf:l:p:tisbn:m:d:r:c:P:a:w:o:x:X:vT:S:k:K:")) != -1)
    {
       switch (opt)
       {
@@ -100,35 +358,191 @@ int main (int argc, char* argv[])
          strcpy(log_file_path, optarg);
          change_log_file = true;
          break;
+      case 'l':
+         log_level = logger_parse_level(optarg);
+         if (log_level < 0)
+         {
+            fprintf(stderr, "invalid log level %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'p':
+         law_file_path = optarg;
+         break;
       case 't':
          enable_tmr = true;
          break;
       case 'i':
          inject_errors = true;
          break;
+      case 's':
+         enable_shm = true;
+         break;
+      case 'b':
+         enable_board = true;
+         break;
+      case 'n':
+         vote_replicas = atoi(optarg);
+         break;
+      case 'm':
+         vote_quorum = atoi(optarg);
+         break;
+      case 'd':
+         vote_deadline_ms = atoi(optarg);
+         break;
+      case 'r':
+         device_rate_hz = atoi(optarg);
+         break;
+      case 'c':
+         control_rate_hz = atoi(optarg);
+         break;
+      case 'P':
+         task_priority = atoi(optarg);
+         break;
+      case 'a':
+         if (placement_parse(optarg) == -1)
+         {
+            fprintf(stderr, "invalid placement %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'w':
+         if (channel_parse_waits(optarg, wait_roles, WAIT_ROLES, waits) == -1)
+         {
+            fprintf(stderr, "invalid waits %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'v':
+         enable_sim = true;
+         break;
+      case 'T':
+         topology_path = optarg;
+         break;
+      case 'S':
+         seed = (unsigned int)strtoul(optarg, NULL, 10);
+         break;
+      case 'k':
+         crash_sample = atoi(optarg);
+         break;
+      case 'K':
+         hang_sample = atoi(optarg);
+         break;
+      case 'o':
+         record_path = optarg;
+         break;
+      case 'x':
+      case 'X':
+         replay_path = optarg;
+         replay_timed = (opt == 'X');
+         break;
       case 'h':
       default:
-         fprintf(stderr, "Usage %s [-h] [-t] [-i] [-f PATH]\n", argv[0]);
+         fprintf(stderr, "Usage %s [-h] [-t] [-i] [-s] [-b] [-f PATH] [-l LEVEL] [-p PLUGIN] [-n N] [-m M] [-d MS] [-r HZ] [-c HZ] [-P PRIO] [-a PLACEMENT] [-w WAITS] [-o PATH] [-x|-X PATH] [-v] [-T PATH] [-S SEED] [-k|-K SAMPLE]\n",
+            argv[0]);
          fprintf(stderr, "............ -h help\n");
          fprintf(stderr, "............ -t enable TMR example\n");
          fprintf(stderr, "............ -i inject errors from sensors\n");
-         fprintf(stderr, "............ -f set the path pf the log file\n");
+         fprintf(stderr, "............ -s use shared-memory channels\n");
+         fprintf(stderr, "............ -b control reads the latest sample of each sensor from a state board\n");
+         fprintf(stderr, "............ -f set the path of the binary log file, read it with logdump\n");
+         fprintf(stderr, "............ -l log level: off, error, warn, info, debug (default)\n");
+         fprintf(stderr, "............ -p control law plugin, reloaded on SIGHUP\n");
+         fprintf(stderr, "............ -n replicas of each sensor with TMR, unless its class sets them (default %d)\n", VOTE_REPLICAS);
+         fprintf(stderr, "............ -m agreeing replicas needed for consensus (default %d)\n", VOTE_QUORUM);
+         fprintf(stderr, "............ -d longest wait for the replicas of a sample in ms, 0 for none (default %d)\n",
+            VOTE_DEADLINE_MS);
+         fprintf(stderr, "............ -r cycles per second of each sensor and actuator, 0 for random intervals (default)\n");
+         fprintf(stderr, "............ -c control cycles per second, 0 to run when data arrives (default)\n");
+         fprintf(stderr, "............ -P SCHED_FIFO priority of the periodic tasks, 0 for none (default)\n");
+         fprintf(stderr, "............ -a CPUs of each role, auto or e.g. control=3:sensor=0-1:voter=isolated\n");
+         fprintf(stderr, "............ -w how voter, control and actuator wait: hybrid (default), block, yield, spin, adaptive,\n");
+         fprintf(stderr, "............    e.g. control=spin:voter=adaptive\n");
+         fprintf(stderr, "............ -o record every message pushed on a channel to a file\n");
+         fprintf(stderr, "............ -x replay a recording in place of the sensors, as fast as possible\n");
+         fprintf(stderr, "............ -X replay a recording in place of the sensors, at its original timing\n");
+         fprintf(stderr, "............ -v simulate on a virtual clock, as fast as possible\n");
+         fprintf(stderr, "............ -T load the sensor classes and the actuators from a topology file\n");
+         fprintf(stderr, "............ -S seed of the sensor values and intervals (default 1)\n");
+         fprintf(stderr, "............ -k replica 0 of the first sensor crashes at this sample\n");
+         fprintf(stderr, "............ -K replica 0 of the first sensor hangs at this sample\n");
          exit(EXIT_FAILURE);
       }
    }
 
+   // the processes of a simulation take turns on the virtual clock, none of them may just vanish
+   if (enable_sim && ((crash_sample >= 0) || (hang_sample >= 0)))
+   {
+      fprintf(stderr, "crashes and hangs cannot be injected in a simulation\n");
+      exit(EXIT_FAILURE);
+   }
+
    // Change output from stout to a user-defined file
    if(change_log_file)
    {
       fprintf(actual_log_file, "[%i] log to %s\n", getpid(), log_file_path);
 
-      if ((log_fd = open(log_file_path, O_CREAT | O_WRONLY | O_APPEND)) == -1)
+      if ((log_fd = open(log_file_path, O_CREAT | O_WRONLY | O_APPEND, 0644)) == -1)
       {
          perror("open failed with code");
          exit(EXIT_FAILURE);
       }
+   }
+
+   // every process forked from now on appends what it pushes to the recording
+   if (record_path != NULL)
+   {
+      if ((replay_path != NULL) && (strcmp(record_path, replay_path) == 0))
+      {
+         fprintf(stderr, "cannot record to the recording being replayed\n");
+         exit(EXIT_FAILURE);
+      }
+      if (record_open(record_path) == -1)
+      {
+         exit(EXIT_FAILURE);
+      }
+      fprintf(actual_log_file, "[%i] recording to %s\n", getpid(), record_path);
+   }
+
+   // the classes take the voting policy, the rate and the wait given on the command line unless they set theirs
+   memset(&defaults, 0, sizeof(defaults));
+   defaults.replicas = vote_replicas;
+   defaults.quorum = vote_quorum;
+   defaults.deadline_ms = vote_deadline_ms;
+   defaults.rate_hz = device_rate_hz;
+   defaults.wait = waits[WAIT_VOTER];
+   if (topology_path != NULL)
+   {
+      if (topology_load(&topo, topology_path, &defaults) == -1)
+      {
+         exit(EXIT_FAILURE);
+      }
+      fprintf(actual_log_file, "[%i] topology from %s\n", getpid(), topology_path);
+   }
+   else
+   {
+      topology_default(&topo, &defaults);
+   }
+   if (topology_check(&topo, enable_tmr, enable_shm ? RING_READERS_MAX : 0) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+   tot_sensors = topology_sensors(&topo, enable_tmr);
+
+   // every process inherits the generator, so the seed sets the values and intervals of the whole run
+   srand(seed);
+
+   // runs started side by side, e.g. by a campaign, each get channels of their own
+   if ((ns = channel_claim_namespace()) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+   fprintf(actual_log_file, "[%i] channels in namespace %04x\n", getpid(), ns);
 
-      dprintf(log_fd, "open a file with descriptor %i\n", log_fd);
+   // a slot for every process the topology makes up, control and a replay included
+   if (metrics_init(ns, tot_sensors + topology_groups(&topo) + topo.actuators + 2) == -1)
+   {
+      exit(EXIT_FAILURE);
    }
 
    // Increase total number of processes in TMR configuration
@@ -136,229 +550,912 @@ int main (int argc, char* argv[])
    {
       fprintf(actual_log_file, "[%i] TMR configuration enabled\n", getpid());
 
-      tot_imu = tot_imu * 3;
-      tot_gnss = tot_gnss * 3;
-      tot_strtrk = tot_strtrk * 3;
-      tot_voters = TOT_VOTERS;
+      tot_voters = topology_groups(&topo);
+      ch_tmr = calloc(tot_voters, sizeof(channel_t));
 
-      ch_imu = malloc(sizeof(channel_t));
-      ch_gnss = malloc(sizeof(channel_t));
-      ch_strtrk = malloc(sizeof(channel_t));
+      // the replicas of a sensor all feed the voter of their group
+      for (i = 0; i < tot_voters; i++)
+      {
+         channel_create_backend(&ch_tmr[i], topology_channel(i), enable_shm ? CHANNEL_SHM_MPSC : CHANNEL_MSGQ);
+      }
+      for (c = 0, group = 0; c < topo.classes; c++)
+      {
+         for (i = 0; i < topo.cls[c].sensors; i++, group++)
+         {
+            channel_set_wait(&ch_tmr[group], (channel_wait_t)topo.cls[c].wait);
+         }
+      }
 
-      channel_create(ch_imu, CHIMUTMR);
-      channel_create(ch_gnss, CHGNSSTMR);
-      channel_create(ch_strtrk, CHSTRTRKTMR);
+      // the replicas are watched on real time, a simulation or a replay has none to restart
+      if (!enable_sim && (replay_path == NULL))
+      {
+         if ((watchdog = watchdog_create(tot_voters)) == NULL)
+         {
+            exit(EXIT_FAILURE);
+         }
+         group_class = calloc(tot_voters, sizeof(int));
+         group_slot = calloc(tot_voters, sizeof(int));
+         watchdog_period_ms = (control_rate_hz > 0) ? ((1000 / control_rate_hz > 0) ? 1000 / control_rate_hz : 1) :
+            WATCHDOG_PERIOD_MS;
+         fprintf(actual_log_file, "[%i] watchdog on the replicas every %i ms\n", getpid(), watchdog_period_ms);
+      }
    }
+   topology_print(&topo, enable_tmr, actual_log_file);
 
-   ch_sens = malloc(sizeof(channel_t));
-   ch_act = malloc(sizeof(channel_t));
-   ch_cmd = malloc(sizeof(channel_t));
+   ch_sens = calloc(1, sizeof(channel_t));
+   ch_act = calloc(1, sizeof(channel_t));
+   ch_cmd = calloc(1, sizeof(channel_t));
 
-   channel_create(ch_sens, CH1);
-   channel_create(ch_act, CH2);
-   channel_create(ch_cmd, CHCMD);
+   // sensors (or voters) feed control, control feeds all the actuators: every thruster gets
+   // every command, read in place on shared memory, as a copy addressed to it on a queue
+   channel_create_backend(ch_sens, CH1, enable_shm ? CHANNEL_SHM_MPSC : CHANNEL_MSGQ);
+   if (enable_shm)
+   {
+      channel_create_broadcast(ch_act, CH2, topo.actuators);
+   }
+   else
+   {
+      channel_create_backend(ch_act, CH2, CHANNEL_MSGQ);
+   }
+   channel_create_backend(ch_cmd, CHCMD, enable_shm ? CHANNEL_SHM_MPMC : CHANNEL_MSGQ);
+   channel_set_wait(ch_cmd, CHANNEL_WAIT_BLOCK);
+   channel_set_wait(ch_sens, waits[WAIT_CONTROL]);
+   channel_set_wait(ch_act, waits[WAIT_ACTUATOR]);
 
-   // generate tot_imu IMU processes
-   for (i = 0; i < tot_imu; i++)
+   // a replay takes the place of all the sensors, feeding control or, with TMR, the voters
+   inputs = calloc(1 + tot_voters, sizeof(channel_t*));
+   inputs[0] = ch_sens;
+   for (i = 0; i < tot_voters; i++)
    {
-      pid = fork();
-      if(pid == 0)
-      {
-         if(enable_tmr){
-            sense(ch_imu, ID_IMU, i, inject_errors);
-         }else{
-            sense(ch_sens, ID_IMU, i, inject_errors);
-         }
-         exit(EXIT_SUCCESS);
-      }
+      inputs[tot_inputs++] = &ch_tmr[i];
+   }
+   if (replay_path != NULL)
+   {
+      fprintf(actual_log_file, "[%i] replaying %s%s\n", getpid(), replay_path, replay_timed ? " at its original timing" : "");
+      tot_sensors = 0;
+      tot_replay = 1;
    }
 
-   // generate tot_gnss GNSS processes
-   for (i = 0; i < tot_gnss; i++)
+   // control takes the latest sample of each sensor from the board, the voters publish there too
+   if (enable_board)
    {
-      pid = fork();
-      if(pid == 0)
+      if ((state_board = board_create()) == NULL)
       {
-         if(enable_tmr){
-            sense(ch_gnss, ID_GNSS, i, inject_errors);
-         }else{
-            sense(ch_sens, ID_GNSS, i, inject_errors);
-         }
-         exit(EXIT_SUCCESS);
+         exit(EXIT_FAILURE);
       }
+      control_set_board(state_board);
+      fprintf(actual_log_file, "[%i] state board enabled\n", getpid());
    }
 
-   // generate tot_strtrk star tracker processes
-   for (i = 0; i < tot_strtrk; i++)
+   // one latency and log slot for each sensor, voter, actuator and for control
+   processes = tot_replay + tot_sensors + tot_voters + topo.actuators + 1;
+   slot_pids = calloc(processes, sizeof(pid_t));
+   tot_slots = processes;
+   trace_init(processes);
+   logger_init(processes, log_level);
+
+   placement_init(processes + 1);
+
+   // the level can be changed at runtime from any process
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = change_log_level;
+   sa.sa_flags = SA_RESTART;
+   sigaction(SIGUSR1, &sa, NULL);
+   sigaction(SIGUSR2, &sa, NULL);
+   sa.sa_handler = forward_reload;
+   sigaction(SIGHUP, &sa, NULL);
+
+   // an interruption from the terminal reaches every process: the driver alone acts on it
+   sa.sa_handler = SIG_IGN;
+   sigaction(SIGINT, &sa, NULL);
+
+   // generate the logger process, the only one formatting or writing the log
+   fflush(actual_log_file);
+   logger_pid = fork();
+   if (logger_pid == 0)
    {
-      pid = fork();
-      if(pid == 0)
+      placement_attach(processes, PLACE_LOGGER);
+      record_attach(PLACE_LOGGER);
+      logger_run(log_fd);
+      exit(EXIT_SUCCESS);
+   }
+
+   // the logger stays out of the simulation, the driver takes part from here on
+   if (enable_sim)
+   {
+      if (vclock_init(processes) == -1)
       {
-         if(enable_tmr){
-            sense(ch_strtrk, ID_STRTRK, i, inject_errors);
-         }else{
-            sense(ch_sens, ID_STRTRK, i, inject_errors);
-         }
-         exit(EXIT_SUCCESS);
+         exit(EXIT_FAILURE);
       }
+      fprintf(actual_log_file, "[%i] simulation on a virtual clock\n", getpid());
    }
 
-   if(enable_tmr)
+   // the chain starts once all its processes are ready, rather than after fixed delays;
+   // in a simulation the clock does not move before they are all attached to it
+   if ((startup = startup_create(processes, !enable_sim)) == NULL)
+   {
+      exit(EXIT_FAILURE);
+   }
+   // or every child would print the lines above again from its copy of the buffer
+   fflush(actual_log_file);
+
+   // generate the replay process
+   for (i = 0; i < tot_replay; i++)
    {
-      // generate the voter process for IMU TMR
       pid = fork();
       if (pid == 0)
       {
-         vote(ch_cmd, ch_imu, ch_sens, ID_IMU);
+         trace_attach(slot);
+         vclock_attach(slot);
+         logger_attach(slot);
+         placement_attach(slot, PLACE_SENSOR);
+         metrics_attach(slot, PLACE_SENSOR);
+         record_attach(PLACE_SENSOR);
+         stop_on_request();
+         startup_ready(startup);
+         replay(inputs, tot_inputs, enable_tmr);
          exit(EXIT_SUCCESS);
       }
+      slot_pids[slot] = pid;
+      slot++;
+   }
 
-      // generate the voter process for GNSS TMR
-      pid = fork();
-      if (pid == 0)
+   // generate the sensor processes, class after class, the replicas of a sensor next to each other
+   for (c = 0, group = 0; (tot_replay == 0) && (c < topo.classes); c++)
+   {
+      for (i = 0; i < topo.cls[c].sensors; i++, group++)
       {
-         sleep(30);
-         vote(ch_cmd, ch_gnss, ch_sens, ID_GNSS);
-         exit(EXIT_SUCCESS);
+         if (watchdog != NULL)
+         {
+            group_class[group] = c;
+            group_slot[group] = slot;
+         }
+         for (j = 0; j < (enable_tmr ? topo.cls[c].replicas : 1); j++)
+         {
+            if(enable_tmr){
+               pid = start_sensor(&ch_tmr[group], &topo.cls[c], group, j, slot, 0, inject_errors);
+            }else{
+               pid = start_sensor(ch_sens, &topo.cls[c], group, i, slot, 0, inject_errors);
+            }
+            slot_pids[slot] = (pid > 0) ? pid : 0;
+            slot++;
+         }
       }
+   }
 
-      // generate the voter process for star tracker TMR
-      pid = fork();
-      if (pid == 0)
+   // generate a voter process for each sensor group in TMR configuration
+   for (c = 0, group = 0; enable_tmr && (c < topo.classes); c++)
+   {
+      for (i = 0; i < topo.cls[c].sensors; i++, group++)
       {
-         sleep(50);
-         vote(ch_cmd, ch_strtrk, ch_sens, ID_STRTRK);
-         exit(EXIT_SUCCESS);
+         pid = fork();
+         if (pid == 0)
+         {
+            trace_attach(slot);
+            vclock_attach(slot);
+            logger_attach(slot);
+            placement_attach(slot, PLACE_VOTER);
+            metrics_attach(slot, PLACE_VOTER);
+            record_attach(PLACE_VOTER);
+            vote_set_policy(topo.cls[c].replicas, topo.cls[c].quorum, topo.cls[c].deadline_ms);
+            if (watchdog != NULL)
+            {
+               vote_set_watchdog(watchdog, group, watchdog_period_ms);
+            }
+            startup_ready(startup);
+            if (topo.cls[c].start_s > 0)
+            {
+               vclock_sleep((uint64_t)topo.cls[c].start_s * VCLOCK_SEC);
+            }
+            vote(ch_cmd, &ch_tmr[group], ch_sens, topo.cls[c].kind);
+            exit(EXIT_SUCCESS);
+         }
+         slot_pids[slot] = pid;
+         slot++;
       }
    }
 
    // generate the actuator processes
-   for (i = 0; i < TOT_ACTUATORS; i++)
+   for (i = 0; i < topo.actuators; i++)
    {
       pid = fork();
       if (pid == 0)
       {
+         trace_attach(slot);
+         vclock_attach(slot);
+         logger_attach(slot);
+         placement_attach(slot, PLACE_ACTUATOR);
+         metrics_attach(slot, PLACE_ACTUATOR);
+         record_attach(PLACE_ACTUATOR);
+         stop_on_request();
+         startup_ready(startup);
          actuate(ch_act, i);
          exit(EXIT_SUCCESS);
       }
+      slot_pids[slot] = pid;
+      slot++;
    }
 
    // generate the control process
    pid = fork();
    if (pid == 0)
    {
+      trace_attach(slot);
+      vclock_attach(slot);
+      logger_attach(slot);
+      placement_attach(slot, PLACE_CONTROL);
+      metrics_attach(slot, PLACE_CONTROL);
+      record_attach(PLACE_CONTROL);
+      control_set_law(law_file_path);
+      control_set_rate(control_rate_hz, task_priority);
+      control_set_actuators(topo.actuators);
+      startup_ready(startup);
       control(ch_cmd, ch_sens, ch_act);
       exit(EXIT_SUCCESS);
    }
+   control_pid = pid;
+   slot_pids[slot] = pid;
+   slot++;
+
+   // the driver alone acts on an interruption, and learns of every termination, on a descriptor
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGTERM);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &mask, NULL);
+   if ((signal_fd = signalfd(-1, &mask, SFD_CLOEXEC)) == -1)
+   {
+      perror("signalfd");
+   }
+
+   if (((ready = startup_release(startup)) < processes) && !enable_sim)
+   {
+      fprintf(actual_log_file, "[%i] driver: %i of %i processes ready, starting anyway...\n", getpid(), ready,
+         processes);
+   }
 
    fprintf(actual_log_file, "[%i] driver: waiting for childs termination....\n", getpid());
 
-   for (i = 0; i < (tot_imu + tot_gnss + tot_strtrk + TOT_ACTUATORS); i++)
+   // the actuators run until the end of the stream reaches them, only the inputs end by themselves
+   vclock_join(0, tot_replay + tot_sensors);
+   supervise(tot_replay + tot_sensors, ch_tmr, inject_errors, watchdog_period_ms, actual_log_file);
+
+   // each stage is stopped behind the last message of the stage before, which is gone by then:
+   // it handles everything queued ahead of the termination and passes it on before exiting
+   fprintf(actual_log_file, "[%i] driver: stopping voters, control and actuators...\n", getpid());
+   t_stop = trace_now();
+   memset(&exit_msg, 0, sizeof(exit_msg));
+   exit_msg.mtype = TERMINATE;
+   exit_msg.mvalue = TERMINATE;
+
+   slot = tot_replay + tot_sensors;
+   for (i = 0; i < tot_voters; i++)
    {
-      if ((pid = wait(&status)) == -1)
+      if (slot_pids[slot + i] > 0)
       {
-         perror("wait");
+         channel_push_block(&ch_tmr[i], &exit_msg);
       }
-      fprintf(actual_log_file, "[%i] driver: process %i terminated with status %i...\n", getpid(), pid, status);
    }
+   killed = reap(slot, tot_voters, actual_log_file);
+   t_voters = trace_now();
 
-   fprintf(actual_log_file, "[%i] driver: terminating voters and command...\n", getpid());
+   // a thruster still firing is cut short, as control may wait on it to queue its last
+   // commands; on real time only, as a simulation shall give the same events every run.
+   // An actuator waiting for a command keeps waiting: the channels resume interrupted waits
+   slot += tot_voters;
+   for (i = slot; !enable_sim && (i < slot + topo.actuators); i++)
+   {
+      if (slot_pids[i] > 0)
+      {
+         kill(slot_pids[i], SIGTERM);
+      }
+   }
 
-   // TODO: fix this part
-   // send the termination message to all stand-alone processes (control and voters)
-   exit_msg.mtype = TERMINATE;
-   exit_msg.mvalue = TERMINATE;
-   channel_push_nonblock(ch_cmd, &exit_msg);
+   slot += topo.actuators;
+   if (slot_pids[slot] > 0)
+   {
+      channel_push_block(ch_sens, &exit_msg);
 
-   // if ((pid = wait(&status)) == -1)
-   // {
-   //    perror("wait");
-   // }
-   // fprintf(actual_log_file, "[%i] driver: process %i terminated with status %i...\n", getpid(), pid, status);
+      // with the board control sleeps on it rather than on its channel
+      if (state_board != NULL)
+      {
+         board_wake(state_board);
+      }
+   }
+   killed += reap(slot, 1, actual_log_file);
+   t_control = trace_now();
 
-   // do the same for the voters in case of TMR configuration
-   if(enable_tmr)
+   // control sent the termination on to them, behind its last command
+   killed += reap(slot - topo.actuators, topo.actuators, actual_log_file);
+   t_actuators = trace_now();
+
+   if (enable_shm)
    {
-      for (i = 0; i < (tot_voters); i++)
+      fprintf(actual_log_file, "[%i] driver: waits on the channels...\n", getpid());
+      channel_report_waits(ch_sens, actual_log_file);
+      channel_report_waits(ch_act, actual_log_file);
+      for (i = 0; i < tot_voters; i++)
       {
-         channel_push_nonblock(ch_cmd, &exit_msg);
-         // TODO: fix this part
-         // if(wait(&status) == -1)
-         // {
-         //    perror("wait");
-         // }
+         channel_report_waits(&ch_tmr[i], actual_log_file);
       }
    }
 
+   fprintf(actual_log_file, "[%i] driver: latency per hop of the samples delivered...\n", getpid());
+   trace_report(actual_log_file);
+   trace_release();
+
+   fprintf(actual_log_file, "[%i] driver: placement and scheduling of the processes...\n", getpid());
+   placement_report(actual_log_file);
+   placement_release();
+
+   if (enable_shm)
+   {
+      fprintf(actual_log_file, "[%i] driver: progress of the actuators on the command channel...\n", getpid());
+      channel_report_readers(ch_act, actual_log_file);
+   }
+
+   if (watchdog != NULL)
+   {
+      fprintf(actual_log_file, "[%i] driver: faults of the sensor replicas...\n", getpid());
+      watchdog_report(watchdog, actual_log_file);
+   }
+
+   startup_report(startup, t_launch, actual_log_file);
+   record_report(actual_log_file);
+   vclock_report(actual_log_file);
+
+   // the logger returns once every record written so far is out
+   t_release = trace_now();
+   logger_stop();
+   if (waitpid(logger_pid, &status, 0) == -1)
+   {
+      perror("waitpid");
+   }
+   logger_release();
+
+   for (i = 0; i < tot_voters; i++)
+   {
+      channel_delete(&ch_tmr[i]);
+   }
    channel_delete(ch_sens);
    channel_delete(ch_act);
    channel_delete(ch_cmd);
+   free(ch_tmr);
+   free(inputs);
    free(ch_sens);
    free(ch_act);
    free(ch_cmd);
-   close(log_fd);
+   metrics_release();
+   channel_release_namespace();
+   board_destroy(state_board);
+   watchdog_destroy(watchdog);
+   startup_destroy(startup);
+   free(slot_pids);
+   free(group_class);
+   free(group_slot);
+   record_close();
+   vclock_release();
+   if (signal_fd != -1)
+   {
+      close(signal_fd);
+   }
+
+   // the reports printed in between are not part of the teardown
+   t_release = trace_now() - t_release;
+   fprintf(actual_log_file, "[%i] driver: shut down in %.3f ms: voters %.3f, control %.3f, actuators %.3f, "
+      "logger and IPC %.3f ms, %i processes killed\n", getpid(), (t_actuators - t_stop + t_release) / 1e6,
+      (t_voters - t_stop) / 1e6, (t_control - t_voters) / 1e6, (t_actuators - t_control) / 1e6, t_release / 1e6, killed);
+
+   if (log_fd != -1)
+   {
+      close(log_fd);
+   }
 
    return EXIT_SUCCESS;
 }
 
-PRIVATE void sense(channel_t* data_ch_tx, int id_sens, int id_replica, bool inject_errors)
+PRIVATE pid_t start_sensor(channel_t* data_ch_tx, const topo_class_t* cls, int group, int id_replica, int slot,
+   unsigned int first, bool inject_errors)
+{
+   uint64_t interval_ns;
+   pid_t pid;
+
+   // a replica is late once it missed a sample and its vote deadline, random intervals take up to 10 s
+   if (watchdog != NULL)
+   {
+      interval_ns = (cls->rate_hz > 0) ? 1000000000ULL / (uint64_t)cls->rate_hz : 10 * VCLOCK_SEC;
+      watchdog_watch(watchdog, group, id_replica, interval_ns + (uint64_t)cls->deadline_ms * 1000000ULL);
+   }
+
+   pid = fork();
+   if (pid == 0)
+   {
+      trace_attach(slot);
+      vclock_attach(slot);
+      logger_attach(slot);
+      placement_attach(slot, PLACE_SENSOR);
+      metrics_attach(slot, PLACE_SENSOR);
+      record_attach(PLACE_SENSOR);
+      stop_on_request();
+      startup_ready(startup);
+      sense(data_ch_tx, cls, group, id_replica, first, inject_errors);
+      exit(EXIT_SUCCESS);
+   }
+   else if (pid == -1)
+   {
+      perror("fork");
+   }
+   return pid;
+}
+
+PRIVATE void supervise(int count, channel_t* ch_tmr, bool inject_errors, int period_ms, FILE* out)
+{
+   struct signalfd_siginfo info;
+   struct pollfd fd = { signal_fd, POLLIN, 0 };
+   unsigned int first;
+   bool failed;
+   pid_t pid;
+   int status;
+   int group;
+   int replica;
+   int left = count;
+   int c;
+   int i;
+
+   while (left > 0)
+   {
+      // a replica gone before it sent all its samples crashed
+      failed = false;
+      pid = waitpid(-1, &status, WNOHANG);
+      if (pid == -1)
+      {
+         perror("waitpid");
+         return;
+      }
+      if (pid > 0)
+      {
+         fprintf(out, "[%i] driver: process %i terminated with status %i...\n", getpid(), pid, status);
+         for (i = 0; (i < tot_slots) && (slot_pids[i] != pid); i++)
+         {
+         }
+
+         // a process of a later stage gone early is waited for already, not counted
+         if ((i == tot_slots) || (i >= count))
+         {
+            if (i < tot_slots)
+            {
+               slot_pids[i] = 0;
+            }
+            continue;
+         }
+         slot_pids[i] = 0;
+
+         for (group = 0; (watchdog != NULL) && (group < topology_groups(&topo)); group++)
+         {
+            replica = i - group_slot[group];
+            if ((replica >= 0) && (replica < topo.cls[group_class[group]].replicas))
+            {
+               failed = watchdog_fail(watchdog, group, replica, true);
+               break;
+            }
+         }
+         left -= !failed;
+      }
+      else if ((watchdog != NULL) && watchdog_expired(watchdog, &group, &replica))
+      {
+         // a late replica is put down before it is replaced
+         failed = true;
+         i = group_slot[group] + replica;
+         pid = slot_pids[i];
+         if (pid > 0)
+         {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            slot_pids[i] = 0;
+            fprintf(out, "[%i] driver: process %i missed its heartbeat, killed...\n", getpid(), pid);
+         }
+      }
+      else
+      {
+         // a terminating child or an interruption wakes the driver up, the checks are periodic
+         if ((poll(&fd, 1, ((watchdog != NULL) || (signal_fd == -1)) ? period_ms : -1) > 0)
+            && (read(signal_fd, &info, sizeof(info)) == sizeof(info)) && (info.ssi_signo != SIGCHLD) && !interrupted)
+         {
+            interrupted = true;
+            fprintf(out, "[%i] driver: interrupted, stopping the sensors...\n", getpid());
+            for (i = 0; i < count; i++)
+            {
+               if (slot_pids[i] > 0)
+               {
+                  kill(slot_pids[i], SIGTERM);
+               }
+            }
+         }
+         continue;
+      }
+
+      if (!failed)
+      {
+         continue;
+      }
+
+      // once interrupted a failed replica is not replaced
+      if (interrupted)
+      {
+         left--;
+         continue;
+      }
+
+      // the replacement takes up from the sample its group is at, an injected fault is not repeated
+      c = group_class[group];
+      first = watchdog_resume(watchdog, group);
+      crash_sample = -1;
+      hang_sample = -1;
+      fflush(out);
+      pid = (first < (unsigned int)topo.samples) ?
+         start_sensor(&ch_tmr[group], &topo.cls[c], group, replica, group_slot[group] + replica, first, inject_errors) :
+         -1;
+      slot_pids[group_slot[group] + replica] = (pid > 0) ? pid : 0;
+      if (pid > 0)
+      {
+         fprintf(out, "[%i] driver: replica %i of group %i restarted from sample %u as process %i...\n", getpid(),
+            replica, group, first, pid);
+      }
+      else
+      {
+         left--;
+      }
+   }
+}
+
+PRIVATE int reap(int first, int count, FILE* out)
+{
+   struct signalfd_siginfo info;
+   struct pollfd fd = { signal_fd, POLLIN, 0 };
+   uint64_t deadline;
+   uint64_t now;
+   int status;
+   int timeout;
+   int left;
+   int killed = 0;
+   int i;
+
+   vclock_join(first, count);
+
+   deadline = trace_now() + SHUTDOWN_GRACE_MS * 1000000ULL;
+   do
+   {
+      left = 0;
+      for (i = first; i < first + count; i++)
+      {
+         if ((slot_pids[i] > 0) && (waitpid(slot_pids[i], &status, WNOHANG) == slot_pids[i]))
+         {
+            fprintf(out, "[%i] driver: process %i terminated with status %i...\n", getpid(), slot_pids[i], status);
+            slot_pids[i] = 0;
+         }
+         left += (slot_pids[i] > 0);
+      }
+
+      // the next termination wakes the driver up, an interruption changes nothing any more
+      now = trace_now();
+      if ((left > 0) && (now < deadline))
+      {
+         timeout = (signal_fd == -1) ? 1 : (int)((deadline - now + 999999) / 1000000);
+         if (poll(&fd, 1, timeout) > 0)
+         {
+            read(signal_fd, &info, sizeof(info));
+         }
+      }
+   } while ((left > 0) && (now < deadline));
+
+   for (i = first; i < first + count; i++)
+   {
+      if (slot_pids[i] > 0)
+      {
+         kill(slot_pids[i], SIGKILL);
+         waitpid(slot_pids[i], &status, 0);
+         fprintf(out, "[%i] driver: process %i still running after %i ms, killed...\n", getpid(), slot_pids[i],
+            SHUTDOWN_GRACE_MS);
+         slot_pids[i] = 0;
+         killed++;
+      }
+   }
+   return killed;
+}
+
+PRIVATE void sense(channel_t* data_ch_tx, const topo_class_t* cls, int group, int id_replica, unsigned int first,
+   bool inject_errors)
 {
-   u_int8_t i;
-   message_t data_msg;
-   data_msg.mtype = id_sens;
+   int id_sens = cls->kind;
+   int i;
+   message_t* data_msg;
+   message_t sample;
+   periodic_t task;
+   int value;
 
    channel_create(data_ch_tx, data_ch_tx->seed);
 
-   for (i = 0; i < TOT_SENSING; i++)
+   if (cls->rate_hz > 0)
    {
+      periodic_init(&task, id_sens, cls->rate_hz, task_priority);
+   }
+
+   for (i = (int)first; (i < topo.samples) && !stop_requested; i++)
+   {
+      // faults injected on the first replica of the first sensor
+      if ((group == 0) && (id_replica == 0) && (i == crash_sample))
+      {
+         kill(getpid(), SIGKILL);
+      }
+      while ((group == 0) && (id_replica == 0) && (i == hang_sample) && !stop_requested)
+      {
+         pause();
+      }
+
       if(inject_errors)
       {
          switch (id_replica)
          {
          case 0:
             srand('c');
-            data_msg.mvalue = (rand() % 1000);
-            fprintf(stdout, "[%i] sensor %i/%i: stuck-at-N simulation\n", getpid(), id_sens, id_replica);
+            value = (rand() % 1000);
+            LOG(LOGGER_WARN, EV_SENSOR_STUCK, id_sens, id_replica);
             break;
          case 1:
-            data_msg.mvalue = 999;
-            fprintf(stdout, "[%i] sensor %i/%i: stuck-at-N simulation\n", getpid(), id_sens, id_replica);
+            value = 999;
+            LOG(LOGGER_WARN, EV_SENSOR_STUCK, id_sens, id_replica);
             break;
          case 2:
          default:
-            data_msg.mvalue = (rand() % 100);
+            value = (rand() % 100);
             break;
          }
       }
       else
       {
-         data_msg.mvalue = (rand() % 100);
+         value = (rand() % 100);
+      }
+      if (cls->rate_hz > 0)
+      {
+         periodic_wait(&task);
+      }
+      else
+      {
+         // simulate work
+         vclock_sleep((uint64_t)(rand() % 10) * VCLOCK_SEC);
       }
-      // simulate work
-      sleep(rand() % 10);
 
-      fprintf(stdout, "[%i] sensor %i/%i: generated data: type %li, value %i\n",
-               getpid(), id_sens, id_replica, data_msg.mtype, data_msg.mvalue);
-      channel_push_nonblock(data_ch_tx, &data_msg);
+      // the frame is written straight into the channel on the shared-memory path,
+      // without TMR the board takes it in place of the channel
+      data_msg = ((state_board != NULL) && (data_ch_tx->seed == CH1)) ? &sample : channel_reserve(data_ch_tx);
+      data_msg->mtype = id_sens;
+      data_msg->mvalue = value;
+      data_msg->source = id_replica;
+      frame_simulate(&data_msg->frame, id_sens, value);
+
+      // replicas number their samples alike, so the i-th samples can be matched
+      trace_origin(data_msg, i);
+      LOG(LOGGER_INFO, EV_SENSOR_GENERATED, id_sens, id_replica, data_msg->mtype, data_msg->mvalue);
+      if (data_msg == &sample)
+      {
+         board_publish(state_board, data_msg);
+      }
+      else
+      {
+         channel_commit(data_ch_tx, data_msg);
+      }
+      if (watchdog != NULL)
+      {
+         watchdog_beat(watchdog, group, id_replica, i);
+      }
+   }
+
+   if (watchdog != NULL)
+   {
+      watchdog_retire(watchdog, group, id_replica);
+   }
+
+   if (cls->rate_hz > 0)
+   {
+      periodic_report(&task);
    }
 }
 
 PRIVATE void actuate(channel_t* data_ch_rx, int id_replica)
 {
-   int i;
-   message_t data_msg;
+   int j;
+   int count;
+   int newest;
+   int thruster = id_replica % FRAME_THRUSTERS;
+   long executed = 0;
+   long superseded = 0;
+   bool stop = false;
+   bool subscribed;
+   int work_ms;
+   message_t data_msg[BATCH_SIZE];
+   periodic_t task;
 
    channel_create(data_ch_rx, CH2);
 
-   for (i = 0; i < TOT_ACTUATING; i++)
+   // on a broadcast channel this actuator reads every command through a cursor of its own,
+   // on a queue the copies addressed to its slot; either way it runs until control ends the
+   // stream with a termination command
+   subscribed = channel_subscribe(data_ch_rx);
+
+   if (device_rate_hz > 0)
+   {
+      periodic_init(&task, ID_ACT, device_rate_hz, task_priority);
+   }
+
+   while (!stop)
+   {
+      LOG(LOGGER_DEBUG, EV_ACTUATOR_WAIT, id_replica);
+
+      // a periodic actuator executes the commands arrived since its previous cycle
+      if (device_rate_hz > 0)
+      {
+         periodic_wait(&task);
+         count = subscribed ? channel_drain(data_ch_rx, data_msg, BATCH_SIZE) :
+            channel_drain_cat(data_ch_rx, data_msg, BATCH_SIZE, ID_ACT_SLOT(id_replica));
+      }
+      else
+      {
+         count = subscribed ? channel_retrieve_batch(data_ch_rx, data_msg, BATCH_SIZE) :
+            channel_retrieve_cat_batch(data_ch_rx, data_msg, BATCH_SIZE, ID_ACT_SLOT(id_replica));
+      }
+
+      // only what was retrieved is looked at: a cycle may bring nothing new
+      if (count <= 0)
+      {
+         continue;
+      }
+
+      // of the commands piled up while the thruster was busy only the newest is executed
+      newest = -1;
+      for (j = 0; j < count; j++)
+      {
+         if (control_terminates(&data_msg[j]))
+         {
+            stop = true;
+            continue;
+         }
+
+         trace_hop(TRACE_HOP_ACTUATOR, &data_msg[j]);
+         superseded += (newest >= 0);
+         if ((newest < 0) || (data_msg[j].frame.cmd.cycle > data_msg[newest].frame.cmd.cycle))
+         {
+            newest = j;
+         }
+      }
+
+      if (newest < 0)
+      {
+         continue;
+      }
+
+      if (++executed == 1)
+      {
+         startup_actuated(startup);
+      }
+      trace_record(TRACE_END_TO_END, data_msg[newest].t_hop - data_msg[newest].t_origin);
+      LOG(LOGGER_INFO, EV_ACTUATOR_RECEIVED, id_replica, data_msg[newest].frame.cmd.cycle,
+         (long)(data_msg[newest].frame.cmd.thrust[thruster] * 1000.0f));
+      // a replay runs as fast as control, the actuators do not hold it up; after the
+      // last command nothing waits on the thruster any more
+      if ((device_rate_hz == 0) && (replay_path == NULL) && !stop && !stop_requested)
+      {
+         // simulate firing the thruster; every actuator sees every command, so they share the delay out
+         work_ms = (rand() % 10) * 1000 / topo.actuators;
+         vclock_sleep((uint64_t)work_ms * 1000000ULL);
+      }
+   }
+
+   LOG(LOGGER_INFO, EV_ACTUATOR_STATS, id_replica, thruster, executed, superseded);
+   channel_unsubscribe(data_ch_rx);
+
+   if (device_rate_hz > 0)
+   {
+      periodic_report(&task);
+   }
+}
+
+PRIVATE void change_log_level(int sig)
+{
+   logger_set_level(atomic_load(logger_level) + ((sig == SIGUSR1) ? 1 : -1));
+}
+
+PRIVATE void forward_reload(int sig)
+{
+   (void)sig;
+   if (control_pid > 0)
+   {
+      kill(control_pid, SIGHUP);
+   }
+}
+
+PRIVATE void replay(channel_t** channels, int count, bool tmr)
+{
+   record_trace_t recording;
+   const record_t* record;
+   message_t sample;
+   uint64_t start;
+   uint64_t t_first = 0;
+   uint64_t t_replay = 0;
+   long fed = 0;
+   long skipped = 0;
+   size_t n;
+   int c;
+
+   if (record_map(replay_path, &recording) == -1)
+   {
+      exit(EXIT_FAILURE);
+   }
+   for (c = 0; c < count; c++)
+   {
+      channel_create(channels[c], channels[c]->seed);
+   }
+
+   start = trace_now();
+   for (n = 0; (n < recording.count) && !stop_requested; n++)
    {
-      fprintf(stdout, "[%i] actuator %i: waiting for data...\n",
-         getpid(), id_replica);
+      record = &recording.records[n];
+      for (c = 0; (c < count) && (channels[c]->seed != record->seed); c++)
+      {
+      }
+
+      // with TMR only the sensor samples are fed, the voters send their outcomes themselves;
+      // the end of the stream is the driver's to send, once the replay is over
+      if ((atomic_load_explicit(&((record_t*)record)->committed, memory_order_acquire) == 0) || (c == count)
+         || (tmr && (record->role != PLACE_SENSOR)) || (record->msg.mtype == TERMINATE))
+      {
+         skipped++;
+         continue;
+      }
 
-      channel_retrieve_block(data_ch_rx, &data_msg);
-      fprintf(stdout, "[%i] actuator %i: received data: type %li, value %i\n",
-         getpid(), id_replica, data_msg.mtype, data_msg.mvalue);
-      // simulate work
-      sleep(rand() % 10);
+      if (replay_timed)
+      {
+         if (fed == 0)
+         {
+            t_first = record->t_ns;
+            t_replay = vclock_now();
+         }
+         vclock_sleep_until(t_replay + (record->t_ns - t_first));
+      }
+
+      // latencies are measured from the replay, the sample keeps its number for the voters
+      sample = record->msg;
+      trace_origin(&sample, sample.seq);
+      if ((state_board != NULL) && (record->seed == CH1))
+      {
+         board_publish(state_board, &sample);
+      }
+      else
+      {
+         channel_push_block(channels[c], &sample);
+      }
+      fed++;
    }
+
+   LOG(LOGGER_INFO, EV_REPLAY_STATS, fed, skipped, (trace_now() - start) / 1000000);
+   record_unmap(&recording);
+}
+
+PRIVATE void stop_on_request(void)
+{
+   struct sigaction sa;
+   sigset_t mask;
+
+   sigemptyset(&mask);
+   sigprocmask(SIG_SETMASK, &mask, NULL);
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = request_stop;
+   sa.sa_flags = SA_RESTART;
+   sigaction(SIGTERM, &sa, NULL);
+}
+
+PRIVATE void request_stop(int sig)
+{
+   (void)sig;
+   stop_requested = 1;
 }
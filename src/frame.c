@@ -0,0 +1,77 @@
+/**
+* @file frame.c
+* @brief Functions implementation of @ref header_frame "frame.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <math.h>
+#include <string.h>
+
+#include "frame.h"
+#include "app.h"
+
+/************************** Constant Definitions *****************************/
+#define EARTH_RADIUS    6378137.0      // equatorial radius, in m
+#define GRAVITY         9.80665f       // standard gravity, in m/s^2
+
+/**
+* @brief Fills a frame with the measurement of a simulated sensor.
+*
+* @details The frame is a deterministic function of the raw value, so replicas
+*     reading the same value produce identical frames and a faulty replica
+*     produces a different one.
+*
+* @param[out] frame frame to be filled
+* @param[in]  id    sensor class according to @ref def_ids "this" classification
+* @param[in]  value raw value read by the sensor
+*
+* @return none
+*/
+void frame_simulate(frame_t* frame, long id, int value)
+{
+   float angle = value * 0.01f;
+   int k;
+
+   memset(frame, 0, sizeof(frame_t));
+
+   switch (id)
+   {
+   case ID_IMU:
+      for (k = 0; k < 3; k++)
+      {
+         frame->imu.rate[k] = value * 0.001f * (k + 1);
+         frame->imu.accel[k] = value * 0.01f;
+      }
+      frame->imu.accel[2] += GRAVITY;
+      break;
+   case ID_GNSS:
+      frame->gnss.position[0] = EARTH_RADIUS + value;
+      frame->gnss.position[1] = value * 10.0;
+      frame->gnss.position[2] = -value * 10.0;
+      for (k = 0; k < 3; k++)
+      {
+         frame->gnss.velocity[k] = value * 0.1f;
+      }
+      break;
+   case ID_STRTRK:
+      // rotation of the raw value in centiradians about z
+      frame->strtrk.quaternion[0] = cosf(angle / 2);
+      frame->strtrk.quaternion[3] = sinf(angle / 2);
+      break;
+   default:
+      break;
+   }
+}
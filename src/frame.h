@@ -0,0 +1,95 @@
+/**
+* @file frame.h
+* @brief Data definitions of the sensor frames carried by the messages
+* @anchor header_frame
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef FRAME_H
+#define FRAME_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Alignment of a frame within a message, one cache line
+ */
+#define FRAME_ALIGN     64
+
+/**
+ * @brief Number of thrusters commanded by a command frame
+ */
+#define FRAME_THRUSTERS 6
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Inertial measurement unit frame, sent by @ref def_ids "ID_IMU" sensors.
+ */
+typedef struct
+{
+   float rate[3];          /**< angular rate around x, y, z, in rad/s */
+   float accel[3];         /**< specific force along x, y, z, in m/s^2 */
+} imu_frame_t;
+
+/**
+ * @brief GNSS receiver frame, sent by @ref def_ids "ID_GNSS" sensors.
+ */
+typedef struct
+{
+   double position[3];     /**< ECEF position, in m */
+   float velocity[3];      /**< ECEF velocity, in m/s */
+} gnss_frame_t;
+
+/**
+ * @brief Star tracker frame, sent by @ref def_ids "ID_STRTRK" sensors.
+ */
+typedef struct
+{
+   float quaternion[4];    /**< attitude quaternion, scalar first */
+} strtrk_frame_t;
+
+/**
+ * @brief Thruster command frame, sent by @ref def_ids "ID_CTR".
+ * @details A frame commands all the thrusters at once; each actuator executes the value of
+ *       its own thruster, the actuator with slot i driving thruster i % FRAME_THRUSTERS.
+ *       The cycle orders the frames, so an actuator only executes the newest it has.
+ */
+typedef struct
+{
+   float thrust[FRAME_THRUSTERS]; /**< thrust of each thruster, in N */
+   uint32_t cycle;                /**< control cycle the command was computed in, from 1 */
+} cmd_frame_t;
+
+/**
+ * @brief Payload of a message, interpreted according to the message type.
+ *
+ * @details Every layout is fixed, so a frame is moved as a whole with the message
+ *       and never split. The frame fits a single cache line.
+ */
+typedef union
+{
+   imu_frame_t imu;        /**< frame of an ID_IMU message */
+   gnss_frame_t gnss;      /**< frame of an ID_GNSS message */
+   strtrk_frame_t strtrk;  /**< frame of an ID_STRTRK message */
+   cmd_frame_t cmd;        /**< frame of an ID_CTR message */
+} frame_t;
+
+_Static_assert(sizeof(frame_t) <= FRAME_ALIGN, "a frame shall fit a cache line");
+
+/************************** Function Prototypes *****************************/
+void frame_simulate(frame_t* frame, long id, int value);
+
+#endif /*FRAME_H*/
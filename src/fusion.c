@@ -0,0 +1,172 @@
+/**
+* @file fusion.c
+* @brief Functions implementation of @ref header_fusion "fusion.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <string.h>
+
+#include "fusion.h"
+#include "app.h"
+
+_Static_assert(FRAME_THRUSTERS == LAW_OUTPUTS, "a command frame carries the output of the law");
+
+/************************** Private Functions *****************************/
+/**
+* @brief Maps a sensor class to its slot in the fusion state.
+*
+* @return index of the sensor, -1 if the class is not fused
+*/
+static int fusion_source(long id)
+{
+   return ((id >= ID_IMU) && (id <= ID_STRTRK)) ? (int)(id - ID_IMU) : -1;
+}
+
+/**
+* @brief Computes the contribution of a sensor from its latest frame.
+*/
+static void fusion_term(fusion_t* fusion, int source)
+{
+   const frame_t* frame = &fusion->frames[source];
+   float in[LAW_GROUP_INPUTS];
+   double h[3];
+   double r2;
+   float sign;
+   int k;
+
+   switch (source + ID_IMU)
+   {
+   case ID_IMU:
+      fusion->partial(LAW_GROUP_RATE, frame->imu.rate, fusion->contribution[source]);
+      break;
+   case ID_GNSS:
+      // the orbital rate h / |r|^2, with h = r x v, is the rate the attitude shall keep
+      h[0] = frame->gnss.position[1] * frame->gnss.velocity[2] - frame->gnss.position[2] * frame->gnss.velocity[1];
+      h[1] = frame->gnss.position[2] * frame->gnss.velocity[0] - frame->gnss.position[0] * frame->gnss.velocity[2];
+      h[2] = frame->gnss.position[0] * frame->gnss.velocity[1] - frame->gnss.position[1] * frame->gnss.velocity[0];
+      r2 = frame->gnss.position[0] * frame->gnss.position[0] + frame->gnss.position[1] * frame->gnss.position[1]
+         + frame->gnss.position[2] * frame->gnss.position[2];
+      for (k = 0; k < LAW_GROUP_INPUTS; k++)
+      {
+         in[k] = (r2 > 0.0) ? (float)(-h[k] / r2) : 0.0f;
+      }
+      fusion->partial(LAW_GROUP_RATE, in, fusion->contribution[source]);
+      break;
+   case ID_STRTRK:
+      // small-angle attitude error, taking the shorter of the two equivalent rotations
+      sign = (frame->strtrk.quaternion[0] < 0.0f) ? -2.0f : 2.0f;
+      for (k = 0; k < LAW_GROUP_INPUTS; k++)
+      {
+         in[k] = sign * frame->strtrk.quaternion[k + 1];
+      }
+      fusion->partial(LAW_GROUP_ATTITUDE, in, fusion->contribution[source]);
+      break;
+   default:
+      break;
+   }
+   fusion->terms++;
+}
+
+/**
+* @brief Clears the state of all the sensors.
+*
+* @details The built-in gain-matrix law is used until fusion_set_law() is called.
+*
+* @param[out] fusion      fusion state
+* @param[in]  incremental true to only recompute the contribution of the sensor that
+*                         changed, false to recompute all of them on every update
+*
+* @return none
+*/
+void fusion_init(fusion_t* fusion, bool incremental)
+{
+   memset(fusion, 0, sizeof(fusion_t));
+   fusion->incremental = incremental;
+   fusion->partial = control_law_partial;
+   fusion->combine = control_law_combine;
+}
+
+/**
+* @brief Switches to another control law.
+*
+* @details The contributions computed with the previous law are computed again from
+*     the latest frames, so the next update only mixes terms of the new law.
+*
+* @param[inout] fusion fusion state
+* @param[in]    law    law to compute the contributions and the thrust with
+*
+* @return none
+*/
+void fusion_set_law(fusion_t* fusion, const law_plugin_t* law)
+{
+   int k;
+
+   fusion->partial = law->partial;
+   fusion->combine = law->combine;
+   for (k = 0; k < FUSION_SOURCES; k++)
+   {
+      if (fusion->heard & (1u << k))
+      {
+         fusion_term(fusion, k);
+      }
+   }
+}
+
+/**
+* @brief Fuses a new sample into the state and computes the thrust of each thruster.
+*
+* @details Incremental and full updates give the same commands: they only differ in
+*     the contributions computed again.
+*
+* @param[inout] fusion fusion state
+* @param[in]    id     sensor class of the sample according to @ref def_ids "this" classification
+* @param[in]    frame  frame of the sample
+* @param[out]   thrust thrust of each thruster, untouched if the class is not fused
+*
+* @return false if the class is not fused
+*/
+bool fusion_update(fusion_t* fusion, long id, const frame_t* frame, float thrust[LAW_OUTPUTS])
+{
+   int source = fusion_source(id);
+   int k;
+
+   if (source < 0)
+   {
+      return false;
+   }
+
+   fusion->frames[source] = *frame;
+   fusion->heard |= 1u << source;
+   fusion->updates[source]++;
+
+   if (fusion->incremental)
+   {
+      fusion_term(fusion, source);
+   }
+   else
+   {
+      for (k = 0; k < FUSION_SOURCES; k++)
+      {
+         if (fusion->heard & (1u << k))
+         {
+            fusion_term(fusion, k);
+         }
+      }
+   }
+
+   fusion->combine((const float (*)[LAW_OUTPUTS])fusion->contribution, FUSION_SOURCES, thrust);
+   return true;
+}
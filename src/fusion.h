@@ -0,0 +1,82 @@
+/**
+* @file fusion.h
+* @brief Functions and data definitions for the multi-rate sensor fusion
+* @anchor header_fusion
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef FUSION_H
+#define FUSION_H
+
+/***************************** Include Files ********************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "control_law.h"
+#include "frame.h"
+#include "law_plugin.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Number of sensor classes fused, IMU, GNSS and star tracker
+ */
+#define FUSION_SOURCES  3
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Latest state of all the sensors and the thrust commanded from it.
+ *
+ * @details Sensors run at different rates, so each sample updates the state of its
+ *       own sensor only. Each sensor feeds one input group of the gain-matrix law
+ *       (see @ref def_law_groups "input groups"): the star tracker the attitude error,
+ *       the IMU the angular rate and the GNSS, through the orbital rate, the reference
+ *       the angular rate is compared against. The contribution of each sensor is kept,
+ *       so an incremental update only computes again the one of the sensor that
+ *       changed; a sensor not heard from yet contributes nothing. The contributions
+ *       and the thrust are computed by the active law (see fusion_set_law()).
+ *
+ */
+typedef struct
+{
+   bool incremental;                               /**< false to recompute every contribution on each update */
+   void (*partial)(int group, const float in[LAW_GROUP_INPUTS], float partial[LAW_OUTPUTS]);
+                                                   /**< contribution of an input group, from the active law */
+   void (*combine)(const float (*partials)[LAW_OUTPUTS], int count, float out[LAW_OUTPUTS]);
+                                                   /**< thrust from the contributions, from the active law */
+   uint32_t heard;                                 /**< mask of the sensors heard from */
+   frame_t frames[FUSION_SOURCES];                 /**< latest frame of each sensor */
+   float contribution[FUSION_SOURCES][LAW_OUTPUTS]; /**< contribution of each sensor to the thrust */
+   uint64_t updates[FUSION_SOURCES];               /**< samples fused, per sensor */
+   uint64_t terms;                                 /**< contributions computed */
+} fusion_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+void fusion_init(fusion_t* fusion, bool incremental);
+void fusion_set_law(fusion_t* fusion, const law_plugin_t* law);
+/* @} */
+
+/**
+ * @name Running
+ * @{
+ */
+bool fusion_update(fusion_t* fusion, long id, const frame_t* frame, float thrust[LAW_OUTPUTS]);
+/* @} */
+
+#endif /*FUSION_H*/
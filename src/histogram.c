@@ -0,0 +1,147 @@
+/**
+* @file histogram.c
+* @brief Functions implementation of @ref header_hist "histogram.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <string.h>
+
+#include "histogram.h"
+
+/************************** Private Functions *****************************/
+static inline int histogram_index(uint64_t value)
+{
+   int exponent;
+
+   if (value < HIST_SUB_COUNT)
+   {
+      return (int)value;
+   }
+
+   // shift that brings the most significant bit at the top of the sub-bucket range
+   exponent = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+   if (exponent > HIST_MAX_BITS - 1 - HIST_SUB_BITS)
+   {
+      return HIST_BUCKETS - 1;
+   }
+   return (exponent + 1) * HIST_SUB_COUNT + (int)((value >> exponent) & (HIST_SUB_COUNT - 1));
+}
+
+static inline uint64_t histogram_upper_bound(int index)
+{
+   int exponent = index / HIST_SUB_COUNT - 1;
+   uint64_t sub = (uint64_t)(index % HIST_SUB_COUNT);
+
+   if (exponent < 0)
+   {
+      return sub;
+   }
+   return (((uint64_t)HIST_SUB_COUNT + sub + 1) << exponent) - 1;
+}
+
+/**
+* @brief Empties a histogram.
+*
+* @param[out] hist pointer to a histogram
+*
+* @return none
+*/
+void histogram_reset(histogram_t* hist)
+{
+   memset(hist, 0, sizeof(*hist));
+}
+
+/**
+* @brief Records one occurrence of a value.
+*
+* @param[inout] hist  pointer to a histogram
+* @param[in]    value value to record
+*
+* @return none
+*/
+void histogram_record(histogram_t* hist, uint64_t value)
+{
+   hist->buckets[histogram_index(value)]++;
+   hist->count++;
+   if (value > hist->max)
+   {
+      hist->max = value;
+   }
+}
+
+/**
+* @brief Adds all the occurrences recorded in a histogram to another one.
+*
+* @param[inout] dst histogram receiving the occurrences
+* @param[in]    src histogram to be added
+*
+* @return none
+*/
+void histogram_merge(histogram_t* dst, const histogram_t* src)
+{
+   int i;
+
+   for (i = 0; i < HIST_BUCKETS; i++)
+   {
+      dst->buckets[i] += src->buckets[i];
+   }
+   dst->count += src->count;
+   if (src->max > dst->max)
+   {
+      dst->max = src->max;
+   }
+}
+
+/**
+* @brief Computes the value below which a given percentage of the occurrences fall.
+*
+* @details The result is the upper bound of the bucket holding the percentile, capped
+*     at the highest recorded value.
+*
+* @param[in] hist       pointer to a histogram
+* @param[in] percentile percentage in the range [0, 100]
+*
+* @return the percentile, 0 for an empty histogram
+*/
+uint64_t histogram_percentile(const histogram_t* hist, double percentile)
+{
+   uint64_t target;
+   uint64_t seen = 0;
+   uint64_t bound;
+   int i;
+
+   if (hist->count == 0)
+   {
+      return 0;
+   }
+
+   target = (uint64_t)(percentile / 100.0 * (double)hist->count + 0.5);
+   if (target == 0)
+   {
+      target = 1;
+   }
+
+   for (i = 0; i < HIST_BUCKETS; i++)
+   {
+      seen += hist->buckets[i];
+      if (seen >= target)
+      {
+         bound = histogram_upper_bound(i);
+         return (bound < hist->max) ? bound : hist->max;
+      }
+   }
+   return hist->max;
+}
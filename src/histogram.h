@@ -0,0 +1,61 @@
+/**
+* @file histogram.h
+* @brief Functions and data definitions for the latency histogram
+* @anchor header_hist
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Histogram layout
+ * @brief Every power of two is split in 2^HIST_SUB_BITS linear buckets, which bounds
+ *     the relative error of a recorded value to 2^-HIST_SUB_BITS (about 3%).
+ * @{
+ */
+#define HIST_SUB_BITS      5
+#define HIST_SUB_COUNT     (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS      40
+#define HIST_BUCKETS       ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+/* @} */
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Log-linear histogram of non-negative values, in the style of HdrHistogram.
+ *
+ * @details Recording a value costs a couple of shifts and an increment, with no
+ *       allocation, so it can be done on the hot path. Values of 2^HIST_MAX_BITS
+ *       and above (about 18 minutes, for nanoseconds) fall in the last bucket.
+ *
+ */
+typedef struct
+{
+   uint64_t count;                  /**< number of recorded values */
+   uint64_t max;                    /**< highest recorded value */
+   uint64_t buckets[HIST_BUCKETS];  /**< occurrences per bucket */
+} histogram_t;
+
+/************************** Function Prototypes *****************************/
+void histogram_reset(histogram_t* hist);
+void histogram_record(histogram_t* hist, uint64_t value);
+void histogram_merge(histogram_t* dst, const histogram_t* src);
+uint64_t histogram_percentile(const histogram_t* hist, double percentile);
+
+#endif /*HISTOGRAM_H*/
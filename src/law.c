@@ -0,0 +1,238 @@
+/**
+* @file law.c
+* @brief Functions implementation of @ref header_law "law.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "law.h"
+#include "control_law.h"
+#include "histogram.h"
+#include "logger.h"
+#include "metrics.h"
+
+/************************** Constant Definitions *****************************/
+// private copy of a plugin, so a rebuilt file is never mistaken for the loaded one
+#define LAW_COPY_TEMPLATE  "/tmp/controlx-law-XXXXXX"
+
+/**************************** Type Definitions ******************************/
+typedef struct
+{
+   void* handle;                 // NULL for the built-in law
+   const law_plugin_t* plugin;
+   int id;                       // load order, 0 for the built-in law
+   histogram_t cycles;           // time spent in each step, in ns
+} law_t;
+
+/************************** Variable Definitions *****************************/
+static const law_plugin_t law_builtin =
+   { LAW_ABI_VERSION, sizeof(law_plugin_t), "builtin", NULL, NULL, control_law_partial, control_law_combine };
+
+static law_t law_active = { NULL, &law_builtin, 0, { 0, 0, { 0 } } };
+static const char* law_path = NULL;
+static int law_loaded = 0;
+
+/************************** Private Functions *****************************/
+/**
+* @brief Loads a private copy of a shared object.
+*
+* @details dlopen() hands back the already loaded object when given a path it has
+*     seen before, even if the file was rebuilt in the meantime: loading a fresh
+*     copy each time makes sure the current content of the file is used.
+*/
+static void* law_open(const char* path)
+{
+   char copy[] = LAW_COPY_TEMPLATE;
+   char buffer[4096];
+   void* handle = NULL;
+   ssize_t bytes;
+   int src;
+   int dst;
+
+   if ((src = open(path, O_RDONLY)) == -1)
+   {
+      perror("open");
+      return NULL;
+   }
+   if ((dst = mkstemp(copy)) == -1)
+   {
+      perror("mkstemp");
+      close(src);
+      return NULL;
+   }
+
+   while ((bytes = read(src, buffer, sizeof(buffer))) > 0)
+   {
+      if (write(dst, buffer, bytes) != bytes)
+      {
+         perror("write");
+         bytes = -1;
+         break;
+      }
+   }
+   close(src);
+   close(dst);
+
+   if (bytes == 0)
+   {
+      if ((handle = dlopen(copy, RTLD_NOW | RTLD_LOCAL)) == NULL)
+      {
+         fprintf(stderr, "[%i] control: %s\n", getpid(), dlerror());
+      }
+   }
+
+   // the mapping outlives the file
+   unlink(copy);
+   return handle;
+}
+
+/**
+* @brief Checks that a plugin descriptor matches the ABI of the loader.
+*/
+static bool law_compatible(const law_plugin_t* plugin)
+{
+   return (plugin->abi_version == LAW_ABI_VERSION)
+      && (plugin->size >= offsetof(law_plugin_t, combine) + sizeof(plugin->combine))
+      && (plugin->partial != NULL) && (plugin->combine != NULL);
+}
+
+/**
+* @brief Sets the law used by control() and, optionally, the plugin it is reloaded from.
+*
+* @details With a path the plugin is loaded right away; when that fails, or
+*     without a path, the built-in gain-matrix law is used.
+*
+* @param[in] path path of the plugin shared object, NULL for the built-in law
+*
+* @return none
+*/
+void law_init(const char* path)
+{
+   law_path = path;
+   histogram_reset(&law_active.cycles);
+
+   if (law_path != NULL)
+   {
+      law_reload();
+   }
+}
+
+/**
+* @brief Loads the plugin again and makes it the active law.
+*
+* @details Meant to be called between two control cycles. The new plugin is fully
+*     loaded and initialised before it replaces the active law, which is then
+*     reported, finalised and unloaded. On failure the active law is kept. The
+*     caller hands the new law to its fusion with fusion_set_law().
+*
+* @return true if the new plugin is active
+*/
+bool law_reload(void)
+{
+   const law_plugin_t* plugin;
+   void* handle;
+
+   if (law_path == NULL)
+   {
+      return false;
+   }
+
+   if ((handle = law_open(law_path)) == NULL)
+   {
+      fprintf(stderr, "[%i] control: cannot load %s, keeping law #%i\n", getpid(), law_path, law_active.id);
+      return false;
+   }
+
+   plugin = dlsym(handle, LAW_PLUGIN_SYMBOL);
+   if ((plugin == NULL) || !law_compatible(plugin))
+   {
+      fprintf(stderr, "[%i] control: %s is not a law plugin of ABI version %i, keeping law #%i\n",
+         getpid(), law_path, LAW_ABI_VERSION, law_active.id);
+      dlclose(handle);
+      return false;
+   }
+
+   if ((plugin->init != NULL) && (plugin->init() != 0))
+   {
+      fprintf(stderr, "[%i] control: law %s failed to start, keeping law #%i\n",
+         getpid(), plugin->name, law_active.id);
+      dlclose(handle);
+      return false;
+   }
+
+   law_report();
+   if (law_active.plugin->fini != NULL)
+   {
+      law_active.plugin->fini();
+   }
+   if (law_active.handle != NULL)
+   {
+      dlclose(law_active.handle);
+   }
+
+   law_active.handle = handle;
+   law_active.plugin = plugin;
+   law_active.id = ++law_loaded;
+   histogram_reset(&law_active.cycles);
+
+   fprintf(stderr, "[%i] control: law #%i %s loaded from %s\n", getpid(), law_active.id, plugin->name, law_path);
+   return true;
+}
+
+/**
+* @brief Returns the active law.
+*
+* @return descriptor of the loaded plugin, or of the built-in law
+*/
+const law_plugin_t* law_current(void)
+{
+   return law_active.plugin;
+}
+
+/**
+* @brief Records how long the active law took to turn a sample into a command.
+*
+* @param[in] elapsed duration of the cycle, in ns
+*
+* @return none
+*/
+void law_record(uint64_t elapsed)
+{
+   histogram_record(&law_active.cycles, elapsed);
+   metrics_law_cycle(elapsed);
+}
+
+/**
+* @brief Logs the cycle-time statistics of the active law.
+*
+* @return none
+*/
+void law_report(void)
+{
+   if (law_active.cycles.count == 0)
+   {
+      return;
+   }
+
+   LOG(LOGGER_INFO, EV_LAW_STATS, law_active.id, law_active.cycles.count,
+      histogram_percentile(&law_active.cycles, 50.0), histogram_percentile(&law_active.cycles, 99.0));
+}
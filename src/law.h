@@ -0,0 +1,48 @@
+/**
+* @file law.h
+* @brief Functions and data definitions for the hot-swappable control law
+* @anchor header_law
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef LAW_H
+#define LAW_H
+
+/***************************** Include Files ********************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "law_plugin.h"
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Loading
+ * @{
+ */
+void law_init(const char* path);
+bool law_reload(void);
+const law_plugin_t* law_current(void);
+/* @} */
+
+/**
+ * @name Running
+ * @{
+ */
+void law_record(uint64_t elapsed);
+void law_report(void);
+/* @} */
+
+#endif /*LAW_H*/
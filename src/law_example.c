@@ -0,0 +1,74 @@
+/**
+* @file law_example.c
+* @brief Example of a control law plugin, see @ref header_law_plugin "law_plugin.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include "law_plugin.h"
+
+/************************** Constant Definitions *****************************/
+#define EXAMPLE_GAIN    4.0f  // proportional gain on the attitude error
+
+/**
+* @brief Proportional control law, which ignores the angular rate.
+*
+* @details Thruster 2k pushes around +k and thruster 2k+1 around -k, as with the
+*     built-in law.
+*
+* @param[in]  group   input group according to @ref def_law_groups "this" layout
+* @param[in]  in      inputs of the group
+* @param[out] partial contribution to each thruster, before saturation
+*
+* @return none
+*/
+static void example_partial(int group, const float in[LAW_GROUP_INPUTS], float partial[LAW_OUTPUTS])
+{
+   int k;
+
+   for (k = 0; k < LAW_GROUP_INPUTS; k++)
+   {
+      partial[2 * k] = (group == LAW_GROUP_ATTITUDE) ? EXAMPLE_GAIN * in[k] : 0.0f;
+      partial[2 * k + 1] = -partial[2 * k];
+   }
+}
+
+/**
+* @brief Adds up the contributions and saturates the thrust of each thruster.
+*
+* @param[in]  partials contributions to add up
+* @param[in]  count    number of contributions
+* @param[out] out      thrust of each thruster
+*
+* @return none
+*/
+static void example_combine(const float (*partials)[LAW_OUTPUTS], int count, float out[LAW_OUTPUTS])
+{
+   float thrust;
+   int i;
+   int k;
+
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      thrust = 0.0f;
+      for (k = 0; k < count; k++)
+      {
+         thrust += partials[k][i];
+      }
+      out[i] = (thrust < 0.0f) ? 0.0f : ((thrust > LAW_THRUST_MAX) ? LAW_THRUST_MAX : thrust);
+   }
+}
+
+LAW_PLUGIN("proportional", NULL, NULL, example_partial, example_combine);
@@ -0,0 +1,80 @@
+/**
+* @file law_plugin.h
+* @brief ABI between the control process and the control law plugins
+* @anchor header_law_plugin
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef LAW_PLUGIN_H
+#define LAW_PLUGIN_H
+
+/***************************** Include Files ********************************/
+#include <stddef.h>
+#include <stdint.h>
+
+#include "control_law.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Version of the plugin ABI, bumped on every incompatible change
+ */
+#define LAW_ABI_VERSION       2
+
+/**
+ * @brief Name of the descriptor every plugin exports
+ */
+#define LAW_PLUGIN_SYMBOL     "controlx_law_plugin"
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Descriptor of a control law plugin.
+ *
+ * @details A plugin is a shared object exporting a const law_plugin_t named
+ *       controlx_law_plugin, usually through LAW_PLUGIN(). The loader rejects a
+ *       plugin built against another ABI version or with a smaller descriptor.
+ *       Fields may only be appended, which keeps older plugins loadable.
+ *       The law is split like the built-in gain matrix: partial() computes the
+ *       contribution of one input group (see @ref def_law_groups "input groups")
+ *       and combine() the thrust of each thruster from the contributions, so the
+ *       fusion of control only computes again the one of the sensor that changed.
+ *
+ */
+typedef struct
+{
+   uint32_t abi_version;                     /**< LAW_ABI_VERSION the plugin was built against */
+   uint32_t size;                            /**< sizeof(law_plugin_t) the plugin was built against */
+   const char* name;                         /**< printable name of the law */
+   int (*init)(void);                        /**< optional, called once loaded: non-zero rejects the plugin */
+   void (*fini)(void);                       /**< optional, called before the plugin is unloaded */
+   void (*partial)(int group, const float in[LAW_GROUP_INPUTS], float partial[LAW_OUTPUTS]);
+                                             /**< contribution of a group, same contract as control_law_partial() */
+   void (*combine)(const float (*partials)[LAW_OUTPUTS], int count, float out[LAW_OUTPUTS]);
+                                             /**< thrust of each thruster, same contract as control_law_combine() */
+} law_plugin_t;
+
+/**
+ * @brief Defines the descriptor of a plugin.
+ *
+ * @param name printable name of the law
+ * @param init function called once loaded, or NULL
+ * @param fini function called before unloading, or NULL
+ * @param partial contribution of an input group to the thrust
+ * @param combine thrust of each thruster from the contributions
+ */
+#define LAW_PLUGIN(name, init, fini, partial, combine) \
+   const law_plugin_t controlx_law_plugin = \
+      { LAW_ABI_VERSION, sizeof(law_plugin_t), (name), (init), (fini), (partial), (combine) }
+
+#endif /*LAW_PLUGIN_H*/
@@ -0,0 +1,308 @@
+/**
+* @file lawbench.c
+* @brief Microbenchmark of the batch control law against the per-sample path,
+*     and of the incremental sensor fusion against the full one.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "control_law.h"
+#include "fusion.h"
+#include "app.h"
+
+/************************** Constant Definitions *****************************/
+#define LAWBENCH_SAMPLES   (1 << 20)   // default number of samples per run
+#define LAWBENCH_RUNS      10          // default number of runs, the fastest is reported
+#define LAWBENCH_RATIO     100         // default IMU samples per GNSS and star tracker sample
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Reads the monotonic clock.
+*
+* @return current time in seconds
+*/
+static double lawbench_now(void);
+
+/**
+* @brief Allocates count floats aligned to a cache line.
+*
+* @param[in] count number of floats
+*
+* @return pointer to the floats, the process exits on failure
+*/
+static float* lawbench_alloc(size_t count);
+
+/**
+* @brief Fuses a stream of samples and times it.
+*
+* @param[in]  incremental fusion mode, see fusion_init()
+* @param[in]  ids         sensor class of each sample
+* @param[in]  frames      frame of each sample
+* @param[in]  samples     number of samples
+* @param[in]  runs        number of runs, the fastest is reported
+* @param[out] thrust      thrust commanded after each sample
+* @param[out] terms       sensor contributions computed in a run
+*
+* @return duration of the fastest run, in seconds
+*/
+static double lawbench_fusion(bool incremental, const long* ids, const frame_t* frames, size_t samples,
+   int runs, float (*thrust)[LAW_OUTPUTS], uint64_t* terms);
+
+/**
+*
+* @brief Times the gain-matrix control law over a large batch of random samples
+*
+* @details The reference is the per-sample path, one control_law_sample() call per
+*   sample, as a GNC loop would do. Every instruction set supported by the CPU is
+*   then timed through control_law_batch() and its commands checked against the
+*   reference, which they shall match exactly.
+*   Last, a multi-rate stream, where the IMU updates ratio times as often as the GNSS
+*   and the star tracker, is fused both incrementally and in full: the commands shall
+*   again match exactly.
+*/
+int main(int argc, char* argv[])
+{
+   static const law_isa_t isas[] = { LAW_ISA_SCALAR, LAW_ISA_SSE, LAW_ISA_AVX2 };
+   float* in[LAW_INPUTS];
+   float* out[LAW_OUTPUTS];
+   float* ref[LAW_OUTPUTS];
+   float sample_in[LAW_INPUTS];
+   float sample_out[LAW_OUTPUTS];
+   float (*thrust)[LAW_OUTPUTS];
+   float (*thrust_ref)[LAW_OUTPUTS];
+   frame_t* frames;
+   long* ids;
+   uint64_t terms;
+   uint64_t terms_ref;
+   size_t samples = LAWBENCH_SAMPLES;
+   size_t mismatches;
+   size_t n;
+   double start;
+   double best;
+   double reference;
+   int runs = LAWBENCH_RUNS;
+   int ratio = LAWBENCH_RATIO;
+   int opt;
+   int r;
+   int i;
+   int j;
+
+   while ((opt = getopt(argc, argv, "hn:r:f:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'n':
+         samples = (size_t)atol(optarg);
+         break;
+      case 'r':
+         runs = atoi(optarg);
+         break;
+      case 'f':
+         ratio = atoi(optarg);
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-n COUNT] [-r RUNS] [-f RATIO]\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -n samples per run (default %i)\n", LAWBENCH_SAMPLES);
+         fprintf(stderr, "............ -r runs, the fastest is reported (default %i)\n", LAWBENCH_RUNS);
+         fprintf(stderr, "............ -f IMU samples per GNSS and star tracker sample in the fusion (default %i)\n",
+            LAWBENCH_RATIO);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if ((samples == 0) || (runs <= 0) || (ratio <= 0))
+   {
+      fprintf(stderr, "invalid benchmark configuration\n");
+      exit(EXIT_FAILURE);
+   }
+
+   // attitude errors within +-0.5 rad and rates within +-0.5 rad/s
+   srand(1);
+   for (j = 0; j < LAW_INPUTS; j++)
+   {
+      in[j] = lawbench_alloc(samples);
+      for (n = 0; n < samples; n++)
+      {
+         in[j][n] = (float)rand() / RAND_MAX - 0.5f;
+      }
+   }
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      out[i] = lawbench_alloc(samples);
+      ref[i] = lawbench_alloc(samples);
+   }
+
+   best = 0.0;
+   for (r = 0; r < runs; r++)
+   {
+      start = lawbench_now();
+      for (n = 0; n < samples; n++)
+      {
+         for (j = 0; j < LAW_INPUTS; j++)
+         {
+            sample_in[j] = in[j][n];
+         }
+         control_law_sample(sample_in, sample_out);
+         for (i = 0; i < LAW_OUTPUTS; i++)
+         {
+            ref[i][n] = sample_out[i];
+         }
+      }
+      start = lawbench_now() - start;
+      best = ((r == 0) || (start < best)) ? start : best;
+   }
+   reference = best;
+
+   fprintf(stdout, "%-12s %12s %14s %10s %12s\n", "path", "ns/sample", "Msamples/s", "speedup", "mismatches");
+   fprintf(stdout, "%-12s %12.2f %14.2f %9.2fx %12s\n", "per-sample",
+      reference * 1e9 / samples, samples / reference / 1e6, 1.0, "-");
+
+   for (r = 0; r < (int)(sizeof(isas) / sizeof(isas[0])); r++)
+   {
+      if (control_law_select(isas[r]) != isas[r])
+      {
+         fprintf(stdout, "%-12s %12s\n", control_law_isa_name(isas[r]), "unsupported");
+         continue;
+      }
+
+      best = 0.0;
+      for (i = 0; i < runs; i++)
+      {
+         start = lawbench_now();
+         control_law_batch((const float* const*)in, out, samples);
+         start = lawbench_now() - start;
+         best = ((i == 0) || (start < best)) ? start : best;
+      }
+
+      mismatches = 0;
+      for (i = 0; i < LAW_OUTPUTS; i++)
+      {
+         for (n = 0; n < samples; n++)
+         {
+            mismatches += (out[i][n] != ref[i][n]);
+         }
+      }
+
+      fprintf(stdout, "%-12s %12.2f %14.2f %9.2fx %12lu\n", control_law_isa_name(isas[r]),
+         best * 1e9 / samples, samples / best / 1e6, reference / best, (unsigned long)mismatches);
+   }
+
+   for (j = 0; j < LAW_INPUTS; j++)
+   {
+      free(in[j]);
+   }
+   for (i = 0; i < LAW_OUTPUTS; i++)
+   {
+      free(out[i]);
+      free(ref[i]);
+   }
+
+   // each cycle of the stream is ratio IMU samples, then one GNSS and one star tracker sample
+   ids = malloc(samples * sizeof(long));
+   frames = malloc(samples * sizeof(frame_t));
+   thrust = malloc(samples * sizeof(*thrust));
+   thrust_ref = malloc(samples * sizeof(*thrust_ref));
+   if ((ids == NULL) || (frames == NULL) || (thrust == NULL) || (thrust_ref == NULL))
+   {
+      perror("malloc");
+      exit(EXIT_FAILURE);
+   }
+   for (n = 0; n < samples; n++)
+   {
+      j = (int)(n % (size_t)(ratio + 2));
+      ids[n] = (j < ratio) ? ID_IMU : (j == ratio) ? ID_GNSS : ID_STRTRK;
+      frame_simulate(&frames[n], ids[n], rand() % 100);
+   }
+
+   reference = lawbench_fusion(false, ids, frames, samples, runs, thrust_ref, &terms_ref);
+   best = lawbench_fusion(true, ids, frames, samples, runs, thrust, &terms);
+
+   mismatches = 0;
+   for (n = 0; n < samples; n++)
+   {
+      for (i = 0; i < LAW_OUTPUTS; i++)
+      {
+         mismatches += (thrust[n][i] != thrust_ref[n][i]);
+      }
+   }
+
+   fprintf(stdout, "\nfusion, %i IMU samples per GNSS and star tracker sample\n", ratio);
+   fprintf(stdout, "%-12s %12s %14s %10s %12s\n", "fusion", "ns/sample", "terms/sample", "speedup", "mismatches");
+   fprintf(stdout, "%-12s %12.2f %14.2f %9.2fx %12s\n", "full",
+      reference * 1e9 / samples, (double)terms_ref / samples, 1.0, "-");
+   fprintf(stdout, "%-12s %12.2f %14.2f %9.2fx %12lu\n", "incremental",
+      best * 1e9 / samples, (double)terms / samples, reference / best, (unsigned long)mismatches);
+
+   free(ids);
+   free(frames);
+   free(thrust);
+   free(thrust_ref);
+
+   return EXIT_SUCCESS;
+}
+
+static double lawbench_now(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static float* lawbench_alloc(size_t count)
+{
+   float* ptr;
+
+   // aligned_alloc() wants a size multiple of the alignment
+   if ((ptr = aligned_alloc(64, (count * sizeof(float) + 63) / 64 * 64)) == NULL)
+   {
+      perror("aligned_alloc");
+      exit(EXIT_FAILURE);
+   }
+   return ptr;
+}
+
+static double lawbench_fusion(bool incremental, const long* ids, const frame_t* frames, size_t samples,
+   int runs, float (*thrust)[LAW_OUTPUTS], uint64_t* terms)
+{
+   fusion_t fusion;
+   double start;
+   double best = 0.0;
+   size_t n;
+   int r;
+
+   for (r = 0; r < runs; r++)
+   {
+      fusion_init(&fusion, incremental);
+      start = lawbench_now();
+      for (n = 0; n < samples; n++)
+      {
+         fusion_update(&fusion, ids[n], &frames[n], thrust[n]);
+      }
+      start = lawbench_now() - start;
+      best = ((r == 0) || (start < best)) ? start : best;
+   }
+
+   *terms = fusion.terms;
+   return best;
+}
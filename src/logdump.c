@@ -0,0 +1,141 @@
+/**
+* @file logdump.c
+* @brief Decoder of the binary log files written by the driver.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "record.h"
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Prints a recording of the channel traffic, one message per line.
+*
+* @param[in] path path of the recording
+*
+* @return EXIT_SUCCESS, EXIT_FAILURE if the file is not a recording
+*/
+static int logdump_recording(const char* path);
+
+/**
+*
+* @brief Prints a binary log file in the same text format as the demo output
+*
+* @details The file is a sequence of runs, each starting with an EV_HEADER record.
+*   Records above the level given with -l are skipped. With -r the file is a recording
+*   of the channel traffic instead (see @ref header_record "record.h").
+*/
+int main(int argc, char* argv[])
+{
+   log_record_t record;
+   FILE* file;
+   int level = LOGGER_DEBUG;
+   bool recording = false;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "hl:r")) != -1)
+   {
+      switch (opt)
+      {
+      case 'l':
+         level = logger_parse_level(optarg);
+         if (level < 0)
+         {
+            fprintf(stderr, "invalid log level %s\n", optarg);
+            exit(EXIT_FAILURE);
+         }
+         break;
+      case 'r':
+         recording = true;
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-l LEVEL] [-r] FILE\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -l print up to this level: error, warn, info, debug (default)\n");
+         fprintf(stderr, "............ -r FILE is a recording of the channel traffic\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if (optind >= argc)
+   {
+      fprintf(stderr, "Usage %s [-h] [-l LEVEL] [-r] FILE\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+
+   if (recording)
+   {
+      return logdump_recording(argv[optind]);
+   }
+
+   if ((file = fopen(argv[optind], "rb")) == NULL)
+   {
+      perror("fopen");
+      exit(EXIT_FAILURE);
+   }
+
+   while (fread(&record, sizeof(record), 1, file) == 1)
+   {
+      if (record.event == EV_HEADER)
+      {
+         if ((record.args[0] != LOGGER_MAGIC) || (record.args[1] != LOGGER_VERSION)
+            || (record.args[2] != sizeof(log_record_t)))
+         {
+            fprintf(stderr, "%s: not a log file of this version\n", argv[optind]);
+            fclose(file);
+            exit(EXIT_FAILURE);
+         }
+         continue;
+      }
+
+      if (record.level <= level)
+      {
+         logger_decode(&record, stdout);
+      }
+   }
+
+   fclose(file);
+   return EXIT_SUCCESS;
+}
+
+static int logdump_recording(const char* path)
+{
+   record_trace_t trace;
+   size_t n;
+
+   if (record_map(path, &trace) == -1)
+   {
+      return EXIT_FAILURE;
+   }
+
+   for (n = 0; n < trace.count; n++)
+   {
+      record_decode(&trace.records[n], trace.records[0].t_ns, stdout);
+   }
+   if (trace.dropped > 0)
+   {
+      fprintf(stdout, "%lu messages dropped with the recording full\n", (unsigned long)trace.dropped);
+   }
+
+   record_unmap(&trace);
+   return EXIT_SUCCESS;
+}
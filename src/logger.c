@@ -0,0 +1,486 @@
+/**
+* @file logger.c
+* @brief Functions implementation of @ref header_logger "logger.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "sysdep.h"
+#include "ring.h"
+
+/************************** Constant Definitions *****************************/
+#define LOGGER_CAPACITY    2048     // records buffered per process
+#define LOGGER_DRAIN       256      // records taken from a process per pass
+#define LOGGER_IDLE_NS     1000000  // logger sleep when all the rings are empty
+
+#define LOGGER_ALIGN(size) (((size) + 63) & ~(size_t)63)
+
+/**************************** Type Definitions ******************************/
+// head of the shared segment, followed by the per-process drop counters and rings
+typedef struct
+{
+   _Atomic int level;
+   _Atomic int stop;
+   int processes;
+   size_t ring_size;
+} logger_shared_t;
+
+/************************** Variable Definitions *****************************/
+// level used until the logger is initialised: everything, as plain text
+static _Atomic int logger_default_level = LOGGER_DEBUG;
+_Atomic int* logger_level = &logger_default_level;
+
+static logger_shared_t* logger_shared = NULL;
+static size_t logger_size = 0;
+
+// ring and drop counter owned by the calling process, NULL when it has no slot
+static ring_t* logger_mine = NULL;
+static _Atomic uint64_t* logger_dropped = NULL;
+
+// pid of the calling process, cached once it owns a slot
+static int32_t logger_pid = 0;
+
+static const char* logger_formats[EV_TOT] =
+{
+   [EV_SENSOR_STUCK]       = "[%i] sensor %li/%li: stuck-at-N simulation\n",
+   [EV_SENSOR_GENERATED]   = "[%i] sensor %li/%li: generated data: type %li, value %li\n",
+   [EV_ACTUATOR_WAIT]      = "[%i] actuator %li: waiting for data...\n",
+   [EV_ACTUATOR_RECEIVED]  = "[%i] actuator %li: executing command %li, thrust %li mN\n",
+   [EV_CONTROL_WAIT]       = "[%i] control: waiting for messages...\n",
+   [EV_CONTROL_TERMINATE]  = "[%i] control: received termination command, SHUTTING DOWN...\n",
+   [EV_CONTROL_RECEIVED]   = "[%i] control: received data: type %li, value %li \n",
+   [EV_CONTROL_TRANSMIT]   = "[%i] control: transmit data: type %li, value %li\n",
+   [EV_VOTER_WAIT]         = "[%i] voter: waiting for messages...\n",
+   [EV_VOTER_TERMINATE]    = "[%i] voter: received termination command, SHUTTING DOWN...\n",
+   [EV_VOTER_RECEIVED]     = "[%i] voter: received data: type %li, value %li \n",
+   [EV_VOTER_CONSENSUS]    = "[%i] voter: %li-out-%li consensus reached on sample %li, value %li\n",
+   [EV_VOTER_DEADLINE]     = "[%i] voter: deadline expired on sample %li with %li of %li replicas, sending 0\n",
+   [EV_VOTER_NO_CONSENSUS] = "[%i] voter: NO consensus reached on sample %li with %li of %li replicas, sending 0\n",
+   [EV_VOTER_SENT]         = "[%i] voter: sent data to control: type %li, value %li\n",
+   [EV_LOGGER_DROPPED]     = "[%i] logger: %li records dropped, log slot %li full\n",
+   [EV_LAW_STATS]          = "[%i] control: law #%li ran %li cycles, p50 %li ns, p99 %li ns\n",
+   [EV_VOTER_LATE]         = "[%i] voter: discarding sample %li from replica %li, late or unexpected\n",
+   [EV_TASK_STATS]         = "[%i] task %li: %li activations, %li deadline misses, %li overruns\n",
+   [EV_TASK_JITTER]        = "[%i] task %li: jitter p50 %li ns, p99 %li ns, max %li ns\n",
+   [EV_BOARD_STATS]        = "[%i] control: sensor %li, read up to its sample %li, %li superseded before being read\n",
+   [EV_FUSION_STATS]       = "[%i] control: %li samples fused, %li sensor terms computed, p50 %li ns, p99 %li ns\n",
+   [EV_REPLAY_STATS]       = "[%i] replay: %li messages fed from the recording, %li skipped, in %li ms\n",
+   [EV_ACTUATOR_STATS]     = "[%i] actuator %li: thruster %li, %li commands executed, %li superseded\n",
+   [EV_VOTER_FAILOVER]     = "[%i] voter: voting %li-out-of-%li, on the replicas alive of %li\n"
+};
+
+static const char* logger_level_names[] = { "off", "error", "warn", "info", "debug" };
+
+/************************** Function Prototypes *****************************/
+static ring_t* logger_ring(int slot);
+static size_t logger_rings_offset(int processes);
+static void logger_output(const log_record_t* records, size_t count, int fd);
+static int logger_compare(const void* a, const void* b);
+
+/**
+* @brief Allocates the log rings of all the processes.
+*
+* @details The rings are kept in an anonymous shared mapping, so it shall be
+*     called before forking the processes. Every process owns a single-producer
+*     ring, drained by the process running logger_run(). Until this is called
+*     the records are printed synchronously on stdout.
+*
+* @param[in] processes number of process slots
+* @param[in] level     initial level according to @ref def_levels "this" list
+*
+* @return none
+*/
+void logger_init(int processes, int level)
+{
+   size_t ring_size;
+   size_t size;
+   void* ptr;
+   int i;
+
+   ring_size = LOGGER_ALIGN(ring_footprint(LOGGER_CAPACITY, sizeof(log_record_t), _Alignof(log_record_t)));
+   size = logger_rings_offset(processes) + (size_t)processes * ring_size;
+
+   ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED)
+   {
+      perror("mmap");
+      return;
+   }
+
+   logger_shared = ptr;
+   logger_size = size;
+   logger_shared->processes = processes;
+   logger_shared->ring_size = ring_size;
+   atomic_init(&logger_shared->stop, 0);
+   atomic_init(&logger_shared->level, LOGGER_OFF);
+   for (i = 0; i < processes; i++)
+   {
+      ring_init(logger_ring(i), LOGGER_CAPACITY, sizeof(log_record_t), _Alignof(log_record_t), RING_SINGLE);
+   }
+
+   logger_level = &logger_shared->level;
+   logger_set_level(level);
+   logger_mine = NULL;
+   logger_dropped = NULL;
+}
+
+/**
+* @brief Makes the calling process log through a slot.
+*
+* @param[in] slot index of the slot, unique among the processes
+*
+* @return none
+*/
+void logger_attach(int slot)
+{
+   if ((logger_shared != NULL) && (slot >= 0) && (slot < logger_shared->processes))
+   {
+      logger_mine = logger_ring(slot);
+      logger_dropped = (_Atomic uint64_t*)((char*)logger_shared + LOGGER_ALIGN(sizeof(logger_shared_t))) + slot;
+      logger_pid = getpid();
+   }
+}
+
+/**
+* @brief Releases the log rings of all the processes.
+*
+* @details Records not yet drained are lost, logging goes back to stdout.
+*
+* @return none
+*/
+void logger_release(void)
+{
+   if (logger_shared != NULL)
+   {
+      logger_default_level = atomic_load(&logger_shared->level);
+      munmap(logger_shared, logger_size);
+   }
+   logger_level = &logger_default_level;
+   logger_shared = NULL;
+   logger_size = 0;
+   logger_mine = NULL;
+   logger_dropped = NULL;
+}
+
+/**
+* @brief Changes the level of all the processes.
+*
+* @details It is async-signal-safe, so it can be called from a signal handler.
+*
+* @param[in] level level according to @ref def_levels "this" list, clamped
+*
+* @return none
+*/
+void logger_set_level(int level)
+{
+   if (level < LOGGER_OFF)
+   {
+      level = LOGGER_OFF;
+   }
+   else if (level > LOGGER_DEBUG)
+   {
+      level = LOGGER_DEBUG;
+   }
+   atomic_store_explicit(logger_level, level, memory_order_relaxed);
+}
+
+/**
+* @brief Parses a level given by name (off, error, warn, info, debug) or number.
+*
+* @param[in] name name or number of the level
+*
+* @return level according to @ref def_levels "this" list, -1 if not valid
+*/
+int logger_parse_level(const char* name)
+{
+   char* end;
+   long level;
+   int i;
+
+   for (i = LOGGER_OFF; i <= LOGGER_DEBUG; i++)
+   {
+      if (strcasecmp(name, logger_level_names[i]) == 0)
+      {
+         return i;
+      }
+   }
+
+   level = strtol(name, &end, 10);
+   if ((*name == '\0') || (*end != '\0') || (level < LOGGER_OFF) || (level > LOGGER_DEBUG))
+   {
+      return -1;
+   }
+   return (int)level;
+}
+
+/**
+* @brief Writes a record into the ring of the calling process.
+*
+* @details It never blocks nor formats: if the ring is full the record is
+*     dropped and counted. Use the LOG() macro, which skips disabled levels
+*     without evaluating the arguments.
+*
+* @param[in] level level according to @ref def_levels "this" list
+* @param[in] event event according to @ref def_events "this" list
+* @param[in] arg0  first argument of the event format
+* @param[in] arg1  second argument of the event format
+* @param[in] arg2  third argument of the event format
+* @param[in] arg3  fourth argument of the event format
+*
+* @return none
+*/
+void logger_write(int level, int event, int64_t arg0, int64_t arg1, int64_t arg2, int64_t arg3)
+{
+   log_record_t record;
+
+   record.t_ns = sysdep_now();
+   record.event = (uint16_t)event;
+   record.level = (uint16_t)level;
+   record.args[0] = arg0;
+   record.args[1] = arg1;
+   record.args[2] = arg2;
+   record.args[3] = arg3;
+
+   if (logger_mine == NULL)
+   {
+      record.pid = getpid();
+      logger_decode(&record, stdout);
+      return;
+   }
+
+   record.pid = logger_pid;
+   if (!ring_push(logger_mine, &record))
+   {
+      atomic_fetch_add_explicit(logger_dropped, 1, memory_order_relaxed);
+   }
+}
+
+/**
+* @brief Prints a record in its human-readable format.
+*
+* @param[in] record record to be printed, file headers are skipped
+* @param[in] out    stream where the record is printed
+*
+* @return none
+*/
+void logger_decode(const log_record_t* record, FILE* out)
+{
+   if (record->event == EV_HEADER)
+   {
+      return;
+   }
+
+   if ((record->event >= EV_TOT) || (logger_formats[record->event] == NULL))
+   {
+      fprintf(out, "[%i] unknown event %u\n", record->pid, record->event);
+      return;
+   }
+
+   fprintf(out, logger_formats[record->event], record->pid,
+      (long)record->args[0], (long)record->args[1], (long)record->args[2], (long)record->args[3]);
+}
+
+/**
+* @brief Drains the rings of all the processes until logger_stop() is called.
+*
+* @details Meant to run in a dedicated process. The records drained in a pass
+*     are sorted by time, then either appended in binary to a file, which
+*     starts with an EV_HEADER record, or printed on stdout. When all the rings
+*     are empty it sleeps, so the writers never have to wake it up.
+*
+* @param[in] fd descriptor of the binary log file, -1 to print on stdout
+*
+* @return none
+*/
+void logger_run(int fd)
+{
+   struct timespec idle = { 0, LOGGER_IDLE_NS };
+   log_record_t* buffer;
+   log_record_t record;
+   _Atomic uint64_t* dropped;
+   size_t count;
+   bool stopping;
+   int i;
+
+   if (logger_shared == NULL)
+   {
+      return;
+   }
+
+   buffer = malloc((size_t)logger_shared->processes * LOGGER_DRAIN * sizeof(log_record_t));
+   if (buffer == NULL)
+   {
+      perror("malloc");
+      return;
+   }
+
+   if (fd >= 0)
+   {
+      memset(&record, 0, sizeof(record));
+      record.t_ns = sysdep_now();
+      record.pid = getpid();
+      record.event = EV_HEADER;
+      record.args[0] = LOGGER_MAGIC;
+      record.args[1] = LOGGER_VERSION;
+      record.args[2] = sizeof(log_record_t);
+      logger_output(&record, 1, fd);
+   }
+
+   do
+   {
+      // a record written before the stop request is drained by the next pass
+      stopping = atomic_load(&logger_shared->stop);
+
+      count = 0;
+      for (i = 0; i < logger_shared->processes; i++)
+      {
+         count += ring_pop_batch(logger_ring(i), &buffer[count], LOGGER_DRAIN);
+      }
+
+      if (count > 0)
+      {
+         qsort(buffer, count, sizeof(log_record_t), logger_compare);
+         logger_output(buffer, count, fd);
+      }
+      else if (!stopping)
+      {
+         nanosleep(&idle, NULL);
+      }
+   } while (!stopping || (count > 0));
+
+   dropped = (_Atomic uint64_t*)((char*)logger_shared + LOGGER_ALIGN(sizeof(logger_shared_t)));
+   for (i = 0; i < logger_shared->processes; i++)
+   {
+      if (atomic_load(&dropped[i]) > 0)
+      {
+         memset(&record, 0, sizeof(record));
+         record.t_ns = sysdep_now();
+         record.pid = getpid();
+         record.event = EV_LOGGER_DROPPED;
+         record.level = LOGGER_WARN;
+         record.args[0] = (int64_t)atomic_load(&dropped[i]);
+         record.args[1] = i;
+         logger_output(&record, 1, fd);
+      }
+   }
+
+   free(buffer);
+}
+
+/**
+* @brief Makes logger_run() return once the rings are empty.
+*
+* @return none
+*/
+void logger_stop(void)
+{
+   if (logger_shared != NULL)
+   {
+      atomic_store(&logger_shared->stop, 1);
+   }
+}
+
+/**
+* @brief Returns the ring of a slot.
+*
+* @param[in] slot index of the slot
+*
+* @return ring of the slot
+*/
+static ring_t* logger_ring(int slot)
+{
+   return (ring_t*)((char*)logger_shared + logger_rings_offset(logger_shared->processes)
+      + (size_t)slot * logger_shared->ring_size);
+}
+
+/**
+* @brief Returns the offset of the first ring in the shared segment.
+*
+* @param[in] processes number of process slots
+*
+* @return offset in bytes
+*/
+static size_t logger_rings_offset(int processes)
+{
+   return LOGGER_ALIGN(sizeof(logger_shared_t)) + LOGGER_ALIGN((size_t)processes * sizeof(uint64_t));
+}
+
+/**
+* @brief Writes records in binary to a file or prints them on stdout.
+*
+* @param[in] records records to be written
+* @param[in] count   number of records
+* @param[in] fd      descriptor of the binary log file, -1 to print on stdout
+*
+* @return none
+*/
+static void logger_output(const log_record_t* records, size_t count, int fd)
+{
+   const char* data = (const char*)records;
+   size_t left = count * sizeof(log_record_t);
+   ssize_t written;
+   size_t i;
+
+   if (fd < 0)
+   {
+      for (i = 0; i < count; i++)
+      {
+         logger_decode(&records[i], stdout);
+      }
+      fflush(stdout);
+      return;
+   }
+
+   while (left > 0)
+   {
+      written = write(fd, data, left);
+      if (written < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         perror("write");
+         return;
+      }
+      data += written;
+      left -= (size_t)written;
+   }
+}
+
+/**
+* @brief Orders two records by time.
+*
+* @param[in] a first record
+* @param[in] b second record
+*
+* @return negative, zero or positive as for qsort()
+*/
+static int logger_compare(const void* a, const void* b)
+{
+   const log_record_t* first = a;
+   const log_record_t* second = b;
+
+   return (first->t_ns > second->t_ns) - (first->t_ns < second->t_ns);
+}
@@ -0,0 +1,173 @@
+/**
+* @file logger.h
+* @brief Functions and data definitions for the asynchronous binary logger
+* @anchor header_logger
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Log levels
+ * @anchor def_levels
+ * @brief A record is logged when its level is lower or equal than the current one
+ * @{
+ */
+#define LOGGER_OFF         0     /**< nothing is logged */
+#define LOGGER_ERROR       1
+#define LOGGER_WARN        2
+#define LOGGER_INFO        3
+#define LOGGER_DEBUG       4
+/* @} */
+
+/**
+ * @name Events
+ * @anchor def_events
+ * @brief Identifiers of the log records, each bound to a fixed text format
+ * @{
+ */
+#define EV_HEADER                0     /**< file header, never printed */
+#define EV_SENSOR_STUCK          1
+#define EV_SENSOR_GENERATED      2
+#define EV_ACTUATOR_WAIT         3
+#define EV_ACTUATOR_RECEIVED     4
+#define EV_CONTROL_WAIT          5
+#define EV_CONTROL_TERMINATE     6
+#define EV_CONTROL_RECEIVED      7
+#define EV_CONTROL_TRANSMIT      8
+#define EV_VOTER_WAIT            9
+#define EV_VOTER_TERMINATE       10
+#define EV_VOTER_RECEIVED        11
+#define EV_VOTER_CONSENSUS       12
+#define EV_VOTER_DEADLINE        13
+#define EV_VOTER_NO_CONSENSUS    14
+#define EV_VOTER_SENT            15
+#define EV_LOGGER_DROPPED        16
+#define EV_LAW_STATS             17
+#define EV_VOTER_LATE            18
+#define EV_TASK_STATS            19
+#define EV_TASK_JITTER           20
+#define EV_BOARD_STATS           21
+#define EV_FUSION_STATS          22
+#define EV_REPLAY_STATS          23
+#define EV_ACTUATOR_STATS        24
+#define EV_VOTER_FAILOVER        25
+#define EV_TOT                   26
+/* @} */
+
+/**
+ * @brief Number of arguments carried by a log record
+ */
+#define LOGGER_ARGS        4
+
+/**
+ * @name Log file
+ * @brief Values carried by the EV_HEADER record that starts every run in a log file
+ * @{
+ */
+#define LOGGER_MAGIC       0x474f4c58     /**< args[0], "XLOG" */
+#define LOGGER_VERSION     2              /**< args[1], args[2] is the record size */
+/* @} */
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Fixed-size binary log record.
+ *
+ * @details Records are written unformatted by the processes and turned into text
+ *       by the logger process or, for log files, by the logdump tool.
+ *
+ */
+typedef struct
+{
+   uint64_t t_ns;                /**< monotonic time the record was written, in ns */
+   int32_t pid;                  /**< process that wrote the record */
+   uint16_t event;               /**< event according to @ref def_events "this" list */
+   uint16_t level;               /**< level according to @ref def_levels "this" list */
+   int64_t args[LOGGER_ARGS];    /**< arguments of the event text format */
+} log_record_t;
+
+/************************** Variable Definitions *****************************/
+// current level, shared by all the processes once the logger is initialised
+extern _Atomic int* logger_level;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+void logger_init(int processes, int level);
+void logger_attach(int slot);
+void logger_release(void);
+/* @} */
+
+/**
+ * @name Levels
+ * @{
+ */
+void logger_set_level(int level);
+int logger_parse_level(const char* name);
+
+/**
+* @brief Tells whether records of a level are currently logged.
+*
+* @param[in] level level according to @ref def_levels "this" list
+*
+* @return true if the records are logged
+*/
+static inline bool logger_enabled(int level)
+{
+   return level <= atomic_load_explicit(logger_level, memory_order_relaxed);
+}
+/* @} */
+
+/**
+ * @name Logging
+ * @{
+ */
+void logger_write(int level, int event, int64_t arg0, int64_t arg1, int64_t arg2, int64_t arg3);
+void logger_decode(const log_record_t* record, FILE* out);
+/* @} */
+
+/**
+ * @name Logger process
+ * @{
+ */
+void logger_run(int fd);
+void logger_stop(void);
+/* @} */
+
+/**
+ * @brief Logs an event with up to LOGGER_ARGS arguments.
+ *
+ * @details The arguments are not evaluated when the level is disabled, so a
+ *       disabled log statement costs a load and a compare.
+ */
+#define LOG(level, ...) \
+   do { if (logger_enabled(level)) logger_write(level, LOGGER_ARGS_PAD(__VA_ARGS__, 0, 0, 0, 0, 0)); } while (0)
+
+// pads the event arguments with zeros
+#define LOGGER_ARGS_PAD(event, a0, a1, a2, a3, ...) \
+   (event), (int64_t)(a0), (int64_t)(a1), (int64_t)(a2), (int64_t)(a3)
+
+#endif /*LOGGER_H*/
@@ -0,0 +1,353 @@
+/**
+* @file metrics.c
+* @brief Functions implementation of @ref header_metrics "metrics.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+// longest name of a metrics segment
+#define METRICS_NAME_LEN   32
+
+/************************** Variable Definitions *****************************/
+// segment inherited by the processes forked after metrics_init(), NULL when not counting
+static metrics_t* metrics = NULL;
+static size_t metrics_size = 0;
+static char metrics_name[METRICS_NAME_LEN];
+
+// counters of the calling process, NULL if it is not attached
+static metrics_process_t* metrics_mine = NULL;
+
+/************************** Private Functions *****************************/
+// only the owner writes the counters of a process: a plain add, published with a relaxed store
+static inline void metrics_add(_Atomic uint64_t* counter, uint64_t value)
+{
+   atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline bool metrics_channel_valid(int seed)
+{
+   return (metrics != NULL) && (seed > 0) && (seed < METRICS_CHANNELS);
+}
+
+/**
+* @brief Creates the metrics segment of a run.
+*
+* @details The segment is a shared-memory object named after the channel namespace of
+*     the run, so tools such as controlx-top can map it while the run goes on. It is
+*     inherited by the processes forked afterwards; each of them shall call
+*     metrics_attach() to count its own traffic. The counters are relaxed atomics,
+*     only written by the process or channel they belong to, so updating them costs
+*     no more than a plain add on a line already in cache.
+*
+* @param[in] ns        channel namespace of the run
+* @param[in] processes number of process slots
+*
+* @return 0 on success, -1 if the segment could not be created
+*/
+int metrics_init(int ns, int processes)
+{
+   metrics_t* segment;
+   int fd;
+
+   snprintf(metrics_name, METRICS_NAME_LEN, METRICS_NAME, ns);
+   metrics_size = sizeof(metrics_t) + (size_t)processes * sizeof(metrics_process_t);
+
+   // a stale segment of a namespace left behind is replaced, the object is sparse
+   shm_unlink(metrics_name);
+   if ((fd = shm_open(metrics_name, O_RDWR | O_CREAT | O_EXCL, 0644)) == -1)
+   {
+      perror("shm_open");
+      return -1;
+   }
+   if (ftruncate(fd, metrics_size) == -1)
+   {
+      perror("ftruncate");
+      close(fd);
+      shm_unlink(metrics_name);
+      return -1;
+   }
+   segment = mmap(NULL, metrics_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (segment == MAP_FAILED)
+   {
+      perror("mmap");
+      shm_unlink(metrics_name);
+      return -1;
+   }
+
+   segment->pid = getpid();
+   segment->processes = processes;
+   segment->start_ns = sysdep_now();
+   segment->version = METRICS_VERSION;
+   atomic_thread_fence(memory_order_release);
+   segment->magic = METRICS_MAGIC;
+   metrics = segment;
+   return 0;
+}
+
+/**
+* @brief Counts the traffic of the calling process in a slot of its own.
+*
+* @param[in] slot index of the process, from 0 to the processes given to metrics_init()
+* @param[in] role @ref header_placement "placement" role of the process
+*
+* @return none
+*/
+void metrics_attach(int slot, int role)
+{
+   if ((metrics == NULL) || (slot < 0) || (slot >= metrics->processes))
+   {
+      return;
+   }
+   metrics_mine = &metrics->process[slot];
+   metrics_mine->role = role;
+   atomic_store_explicit(&metrics_mine->pid, getpid(), memory_order_release);
+}
+
+/**
+* @brief Removes the metrics segment, once the run is over.
+*
+* @return none
+*/
+void metrics_release(void)
+{
+   if (metrics == NULL)
+   {
+      return;
+   }
+   munmap(metrics, metrics_size);
+   shm_unlink(metrics_name);
+   metrics = NULL;
+   metrics_mine = NULL;
+}
+
+/**
+* @brief Maps the metrics segment of a run, read-only.
+*
+* @details The run is not disturbed: its processes do not know the segment is read.
+*     The mapping shall be removed with munmap() and the returned size.
+*
+* @param[in]  ns   channel namespace of the run
+* @param[out] size length of the mapping
+*
+* @return the segment, NULL if the run has none or it is not of this version
+*/
+const metrics_t* metrics_open(int ns, size_t* size)
+{
+   char name[METRICS_NAME_LEN];
+   const metrics_t* segment;
+   struct stat st;
+   int fd;
+
+   snprintf(name, METRICS_NAME_LEN, METRICS_NAME, ns);
+   if ((fd = shm_open(name, O_RDONLY, 0)) == -1)
+   {
+      return NULL;
+   }
+   if ((fstat(fd, &st) == -1) || ((size_t)st.st_size < sizeof(metrics_t)))
+   {
+      close(fd);
+      return NULL;
+   }
+   segment = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (segment == MAP_FAILED)
+   {
+      return NULL;
+   }
+   if ((segment->magic != METRICS_MAGIC) || (segment->version != METRICS_VERSION) ||
+      ((size_t)st.st_size < sizeof(metrics_t) + (size_t)segment->processes * sizeof(metrics_process_t)))
+   {
+      munmap((void*)segment, (size_t)st.st_size);
+      return NULL;
+   }
+
+   *size = (size_t)st.st_size;
+   return segment;
+}
+
+/**
+* @brief Returns the monotonic time in ns, to time a wait with metrics_channel_blocked().
+*
+* @return the time, 0 when nothing is counted
+*/
+uint64_t metrics_clock(void)
+{
+   return (metrics != NULL) ? sysdep_now() : 0;
+}
+
+/**
+* @brief Records the backend of a channel being opened.
+*
+* @param[in] seed    seed of the channel
+* @param[in] backend @ref channel_backend_t "backend" of the channel
+* @param[in] readers consumers of a broadcast channel
+*
+* @return none
+*/
+void metrics_channel_open(int seed, int backend, int readers)
+{
+   metrics_channel_t* channel;
+   int top;
+
+   if (!metrics_channel_valid(seed))
+   {
+      return;
+   }
+
+   channel = &metrics->channels[seed];
+   atomic_store_explicit(&channel->backend, backend, memory_order_relaxed);
+   atomic_store_explicit(&channel->readers, (backend == CHANNEL_SHM_BCAST) ? readers : 1, memory_order_relaxed);
+   atomic_store_explicit(&channel->used, 1, memory_order_relaxed);
+
+   top = atomic_load_explicit(&metrics->top_channel, memory_order_relaxed);
+   while ((seed > top) && !atomic_compare_exchange_weak_explicit(&metrics->top_channel, &top, seed,
+      memory_order_relaxed, memory_order_relaxed))
+   {
+   }
+}
+
+/**
+* @brief Counts messages pushed on a channel by the calling process.
+*
+* @param[in] seed  seed of the channel
+* @param[in] count messages pushed
+*
+* @return none
+*/
+void metrics_channel_in(int seed, int count)
+{
+   if (!metrics_channel_valid(seed))
+   {
+      return;
+   }
+   atomic_fetch_add_explicit(&metrics->channels[seed].in, (uint64_t)count, memory_order_relaxed);
+   if (metrics_mine != NULL)
+   {
+      metrics_add(&metrics_mine->out, (uint64_t)count);
+   }
+}
+
+/**
+* @brief Counts messages retrieved from a channel by the calling process.
+*
+* @param[in] seed  seed of the channel
+* @param[in] count messages retrieved
+*
+* @return none
+*/
+void metrics_channel_out(int seed, int count)
+{
+   if (!metrics_channel_valid(seed) || (count <= 0))
+   {
+      return;
+   }
+   atomic_fetch_add_explicit(&metrics->channels[seed].out, (uint64_t)count, memory_order_relaxed);
+   if (metrics_mine != NULL)
+   {
+      metrics_add(&metrics_mine->in, (uint64_t)count);
+   }
+}
+
+/**
+* @brief Counts a message dropped because the channel was full.
+*
+* @param[in] seed seed of the channel
+*
+* @return none
+*/
+void metrics_channel_drop(int seed)
+{
+   if (metrics_channel_valid(seed))
+   {
+      atomic_fetch_add_explicit(&metrics->channels[seed].drops, 1, memory_order_relaxed);
+   }
+}
+
+/**
+* @brief Counts the time the calling process was blocked on a channel.
+*
+* @param[in] seed     seed of the channel
+* @param[in] producer true if the process waited for room, false if for data
+* @param[in] since_ns time the wait started, from metrics_clock(), 0 if it was not timed
+*
+* @return none
+*/
+void metrics_channel_blocked(int seed, bool producer, uint64_t since_ns)
+{
+   metrics_channel_t* channel;
+   uint64_t blocked_ns;
+
+   if (!metrics_channel_valid(seed) || (since_ns == 0))
+   {
+      return;
+   }
+
+   channel = &metrics->channels[seed];
+   blocked_ns = sysdep_now() - since_ns;
+   atomic_fetch_add_explicit(producer ? &channel->blocked_in_ns : &channel->blocked_out_ns, blocked_ns,
+      memory_order_relaxed);
+   if (metrics_mine != NULL)
+   {
+      metrics_add(&metrics_mine->blocked_ns, blocked_ns);
+   }
+}
+
+/**
+* @brief Counts a vote where not every replica agreed with the outcome.
+*
+* @return none
+*/
+void metrics_disagreement(void)
+{
+   if (metrics_mine != NULL)
+   {
+      metrics_add(&metrics_mine->disagreements, 1);
+   }
+}
+
+/**
+* @brief Counts a step of the control law.
+*
+* @param[in] ns time the step took
+*
+* @return none
+*/
+void metrics_law_cycle(uint64_t ns)
+{
+   if (metrics_mine == NULL)
+   {
+      return;
+   }
+   metrics_add(&metrics_mine->law_cycles, 1);
+   metrics_add(&metrics_mine->law_ns, ns);
+   if (ns > atomic_load_explicit(&metrics_mine->law_max_ns, memory_order_relaxed))
+   {
+      atomic_store_explicit(&metrics_mine->law_max_ns, ns, memory_order_relaxed);
+   }
+}
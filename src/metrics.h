@@ -0,0 +1,130 @@
+/**
+* @file metrics.h
+* @brief Functions and data definitions for the live metrics of the chain
+* @anchor header_metrics
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef METRICS_H
+#define METRICS_H
+
+/***************************** Include Files ********************************/
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "channel.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Identifies a metrics segment
+ */
+#define METRICS_MAGIC      0x4d455452U
+
+/**
+ * @brief Version of the layout of the segment, bumped on every change
+ */
+#define METRICS_VERSION    1
+
+/**
+ * @brief Channels the segment has room for, indexed by their seed
+ */
+#define METRICS_CHANNELS   (CHANNEL_ID_MAX + 1)
+
+/**
+ * @brief Name of the segment of a run, after its channel namespace
+ */
+#define METRICS_NAME       "/controlx-metrics-%04x"
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Counters of a process, only written by the process itself.
+ */
+typedef struct
+{
+   _Alignas(64) _Atomic pid_t pid;  /**< process, 0 while not attached */
+   int role;                        /**< @ref header_placement "placement" role of the process */
+   _Atomic uint64_t in;             /**< messages retrieved from the channels */
+   _Atomic uint64_t out;            /**< messages pushed on the channels */
+   _Atomic uint64_t blocked_ns;     /**< time spent blocked on a channel */
+   _Atomic uint64_t disagreements;  /**< votes with at least a replica out of the majority */
+   _Atomic uint64_t law_cycles;     /**< control-law steps */
+   _Atomic uint64_t law_ns;         /**< time spent in the control law */
+   _Atomic uint64_t law_max_ns;     /**< longest control-law step */
+} metrics_process_t;
+
+/**
+ * @brief Counters of a channel, shared by all its producers and consumers.
+ *
+ * @details The producers and the consumers update lines of their own. The depth of the
+ *       channel is the difference between the messages in and out; on a broadcast
+ *       channel every consumer counts the messages it gets, so they are divided by
+ *       the readers.
+ */
+typedef struct
+{
+   _Alignas(64) _Atomic uint64_t in;         /**< messages pushed */
+   _Atomic uint64_t drops;                   /**< messages dropped with the channel full */
+   _Atomic uint64_t blocked_in_ns;           /**< time producers spent waiting for room */
+   _Atomic int backend;                      /**< @ref channel_backend_t "backend" of the channel */
+   _Atomic int readers;                      /**< consumers of a broadcast channel, 1 otherwise */
+   _Atomic int used;                         /**< the channel has been opened */
+   _Alignas(64) _Atomic uint64_t out;        /**< messages retrieved */
+   _Atomic uint64_t blocked_out_ns;          /**< time consumers spent waiting for data */
+} metrics_channel_t;
+
+/**
+ * @brief Metrics segment of a run.
+ */
+typedef struct
+{
+   uint32_t magic;                  /**< METRICS_MAGIC */
+   uint32_t version;                /**< METRICS_VERSION */
+   pid_t pid;                       /**< process that created the segment */
+   int processes;                   /**< process slots */
+   uint64_t start_ns;               /**< monotonic time the segment was created at */
+   _Atomic int top_channel;         /**< highest seed of a channel opened so far */
+   metrics_channel_t channels[METRICS_CHANNELS];
+   metrics_process_t process[];
+} metrics_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+int metrics_init(int ns, int processes);
+void metrics_attach(int slot, int role);
+void metrics_release(void);
+const metrics_t* metrics_open(int ns, size_t* size);
+/* @} */
+
+/**
+ * @name Counters
+ * @{
+ */
+uint64_t metrics_clock(void);
+void metrics_channel_open(int seed, int backend, int readers);
+void metrics_channel_in(int seed, int count);
+void metrics_channel_out(int seed, int count);
+void metrics_channel_drop(int seed);
+void metrics_channel_blocked(int seed, bool producer, uint64_t since_ns);
+void metrics_disagreement(void);
+void metrics_law_cycle(uint64_t ns);
+/* @} */
+
+#endif /*METRICS_H*/
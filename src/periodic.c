@@ -0,0 +1,128 @@
+/**
+* @file periodic.c
+* @brief Functions implementation of @ref header_periodic "periodic.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "periodic.h"
+#include "logger.h"
+#include "trace.h"
+#include "vclock.h"
+
+/**
+* @brief Sets up a periodic task for the calling process.
+*
+* @details The first job is released one period after this call. With a priority,
+*     the process is moved to the SCHED_FIFO class and its memory is locked, so
+*     page faults do not add to the jitter; when the system does not allow it a
+*     warning is printed and the task runs with the default policy.
+*
+* @param[out] task     task to be set up
+* @param[in]  id       identifier of the task in the log
+* @param[in]  rate_hz  releases per second
+* @param[in]  priority SCHED_FIFO priority, 0 for the default policy
+*
+* @return none
+*/
+void periodic_init(periodic_t* task, int id, int rate_hz, int priority)
+{
+   struct sched_param param;
+
+   memset(task, 0, sizeof(periodic_t));
+   task->id = id;
+   task->period_ns = 1000000000ULL / (uint64_t)((rate_hz > 0) ? rate_hz : 1);
+   task->release_ns = vclock_now();
+
+   if (priority <= 0)
+   {
+      return;
+   }
+
+   memset(&param, 0, sizeof(param));
+   param.sched_priority = priority;
+   if (sched_setscheduler(0, SCHED_FIFO, &param) == -1)
+   {
+      fprintf(stderr, "[%i] task %i: cannot run at priority %i, %s\n", getpid(), id, priority, strerror(errno));
+      return;
+   }
+   if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+   {
+      fprintf(stderr, "[%i] task %i: cannot lock memory, %s\n", getpid(), id, strerror(errno));
+   }
+}
+
+/**
+* @brief Completes the current job and waits for the release of the next one.
+*
+* @details Shall be called once per job, before the job: the first call waits for
+*     the first release, each further call also completes the previous job.
+*
+* @param[inout] task periodic task
+*
+* @return none
+*/
+void periodic_wait(periodic_t* task)
+{
+   uint64_t now = vclock_now();
+   uint64_t elapsed;
+
+   // number of releases that went by while the job was running
+   elapsed = (task->activations > 0) ? (now - task->release_ns) / task->period_ns : 0;
+   if (elapsed >= 1)
+   {
+      // the job is late, the next one starts right away on the latest release
+      task->misses++;
+      task->overruns += elapsed - 1;
+      task->release_ns += elapsed * task->period_ns;
+   }
+   else
+   {
+      task->release_ns += task->period_ns;
+   }
+
+   vclock_sleep_until(task->release_ns);
+
+   now = vclock_now();
+   histogram_record(&task->jitter, (now > task->release_ns) ? now - task->release_ns : 0);
+   task->activations++;
+}
+
+/**
+* @brief Logs the deadline and jitter statistics of a task.
+*
+* @param[in] task periodic task
+*
+* @return none
+*/
+void periodic_report(const periodic_t* task)
+{
+   if (task->activations == 0)
+   {
+      return;
+   }
+
+   LOG(LOGGER_INFO, EV_TASK_STATS, task->id, task->activations, task->misses, task->overruns);
+   LOG(LOGGER_INFO, EV_TASK_JITTER, task->id, histogram_percentile(&task->jitter, 50.0),
+      histogram_percentile(&task->jitter, 99.0), task->jitter.max);
+}
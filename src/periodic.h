@@ -0,0 +1,68 @@
+/**
+* @file periodic.h
+* @brief Functions and data definitions for the periodic tasks
+* @anchor header_periodic
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef PERIODIC_H
+#define PERIODIC_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+
+#include "histogram.h"
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Task released at a fixed rate, on absolute times of the monotonic clock, or of
+ *       the virtual one in a simulation (see @ref header_vclock "vclock.h").
+ *
+ * @details Every job has to complete before the next release, which is its deadline.
+ *       A job completing later is a deadline miss; a job running past more than one
+ *       release is an overrun, and the releases it ran past are skipped rather than
+ *       run back to back. The jitter is the delay between a release and the time the
+ *       task actually woke up for it.
+ *
+ */
+typedef struct
+{
+   int id;                    /**< identifier of the task in the log, e.g. the one of its role */
+   uint64_t period_ns;        /**< time between two releases */
+   uint64_t release_ns;       /**< release of the current job */
+   uint64_t activations;      /**< number of jobs released */
+   uint64_t misses;           /**< jobs completed after their deadline */
+   uint64_t overruns;         /**< releases skipped because a job ran past them */
+   histogram_t jitter;        /**< wake-up delays, in ns */
+} periodic_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+void periodic_init(periodic_t* task, int id, int rate_hz, int priority);
+/* @} */
+
+/**
+ * @name Running
+ * @{
+ */
+void periodic_wait(periodic_t* task);
+void periodic_report(const periodic_t* task);
+/* @} */
+
+#endif /*PERIODIC_H*/
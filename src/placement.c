@@ -0,0 +1,503 @@
+/**
+* @file placement.c
+* @brief Functions implementation of @ref header_placement "placement.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+// cpu_set_t and the affinity calls are GNU extensions
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "placement.h"
+
+/************************** Constant Definitions *****************************/
+#define PLACE_TEXT         64       // room for a printed CPU list
+#define PLACE_ISOLATED     "/sys/devices/system/cpu/isolated"
+
+/**************************** Type Definitions ******************************/
+// placement and scheduling counters of a process
+typedef struct
+{
+   pid_t pid;                    // 0 for an unused slot
+   int role;
+   bool done;                    // counters sampled at exit, final
+   int cpu;                      // last CPU the process ran on
+   long migrations;              // -1 when the kernel does not tell
+   long voluntary;               // context switches while waiting
+   long involuntary;             // context switches by preemption
+   char cpus[PLACE_TEXT];        // CPUs the process is allowed on
+} placement_slot_t;
+
+/************************** Variable Definitions *****************************/
+// CPUs of each role, inherited by the processes forked after placement_parse()
+static cpu_set_t placement_sets[PLACE_ROLES];
+static bool placement_pinned[PLACE_ROLES];
+
+// counters of all processes, shared so the driver can report them
+static placement_slot_t* placement_table = NULL;
+static int placement_processes = 0;
+static placement_slot_t* placement_mine = NULL;
+
+static const char* placement_role_names[PLACE_ROLES] = { "sensor", "voter", "control", "actuator", "logger" };
+
+/************************** Function Prototypes *****************************/
+static int placement_parse_cpus(const char* list, cpu_set_t* set);
+static bool placement_auto(void);
+static void placement_format(const cpu_set_t* set, char* text, size_t size);
+static void placement_sample(placement_slot_t* slot);
+static void placement_exit(void);
+
+/************************** Private Functions *****************************/
+/**
+* @brief Parses a CPU list such as "0-2,5", or "isolated" for the isolated CPUs.
+*
+* @return number of CPUs in the list, -1 if it is not valid
+*/
+static int placement_parse_cpus(const char* list, cpu_set_t* set)
+{
+   char isolated[256];
+   const char* cursor = list;
+   char* end;
+   long first;
+   long last;
+   FILE* file;
+
+   CPU_ZERO(set);
+
+   if (strcmp(list, "isolated") == 0)
+   {
+      if (((file = fopen(PLACE_ISOLATED, "r")) == NULL) || (fgets(isolated, sizeof(isolated), file) == NULL))
+      {
+         if (file != NULL)
+         {
+            fclose(file);
+         }
+         return 0;
+      }
+      fclose(file);
+      isolated[strcspn(isolated, "\n")] = '\0';
+      return (isolated[0] == '\0') ? 0 : placement_parse_cpus(isolated, set);
+   }
+
+   if (*cursor == '\0')
+   {
+      return -1;
+   }
+
+   while (*cursor != '\0')
+   {
+      first = strtol(cursor, &end, 10);
+      if ((end == cursor) || (first < 0))
+      {
+         return -1;
+      }
+      last = first;
+      if (*end == '-')
+      {
+         cursor = end + 1;
+         last = strtol(cursor, &end, 10);
+         if ((end == cursor) || (last < first))
+         {
+            return -1;
+         }
+      }
+      if (last >= CPU_SETSIZE)
+      {
+         return -1;
+      }
+      for (; first <= last; first++)
+      {
+         CPU_SET(first, set);
+      }
+
+      if (*end == ',')
+      {
+         end++;
+      }
+      else if (*end != '\0')
+      {
+         return -1;
+      }
+      cursor = end;
+   }
+   return CPU_COUNT(set);
+}
+
+/**
+* @brief Gives control a CPU of its own: the first isolated CPU or else the last
+*     CPU available, the other processes sharing the remaining ones.
+*
+* @return false if there are not enough CPUs to set control apart
+*/
+static bool placement_auto(void)
+{
+   cpu_set_t available;
+   cpu_set_t isolated;
+   int control_cpu = -1;
+   int role;
+   int cpu;
+
+   if (sched_getaffinity(0, sizeof(available), &available) == -1)
+   {
+      return false;
+   }
+
+   if (placement_parse_cpus("isolated", &isolated) > 0)
+   {
+      for (cpu = 0; (cpu < CPU_SETSIZE) && (control_cpu == -1); cpu++)
+      {
+         control_cpu = CPU_ISSET(cpu, &isolated) ? cpu : -1;
+      }
+   }
+   else if (CPU_COUNT(&available) >= 2)
+   {
+      for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      {
+         control_cpu = CPU_ISSET(cpu, &available) ? cpu : control_cpu;
+      }
+   }
+   else
+   {
+      return false;
+   }
+
+   CPU_CLR(control_cpu, &available);
+   for (role = 0; role < PLACE_ROLES; role++)
+   {
+      placement_sets[role] = available;
+      placement_pinned[role] = true;
+   }
+   CPU_ZERO(&placement_sets[PLACE_CONTROL]);
+   CPU_SET(control_cpu, &placement_sets[PLACE_CONTROL]);
+   return true;
+}
+
+/**
+* @brief Prints a CPU set as a list of ranges.
+*/
+static void placement_format(const cpu_set_t* set, char* text, size_t size)
+{
+   size_t used = 0;
+   int first;
+   int cpu;
+
+   text[0] = '\0';
+   for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+   {
+      if (!CPU_ISSET(cpu, set))
+      {
+         continue;
+      }
+      for (first = cpu; (cpu + 1 < CPU_SETSIZE) && CPU_ISSET(cpu + 1, set); cpu++)
+      {
+      }
+
+      if (used < size)
+      {
+         used += snprintf(text + used, size - used, (first == cpu) ? "%s%i" : "%s%i-%i",
+            (used == 0) ? "" : ",", first, cpu);
+      }
+   }
+}
+
+/**
+* @brief Reads the last CPU, the migrations and the context switches of a process.
+*/
+static void placement_sample(placement_slot_t* slot)
+{
+   char path[64];
+   char line[1024];
+   char* field;
+   FILE* file;
+   int i;
+
+   // the CPU is the 39th field of stat, the 37th after the command name
+   snprintf(path, sizeof(path), "/proc/%i/stat", slot->pid);
+   if ((file = fopen(path, "r")) != NULL)
+   {
+      if ((fgets(line, sizeof(line), file) != NULL) && ((field = strrchr(line, ')')) != NULL))
+      {
+         for (i = 0, field = strtok(field + 1, " "); (field != NULL) && (i < 36); i++)
+         {
+            field = strtok(NULL, " ");
+         }
+         slot->cpu = (field != NULL) ? atoi(field) : -1;
+      }
+      fclose(file);
+   }
+
+   snprintf(path, sizeof(path), "/proc/%i/status", slot->pid);
+   if ((file = fopen(path, "r")) != NULL)
+   {
+      while (fgets(line, sizeof(line), file) != NULL)
+      {
+         sscanf(line, "voluntary_ctxt_switches: %ld", &slot->voluntary);
+         sscanf(line, "nonvoluntary_ctxt_switches: %ld", &slot->involuntary);
+      }
+      fclose(file);
+   }
+
+   // only kernels with scheduler debugging count the migrations
+   slot->migrations = -1;
+   snprintf(path, sizeof(path), "/proc/%i/sched", slot->pid);
+   if ((file = fopen(path, "r")) != NULL)
+   {
+      while (fgets(line, sizeof(line), file) != NULL)
+      {
+         sscanf(line, "se.nr_migrations : %ld", &slot->migrations);
+      }
+      fclose(file);
+   }
+}
+
+/**
+* @brief Takes the final counters of the calling process, registered with atexit().
+*/
+static void placement_exit(void)
+{
+   if (placement_mine != NULL)
+   {
+      placement_sample(placement_mine);
+      placement_mine->done = true;
+   }
+}
+
+/**
+* @brief Sets the CPUs each role runs on.
+*
+* @details The policy is either "auto", which gives control a CPU of its own, or a
+*     list of role=cpus entries separated by ':', e.g. "control=3:sensor=0-1:voter=2".
+*     Roles are sensor, voter, control, actuator and logger; cpus is a list of CPUs
+*     and ranges, or "isolated" for the CPUs isolated from the kernel scheduler.
+*     Roles left out are not pinned. It shall be called before forking the processes.
+*
+* @param[in] spec placement policy
+*
+* @return 0 on success, -1 if the policy is not valid
+*/
+int placement_parse(const char* spec)
+{
+   char entry[PLACE_TEXT * 2];
+   const char* cursor = spec;
+   char* cpus;
+   size_t length;
+   int role;
+
+   memset(placement_pinned, 0, sizeof(placement_pinned));
+
+   if (strcmp(spec, "auto") == 0)
+   {
+      if (!placement_auto())
+      {
+         fprintf(stderr, "[%i] placement: not enough CPUs to set control apart, nothing pinned\n", getpid());
+      }
+      return 0;
+   }
+
+   while (*cursor != '\0')
+   {
+      length = strcspn(cursor, ":");
+      if ((length == 0) || (length >= sizeof(entry)))
+      {
+         return -1;
+      }
+      memcpy(entry, cursor, length);
+      entry[length] = '\0';
+      cursor += length + ((cursor[length] == ':') ? 1 : 0);
+
+      if ((cpus = strchr(entry, '=')) == NULL)
+      {
+         return -1;
+      }
+      *cpus++ = '\0';
+
+      for (role = 0; (role < PLACE_ROLES) && (strcmp(entry, placement_role_names[role]) != 0); role++)
+      {
+      }
+      if (role == PLACE_ROLES)
+      {
+         return -1;
+      }
+
+      switch (placement_parse_cpus(cpus, &placement_sets[role]))
+      {
+      case -1:
+         return -1;
+      case 0:
+         // only "isolated" can be empty, on systems without isolated CPUs
+         fprintf(stderr, "[%i] placement: no %s CPUs, %s not pinned\n", getpid(), cpus, entry);
+         break;
+      default:
+         placement_pinned[role] = true;
+         break;
+      }
+   }
+   return 0;
+}
+
+/**
+* @brief Pins the calling process to the CPUs of its role, if the role has any.
+*
+* @param[in] role role according to @ref def_roles "this" list
+*
+* @return none
+*/
+void placement_apply(int role)
+{
+   if ((role < 0) || (role >= PLACE_ROLES) || !placement_pinned[role])
+   {
+      return;
+   }
+
+   if (sched_setaffinity(0, sizeof(cpu_set_t), &placement_sets[role]) == -1)
+   {
+      fprintf(stderr, "[%i] placement: cannot pin %s, %s\n", getpid(), placement_role_names[role], strerror(errno));
+   }
+}
+
+/**
+* @brief Allocates the counters of all the processes.
+*
+* @details The counters are kept in an anonymous shared mapping, so it shall be
+*     called before forking the processes.
+*
+* @param[in] processes number of process slots
+*
+* @return none
+*/
+void placement_init(int processes)
+{
+   void* ptr;
+
+   ptr = mmap(NULL, (size_t)processes * sizeof(placement_slot_t),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED)
+   {
+      perror("mmap");
+      return;
+   }
+
+   placement_table = ptr;
+   placement_processes = processes;
+   placement_mine = NULL;
+}
+
+/**
+* @brief Pins the calling process according to its role and accounts it in a slot.
+*
+* @details The counters of the process are taken when it exits; the ones of the
+*     processes still running are taken when reported.
+*
+* @param[in] slot index of the slot, unique among the processes
+* @param[in] role role according to @ref def_roles "this" list
+*
+* @return none
+*/
+void placement_attach(int slot, int role)
+{
+   cpu_set_t set;
+
+   placement_apply(role);
+
+   if ((placement_table == NULL) || (slot < 0) || (slot >= placement_processes))
+   {
+      return;
+   }
+
+   placement_mine = &placement_table[slot];
+   placement_mine->pid = getpid();
+   placement_mine->role = role;
+   placement_mine->done = false;
+   if (sched_getaffinity(0, sizeof(set), &set) == 0)
+   {
+      placement_format(&set, placement_mine->cpus, sizeof(placement_mine->cpus));
+   }
+   atexit(placement_exit);
+}
+
+/**
+* @brief Prints the CPUs, migrations and context switches of every accounted process.
+*
+* @param[in] out stream where the report is printed
+*
+* @return none
+*/
+void placement_report(FILE* out)
+{
+   placement_slot_t* slot;
+   char migrations[24];
+   int i;
+
+   for (i = 0; i < placement_processes; i++)
+   {
+      slot = &placement_table[i];
+      if (slot->pid == 0)
+      {
+         continue;
+      }
+      if (!slot->done && (kill(slot->pid, 0) == 0))
+      {
+         placement_sample(slot);
+      }
+
+      if (slot->migrations < 0)
+      {
+         strcpy(migrations, "n/a");
+      }
+      else
+      {
+         snprintf(migrations, sizeof(migrations), "%ld", slot->migrations);
+      }
+      fprintf(out, "[%i] placement %-8s pid %-6i cpus %-10s last cpu %-3i migrations %-6s switches %ld voluntary, %ld involuntary\n",
+         getpid(), placement_role_names[slot->role], slot->pid, slot->cpus, slot->cpu, migrations,
+         slot->voluntary, slot->involuntary);
+   }
+}
+
+/**
+* @brief Releases the counters of all the processes.
+*
+* @return none
+*/
+void placement_release(void)
+{
+   if (placement_table != NULL)
+   {
+      munmap(placement_table, (size_t)placement_processes * sizeof(placement_slot_t));
+   }
+   placement_table = NULL;
+   placement_mine = NULL;
+   placement_processes = 0;
+}
+
+/**
+* @brief Gives the name of a role, as accepted by placement_parse().
+*
+* @param[in] role role according to @ref def_roles "this" classification
+*
+* @return name of the role, "driver" for any other value
+*/
+const char* placement_role_name(int role)
+{
+   return ((role >= 0) && (role < PLACE_ROLES)) ? placement_role_names[role] : "driver";
+}
@@ -0,0 +1,62 @@
+/**
+* @file placement.h
+* @brief Functions and data definitions for the CPU placement of the processes
+* @anchor header_placement
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/***************************** Include Files ********************************/
+#include <stdio.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Roles
+ * @anchor def_roles
+ * @brief Kinds of processes, each with its own set of CPUs
+ * @{
+ */
+#define PLACE_SENSOR       0
+#define PLACE_VOTER        1
+#define PLACE_CONTROL      2
+#define PLACE_ACTUATOR     3
+#define PLACE_LOGGER       4
+#define PLACE_ROLES        5
+/* @} */
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Policy
+ * @{
+ */
+int placement_parse(const char* spec);
+void placement_apply(int role);
+/* @} */
+
+/**
+ * @name Accounting
+ * @{
+ */
+void placement_init(int processes);
+void placement_attach(int slot, int role);
+void placement_report(FILE* out);
+void placement_release(void);
+const char* placement_role_name(int role);
+/* @} */
+
+#endif /*PLACEMENT_H*/
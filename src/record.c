@@ -0,0 +1,294 @@
+/**
+* @file record.c
+* @brief Functions implementation of @ref header_record "record.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "record.h"
+#include "placement.h"
+#include "vclock.h"
+
+/**************************** Type Definitions ******************************/
+// start of a recording file, shared by every process pushing on a channel
+typedef struct
+{
+   uint32_t magic;                  // RECORD_MAGIC
+   uint32_t version;                // RECORD_VERSION
+   uint32_t record_size;            // sizeof(record_t) of the writer
+   uint32_t capacity;               // number of records the file holds
+   _Atomic uint64_t claimed;        // records handed out, may run past the capacity
+   _Atomic uint64_t dropped;        // messages pushed with the recording full
+} record_header_t;
+
+_Static_assert(sizeof(record_header_t) <= RECORD_HEADER_SIZE, "the header shall fit its room in the file");
+
+/************************** Variable Definitions *****************************/
+// recording in use, inherited by the processes forked after record_open()
+static record_header_t* record_header = NULL;
+static record_t* record_slots = NULL;
+static size_t record_length = 0;
+static const char* record_path = NULL;
+
+// identity of the calling process in its records
+static int record_role = -1;
+static pid_t record_pid = 0;
+
+/**
+* @brief Creates a recording file, where every message pushed on a channel is appended.
+*
+* @details The file is mapped in shared memory and inherited by the processes forked
+*     afterwards, so appending a message takes no system call. An existing file is
+*     overwritten.
+*
+* @param[in] path path of the file, kept until record_close()
+*
+* @return 0 on success, -1 if the file could not be created
+*/
+int record_open(const char* path)
+{
+   void* base;
+   int fd;
+
+   record_length = RECORD_HEADER_SIZE + (size_t)RECORD_CAPACITY * sizeof(record_t);
+   if ((fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644)) == -1)
+   {
+      perror("open");
+      return -1;
+   }
+   // the file is sparse, only the records written take room on disk
+   if (ftruncate(fd, (off_t)record_length) == -1)
+   {
+      perror("ftruncate");
+      close(fd);
+      return -1;
+   }
+   base = mmap(NULL, record_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (base == MAP_FAILED)
+   {
+      perror("mmap");
+      return -1;
+   }
+
+   record_header = base;
+   record_slots = (record_t*)((char*)base + RECORD_HEADER_SIZE);
+   record_header->magic = RECORD_MAGIC;
+   record_header->version = RECORD_VERSION;
+   record_header->record_size = sizeof(record_t);
+   record_header->capacity = RECORD_CAPACITY;
+   record_path = path;
+   record_pid = getpid();
+   return 0;
+}
+
+/**
+* @brief Sets the identity of the calling process in the records it appends.
+*
+* @param[in] role role of the process according to @ref def_roles "this" classification
+*
+* @return none
+*/
+void record_attach(int role)
+{
+   record_role = role;
+   record_pid = getpid();
+}
+
+/**
+* @brief Appends a message to the recording, if any.
+*
+* @details Called by the channel on every push. When the recording is full the
+*     message is only counted as dropped.
+*
+* @param[in] seed seed of the channel the message was pushed on
+* @param[in] msg  message pushed
+*
+* @return none
+*/
+void record_append(int seed, const message_t* msg)
+{
+   record_t* record;
+   uint64_t index;
+
+   if (record_header == NULL)
+   {
+      return;
+   }
+
+   index = atomic_fetch_add_explicit(&record_header->claimed, 1, memory_order_relaxed);
+   if (index >= record_header->capacity)
+   {
+      atomic_fetch_add_explicit(&record_header->dropped, 1, memory_order_relaxed);
+      return;
+   }
+
+   record = &record_slots[index];
+   record->seed = seed;
+   record->role = record_role;
+   record->pid = record_pid;
+   record->t_ns = vclock_now();
+   memcpy(&record->msg, msg, sizeof(message_t));
+   atomic_store_explicit(&record->committed, 1, memory_order_release);
+}
+
+/**
+* @brief Prints how many messages were recorded.
+*
+* @param[in] out stream the report is printed on
+*
+* @return none
+*/
+void record_report(FILE* out)
+{
+   uint64_t claimed;
+
+   if (record_header == NULL)
+   {
+      return;
+   }
+
+   claimed = atomic_load(&record_header->claimed);
+   fprintf(out, "[%i] record: %lu messages recorded to %s, %lu dropped\n", getpid(),
+      (unsigned long)((claimed < record_header->capacity) ? claimed : record_header->capacity), record_path,
+      (unsigned long)atomic_load(&record_header->dropped));
+}
+
+/**
+* @brief Stops recording in the calling process.
+*
+* @details The file keeps its full length, so a process still pushing never writes
+*     past its end; unused records are holes that take no room on disk.
+*
+* @return none
+*/
+void record_close(void)
+{
+   if (record_header != NULL)
+   {
+      munmap(record_header, record_length);
+   }
+   record_header = NULL;
+   record_slots = NULL;
+   record_length = 0;
+   record_path = NULL;
+}
+
+/**
+* @brief Maps a recording file for reading.
+*
+* @param[in]  path  path of the file
+* @param[out] trace recording mapped, to be released with record_unmap()
+*
+* @return 0 on success, -1 if the file cannot be read or is not a recording of this version
+*/
+int record_map(const char* path, record_trace_t* trace)
+{
+   const record_header_t* header;
+   struct stat st;
+   uint64_t count;
+   void* base;
+   int fd;
+
+   memset(trace, 0, sizeof(record_trace_t));
+   if ((fd = open(path, O_RDONLY)) == -1)
+   {
+      perror("open");
+      return -1;
+   }
+   if ((fstat(fd, &st) == -1) || (st.st_size < RECORD_HEADER_SIZE))
+   {
+      fprintf(stderr, "%s: not a recording\n", path);
+      close(fd);
+      return -1;
+   }
+   base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (base == MAP_FAILED)
+   {
+      perror("mmap");
+      return -1;
+   }
+
+   header = base;
+   if ((header->magic != RECORD_MAGIC) || (header->version != RECORD_VERSION)
+      || (header->record_size != sizeof(record_t)))
+   {
+      fprintf(stderr, "%s: not a recording of this version\n", path);
+      munmap(base, (size_t)st.st_size);
+      return -1;
+   }
+
+   // a file cut short keeps the records that made it
+   count = atomic_load(&((record_header_t*)base)->claimed);
+   count = (count < header->capacity) ? count : header->capacity;
+   if (count > (uint64_t)(st.st_size - RECORD_HEADER_SIZE) / sizeof(record_t))
+   {
+      count = (uint64_t)(st.st_size - RECORD_HEADER_SIZE) / sizeof(record_t);
+   }
+
+   trace->records = (const record_t*)((const char*)base + RECORD_HEADER_SIZE);
+   trace->count = (size_t)count;
+   trace->dropped = atomic_load(&((record_header_t*)base)->dropped);
+   trace->base = base;
+   trace->length = (size_t)st.st_size;
+   return 0;
+}
+
+/**
+* @brief Unmaps a recording mapped with record_map().
+*
+* @param[inout] trace recording
+*
+* @return none
+*/
+void record_unmap(record_trace_t* trace)
+{
+   if (trace->base != NULL)
+   {
+      munmap(trace->base, trace->length);
+   }
+   memset(trace, 0, sizeof(record_trace_t));
+}
+
+/**
+* @brief Prints a record as a line of text.
+*
+* @param[in] record  record to be printed
+* @param[in] t_start time the times are printed relative to, in ns
+* @param[in] out     stream the record is printed on
+*
+* @return none
+*/
+void record_decode(const record_t* record, uint64_t t_start, FILE* out)
+{
+   uint64_t t_rel = (record->t_ns > t_start) ? record->t_ns - t_start : 0;
+
+   if (atomic_load_explicit(&((record_t*)record)->committed, memory_order_acquire) == 0)
+   {
+      fprintf(out, "incomplete record\n");
+      return;
+   }
+
+   fprintf(out, "%10lu.%06lu ms %-8s pid %-6i channel %i: type %li, value %i, sample %u, replica %i\n",
+      (unsigned long)(t_rel / 1000000), (unsigned long)(t_rel % 1000000), placement_role_name(record->role),
+      record->pid, record->seed, record->msg.mtype, record->msg.mvalue, record->msg.seq, record->msg.source);
+}
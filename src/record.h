@@ -0,0 +1,100 @@
+/**
+* @file record.h
+* @brief Functions and data definitions for the recording and replay of the channel traffic
+* @anchor header_record
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef RECORD_H
+#define RECORD_H
+
+/***************************** Include Files ********************************/
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "channel.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Recording file
+ * @brief Header that starts every recording file
+ * @{
+ */
+#define RECORD_MAGIC       0x43455258     /**< "XREC" */
+#define RECORD_VERSION     2
+#define RECORD_HEADER_SIZE 64             /**< room taken by the header, the records follow */
+/* @} */
+
+/**
+ * @brief Number of messages a recording holds, later ones are counted as dropped
+ */
+#define RECORD_CAPACITY    (1 << 18)
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Message pushed on a channel, as kept in a recording.
+ *
+ * @details Records are claimed in the order the messages were pushed and filled
+ *       in place in the file mapping: a record whose writer did not complete is
+ *       left uncommitted and skipped.
+ *
+ */
+typedef struct
+{
+   _Atomic uint32_t committed;   /**< non-zero once the record is complete */
+   int32_t seed;                 /**< seed of the channel the message was pushed on */
+   int32_t role;                 /**< role of the pushing process, see @ref def_roles "roles", -1 for the driver */
+   int32_t pid;                  /**< pushing process */
+   uint64_t t_ns;                /**< monotonic time of the push, in ns */
+   message_t msg;                /**< message as pushed */
+} record_t;
+
+/**
+ * @brief Recording mapped for reading.
+ */
+typedef struct
+{
+   const record_t* records;      /**< records, in push order */
+   size_t count;                 /**< number of records claimed */
+   uint64_t dropped;             /**< messages pushed with the recording full */
+   void* base;                   /**< mapping of the file */
+   size_t length;                /**< length of the mapping */
+} record_trace_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Recording
+ * @{
+ */
+int record_open(const char* path);
+void record_attach(int role);
+void record_append(int seed, const message_t* msg);
+void record_report(FILE* out);
+void record_close(void);
+/* @} */
+
+/**
+ * @name Reading
+ * @{
+ */
+int record_map(const char* path, record_trace_t* trace);
+void record_unmap(record_trace_t* trace);
+void record_decode(const record_t* record, uint64_t t_start, FILE* out);
+/* @} */
+
+#endif /*RECORD_H*/
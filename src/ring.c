@@ -0,0 +1,1595 @@
+/**
+* @file ring.c
+* @brief Functions implementation of @ref header_ring "ring.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ring.h"
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+// marks a ring whose header has been fully initialised
+#define RING_MAGIC         0x52494e47u
+
+// size of a cache line, used to keep producer and consumer state apart
+#define RING_CACHE_LINE    64
+
+// busy-wait iterations before a blocked caller sleeps on the futex, or yields the CPU
+#define RING_SPIN_LIMIT    256
+
+// longest usual wait the adaptive strategy spins for, in ns: a futex wake-up costs a few us
+#define RING_ADAPT_SPIN_NS 50000ULL
+
+// weight of the last wait in the moving average of the adaptive strategy, as a shift
+#define RING_ADAPT_SHIFT   3
+
+// period used to re-check a filtered retrieve that is not woken by a push
+#define RING_RECHECK_NS    1000000L
+
+// polling period used by ring_wait_any() on kernels without futex_waitv()
+#define RING_POLL_NS       100000L
+
+// position of a reader that no longer holds the producer back
+#define RING_DETACHED_POS  UINT64_MAX
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Cursor of a consumer of a broadcast ring, on a cache line of its own.
+*
+* @details position is written by the reader only; stalls and stall_ns by the
+*     producer only, when it has to sleep because of this reader.
+*/
+typedef struct
+{
+   _Alignas(RING_CACHE_LINE) _Atomic uint64_t position;     /**< next position to be read */
+   _Atomic uint32_t state;                                  /**< RING_READER_* state */
+   uint64_t received;                                       /**< elements read so far */
+   uint64_t max_lag;                                        /**< largest backlog found on a read */
+   uint64_t stalls;                                         /**< times the producer slept on this reader */
+   uint64_t stall_ns;                                       /**< time the producer slept on this reader */
+} ring_reader_t;
+
+/**
+* @brief Waits of one side of the ring, updated by the callers once their wait is over.
+*/
+typedef struct
+{
+   _Atomic uint64_t spun;                                   /**< waits over before the caller slept */
+   _Atomic uint64_t slept;                                  /**< waits that slept on the futex */
+   _Atomic uint64_t avg_ns;                                 /**< moving average of the waits, adaptive only */
+} ring_waits_t;
+
+struct ring_s
+{
+   _Atomic uint32_t magic;                                  /**< RING_MAGIC once initialised */
+   uint32_t flags;                                          /**< RING_* concurrency flags */
+   uint32_t capacity;                                       /**< number of slots, power of two */
+   uint32_t mask;                                           /**< capacity - 1 */
+   uint32_t slot_size;                                      /**< stride between two slots */
+   uint32_t elem_offset;                                    /**< offset of the element within a slot */
+   uint32_t elem_size;                                      /**< size of an element */
+   uint32_t readers;                                        /**< readers declared on a broadcast ring */
+   _Atomic uint32_t subscribed;                             /**< readers handed out by ring_subscribe() */
+   _Atomic uint32_t wait;                                   /**< RING_WAIT_* strategy of the blocked callers */
+   _Alignas(RING_CACHE_LINE) _Atomic uint64_t tail;         /**< next position to be written */
+   uint64_t gate;                                           /**< slowest reader last seen by the producer */
+   _Alignas(RING_CACHE_LINE) _Atomic uint64_t head;         /**< next position to be read */
+   _Alignas(RING_CACHE_LINE) _Atomic uint32_t data_seq;     /**< futex bumped when data is published */
+   _Atomic uint32_t data_waiters;                           /**< consumers sleeping on data_seq */
+   ring_waits_t data_waits;                                 /**< waits of the consumers */
+   _Alignas(RING_CACHE_LINE) _Atomic uint32_t space_seq;    /**< futex bumped when a slot is freed */
+   _Atomic uint32_t space_waiters;                          /**< producers sleeping on space_seq */
+   ring_waits_t space_waits;                                /**< waits of the producers */
+   ring_reader_t reader[RING_READERS_MAX];                  /**< cursors of a broadcast ring */
+   _Alignas(RING_CACHE_LINE) unsigned char slots[];         /**< capacity * slot_size bytes */
+};
+
+/************************** Private Functions *****************************/
+static inline void ring_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   __asm__ __volatile__("yield" ::: "memory");
+#else
+   __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline uint32_t ring_round_pow2(uint32_t value)
+{
+   uint32_t pow2 = 1;
+
+   while (pow2 < value)
+   {
+      pow2 <<= 1;
+   }
+   return pow2;
+}
+
+static inline size_t ring_round_up(size_t value, size_t align)
+{
+   return (value + align - 1) / align * align;
+}
+
+static inline unsigned char* ring_slot(const ring_t* ring, uint64_t pos)
+{
+   return (unsigned char*)ring->slots + (size_t)(pos & ring->mask) * ring->slot_size;
+}
+
+static inline _Atomic uint64_t* ring_slot_seq(unsigned char* slot)
+{
+   return (_Atomic uint64_t*)slot;
+}
+
+/**
+* @brief Wakes the sleepers of one side of the ring, if there are any.
+*
+* @details The fence pairs with the one in the waiting path: either the waiter
+*     sees the state change before sleeping or the notifier sees the waiter.
+*/
+static inline void ring_notify(_Atomic uint32_t* seq, _Atomic uint32_t* waiters)
+{
+   atomic_thread_fence(memory_order_seq_cst);
+   if (atomic_load_explicit(waiters, memory_order_relaxed) > 0)
+   {
+      atomic_fetch_add_explicit(seq, 1, memory_order_release);
+      sysdep_futex_wake(seq);
+   }
+}
+
+static inline ring_waits_t* ring_waits(ring_t* ring, bool producer)
+{
+   return producer ? &ring->space_waits : &ring->data_waits;
+}
+
+/**
+* @brief Returns the reader of a broadcast ring that is the furthest behind.
+*
+* @details Declared readers hold the producer back even before they subscribe,
+*     so none of them misses the first elements.
+*
+* @return index of the reader, -1 when every reader has detached
+*/
+static int ring_slowest(const ring_t* ring)
+{
+   uint64_t slowest = RING_DETACHED_POS;
+   uint64_t pos;
+   int found = -1;
+   uint32_t i;
+
+   for (i = 0; i < ring->readers; i++)
+   {
+      pos = atomic_load_explicit(&ring->reader[i].position, memory_order_acquire);
+      if (pos < slowest)
+      {
+         slowest = pos;
+         found = i;
+      }
+   }
+   return found;
+}
+
+/**
+* @brief Counts the slots the producer of a broadcast ring can fill from pos on, up to count.
+*
+* @details The position of the slowest reader is cached, so the readers' cache lines
+*     are only visited when the cached value says the ring is full.
+*/
+static uint32_t ring_bcast_room(ring_t* ring, uint64_t pos, uint32_t count)
+{
+   uint64_t free_slots = ring->capacity - (pos - ring->gate);
+   int slowest;
+
+   if (free_slots < count)
+   {
+      slowest = ring_slowest(ring);
+      ring->gate = (slowest < 0) ? pos :
+         atomic_load_explicit(&ring->reader[slowest].position, memory_order_acquire);
+      free_slots = ring->capacity - (pos - ring->gate);
+   }
+   return (free_slots < count) ? (uint32_t)free_slots : count;
+}
+
+/**
+* @brief Claims the next slot of a broadcast ring for its single producer.
+*
+* @details The slot is stamped with its position: readers see it published once
+*     the stamp becomes pos + 1, like on the other rings.
+*/
+static unsigned char* ring_bcast_claim(ring_t* ring, uint64_t* claimed)
+{
+   uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+   unsigned char* slot;
+
+   if (ring_bcast_room(ring, pos, 1) == 0)
+   {
+      return NULL;
+   }
+
+   slot = ring_slot(ring, pos);
+   atomic_store_explicit(ring_slot_seq(slot), pos, memory_order_relaxed);
+   atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+   *claimed = pos;
+   return slot;
+}
+
+/**
+* @brief Records that the producer of a broadcast ring slept because of a reader.
+*/
+static void ring_bcast_stall(ring_t* ring, int slowest, uint64_t since)
+{
+   if (slowest >= 0)
+   {
+      ring->reader[slowest].stalls++;
+      ring->reader[slowest].stall_ns += sysdep_now() - since;
+   }
+}
+
+/**
+* @brief Counts the elements published past the cursor of a reader, up to count.
+*/
+static uint32_t ring_bcast_ready(const ring_t* ring, uint64_t pos, uint32_t count)
+{
+   uint32_t ready;
+
+   for (ready = 0; ready < count; ready++)
+   {
+      if (atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos + ready)), memory_order_acquire)
+         != pos + ready + 1)
+      {
+         break;
+      }
+   }
+   return ready;
+}
+
+/**
+* @brief Moves the cursor of a reader past count elements and wakes up the producer.
+*/
+static void ring_bcast_advance(ring_t* ring, int reader, uint64_t pos, uint32_t count)
+{
+   ring_reader_t* cursor = &ring->reader[reader];
+   uint64_t lag = atomic_load_explicit(&ring->tail, memory_order_relaxed) - pos;
+
+   if (lag > cursor->max_lag)
+   {
+      cursor->max_lag = lag;
+   }
+   cursor->received += count;
+   atomic_store_explicit(&cursor->position, pos + count, memory_order_release);
+   ring_notify(&ring->space_seq, &ring->space_waiters);
+}
+
+/**
+* @brief Claims the next free slot for a producer.
+*
+* @details The slot belongs to the caller until its sequence number is set to
+*     pos + 1, which publishes it to the consumers.
+*/
+static unsigned char* ring_try_claim(ring_t* ring, uint64_t* claimed)
+{
+   uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+   unsigned char* slot;
+   uint64_t seq;
+   int64_t dif;
+
+   if (ring->flags & RING_BROADCAST)
+   {
+      return ring_bcast_claim(ring, claimed);
+   }
+
+   for (;;)
+   {
+      slot = ring_slot(ring, pos);
+      seq = atomic_load_explicit(ring_slot_seq(slot), memory_order_acquire);
+      dif = (int64_t)(seq - pos);
+
+      if (dif == 0)
+      {
+         if (!(ring->flags & RING_MULTI_PRODUCER))
+         {
+            atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+            break;
+         }
+         if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+               memory_order_relaxed, memory_order_relaxed))
+         {
+            break;
+         }
+      }
+      else if (dif < 0)
+      {
+         // the slot still holds an element from the previous lap: ring is full
+         return NULL;
+      }
+      else
+      {
+         pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      }
+   }
+
+   *claimed = pos;
+   return slot;
+}
+
+static bool ring_try_push(ring_t* ring, const void* elem)
+{
+   unsigned char* slot;
+   uint64_t pos;
+
+   if ((slot = ring_try_claim(ring, &pos)) == NULL)
+   {
+      return false;
+   }
+
+   memcpy(slot + ring->elem_offset, elem, ring->elem_size);
+   atomic_store_explicit(ring_slot_seq(slot), pos + 1, memory_order_release);
+   return true;
+}
+
+/**
+* @brief Claims the oldest published slot for a consumer, if accepted by a predicate.
+*
+* @details The slot belongs to the caller until its sequence number is set to
+*     pos + capacity, which hands it back to the producers.
+*/
+static unsigned char* ring_try_take(ring_t* ring, uint64_t* claimed, bool (*accept)(const void*, long), long arg)
+{
+   uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   unsigned char* slot;
+   uint64_t seq;
+   int64_t dif;
+
+   for (;;)
+   {
+      slot = ring_slot(ring, pos);
+      seq = atomic_load_explicit(ring_slot_seq(slot), memory_order_acquire);
+      dif = (int64_t)(seq - (pos + 1));
+
+      if (dif == 0)
+      {
+         // a stale read is harmless: the claim below fails if the slot moved on
+         if ((accept != NULL) && !accept(slot + ring->elem_offset, arg))
+         {
+            return NULL;
+         }
+         if (!(ring->flags & RING_MULTI_CONSUMER))
+         {
+            atomic_store_explicit(&ring->head, pos + 1, memory_order_relaxed);
+            break;
+         }
+         if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+               memory_order_relaxed, memory_order_relaxed))
+         {
+            break;
+         }
+      }
+      else if (dif < 0)
+      {
+         // nothing published at this position yet: ring is empty
+         return NULL;
+      }
+      else
+      {
+         pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+      }
+   }
+
+   *claimed = pos;
+   return slot;
+}
+
+static bool ring_try_pop(ring_t* ring, void* elem, bool (*accept)(const void*, long), long arg)
+{
+   unsigned char* slot;
+   uint64_t pos;
+
+   if ((slot = ring_try_take(ring, &pos, accept, arg)) == NULL)
+   {
+      return false;
+   }
+
+   memcpy(elem, slot + ring->elem_offset, ring->elem_size);
+   atomic_store_explicit(ring_slot_seq(slot), pos + ring->capacity, memory_order_release);
+   return true;
+}
+
+static uint32_t ring_try_push_batch(ring_t* ring, const void* elems, uint32_t count)
+{
+   uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+   uint64_t seq;
+   uint32_t free_slots;
+   uint32_t i;
+
+   if (ring->flags & RING_BROADCAST)
+   {
+      if ((free_slots = ring_bcast_room(ring, pos, count)) == 0)
+      {
+         return 0;
+      }
+      atomic_store_explicit(&ring->tail, pos + free_slots, memory_order_relaxed);
+   }
+
+   while (!(ring->flags & RING_BROADCAST))
+   {
+      // count the consecutive slots that have been released by the consumers
+      for (free_slots = 0; free_slots < count; free_slots++)
+      {
+         seq = atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos + free_slots)), memory_order_acquire);
+         if (seq != pos + free_slots)
+         {
+            break;
+         }
+      }
+
+      if (free_slots == 0)
+      {
+         seq = atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos)), memory_order_acquire);
+         if ((int64_t)(seq - pos) < 0)
+         {
+            return 0;
+         }
+         pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+         continue;
+      }
+
+      if (!(ring->flags & RING_MULTI_PRODUCER))
+      {
+         atomic_store_explicit(&ring->tail, pos + free_slots, memory_order_relaxed);
+         break;
+      }
+      if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + free_slots,
+            memory_order_relaxed, memory_order_relaxed))
+      {
+         break;
+      }
+   }
+
+   for (i = 0; i < free_slots; i++)
+   {
+      unsigned char* slot = ring_slot(ring, pos + i);
+
+      memcpy(slot + ring->elem_offset, (const unsigned char*)elems + (size_t)i * ring->elem_size,
+         ring->elem_size);
+      atomic_store_explicit(ring_slot_seq(slot), pos + i + 1, memory_order_release);
+   }
+   return free_slots;
+}
+
+static uint32_t ring_try_pop_batch(ring_t* ring, void* elems, uint32_t count)
+{
+   uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   uint64_t seq;
+   uint32_t ready;
+   uint32_t i;
+
+   for (;;)
+   {
+      // count the consecutive slots that have been published by the producers
+      for (ready = 0; ready < count; ready++)
+      {
+         seq = atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos + ready)), memory_order_acquire);
+         if (seq != pos + ready + 1)
+         {
+            break;
+         }
+      }
+
+      if (ready == 0)
+      {
+         seq = atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos)), memory_order_acquire);
+         if ((int64_t)(seq - (pos + 1)) < 0)
+         {
+            return 0;
+         }
+         pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+         continue;
+      }
+
+      if (!(ring->flags & RING_MULTI_CONSUMER))
+      {
+         atomic_store_explicit(&ring->head, pos + ready, memory_order_relaxed);
+         break;
+      }
+      if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + ready,
+            memory_order_relaxed, memory_order_relaxed))
+      {
+         break;
+      }
+   }
+
+   for (i = 0; i < ready; i++)
+   {
+      unsigned char* slot = ring_slot(ring, pos + i);
+
+      memcpy((unsigned char*)elems + (size_t)i * ring->elem_size, slot + ring->elem_offset,
+         ring->elem_size);
+      atomic_store_explicit(ring_slot_seq(slot), pos + i + ring->capacity, memory_order_release);
+   }
+   return ready;
+}
+
+static void ring_init_readers(ring_t* ring, uint32_t capacity, size_t elem_size, size_t elem_align,
+   unsigned flags, uint32_t readers)
+{
+   size_t align = (elem_align > sizeof(uint64_t)) ? elem_align : sizeof(uint64_t);
+   uint32_t i;
+
+   ring->flags = flags;
+   ring->capacity = ring_round_pow2(capacity);
+   ring->mask = ring->capacity - 1;
+   ring->elem_offset = ring_round_up(sizeof(uint64_t), align);
+   ring->elem_size = elem_size;
+   ring->slot_size = ring_round_up(ring->elem_offset + elem_size, align);
+   ring->readers = readers;
+   ring->gate = 0;
+
+   atomic_init(&ring->subscribed, 0);
+   atomic_init(&ring->wait, RING_WAIT_HYBRID);
+   atomic_init(&ring->tail, 0);
+   atomic_init(&ring->head, 0);
+   atomic_init(&ring->data_seq, 0);
+   atomic_init(&ring->data_waiters, 0);
+   atomic_init(&ring->space_seq, 0);
+   atomic_init(&ring->space_waiters, 0);
+   memset(&ring->data_waits, 0, sizeof(ring_waits_t));
+   memset(&ring->space_waits, 0, sizeof(ring_waits_t));
+
+   for (i = 0; i < RING_READERS_MAX; i++)
+   {
+      memset(&ring->reader[i], 0, sizeof(ring_reader_t));
+      atomic_init(&ring->reader[i].position, (i < readers) ? 0 : RING_DETACHED_POS);
+      atomic_init(&ring->reader[i].state, (i < readers) ? RING_READER_DECLARED : RING_READER_DETACHED);
+   }
+
+   for (i = 0; i < ring->capacity; i++)
+   {
+      atomic_init(ring_slot_seq(ring_slot(ring, i)), i);
+   }
+
+   atomic_store_explicit(&ring->magic, RING_MAGIC, memory_order_release);
+}
+
+/**
+* @brief Computes the number of bytes needed to hold a ring.
+*
+* @param[in] capacity   requested number of elements, rounded up to a power of two
+* @param[in] elem_size  size of an element
+* @param[in] elem_align alignment required by an element
+*
+* @return size of the memory area to be passed to ring_init()
+*/
+size_t ring_footprint(uint32_t capacity, size_t elem_size, size_t elem_align)
+{
+   size_t align = (elem_align > sizeof(uint64_t)) ? elem_align : sizeof(uint64_t);
+   size_t slot_size = ring_round_up(ring_round_up(sizeof(uint64_t), align) + elem_size, align);
+
+   return sizeof(struct ring_s) + (size_t)ring_round_pow2(capacity) * slot_size;
+}
+
+/**
+* @brief Initialises a ring in a memory area of at least ring_footprint() bytes.
+*
+* @details The area shall be aligned to a cache line, which mmap() guarantees.
+*     Other processes can use the ring as soon as ring_ready() returns true.
+*
+* @param[out] ring       memory area holding the ring
+* @param[in]  capacity   requested number of elements, rounded up to a power of two
+* @param[in]  elem_size  size of an element
+* @param[in]  elem_align alignment required by an element
+* @param[in]  flags      combination of RING_MULTI_PRODUCER and RING_MULTI_CONSUMER
+*
+* @return none
+*/
+void ring_init(ring_t* ring, uint32_t capacity, size_t elem_size, size_t elem_align, unsigned flags)
+{
+   ring_init_readers(ring, capacity, elem_size, elem_align, flags & ~RING_BROADCAST, 0);
+}
+
+/**
+* @brief Initialises a broadcast ring in a memory area of at least ring_footprint() bytes.
+*
+* @details A broadcast ring has a single producer and every reader gets every element:
+*     each one moves its own cursor over the same slots, which are reused once all the
+*     readers have gone past them (LMAX disruptor). The readers are fixed here and
+*     claimed with ring_subscribe(); until then they already hold the producer back.
+*
+* @param[out] ring       memory area holding the ring
+* @param[in]  capacity   requested number of elements, rounded up to a power of two
+* @param[in]  elem_size  size of an element
+* @param[in]  elem_align alignment required by an element
+* @param[in]  readers    number of readers, at most RING_READERS_MAX
+*
+* @return none
+*/
+void ring_init_broadcast(ring_t* ring, uint32_t capacity, size_t elem_size, size_t elem_align, uint32_t readers)
+{
+   ring_init_readers(ring, capacity, elem_size, elem_align, RING_BROADCAST,
+      (readers < RING_READERS_MAX) ? readers : RING_READERS_MAX);
+}
+
+/**
+* @brief Tells whether a ring has been initialised by its creator.
+*
+* @param[in] ring pointer to a ring
+*
+* @return true when the ring can be used
+*/
+bool ring_ready(const ring_t* ring)
+{
+   return atomic_load_explicit(&ring->magic, memory_order_acquire) == RING_MAGIC;
+}
+
+/**
+* @brief Appends an element to the ring. The caller is not blocked when the ring is full.
+*
+* @param[inout] ring pointer to a ring
+* @param[in]    elem element to be copied into the ring
+*
+* @return true if the element was appended, false if the ring is full
+*/
+bool ring_push(ring_t* ring, const void* elem)
+{
+   if (!ring_try_push(ring, elem))
+   {
+      return false;
+   }
+   ring_notify(&ring->data_seq, &ring->data_waiters);
+   return true;
+}
+
+/**
+* @brief Removes the oldest element from the ring. The caller is not blocked when the ring is empty.
+*
+* @param[inout] ring pointer to a ring
+* @param[out]   elem buffer receiving the element, untouched when the ring is empty
+*
+* @return true if an element was removed, false if the ring is empty
+*/
+bool ring_pop(ring_t* ring, void* elem)
+{
+   return ring_pop_if(ring, elem, NULL, 0);
+}
+
+/**
+* @brief Removes the oldest element from the ring only if it is accepted by a predicate.
+*
+* @details Only the oldest element is examined: the ring keeps a strict FIFO order.
+*
+* @param[inout] ring   pointer to a ring
+* @param[out]   elem   buffer receiving the element, untouched when nothing is removed
+* @param[in]    accept predicate applied to the oldest element, NULL accepts everything
+* @param[in]    arg    argument forwarded to the predicate
+*
+* @return true if an element was removed
+*/
+bool ring_pop_if(ring_t* ring, void* elem, bool (*accept)(const void* elem, long arg), long arg)
+{
+   if (!ring_try_pop(ring, elem, accept, arg))
+   {
+      return false;
+   }
+   ring_notify(&ring->space_seq, &ring->space_waiters);
+   return true;
+}
+
+/**
+* @brief Reserves the next free slot, to be filled in place. The caller is not blocked
+*     when the ring is full.
+*
+* @details The element is invisible to the consumers until ring_commit() is called.
+*     Consumers stop at the first reserved slot, so it shall be committed promptly.
+*
+* @param[inout] ring pointer to a ring
+*
+* @return pointer to the element within the ring, NULL if the ring is full
+*/
+void* ring_reserve(ring_t* ring)
+{
+   unsigned char* slot;
+   uint64_t pos;
+
+   if ((slot = ring_try_claim(ring, &pos)) == NULL)
+   {
+      return NULL;
+   }
+   return slot + ring->elem_offset;
+}
+
+/**
+* @brief Publishes an element reserved with ring_reserve().
+*
+* @param[inout] ring pointer to a ring
+* @param[in]    elem pointer returned by ring_reserve()
+*
+* @return none
+*/
+void ring_commit(ring_t* ring, void* elem)
+{
+   _Atomic uint64_t* seq = ring_slot_seq((unsigned char*)elem - ring->elem_offset);
+
+   // a reserved slot still carries the position it was claimed at
+   atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_release);
+   ring_notify(&ring->data_seq, &ring->data_waiters);
+}
+
+/**
+* @brief Takes the oldest element, to be read in place. The caller is not blocked
+*     when the ring is empty.
+*
+* @details The slot is not reused by the producers until ring_release() is called.
+*
+* @param[inout] ring pointer to a ring
+*
+* @return pointer to the element within the ring, NULL if the ring is empty
+*/
+void* ring_acquire(ring_t* ring)
+{
+   unsigned char* slot;
+   uint64_t pos;
+
+   if ((slot = ring_try_take(ring, &pos, NULL, 0)) == NULL)
+   {
+      return NULL;
+   }
+   return slot + ring->elem_offset;
+}
+
+/**
+* @brief Hands back to the producers a slot taken with ring_acquire().
+*
+* @param[inout] ring pointer to a ring
+* @param[in]    elem pointer returned by ring_acquire()
+*
+* @return none
+*/
+void ring_release(ring_t* ring, void* elem)
+{
+   _Atomic uint64_t* seq = ring_slot_seq((unsigned char*)elem - ring->elem_offset);
+
+   // a taken slot carries its position + 1, it is free again a lap later
+   atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) - 1 + ring->capacity,
+      memory_order_release);
+   ring_notify(&ring->space_seq, &ring->space_waiters);
+}
+
+/**
+* @brief Reserves the next free slot, to be filled in place. The caller is blocked
+*     while the ring is full.
+*
+* @param[inout] ring pointer to a ring
+*
+* @return pointer to the element within the ring, to be passed to ring_commit()
+*/
+void* ring_reserve_wait(ring_t* ring)
+{
+   uint64_t since = 0;
+   ring_spin_t spin = { 0 };
+   uint32_t seq;
+   int slowest = -1;
+   void* elem;
+
+   while ((elem = ring_reserve(ring)) == NULL)
+   {
+      if (ring_spin(&spin, ring, true))
+      {
+         continue;
+      }
+
+      if ((ring->flags & RING_BROADCAST) && (slowest < 0))
+      {
+         // blame the reader holding the ring full for the whole stall
+         slowest = ring_slowest(ring);
+         since = sysdep_now();
+      }
+
+      atomic_fetch_add_explicit(&ring->space_waiters, 1, memory_order_seq_cst);
+      atomic_thread_fence(memory_order_seq_cst);
+      seq = atomic_load_explicit(&ring->space_seq, memory_order_acquire);
+      if ((elem = ring_reserve(ring)) != NULL)
+      {
+         atomic_fetch_sub_explicit(&ring->space_waiters, 1, memory_order_relaxed);
+         break;
+      }
+      sysdep_futex_wait(&ring->space_seq, seq, NULL);
+      atomic_fetch_sub_explicit(&ring->space_waiters, 1, memory_order_relaxed);
+   }
+
+   ring_spin_end(&spin);
+   ring_bcast_stall(ring, slowest, since);
+   return elem;
+}
+
+/**
+* @brief Appends an element to the ring. The caller is blocked while the ring is full.
+*
+* @param[inout] ring pointer to a ring
+* @param[in]    elem element to be copied into the ring
+*
+* @return none
+*/
+void ring_push_wait(ring_t* ring, const void* elem)
+{
+   uint64_t since = 0;
+   ring_spin_t spin = { 0 };
+   uint32_t seq;
+   int slowest = -1;
+
+   while (!ring_push(ring, elem))
+   {
+      if (ring_spin(&spin, ring, true))
+      {
+         continue;
+      }
+
+      if ((ring->flags & RING_BROADCAST) && (slowest < 0))
+      {
+         // blame the reader holding the ring full for the whole stall
+         slowest = ring_slowest(ring);
+         since = sysdep_now();
+      }
+
+      atomic_fetch_add_explicit(&ring->space_waiters, 1, memory_order_seq_cst);
+      atomic_thread_fence(memory_order_seq_cst);
+      seq = atomic_load_explicit(&ring->space_seq, memory_order_acquire);
+      if (ring_push(ring, elem))
+      {
+         atomic_fetch_sub_explicit(&ring->space_waiters, 1, memory_order_relaxed);
+         break;
+      }
+      sysdep_futex_wait(&ring->space_seq, seq, NULL);
+      atomic_fetch_sub_explicit(&ring->space_waiters, 1, memory_order_relaxed);
+   }
+
+   ring_spin_end(&spin);
+   ring_bcast_stall(ring, slowest, since);
+}
+
+/**
+* @brief Removes the oldest element from the ring. The caller is blocked while the ring is empty.
+*
+* @param[inout] ring pointer to a ring
+* @param[out]   elem buffer receiving the element
+*
+* @return none
+*/
+void ring_pop_wait(ring_t* ring, void* elem)
+{
+   ring_pop_if_wait(ring, elem, NULL, 0);
+}
+
+/**
+* @brief Removes the oldest element from the ring once it is accepted by a predicate.
+*     The caller is blocked until that happens.
+*
+* @param[inout] ring   pointer to a ring
+* @param[out]   elem   buffer receiving the element
+* @param[in]    accept predicate applied to the oldest element, NULL accepts everything
+* @param[in]    arg    argument forwarded to the predicate
+*
+* @return none
+*/
+void ring_pop_if_wait(ring_t* ring, void* elem, bool (*accept)(const void* elem, long arg), long arg)
+{
+   // a rejected head can be consumed by somebody else without any push, so poll
+   const struct timespec recheck = { 0, RING_RECHECK_NS };
+   ring_spin_t spin = { 0 };
+   uint32_t seq;
+
+   while (!ring_pop_if(ring, elem, accept, arg))
+   {
+      if (ring_spin(&spin, ring, false))
+      {
+         continue;
+      }
+
+      atomic_fetch_add_explicit(&ring->data_waiters, 1, memory_order_seq_cst);
+      atomic_thread_fence(memory_order_seq_cst);
+      seq = atomic_load_explicit(&ring->data_seq, memory_order_acquire);
+      if (ring_pop_if(ring, elem, accept, arg))
+      {
+         atomic_fetch_sub_explicit(&ring->data_waiters, 1, memory_order_relaxed);
+         break;
+      }
+      sysdep_futex_wait(&ring->data_seq, seq, (accept != NULL) ? &recheck : NULL);
+      atomic_fetch_sub_explicit(&ring->data_waiters, 1, memory_order_relaxed);
+   }
+
+   ring_spin_end(&spin);
+}
+
+/**
+* @brief Appends up to count elements to the ring. The caller is not blocked when the ring is full.
+*
+* @details Free slots are claimed with a single update of the tail and consumers are
+*     notified once for the whole batch.
+*
+* @param[inout] ring   pointer to a ring
+* @param[in]    elems  array of elements to be copied into the ring
+* @param[in]    count  number of elements in the array
+*
+* @return number of elements appended, from the beginning of the array
+*/
+uint32_t ring_push_batch(ring_t* ring, const void* elems, uint32_t count)
+{
+   uint32_t done = 0;
+   uint32_t pushed;
+
+   while (done < count)
+   {
+      pushed = ring_try_push_batch(ring, (const unsigned char*)elems + (size_t)done * ring->elem_size,
+         count - done);
+      if (pushed == 0)
+      {
+         break;
+      }
+      done += pushed;
+   }
+
+   if (done > 0)
+   {
+      ring_notify(&ring->data_seq, &ring->data_waiters);
+   }
+   return done;
+}
+
+/**
+* @brief Removes up to count of the oldest elements from the ring. The caller is not blocked
+*     when the ring is empty.
+*
+* @details Published slots are claimed with a single update of the head and producers
+*     are notified once for the whole batch.
+*
+* @param[inout] ring   pointer to a ring
+* @param[out]   elems  array receiving the elements, in FIFO order
+* @param[in]    count  capacity of the array
+*
+* @return number of elements removed
+*/
+uint32_t ring_pop_batch(ring_t* ring, void* elems, uint32_t count)
+{
+   uint32_t done = 0;
+   uint32_t popped;
+
+   while (done < count)
+   {
+      popped = ring_try_pop_batch(ring, (unsigned char*)elems + (size_t)done * ring->elem_size,
+         count - done);
+      if (popped == 0)
+      {
+         break;
+      }
+      done += popped;
+   }
+
+   if (done > 0)
+   {
+      ring_notify(&ring->space_seq, &ring->space_waiters);
+   }
+   return done;
+}
+
+/**
+* @brief Appends count elements to the ring. The caller is blocked while the ring is full.
+*
+* @param[inout] ring   pointer to a ring
+* @param[in]    elems  array of elements to be copied into the ring
+* @param[in]    count  number of elements in the array
+*
+* @return none
+*/
+void ring_push_batch_wait(ring_t* ring, const void* elems, uint32_t count)
+{
+   uint32_t done = 0;
+
+   while (done < count)
+   {
+      done += ring_push_batch(ring, (const unsigned char*)elems + (size_t)done * ring->elem_size,
+         count - done);
+      if (done < count)
+      {
+         // wait for a free slot, then try to move the rest in one go again
+         ring_push_wait(ring, (const unsigned char*)elems + (size_t)done * ring->elem_size);
+         done++;
+      }
+   }
+}
+
+/**
+* @brief Removes up to count of the oldest elements from the ring. The caller is blocked
+*     until at least one element is available.
+*
+* @param[inout] ring   pointer to a ring
+* @param[out]   elems  array receiving the elements, in FIFO order
+* @param[in]    count  capacity of the array, at least one
+*
+* @return number of elements removed
+*/
+uint32_t ring_pop_batch_wait(ring_t* ring, void* elems, uint32_t count)
+{
+   ring_pop_wait(ring, elems);
+   return 1 + ring_pop_batch(ring, (unsigned char*)elems + ring->elem_size, count - 1);
+}
+
+/**
+* @brief Claims one of the readers declared on a broadcast ring.
+*
+* @details The reader starts from the first element ever pushed: the producer has
+*     been waiting for it since the ring was initialised.
+*
+* @param[inout] ring pointer to a broadcast ring
+*
+* @return index of the reader, -1 when all of them have been claimed
+*/
+int ring_subscribe(ring_t* ring)
+{
+   uint32_t reader = atomic_fetch_add_explicit(&ring->subscribed, 1, memory_order_relaxed);
+
+   if (!(ring->flags & RING_BROADCAST) || (reader >= ring->readers))
+   {
+      return -1;
+   }
+   atomic_store_explicit(&ring->reader[reader].state, RING_READER_ACTIVE, memory_order_relaxed);
+   return reader;
+}
+
+/**
+* @brief Detaches a reader from a broadcast ring, so it no longer holds the producer back.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+*
+* @return none
+*/
+void ring_unsubscribe(ring_t* ring, int reader)
+{
+   if ((reader < 0) || ((uint32_t)reader >= ring->readers))
+   {
+      return;
+   }
+   atomic_store_explicit(&ring->reader[reader].state, RING_READER_DETACHED, memory_order_relaxed);
+   atomic_store_explicit(&ring->reader[reader].position, RING_DETACHED_POS, memory_order_release);
+   ring_notify(&ring->space_seq, &ring->space_waiters);
+}
+
+/**
+* @brief Reads the next element of a broadcast ring, only if it is accepted by a predicate.
+*     The caller is not blocked when the reader has seen every element.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+* @param[out]   elem   buffer receiving the element, untouched when nothing is read
+* @param[in]    accept predicate applied to the next element, NULL accepts everything
+* @param[in]    arg    argument forwarded to the predicate
+*
+* @return true if an element was read
+*/
+bool ring_read_if(ring_t* ring, int reader, void* elem, bool (*accept)(const void* elem, long arg), long arg)
+{
+   uint64_t pos = atomic_load_explicit(&ring->reader[reader].position, memory_order_relaxed);
+   const unsigned char* slot = ring_slot(ring, pos);
+
+   if (ring_bcast_ready(ring, pos, 1) == 0)
+   {
+      return false;
+   }
+   if ((accept != NULL) && !accept(slot + ring->elem_offset, arg))
+   {
+      return false;
+   }
+
+   memcpy(elem, slot + ring->elem_offset, ring->elem_size);
+   ring_bcast_advance(ring, reader, pos, 1);
+   return true;
+}
+
+/**
+* @brief Reads the next element of a broadcast ring once it is accepted by a predicate.
+*     The caller is blocked until that happens.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+* @param[out]   elem   buffer receiving the element
+* @param[in]    accept predicate applied to the next element, NULL accepts everything
+* @param[in]    arg    argument forwarded to the predicate
+*
+* @return none
+*/
+void ring_read_if_wait(ring_t* ring, int reader, void* elem, bool (*accept)(const void* elem, long arg), long arg)
+{
+   ring_spin_t spin = { 0 };
+   uint32_t seq;
+
+   while (!ring_read_if(ring, reader, elem, accept, arg))
+   {
+      if (ring_spin(&spin, ring, false))
+      {
+         continue;
+      }
+
+      atomic_fetch_add_explicit(&ring->data_waiters, 1, memory_order_seq_cst);
+      atomic_thread_fence(memory_order_seq_cst);
+      seq = atomic_load_explicit(&ring->data_seq, memory_order_acquire);
+      if (ring_read_if(ring, reader, elem, accept, arg))
+      {
+         atomic_fetch_sub_explicit(&ring->data_waiters, 1, memory_order_relaxed);
+         break;
+      }
+      sysdep_futex_wait(&ring->data_seq, seq, NULL);
+      atomic_fetch_sub_explicit(&ring->data_waiters, 1, memory_order_relaxed);
+   }
+
+   ring_spin_end(&spin);
+}
+
+/**
+* @brief Reads up to count of the next elements of a broadcast ring. The caller is not
+*     blocked when the reader has seen every element.
+*
+* @details The cursor of the reader moves once for the whole batch.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+* @param[out]   elems  array receiving the elements, in FIFO order
+* @param[in]    count  capacity of the array
+*
+* @return number of elements read
+*/
+uint32_t ring_read_batch(ring_t* ring, int reader, void* elems, uint32_t count)
+{
+   uint64_t pos = atomic_load_explicit(&ring->reader[reader].position, memory_order_relaxed);
+   uint32_t ready = ring_bcast_ready(ring, pos, count);
+   uint32_t i;
+
+   if (ready == 0)
+   {
+      return 0;
+   }
+
+   for (i = 0; i < ready; i++)
+   {
+      memcpy((unsigned char*)elems + (size_t)i * ring->elem_size, ring_slot(ring, pos + i) + ring->elem_offset,
+         ring->elem_size);
+   }
+   ring_bcast_advance(ring, reader, pos, ready);
+   return ready;
+}
+
+/**
+* @brief Reads up to count of the next elements of a broadcast ring. The caller is
+*     blocked until at least one element is available.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+* @param[out]   elems  array receiving the elements, in FIFO order
+* @param[in]    count  capacity of the array, at least one
+*
+* @return number of elements read
+*/
+uint32_t ring_read_batch_wait(ring_t* ring, int reader, void* elems, uint32_t count)
+{
+   ring_read_if_wait(ring, reader, elems, NULL, 0);
+   return 1 + ring_read_batch(ring, reader, (unsigned char*)elems + ring->elem_size, count - 1);
+}
+
+/**
+* @brief Takes the next element of a broadcast ring, to be read in place. The caller
+*     is not blocked when the reader has seen every element.
+*
+* @details The slot is shared with the other readers and shall not be modified.
+*     It is not reused by the producer until ring_read_release() is called.
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+*
+* @return pointer to the element within the ring, NULL if there is nothing new
+*/
+void* ring_read_acquire(ring_t* ring, int reader)
+{
+   uint64_t pos = atomic_load_explicit(&ring->reader[reader].position, memory_order_relaxed);
+
+   if (ring_bcast_ready(ring, pos, 1) == 0)
+   {
+      return NULL;
+   }
+   return ring_slot(ring, pos) + ring->elem_offset;
+}
+
+/**
+* @brief Moves a reader past the element taken with ring_read_acquire().
+*
+* @param[inout] ring   pointer to a broadcast ring
+* @param[in]    reader index returned by ring_subscribe()
+*
+* @return none
+*/
+void ring_read_release(ring_t* ring, int reader)
+{
+   ring_bcast_advance(ring, reader,
+      atomic_load_explicit(&ring->reader[reader].position, memory_order_relaxed), 1);
+}
+
+/**
+* @brief Tells whether a reader of a broadcast ring has an element it has not read yet.
+*
+* @param[in] ring   pointer to a broadcast ring
+* @param[in] reader index returned by ring_subscribe()
+*
+* @return true if a read would find an element
+*/
+bool ring_reader_has_data(const ring_t* ring, int reader)
+{
+   return ring_bcast_ready(ring, atomic_load_explicit(&ring->reader[reader].position, memory_order_relaxed), 1) > 0;
+}
+
+/**
+* @brief Returns the number of readers declared on a ring.
+*
+* @param[in] ring pointer to a ring
+*
+* @return number of readers, 0 unless the ring is a broadcast one
+*/
+uint32_t ring_readers(const ring_t* ring)
+{
+   return ring->readers;
+}
+
+/**
+* @brief Takes a snapshot of the progress of a reader of a broadcast ring.
+*
+* @details The lag is the number of elements pushed that the reader has not read
+*     yet. The stalls are the times the producer found the ring full and had to
+*     sleep with this reader as the slowest one.
+*
+* @param[in]  ring   pointer to a broadcast ring
+* @param[in]  reader index of the reader, below ring_readers()
+* @param[out] stats  progress of the reader
+*
+* @return false when there is no such reader
+*/
+bool ring_reader_stats(const ring_t* ring, int reader, ring_reader_stats_t* stats)
+{
+   const ring_reader_t* cursor;
+   uint64_t pos;
+
+   if ((reader < 0) || ((uint32_t)reader >= ring->readers))
+   {
+      return false;
+   }
+
+   cursor = &ring->reader[reader];
+   pos = atomic_load_explicit(&cursor->position, memory_order_acquire);
+   stats->state = atomic_load_explicit(&cursor->state, memory_order_relaxed);
+   stats->received = cursor->received;
+   stats->lag = (pos == RING_DETACHED_POS) ? 0 : atomic_load_explicit(&ring->tail, memory_order_relaxed) - pos;
+   stats->max_lag = cursor->max_lag;
+   stats->stalls = cursor->stalls;
+   stats->stall_ns = cursor->stall_ns;
+   return true;
+}
+
+/**
+* @brief Tells whether the oldest element of the ring has been published.
+*
+* @param[in] ring pointer to a ring
+*
+* @return true if a retrieve would not find the ring empty
+*/
+bool ring_has_data(const ring_t* ring)
+{
+   uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   uint64_t seq = atomic_load_explicit(ring_slot_seq(ring_slot(ring, pos)), memory_order_acquire);
+
+   return seq == pos + 1;
+}
+
+/**
+* @brief Counts the caller among the consumers sleeping on a ring, before it sleeps on
+*     the futex word of the ring along with others.
+*
+* @details Once armed, any push wakes the caller up; ring_wait_disarm() shall follow
+*     the sleep, or the decision not to sleep.
+*
+* @param[inout] ring   pointer to a ring
+* @param[in]    reader reader of the caller on a broadcast ring, -1 if none
+* @param[out]   word   futex word to sleep on
+* @param[out]   value  value the word holds as long as nothing is published
+*
+* @return true if the ring has data already: the caller shall not sleep
+*/
+bool ring_wait_arm(ring_t* ring, int reader, _Atomic uint32_t** word, uint32_t* value)
+{
+   atomic_fetch_add_explicit(&ring->data_waiters, 1, memory_order_seq_cst);
+   atomic_thread_fence(memory_order_seq_cst);
+
+   *word = &ring->data_seq;
+   *value = atomic_load_explicit(&ring->data_seq, memory_order_acquire);
+   if (ring->flags & RING_BROADCAST)
+   {
+      return (reader >= 0) && ring_reader_has_data(ring, reader);
+   }
+   return ring_has_data(ring);
+}
+
+/**
+* @brief Takes the caller off the consumers sleeping on a ring.
+*
+* @param[inout] ring pointer to a ring armed with ring_wait_arm()
+*
+* @return none
+*/
+void ring_wait_disarm(ring_t* ring)
+{
+   atomic_fetch_sub_explicit(&ring->data_waiters, 1, memory_order_relaxed);
+}
+
+/**
+* @brief Sleeps until data is published on any of the rings or a deadline expires.
+*
+* @details The caller is registered as a consumer waiting on every ring, so any push
+*     wakes it up. Spurious wake-ups are possible: the caller shall check again the
+*     state of the rings. Without futex_waitv() support the rings are polled instead,
+*     which the result tells.
+*
+* @param[in] rings    array of pointers to rings
+* @param[in] readers  reader of the caller on each ring, only looked at on broadcast rings;
+*                     NULL when none of the rings is a broadcast one
+* @param[in] count    number of rings, at most RING_WAIT_MAX
+* @param[in] deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+*
+* @return 1 if the caller slept on the futexes of the rings or found data, 0 if it polled
+*     them instead, -1 with errno set to EINVAL when count is past RING_WAIT_MAX
+*/
+int ring_wait_any(ring_t* const* rings, const int* readers, unsigned count, const struct timespec* deadline)
+{
+   _Atomic uint32_t* words[RING_WAIT_MAX];
+   uint32_t values[RING_WAIT_MAX];
+   const struct timespec poll = { 0, RING_POLL_NS };
+   bool ready = false;
+   bool slept = true;
+   unsigned i;
+
+   // the rings past the limit would never wake the caller up
+   if (count > RING_WAIT_MAX)
+   {
+      errno = EINVAL;
+      return -1;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      ready = ring_wait_arm(rings[i], (readers != NULL) ? readers[i] : -1, &words[i], &values[i]) || ready;
+   }
+
+   if (!ready && (sysdep_futex_waitv(words, values, count, deadline) == -1))
+   {
+      nanosleep(&poll, NULL);
+      slept = false;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      ring_wait_disarm(rings[i]);
+   }
+   return slept ? 1 : 0;
+}
+
+/**
+* @brief Sets how the callers blocked on a ring wait.
+*
+* @details The strategy lives in the ring, so it holds for every process using it,
+*     from their next wait on. Spinning takes a CPU for the time the caller would
+*     have slept, but saves the futex wake-up, a few microseconds per message.
+*     RING_WAIT_SPIN and RING_WAIT_YIELD never sleep, which only suits a caller with
+*     a CPU of its own. RING_WAIT_ADAPTIVE keeps a moving average of the waits on
+*     each side of the ring: a caller spins for about twice the average while it is
+*     below RING_ADAPT_SPIN_NS, so it catches the next message of a busy ring without
+*     sleeping, and goes to sleep right away on a ring that is mostly idle.
+*
+* @param[inout] ring     pointer to a ring
+* @param[in]    strategy RING_WAIT_* strategy
+*
+* @return none
+*/
+void ring_set_wait(ring_t* ring, uint32_t strategy)
+{
+   atomic_store_explicit(&ring->wait, (strategy <= RING_WAIT_ADAPTIVE) ? strategy : RING_WAIT_HYBRID,
+      memory_order_relaxed);
+}
+
+/**
+* @brief Returns how the callers blocked on a ring wait.
+*
+* @param[in] ring pointer to a ring
+*
+* @return RING_WAIT_* strategy of the ring
+*/
+uint32_t ring_get_wait(const ring_t* ring)
+{
+   return atomic_load_explicit(&ring->wait, memory_order_relaxed);
+}
+
+/**
+* @brief Lets a blocked caller spin according to the strategy of the ring, after a failed try.
+*
+* @details The caller tries again when true is returned, or else sleeps on the futex
+*     and tries again when woken up. Once the caller is done, ring_spin_end() shall be
+*     called with the same state. The strategy is taken on the first call of each wait.
+*
+* @param[inout] spin     state of the wait, zero-initialised before the first call
+* @param[inout] ring     pointer to the ring waited on
+* @param[in]    producer true when the caller waits for room, false for data
+*
+* @return true if the caller shall try again right away, false if it shall sleep
+*/
+bool ring_spin(ring_spin_t* spin, ring_t* ring, bool producer)
+{
+   uint64_t avg_ns;
+
+   if (spin->ring == NULL)
+   {
+      spin->ring = ring;
+      spin->producer = producer;
+      spin->strategy = atomic_load_explicit(&ring->wait, memory_order_relaxed);
+      if (spin->strategy == RING_WAIT_ADAPTIVE)
+      {
+         avg_ns = atomic_load_explicit(&ring_waits(ring, producer)->avg_ns, memory_order_relaxed);
+         spin->since_ns = sysdep_now();
+         spin->until_ns = (avg_ns < RING_ADAPT_SPIN_NS) ? spin->since_ns + 2 * avg_ns : 0;
+      }
+   }
+
+   if (spin->slept)
+   {
+      return false;
+   }
+
+   switch (spin->strategy)
+   {
+   case RING_WAIT_SPIN:
+      ring_cpu_relax();
+      return true;
+   case RING_WAIT_YIELD:
+      if (spin->spins++ < RING_SPIN_LIMIT)
+      {
+         ring_cpu_relax();
+      }
+      else
+      {
+         sched_yield();
+      }
+      return true;
+   case RING_WAIT_BLOCK:
+      break;
+   case RING_WAIT_ADAPTIVE:
+      // a short usual wait is spun through, at least as long as the hybrid strategy does
+      if ((spin->until_ns != 0) && ((spin->spins++ < RING_SPIN_LIMIT) || (sysdep_now() < spin->until_ns)))
+      {
+         ring_cpu_relax();
+         return true;
+      }
+      break;
+   case RING_WAIT_HYBRID:
+   default:
+      if (spin->spins++ < RING_SPIN_LIMIT)
+      {
+         ring_cpu_relax();
+         return true;
+      }
+      break;
+   }
+
+   spin->slept = true;
+   return false;
+}
+
+/**
+* @brief Accounts for a wait that ring_spin() took part in, once the caller is done.
+*
+* @param[in] spin state of the wait, left untouched when ring_spin() was never called
+*
+* @return none
+*/
+void ring_spin_end(ring_spin_t* spin)
+{
+   ring_waits_t* waits;
+   uint64_t avg_ns;
+
+   if (spin->ring == NULL)
+   {
+      return;
+   }
+
+   waits = ring_waits(spin->ring, spin->producer);
+   atomic_fetch_add_explicit(spin->slept ? &waits->slept : &waits->spun, 1, memory_order_relaxed);
+   if (spin->strategy == RING_WAIT_ADAPTIVE)
+   {
+      // concurrent waiters may lose an update of the average, which only delays it
+      avg_ns = atomic_load_explicit(&waits->avg_ns, memory_order_relaxed);
+      avg_ns += ((sysdep_now() - spin->since_ns) >> RING_ADAPT_SHIFT) - (avg_ns >> RING_ADAPT_SHIFT);
+      atomic_store_explicit(&waits->avg_ns, avg_ns, memory_order_relaxed);
+   }
+}
+
+/**
+* @brief Returns the waits on one side of a ring.
+*
+* @param[in]  ring     pointer to a ring
+* @param[in]  producer true for the waits for room, false for the waits for data
+* @param[out] stats    waits of that side
+*
+* @return none
+*/
+void ring_wait_stats(const ring_t* ring, bool producer, ring_wait_stats_t* stats)
+{
+   const ring_waits_t* waits = producer ? &ring->space_waits : &ring->data_waits;
+
+   stats->strategy = atomic_load_explicit(&ring->wait, memory_order_relaxed);
+   stats->spun = atomic_load_explicit(&waits->spun, memory_order_relaxed);
+   stats->slept = atomic_load_explicit(&waits->slept, memory_order_relaxed);
+   stats->avg_ns = atomic_load_explicit(&waits->avg_ns, memory_order_relaxed);
+   stats->spinning = (stats->strategy == RING_WAIT_ADAPTIVE) && (stats->avg_ns < RING_ADAPT_SPIN_NS);
+}
+
+/**
+* @brief Returns the number of elements currently stored in the ring.
+*
+* @details The value is a snapshot and may be stale as soon as it is returned. On a
+*     broadcast ring it is the number of elements the slowest reader has not read yet.
+*
+* @param[in] ring pointer to a ring
+*
+* @return number of elements in the ring
+*/
+uint32_t ring_count(const ring_t* ring)
+{
+   uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+   int slowest;
+
+   if (ring->flags & RING_BROADCAST)
+   {
+      // the slots still held by the slowest reader
+      slowest = ring_slowest(ring);
+      head = (slowest < 0) ? tail : atomic_load_explicit(&ring->reader[slowest].position, memory_order_relaxed);
+   }
+
+   if (tail <= head)
+   {
+      return 0;
+   }
+   return (tail - head > ring->capacity) ? ring->capacity : (uint32_t)(tail - head);
+}
+
+/**
+* @brief Returns the number of slots of the ring.
+*
+* @param[in] ring pointer to a ring
+*
+* @return capacity of the ring
+*/
+uint32_t ring_capacity(const ring_t* ring)
+{
+   return ring->capacity;
+}
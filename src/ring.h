@@ -0,0 +1,217 @@
+/**
+* @file ring.h
+* @brief Functions and data definitions for the lock-free ring buffer
+* @anchor header_ring
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef RING_H
+#define RING_H
+
+/***************************** Include Files ********************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Ring flags
+ * @brief Concurrency model of a ring, selected at initialisation time
+ * @{
+ */
+#define RING_SINGLE           0x0   /**< one producer and one consumer */
+#define RING_MULTI_PRODUCER   0x1   /**< producers claim slots with a CAS */
+#define RING_MULTI_CONSUMER   0x2   /**< consumers claim slots with a CAS */
+#define RING_BROADCAST        0x4   /**< one producer, every reader gets every element */
+/* @} */
+
+/**
+ * @name Reader states
+ * @brief Life cycle of a reader of a broadcast ring
+ * @{
+ */
+#define RING_READER_DECLARED  0     /**< not claimed yet, already holding the producer back */
+#define RING_READER_ACTIVE    1     /**< claimed with ring_subscribe() */
+#define RING_READER_DETACHED  2     /**< gone, ignored by the producer */
+/* @} */
+
+/**
+ * @name Wait strategies
+ * @brief How a caller blocked on a ring waits, chosen per ring with ring_set_wait()
+ * @{
+ */
+#define RING_WAIT_HYBRID      0     /**< spins for a while, then sleeps on the futex (default) */
+#define RING_WAIT_BLOCK       1     /**< sleeps on the futex right away */
+#define RING_WAIT_YIELD       2     /**< spins for a while, then yields the CPU until it is done: never sleeps */
+#define RING_WAIT_SPIN        3     /**< busy-spins until it is done: never sleeps, takes a whole CPU */
+#define RING_WAIT_ADAPTIVE    4     /**< spins about as long as the usual wait when it is short, sleeps right away otherwise */
+/* @} */
+
+/**
+ * @brief Maximum number of readers of a broadcast ring
+ */
+#define RING_READERS_MAX      256
+
+/**
+ * @brief Maximum number of rings a process can wait on at once, one futex word each
+ */
+#define RING_WAIT_MAX         SYSDEP_WAITV_MAX
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Bounded lock-free ring of fixed-size elements.
+ *
+ * @details The ring lives entirely in the memory handed to ring_init(), so it
+ *       can be placed in a shared-memory segment and used by several processes.
+ *       Each slot carries a sequence number (Vyukov's bounded queue), which makes
+ *       the same layout usable as SPSC, MPSC, SPMC or MPMC: only the way positions
+ *       are claimed changes. A broadcast ring gives every reader a cursor of its own
+ *       over the same slots instead. Blocked producers and consumers spin, then
+ *       sleep on a futex, which is only touched when somebody is actually waiting;
+ *       how long they spin, if they sleep at all, is the wait strategy of the ring.
+ *
+ */
+typedef struct ring_s ring_t;
+
+/**
+ * @brief Progress of a reader of a broadcast ring, see ring_reader_stats().
+ */
+typedef struct
+{
+   uint32_t state;         /**< RING_READER_* state */
+   uint64_t received;      /**< elements read so far */
+   uint64_t lag;           /**< elements pushed and not read yet */
+   uint64_t max_lag;       /**< largest lag found on a read */
+   uint64_t stalls;        /**< times the producer slept because of this reader */
+   uint64_t stall_ns;      /**< time the producer slept because of this reader */
+} ring_reader_stats_t;
+
+/**
+ * @brief State of a caller waiting on a ring, see ring_spin().
+ *
+ * @details Shall be zero-initialised before each wait.
+ */
+typedef struct
+{
+   ring_t* ring;           /**< ring waited on, NULL until the first ring_spin() */
+   bool producer;          /**< the caller waits for room rather than for data */
+   bool slept;             /**< the caller gave up spinning */
+   uint32_t strategy;      /**< RING_WAIT_* strategy of the ring when the wait started */
+   uint32_t spins;         /**< looks at the ring so far */
+   uint64_t since_ns;      /**< time the wait started, only taken by the adaptive strategy */
+   uint64_t until_ns;      /**< time the adaptive strategy spins until, 0 when it does not spin */
+} ring_spin_t;
+
+/**
+ * @brief Waits on one side of a ring, see ring_wait_stats().
+ */
+typedef struct
+{
+   uint32_t strategy;      /**< RING_WAIT_* strategy of the ring */
+   uint64_t spun;          /**< waits over before the caller slept */
+   uint64_t slept;         /**< waits that slept on the futex */
+   uint64_t avg_ns;        /**< moving average of the waits, kept by the adaptive strategy */
+   bool spinning;          /**< the adaptive strategy spins on the next wait */
+} ring_wait_stats_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+size_t ring_footprint(uint32_t capacity, size_t elem_size, size_t elem_align);
+void ring_init(ring_t* ring, uint32_t capacity, size_t elem_size, size_t elem_align, unsigned flags);
+void ring_init_broadcast(ring_t* ring, uint32_t capacity, size_t elem_size, size_t elem_align, uint32_t readers);
+bool ring_ready(const ring_t* ring);
+/* @} */
+
+/**
+ * @name Non-blocking operations
+ * @{
+ */
+bool ring_push(ring_t* ring, const void* elem);
+bool ring_pop(ring_t* ring, void* elem);
+bool ring_pop_if(ring_t* ring, void* elem, bool (*accept)(const void* elem, long arg), long arg);
+uint32_t ring_push_batch(ring_t* ring, const void* elems, uint32_t count);
+uint32_t ring_pop_batch(ring_t* ring, void* elems, uint32_t count);
+/* @} */
+
+/**
+ * @name Zero-copy operations
+ * @{
+ */
+void* ring_reserve(ring_t* ring);
+void ring_commit(ring_t* ring, void* elem);
+void* ring_acquire(ring_t* ring);
+void ring_release(ring_t* ring, void* elem);
+void* ring_reserve_wait(ring_t* ring);
+/* @} */
+
+/**
+ * @name Blocking operations
+ * @{
+ */
+void ring_push_wait(ring_t* ring, const void* elem);
+void ring_pop_wait(ring_t* ring, void* elem);
+void ring_pop_if_wait(ring_t* ring, void* elem, bool (*accept)(const void* elem, long arg), long arg);
+void ring_push_batch_wait(ring_t* ring, const void* elems, uint32_t count);
+uint32_t ring_pop_batch_wait(ring_t* ring, void* elems, uint32_t count);
+int ring_wait_any(ring_t* const* rings, const int* readers, unsigned count, const struct timespec* deadline);
+bool ring_wait_arm(ring_t* ring, int reader, _Atomic uint32_t** word, uint32_t* value);
+void ring_wait_disarm(ring_t* ring);
+/* @} */
+
+/**
+ * @name Wait strategies
+ * @{
+ */
+void ring_set_wait(ring_t* ring, uint32_t strategy);
+uint32_t ring_get_wait(const ring_t* ring);
+bool ring_spin(ring_spin_t* spin, ring_t* ring, bool producer);
+void ring_spin_end(ring_spin_t* spin);
+void ring_wait_stats(const ring_t* ring, bool producer, ring_wait_stats_t* stats);
+/* @} */
+
+/**
+ * @name Broadcast readers
+ * @{
+ */
+int ring_subscribe(ring_t* ring);
+void ring_unsubscribe(ring_t* ring, int reader);
+bool ring_read_if(ring_t* ring, int reader, void* elem, bool (*accept)(const void* elem, long arg), long arg);
+void ring_read_if_wait(ring_t* ring, int reader, void* elem, bool (*accept)(const void* elem, long arg), long arg);
+uint32_t ring_read_batch(ring_t* ring, int reader, void* elems, uint32_t count);
+uint32_t ring_read_batch_wait(ring_t* ring, int reader, void* elems, uint32_t count);
+void* ring_read_acquire(ring_t* ring, int reader);
+void ring_read_release(ring_t* ring, int reader);
+/* @} */
+
+/**
+ * @name Inspection
+ * @{
+ */
+bool ring_has_data(const ring_t* ring);
+bool ring_reader_has_data(const ring_t* ring, int reader);
+uint32_t ring_count(const ring_t* ring);
+uint32_t ring_capacity(const ring_t* ring);
+uint32_t ring_readers(const ring_t* ring);
+bool ring_reader_stats(const ring_t* ring, int reader, ring_reader_stats_t* stats);
+/* @} */
+
+#endif /*RING_H*/
@@ -0,0 +1,205 @@
+/**
+* @file startup.c
+* @brief Functions implementation of @ref header_startup "startup.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "startup.h"
+#include "sysdep.h"
+
+/**************************** Type Definitions ******************************/
+struct startup_s
+{
+   int processes;                      /**< processes the gate waits for */
+   bool hold;                          /**< false when they do not wait at the gate */
+   uint64_t created_ns;                /**< the processes are forked from here on */
+   _Atomic uint32_t ready;             /**< futex, processes that checked in */
+   _Atomic uint32_t open;              /**< futex, 1 once the gate is open */
+   _Atomic uint64_t ready_ns;          /**< the last process checked in */
+   _Atomic uint64_t released_ns;       /**< the gate opened */
+   _Atomic uint64_t actuated_ns;       /**< the first thruster fired */
+};
+
+/**
+* @brief Creates a closed gate in shared memory.
+*
+* @details The gate is inherited by the processes forked afterwards. In a simulation
+*     the virtual clock already holds every process until all of them are attached,
+*     and a process waiting outside of it would stall the others: the processes then
+*     only check in, for the report.
+*
+* @param[in] processes number of processes the gate waits for
+* @param[in] hold      true to make the processes wait at the gate until it opens
+*
+* @return the gate, NULL if it could not be mapped
+*/
+startup_t* startup_create(int processes, bool hold)
+{
+   startup_t* startup;
+
+   startup = mmap(NULL, sizeof(startup_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (startup == MAP_FAILED)
+   {
+      perror("mmap");
+      return NULL;
+   }
+
+   // anonymous mappings are zero-filled: nobody is ready and the gate is closed
+   startup->processes = processes;
+   startup->hold = hold;
+   startup->created_ns = sysdep_now();
+   return startup;
+}
+
+/**
+* @brief Unmaps a gate from the calling process.
+*
+* @param[in] startup gate returned by startup_create()
+*
+* @return none
+*/
+void startup_destroy(startup_t* startup)
+{
+   if (startup != NULL)
+   {
+      munmap(startup, sizeof(startup_t));
+   }
+}
+
+/**
+* @brief Checks the calling process in and waits until the gate opens.
+*
+* @details Shall be called once the process is attached to the shared state of the
+*     run, just before its role starts. A process started after the gate opened, e.g.
+*     a restarted replica, goes through at once.
+*
+* @param[inout] startup gate returned by startup_create(), NULL for none
+*
+* @return none
+*/
+void startup_ready(startup_t* startup)
+{
+   if (startup == NULL)
+   {
+      return;
+   }
+
+   if (atomic_fetch_add_explicit(&startup->ready, 1, memory_order_seq_cst) + 1 == (uint32_t)startup->processes)
+   {
+      atomic_store_explicit(&startup->ready_ns, sysdep_now(), memory_order_relaxed);
+   }
+   sysdep_futex_wake(&startup->ready);
+
+   while (startup->hold && (atomic_load_explicit(&startup->open, memory_order_acquire) == 0))
+   {
+      sysdep_futex_wait(&startup->open, 0, NULL);
+   }
+}
+
+/**
+* @brief Notes that a thruster fired, the first time only.
+*
+* @param[inout] startup gate returned by startup_create(), NULL for none
+*
+* @return none
+*/
+void startup_actuated(startup_t* startup)
+{
+   uint64_t none = 0;
+
+   if (startup != NULL)
+   {
+      atomic_compare_exchange_strong_explicit(&startup->actuated_ns, &none, sysdep_now(),
+         memory_order_relaxed, memory_order_relaxed);
+   }
+}
+
+/**
+* @brief Waits for all the processes to be ready, then opens the gate.
+*
+* @details Gives up waiting after STARTUP_READY_MS, e.g. when a process died before
+*     it checked in, and opens the gate to the processes ready by then. A gate that
+*     does not hold the processes is opened at once.
+*
+* @param[inout] startup gate returned by startup_create()
+*
+* @return number of processes ready when the gate opened
+*/
+int startup_release(startup_t* startup)
+{
+   struct timespec timeout;
+   uint64_t deadline = sysdep_now() + STARTUP_READY_MS * 1000000ULL;
+   uint64_t now;
+   uint32_t ready;
+
+   while (((ready = atomic_load_explicit(&startup->ready, memory_order_seq_cst)) < (uint32_t)startup->processes)
+      && startup->hold)
+   {
+      now = sysdep_now();
+      if (now >= deadline)
+      {
+         break;
+      }
+      timeout.tv_sec = (deadline - now) / 1000000000ULL;
+      timeout.tv_nsec = (deadline - now) % 1000000000ULL;
+      sysdep_futex_wait(&startup->ready, ready, &timeout);
+   }
+
+   atomic_store_explicit(&startup->released_ns, sysdep_now(), memory_order_relaxed);
+   atomic_store_explicit(&startup->open, 1, memory_order_release);
+   sysdep_futex_wake(&startup->open);
+   return (int)ready;
+}
+
+/**
+* @brief Prints how long the processes took to start and the chain to first actuate.
+*
+* @param[in] startup   gate returned by startup_create()
+* @param[in] launch_ns time the run was launched at, on the monotonic clock
+* @param[in] out       stream the report is printed on
+*
+* @return none
+*/
+void startup_report(startup_t* startup, uint64_t launch_ns, FILE* out)
+{
+   uint64_t ready = atomic_load_explicit(&startup->ready_ns, memory_order_relaxed);
+   uint64_t released = atomic_load_explicit(&startup->released_ns, memory_order_relaxed);
+   uint64_t actuated = atomic_load_explicit(&startup->actuated_ns, memory_order_relaxed);
+
+   fprintf(out, "startup: set up in %.3f ms", (startup->created_ns - launch_ns) / 1e6);
+   if (ready != 0)
+   {
+      fprintf(out, ", %i processes forked and ready in %.3f ms", startup->processes,
+         (ready - startup->created_ns) / 1e6);
+   }
+   else
+   {
+      fprintf(out, ", not all of the %i processes ready after %i ms", startup->processes, STARTUP_READY_MS);
+   }
+   if (actuated != 0)
+   {
+      fprintf(out, ", first actuation %.3f ms after the release, %.3f ms after launch\n", (actuated - released) / 1e6,
+         (actuated - launch_ns) / 1e6);
+   }
+   else
+   {
+      fprintf(out, ", no actuation\n");
+   }
+}
@@ -0,0 +1,74 @@
+/**
+* @file startup.h
+* @brief Definitions for the readiness gate of the processes of a run
+* @anchor header_startup
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef STARTUP_H
+#define STARTUP_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Longest wait for the processes to be ready, in ms, after which the gate opens anyway
+ */
+#define STARTUP_READY_MS   1000
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Readiness gate of the processes of a run, in shared memory.
+ *
+ * @details Every process forked by the driver checks in once it attached to the
+ *       shared state of the run and opened its channels, and waits at the gate. The
+ *       driver opens it as soon as all of them did, so the chain starts at once
+ *       rather than after a fixed delay, and from the same instant. The time the
+ *       processes took to be forked and ready, and the first actuation, are kept
+ *       for the report.
+ *
+ */
+typedef struct startup_s startup_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+startup_t* startup_create(int processes, bool hold);
+void startup_destroy(startup_t* startup);
+/* @} */
+
+/**
+ * @name Processes
+ * @{
+ */
+void startup_ready(startup_t* startup);
+void startup_actuated(startup_t* startup);
+/* @} */
+
+/**
+ * @name Driver
+ * @{
+ */
+int startup_release(startup_t* startup);
+void startup_report(startup_t* startup, uint64_t launch_ns, FILE* out);
+/* @} */
+
+#endif /*STARTUP_H*/
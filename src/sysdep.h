@@ -0,0 +1,129 @@
+/**
+* @file sysdep.h
+* @brief Futex and monotonic clock helpers shared by the modules
+* @anchor header_sysdep
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef SYSDEP_H
+#define SYSDEP_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Largest number of futex words waited on together, the limit of futex_waitv()
+ */
+#define SYSDEP_WAITV_MAX   128
+
+/************************** Function Prototypes *****************************/
+
+/**
+* @brief Sleeps on a futex word as long as it holds the expected value.
+*
+* @details Returns on a wake-up, on a signal, on the timeout or at once if the word
+*     changed: the caller checks its condition again in every case.
+*
+* @param[in] addr     futex word, in memory shared by the processes
+* @param[in] expected value the word holds while the caller shall sleep
+* @param[in] timeout  relative timeout, NULL for none
+*
+* @return none
+*/
+static inline void sysdep_futex_wait(_Atomic uint32_t* addr, uint32_t expected, const struct timespec* timeout)
+{
+   syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+/**
+* @brief Sleeps on several futex words at once, as long as each holds its expected value.
+*
+* @details Returns on the first wake-up of any of the words, on a signal, on the deadline
+*     or at once if one of them changed. Needs futex_waitv(), from Linux 5.16 on.
+*
+* @param[in] words    futex words, at most SYSDEP_WAITV_MAX
+* @param[in] values   value each word holds while the caller shall sleep
+* @param[in] count    number of words
+* @param[in] deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+*
+* @return 0 once the caller waited, -1 without waiting with errno set to EINVAL when count
+*     is past SYSDEP_WAITV_MAX, or to ENOSYS when the kernel cannot wait on several words:
+*     the caller shall then poll them
+*/
+static inline int sysdep_futex_waitv(_Atomic uint32_t* const* words, const uint32_t* values, unsigned count,
+   const struct timespec* deadline)
+{
+#ifdef __NR_futex_waitv
+   struct futex_waitv waiters[SYSDEP_WAITV_MAX];
+   unsigned i;
+
+   if (count > SYSDEP_WAITV_MAX)
+   {
+      errno = EINVAL;
+      return -1;
+   }
+   for (i = 0; i < count; i++)
+   {
+      waiters[i].val = values[i];
+      waiters[i].uaddr = (uintptr_t)words[i];
+      waiters[i].flags = FUTEX_32;
+      waiters[i].__reserved = 0;
+   }
+   return ((syscall(__NR_futex_waitv, waiters, count, 0, deadline, CLOCK_MONOTONIC) == -1) && (errno == ENOSYS)) ?
+      -1 : 0;
+#else
+   (void)words;
+   (void)values;
+   (void)deadline;
+   errno = (count > SYSDEP_WAITV_MAX) ? EINVAL : ENOSYS;
+   return -1;
+#endif
+}
+
+/**
+* @brief Wakes every process sleeping on a futex word.
+*
+* @param[in] addr futex word, in memory shared by the processes
+*
+* @return none
+*/
+static inline void sysdep_futex_wake(_Atomic uint32_t* addr)
+{
+   syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/**
+* @brief Reads the monotonic clock.
+*
+* @return current time in nanoseconds
+*/
+static inline uint64_t sysdep_now(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+#endif /*SYSDEP_H*/
@@ -0,0 +1,354 @@
+/**
+* @file top.c
+* @brief Live viewer of the metrics of a running chain, controlx-top.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "placement.h"
+
+/************************** Constant Definitions *****************************/
+#define TOP_SHM_DIR        "/dev/shm"
+#define TOP_PREFIX         "controlx-metrics-"
+#define TOP_INTERVAL_MS    1000     // default refresh period
+
+/**************************** Type Definitions ******************************/
+// counters of a channel at a point in time
+typedef struct
+{
+   uint64_t in;
+   uint64_t out;
+   uint64_t drops;
+   uint64_t blocked_in_ns;
+   uint64_t blocked_out_ns;
+} top_channel_t;
+
+// counters of a process at a point in time
+typedef struct
+{
+   pid_t pid;
+   uint64_t in;
+   uint64_t out;
+   uint64_t blocked_ns;
+   uint64_t disagreements;
+   uint64_t law_cycles;
+   uint64_t law_ns;
+} top_process_t;
+
+// counters of a whole run at a point in time
+typedef struct
+{
+   uint64_t t_ns;
+   int channels;
+   top_channel_t* channel;
+   top_process_t* process;
+} top_snapshot_t;
+
+/************************** Variable Definitions *****************************/
+static const char* top_backends[] = { "msgq", "spsc", "mpsc", "mpmc", "bcast" };
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Finds the namespace of the most recent run with a metrics segment.
+*
+* @return the namespace, -1 if no run has one
+*/
+static int top_find(void);
+
+/**
+* @brief Copies the counters of a run.
+*
+* @param[in]  metrics segment of the run
+* @param[out] snap    copy of the counters, with room for every channel and process
+*
+* @return none
+*/
+static void top_take(const metrics_t* metrics, top_snapshot_t* snap);
+
+/**
+* @brief Prints the rates of a run between two snapshots.
+*
+* @param[in] metrics segment of the run
+* @param[in] ns      namespace of the run
+* @param[in] prev    earlier snapshot
+* @param[in] curr    later snapshot
+*
+* @return none
+*/
+static void top_print(const metrics_t* metrics, int ns, const top_snapshot_t* prev, const top_snapshot_t* curr);
+
+/**
+* @brief Returns the monotonic time in ns.
+*/
+static uint64_t top_now(void);
+
+/**
+*
+* @brief Shows the live rates of a running chain
+*
+* @details Maps the metrics segment of a run (see @ref header_metrics "metrics.h") read-only
+*   and prints, every interval, the traffic, depth, drops and blocked time of every channel
+*   and the traffic, blocked time, voter disagreements and control-law cycle time of every
+*   process. The run is not touched: its processes do not know they are watched. Without
+*   -n the most recent run is shown. The viewer stops with the run, or after -c refreshes.
+*/
+int main(int argc, char* argv[])
+{
+   const metrics_t* metrics;
+   top_snapshot_t snap[2];
+   struct timespec pause;
+   size_t size;
+   int interval_ms = TOP_INTERVAL_MS;
+   int count = 0;
+   int ns = -1;
+   int curr = 0;
+   int done;
+   int opt;
+   int i;
+
+   while ((opt = getopt(argc, argv, "hn:i:c:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'n':
+         ns = (int)strtol(optarg, NULL, 16);
+         break;
+      case 'i':
+         interval_ms = atoi(optarg);
+         break;
+      case 'c':
+         count = atoi(optarg);
+         break;
+      case 'h':
+      default:
+         fprintf(stderr, "Usage %s [-h] [-n NAMESPACE] [-i MS] [-c COUNT]\n", argv[0]);
+         fprintf(stderr, "............ -h help\n");
+         fprintf(stderr, "............ -n namespace of the run, as printed by the driver (default the most recent run)\n");
+         fprintf(stderr, "............ -i refresh period in ms (default %i)\n", TOP_INTERVAL_MS);
+         fprintf(stderr, "............ -c refreshes before exiting, 0 to follow the run until it ends (default)\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if ((interval_ms <= 0) || (count < 0))
+   {
+      fprintf(stderr, "invalid refresh\n");
+      exit(EXIT_FAILURE);
+   }
+   if ((ns < 0) && ((ns = top_find()) < 0))
+   {
+      fprintf(stderr, "no run to show\n");
+      exit(EXIT_FAILURE);
+   }
+   if ((metrics = metrics_open(ns, &size)) == NULL)
+   {
+      fprintf(stderr, "no metrics for namespace %04x\n", ns);
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = 0; i < 2; i++)
+   {
+      snap[i].channel = calloc(METRICS_CHANNELS, sizeof(top_channel_t));
+      snap[i].process = calloc(metrics->processes, sizeof(top_process_t));
+   }
+
+   pause.tv_sec = interval_ms / 1000;
+   pause.tv_nsec = (interval_ms % 1000) * 1000000L;
+   top_take(metrics, &snap[curr]);
+
+   for (done = 0; (count == 0) || (done < count); done++)
+   {
+      nanosleep(&pause, NULL);
+      curr = 1 - curr;
+      top_take(metrics, &snap[curr]);
+      top_print(metrics, ns, &snap[1 - curr], &snap[curr]);
+
+      // the segment outlives its run only until the driver removes it
+      if ((kill(metrics->pid, 0) == -1) && (errno == ESRCH))
+      {
+         printf("run %i is over\n", metrics->pid);
+         break;
+      }
+   }
+
+   for (i = 0; i < 2; i++)
+   {
+      free(snap[i].channel);
+      free(snap[i].process);
+   }
+   munmap((void*)metrics, size);
+
+   return EXIT_SUCCESS;
+}
+
+static int top_find(void)
+{
+   char path[sizeof(TOP_SHM_DIR) + NAME_MAX + 1];
+   struct dirent* entry;
+   struct stat st;
+   time_t newest = 0;
+   int found = -1;
+   DIR* dir;
+
+   if ((dir = opendir(TOP_SHM_DIR)) == NULL)
+   {
+      perror("opendir");
+      return -1;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (strncmp(entry->d_name, TOP_PREFIX, strlen(TOP_PREFIX)) != 0)
+      {
+         continue;
+      }
+      snprintf(path, sizeof(path), "%s/%s", TOP_SHM_DIR, entry->d_name);
+      if ((stat(path, &st) == 0) && ((found < 0) || (st.st_mtime >= newest)))
+      {
+         newest = st.st_mtime;
+         found = (int)strtol(entry->d_name + strlen(TOP_PREFIX), NULL, 16);
+      }
+   }
+   closedir(dir);
+
+   return found;
+}
+
+static void top_take(const metrics_t* metrics, top_snapshot_t* snap)
+{
+   const metrics_channel_t* channel;
+   const metrics_process_t* process;
+   int i;
+
+   snap->t_ns = top_now();
+   snap->channels = atomic_load_explicit(&metrics->top_channel, memory_order_relaxed) + 1;
+   if (snap->channels > METRICS_CHANNELS)
+   {
+      snap->channels = METRICS_CHANNELS;
+   }
+
+   for (i = 0; i < snap->channels; i++)
+   {
+      channel = &metrics->channels[i];
+      snap->channel[i].in = atomic_load_explicit(&channel->in, memory_order_relaxed);
+      snap->channel[i].out = atomic_load_explicit(&channel->out, memory_order_relaxed);
+      snap->channel[i].drops = atomic_load_explicit(&channel->drops, memory_order_relaxed);
+      snap->channel[i].blocked_in_ns = atomic_load_explicit(&channel->blocked_in_ns, memory_order_relaxed);
+      snap->channel[i].blocked_out_ns = atomic_load_explicit(&channel->blocked_out_ns, memory_order_relaxed);
+   }
+
+   for (i = 0; i < metrics->processes; i++)
+   {
+      process = &metrics->process[i];
+      snap->process[i].pid = atomic_load_explicit(&process->pid, memory_order_acquire);
+      snap->process[i].in = atomic_load_explicit(&process->in, memory_order_relaxed);
+      snap->process[i].out = atomic_load_explicit(&process->out, memory_order_relaxed);
+      snap->process[i].blocked_ns = atomic_load_explicit(&process->blocked_ns, memory_order_relaxed);
+      snap->process[i].disagreements = atomic_load_explicit(&process->disagreements, memory_order_relaxed);
+      snap->process[i].law_cycles = atomic_load_explicit(&process->law_cycles, memory_order_relaxed);
+      snap->process[i].law_ns = atomic_load_explicit(&process->law_ns, memory_order_relaxed);
+   }
+}
+
+static void top_print(const metrics_t* metrics, int ns, const top_snapshot_t* prev, const top_snapshot_t* curr)
+{
+   const metrics_channel_t* channel;
+   const top_channel_t* c0;
+   const top_channel_t* c1;
+   const top_process_t* p0;
+   const top_process_t* p1;
+   double span_s = (curr->t_ns - prev->t_ns) / 1e9;
+   uint64_t out;
+   uint64_t cycles;
+   int backend;
+   int readers;
+   int i;
+
+   // a terminal is redrawn in place, anything else gets one report after the other
+   if (isatty(STDOUT_FILENO))
+   {
+      printf("\033[H\033[2J");
+   }
+   printf("controlx-top: run %i, namespace %04x, up %.1f s\n\n", metrics->pid, ns,
+      (curr->t_ns - metrics->start_ns) / 1e9);
+
+   printf("%7s %-6s %10s %10s %7s %8s %12s %12s\n", "CHANNEL", "KIND", "IN/s", "OUT/s", "DEPTH", "DROPS",
+      "WAIT-IN ms/s", "WAIT-OUT ms/s");
+   for (i = 1; i < curr->channels; i++)
+   {
+      channel = &metrics->channels[i];
+      if (!atomic_load_explicit(&channel->used, memory_order_relaxed))
+      {
+         continue;
+      }
+      c0 = &prev->channel[i];
+      c1 = &curr->channel[i];
+      backend = atomic_load_explicit(&channel->backend, memory_order_relaxed);
+      readers = atomic_load_explicit(&channel->readers, memory_order_relaxed);
+      out = c1->out / ((readers > 0) ? readers : 1);
+      printf("%7i %-6s %10.1f %10.1f %7li %8lu %12.2f %12.2f\n", i,
+         ((backend >= 0) && (backend <= CHANNEL_SHM_BCAST)) ? top_backends[backend] : "?",
+         (c1->in - c0->in) / span_s, (c1->out - c0->out) / span_s,
+         (c1->in > out) ? (long)(c1->in - out) : 0L, (unsigned long)c1->drops,
+         (c1->blocked_in_ns - c0->blocked_in_ns) / 1e6 / span_s,
+         (c1->blocked_out_ns - c0->blocked_out_ns) / 1e6 / span_s);
+   }
+
+   printf("\n%7s %-8s %4s %10s %10s %9s %8s %10s\n", "PID", "ROLE", "SLOT", "IN/s", "OUT/s", "BLOCKED%",
+      "DISAGREE", "LAW us");
+   for (i = 0; i < metrics->processes; i++)
+   {
+      p0 = &prev->process[i];
+      p1 = &curr->process[i];
+      if (p1->pid == 0)
+      {
+         continue;
+      }
+      cycles = p1->law_cycles - p0->law_cycles;
+      printf("%7i %-8s %4i %10.1f %10.1f %9.1f %8lu ", p1->pid, placement_role_name(metrics->process[i].role), i,
+         (p1->in - p0->in) / span_s, (p1->out - p0->out) / span_s,
+         100.0 * (p1->blocked_ns - p0->blocked_ns) / 1e9 / span_s, (unsigned long)p1->disagreements);
+      if (cycles > 0)
+      {
+         printf("%10.2f\n", (p1->law_ns - p0->law_ns) / 1e3 / cycles);
+      }
+      else
+      {
+         printf("%10s\n", "-");
+      }
+   }
+   fflush(stdout);
+}
+
+static uint64_t top_now(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
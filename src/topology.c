@@ -0,0 +1,413 @@
+/**
+* @file topology.c
+* @brief Functions implementation of @ref header_topology "topology.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "topology.h"
+#include "app.h"
+
+/************************** Constant Definitions *****************************/
+#define TOPO_LINE          256      // longest line of a topology file
+#define TOPO_MAX_GROUPS    (CHANNEL_ID_MAX - CHTMR + 1)
+
+/************************** Variable Definitions *****************************/
+// sensor types, indexed by their identifier
+PRIVATE const char* topo_kinds[ID_STRTRK + 1] = { NULL, "imu", "gnss", "strtrk" };
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Adds a sensor class from a line of a topology file.
+*
+* @param[inout] topo     topology the class is added to
+* @param[in]    fields   rest of the line, after the keyword
+* @param[in]    defaults values of the fields the line does not set
+*
+* @return 0 on success, -1 if the line is not valid
+*/
+PRIVATE int topology_parse_class(topology_t* topo, char* fields, const topo_class_t* defaults);
+
+/**
+* @brief Parses a count, which shall be a whole non-negative number.
+*
+* @return the count, -1 if the text is not a count
+*/
+PRIVATE int topology_parse_count(const char* text);
+
+/************************** Private Functions *****************************/
+PRIVATE int topology_parse_count(const char* text)
+{
+   char* end;
+   long value;
+
+   if (text == NULL)
+   {
+      return -1;
+   }
+   value = strtol(text, &end, 10);
+   return ((end == text) || (*end != '\0') || (value < 0) || (value > CHANNEL_ID_MAX)) ? -1 : (int)value;
+}
+
+PRIVATE int topology_parse_class(topology_t* topo, char* fields, const topo_class_t* defaults)
+{
+   topo_class_t* cls;
+   char* name;
+   char* kind;
+   char* field;
+   char* value;
+   int number;
+
+   if (topo->classes == TOPO_MAX_CLASSES)
+   {
+      fprintf(stderr, "topology: more than %i sensor classes\n", TOPO_MAX_CLASSES);
+      return -1;
+   }
+
+   cls = &topo->cls[topo->classes];
+   *cls = *defaults;
+   name = strtok(fields, " \t");
+   kind = strtok(NULL, " \t");
+   if ((name == NULL) || (kind == NULL) || (strlen(name) >= TOPO_NAME_LEN))
+   {
+      return -1;
+   }
+   strcpy(cls->name, name);
+   for (cls->kind = ID_IMU; (cls->kind <= ID_STRTRK) && (strcmp(kind, topo_kinds[cls->kind]) != 0); cls->kind++)
+   {
+   }
+   if (cls->kind > ID_STRTRK)
+   {
+      fprintf(stderr, "topology: unknown sensor type %s, shall be imu, gnss or strtrk\n", kind);
+      return -1;
+   }
+
+   // the other fields are key=value, in any order
+   while ((field = strtok(NULL, " \t")) != NULL)
+   {
+      if ((value = strchr(field, '=')) == NULL)
+      {
+         return -1;
+      }
+      *value++ = '\0';
+
+      // the only field that is not a count
+      if (strcmp(field, "wait") == 0)
+      {
+         if ((cls->wait = channel_parse_wait(value)) == -1)
+         {
+            fprintf(stderr, "topology: unknown wait %s, shall be hybrid, block, yield, spin or adaptive\n", value);
+            return -1;
+         }
+         continue;
+      }
+      if ((number = topology_parse_count(value)) == -1)
+      {
+         return -1;
+      }
+
+      if (strcmp(field, "sensors") == 0)
+      {
+         cls->sensors = number;
+      }
+      else if (strcmp(field, "replicas") == 0)
+      {
+         cls->replicas = number;
+      }
+      else if (strcmp(field, "quorum") == 0)
+      {
+         cls->quorum = number;
+      }
+      else if (strcmp(field, "deadline") == 0)
+      {
+         cls->deadline_ms = number;
+      }
+      else if (strcmp(field, "rate") == 0)
+      {
+         cls->rate_hz = number;
+      }
+      else if (strcmp(field, "start") == 0)
+      {
+         cls->start_s = number;
+      }
+      else
+      {
+         fprintf(stderr, "topology: unknown field %s\n", field);
+         return -1;
+      }
+   }
+
+   topo->classes++;
+   return 0;
+}
+
+/**
+* @brief Builds the topology of the demo: an IMU, a GNSS and a star tracker, six actuators.
+*
+* @details Every class starts with the chain, once all the processes are ready.
+*
+* @param[out] topo     topology to be built
+* @param[in]  defaults replication and timing of every class
+*
+* @return none
+*/
+void topology_default(topology_t* topo, const topo_class_t* defaults)
+{
+   const int sensors[ID_STRTRK + 1] = { 0, TOT_IMU, TOT_GNSS, TOT_STRTRK };
+   int kind;
+
+   memset(topo, 0, sizeof(topology_t));
+   for (kind = ID_IMU; kind <= ID_STRTRK; kind++)
+   {
+      topo->cls[topo->classes] = *defaults;
+      strcpy(topo->cls[topo->classes].name, topo_kinds[kind]);
+      topo->cls[topo->classes].kind = kind;
+      topo->cls[topo->classes].sensors = sensors[kind];
+      topo->classes++;
+   }
+   topo->actuators = TOT_ACTUATORS;
+   topo->samples = TOT_SENSING;
+}
+
+/**
+* @brief Loads a topology from a file.
+*
+* @details Blank lines and what follows a '#' are ignored. Every other line is one of
+* @code
+* class NAME TYPE [sensors=N] [replicas=N] [quorum=M] [deadline=MS] [rate=HZ] [start=S] [wait=STRATEGY]
+* actuators COUNT
+* samples COUNT
+* @endcode
+*     where TYPE is imu, gnss or strtrk and STRATEGY is how its voters wait for the
+*     replicas: hybrid, block, yield, spin or adaptive. A class line adds a sensor class, forked in
+*     the order of the file; the fields it omits take the values of defaults, with one
+*     sensor and no start delay. Without actuators or samples lines the ones of the demo
+*     are used. The topology is not checked, see topology_check().
+*
+* @param[out] topo     topology to be loaded
+* @param[in]  path     path of the topology file
+* @param[in]  defaults replication and timing of the classes that do not set them
+*
+* @return 0 on success, -1 if the file cannot be read or is not valid
+*/
+int topology_load(topology_t* topo, const char* path, const topo_class_t* defaults)
+{
+   char line[TOPO_LINE];
+   topo_class_t base = *defaults;
+   FILE* file;
+   char* keyword;
+   char* rest;
+   int number = 0;
+   int result = 0;
+
+   if ((file = fopen(path, "r")) == NULL)
+   {
+      perror("fopen");
+      return -1;
+   }
+
+   memset(topo, 0, sizeof(topology_t));
+   topo->actuators = TOT_ACTUATORS;
+   topo->samples = TOT_SENSING;
+   base.sensors = 1;
+   base.start_s = 0;
+
+   while ((result == 0) && (fgets(line, sizeof(line), file) != NULL))
+   {
+      number++;
+      line[strcspn(line, "#\r\n")] = '\0';
+      if ((keyword = strtok(line, " \t")) == NULL)
+      {
+         continue;
+      }
+      rest = strtok(NULL, "");
+
+      if (strcmp(keyword, "class") == 0)
+      {
+         result = (rest != NULL) ? topology_parse_class(topo, rest, &base) : -1;
+      }
+      else if (strcmp(keyword, "actuators") == 0)
+      {
+         result = ((topo->actuators = topology_parse_count((rest != NULL) ? strtok(rest, " \t") : NULL)) == -1) ? -1 : 0;
+      }
+      else if (strcmp(keyword, "samples") == 0)
+      {
+         result = ((topo->samples = topology_parse_count((rest != NULL) ? strtok(rest, " \t") : NULL)) == -1) ? -1 : 0;
+      }
+      else
+      {
+         result = -1;
+      }
+   }
+   fclose(file);
+
+   if (result == -1)
+   {
+      fprintf(stderr, "topology: %s:%i is not valid\n", path, number);
+   }
+   return result;
+}
+
+/**
+* @brief Checks that a topology can run.
+*
+* @param[in] topo        topology to be checked
+* @param[in] tmr         true in TMR configuration
+* @param[in] max_readers most actuators the command channel can feed, 0 for no limit
+*
+* @return 0 if it can, -1 otherwise, with the reason printed
+*/
+int topology_check(const topology_t* topo, bool tmr, int max_readers)
+{
+   const topo_class_t* cls;
+   int i;
+
+   if (topology_sensors(topo, tmr) == 0)
+   {
+      fprintf(stderr, "topology: no sensors\n");
+      return -1;
+   }
+   if ((topo->actuators < 1) || ((max_readers > 0) && (topo->actuators > max_readers)))
+   {
+      fprintf(stderr, "topology: %i actuators, shall be between 1 and %i\n", topo->actuators,
+         (max_readers > 0) ? max_readers : CHANNEL_ID_MAX);
+      return -1;
+   }
+   if (topo->samples < 1)
+   {
+      fprintf(stderr, "topology: sensors shall produce at least a sample\n");
+      return -1;
+   }
+   if (tmr && (topology_groups(topo) > TOPO_MAX_GROUPS))
+   {
+      fprintf(stderr, "topology: %i voter groups, at most %i\n", topology_groups(topo), TOPO_MAX_GROUPS);
+      return -1;
+   }
+
+   for (i = 0; tmr && (i < topo->classes); i++)
+   {
+      cls = &topo->cls[i];
+      if ((cls->replicas < 1) || (cls->replicas > VOTE_MAX_REPLICAS) || (cls->quorum < 1) || (cls->quorum > cls->replicas))
+      {
+         fprintf(stderr, "topology: invalid voting policy %d-out-of-%d for %s\n", cls->quorum, cls->replicas, cls->name);
+         return -1;
+      }
+   }
+   return 0;
+}
+
+/**
+* @brief Prints the sensor classes of a topology and the processes they make up.
+*
+* @param[in] topo topology to be printed
+* @param[in] tmr  true in TMR configuration
+* @param[in] out  stream the topology is printed on
+*
+* @return none
+*/
+void topology_print(const topology_t* topo, bool tmr, FILE* out)
+{
+   const topo_class_t* cls;
+   int i;
+
+   for (i = 0; i < topo->classes; i++)
+   {
+      cls = &topo->cls[i];
+      if (tmr)
+      {
+         fprintf(out, "[%i] topology: %s, %i %s sensors of %i replicas voting %i-out-of-%i, %s wait\n", getpid(),
+            cls->name, cls->sensors, topo_kinds[cls->kind], cls->replicas, cls->quorum, cls->replicas,
+            channel_wait_name((channel_wait_t)cls->wait));
+      }
+      else
+      {
+         fprintf(out, "[%i] topology: %s, %i %s sensors\n", getpid(), cls->name, cls->sensors, topo_kinds[cls->kind]);
+      }
+   }
+   fprintf(out, "[%i] topology: %i sensor processes, %i voters, %i actuators, %i samples per sensor\n", getpid(),
+      topology_sensors(topo, tmr), tmr ? topology_groups(topo) : 0, topo->actuators, topo->samples);
+}
+
+/**
+* @brief Counts the sensor processes of a topology.
+*
+* @param[in] topo topology
+* @param[in] tmr  true in TMR configuration, where every sensor is replicated
+*
+* @return number of sensor processes
+*/
+int topology_sensors(const topology_t* topo, bool tmr)
+{
+   int count = 0;
+   int i;
+
+   for (i = 0; i < topo->classes; i++)
+   {
+      count += topo->cls[i].sensors * (tmr ? topo->cls[i].replicas : 1);
+   }
+   return count;
+}
+
+/**
+* @brief Counts the voter groups of a topology, one per sensor of every class.
+*
+* @param[in] topo topology
+*
+* @return number of voter groups, and of voters with TMR
+*/
+int topology_groups(const topology_t* topo)
+{
+   int count = 0;
+   int i;
+
+   for (i = 0; i < topo->classes; i++)
+   {
+      count += topo->cls[i].sensors;
+   }
+   return count;
+}
+
+/**
+* @brief Gives the channel of a voter group, where its replicas send their samples.
+*
+* @details Groups are numbered from 0 across the classes, in the order of the topology.
+*
+* @param[in] group voter group
+*
+* @return identifier of the channel, to be passed to channel_create()
+*/
+int topology_channel(int group)
+{
+   return CHTMR + group;
+}
+
+/**
+* @brief Counts the commands control sends to the actuators in a run.
+*
+* @details Control sends a command per sample it gets, from a sensor or, with TMR, from
+*     the voter of its group: either way one per sensor of every class.
+*
+* @param[in] topo topology
+*
+* @return number of commands
+*/
+long topology_commands(const topology_t* topo)
+{
+   return (long)topology_groups(topo) * topo->samples;
+}
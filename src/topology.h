@@ -0,0 +1,98 @@
+/**
+* @file topology.h
+* @brief Functions and data definitions for the topology of the chain
+* @anchor header_topology
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+/***************************** Include Files ********************************/
+#include <stdbool.h>
+#include <stdio.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Maximum number of sensor classes in a topology
+ */
+#define TOPO_MAX_CLASSES   64
+
+/**
+ * @brief Room for the name of a sensor class
+ */
+#define TOPO_NAME_LEN      16
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Sensors of the same kind, sharing their replication and timing.
+ *
+ * @details Without TMR every sensor of the class feeds control. With TMR each one
+ *       is replicated and its replicas feed a voter of its own, on a channel of its
+ *       own: a class of n sensors is n voter groups.
+ *
+ */
+typedef struct
+{
+   char name[TOPO_NAME_LEN];  /**< name of the class, e.g. imu */
+   int kind;                  /**< @ref def_ids "identifier" of the sensor type, which sets the frame of its samples */
+   int sensors;               /**< independent sensors of the class */
+   int replicas;              /**< replicas of each sensor with TMR, N */
+   int quorum;                /**< agreeing replicas needed for consensus, M */
+   int deadline_ms;           /**< longest wait of a voter for the replicas of a sample */
+   int rate_hz;               /**< samples per second of each sensor, 0 for random intervals */
+   int start_s;               /**< time the voters of the class wait before they start voting */
+   int wait;                  /**< @ref channel_wait_t "wait strategy" of the voters of the class on their channels */
+} topo_class_t;
+
+/**
+ * @brief Processes of the chain and the way they are connected.
+ *
+ * @details Loaded at startup with topology_load(), or built in with topology_default().
+ *       Channels are numbered from the topology (see topology_channel()), so any number
+ *       of voter groups gets channels of its own.
+ *
+ */
+typedef struct
+{
+   int classes;                           /**< sensor classes in use */
+   topo_class_t cls[TOPO_MAX_CLASSES];    /**< sensor classes, in the order their processes are forked */
+   int actuators;                         /**< actuator processes */
+   int samples;                           /**< samples produced by each sensor */
+} topology_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+void topology_default(topology_t* topo, const topo_class_t* defaults);
+int topology_load(topology_t* topo, const char* path, const topo_class_t* defaults);
+int topology_check(const topology_t* topo, bool tmr, int max_readers);
+void topology_print(const topology_t* topo, bool tmr, FILE* out);
+/* @} */
+
+/**
+ * @name Queries
+ * @{
+ */
+int topology_sensors(const topology_t* topo, bool tmr);
+int topology_groups(const topology_t* topo);
+int topology_channel(int group);
+long topology_commands(const topology_t* topo);
+/* @} */
+
+#endif /*TOPOLOGY_H*/
@@ -0,0 +1,231 @@
+/**
+* @file trace.c
+* @brief Functions implementation of @ref header_trace "trace.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "sysdep.h"
+
+/************************** Variable Definitions *****************************/
+// histograms of all processes, TRACE_HOPS consecutive entries per process
+static histogram_t* trace_table = NULL;
+static int trace_processes = 0;
+
+// histograms owned by the calling process, NULL when it is not traced
+static histogram_t* trace_mine = NULL;
+
+static const char* trace_hop_names[TRACE_HOPS] =
+{
+   "sensor->voter",
+   "sensor->control",
+   "control->actuator",
+   "sensor->actuator"
+};
+
+/**
+* @brief Allocates the histograms of all the processes.
+*
+* @details The histograms are kept in an anonymous shared mapping, so it shall be
+*     called before forking the processes. Every process owns a slot, which it
+*     writes without synchronisation; the slots are only merged for reporting.
+*
+* @param[in] processes number of process slots
+*
+* @return none
+*/
+void trace_init(int processes)
+{
+   void* ptr;
+
+   ptr = mmap(NULL, (size_t)processes * TRACE_HOPS * sizeof(histogram_t),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED)
+   {
+      perror("mmap");
+      return;
+   }
+
+   trace_table = ptr;
+   trace_processes = processes;
+   trace_mine = NULL;
+}
+
+/**
+* @brief Makes the calling process record its latencies in a slot.
+*
+* @param[in] slot index of the slot, unique among the processes
+*
+* @return none
+*/
+void trace_attach(int slot)
+{
+   if ((trace_table != NULL) && (slot >= 0) && (slot < trace_processes))
+   {
+      trace_mine = &trace_table[slot * TRACE_HOPS];
+   }
+}
+
+/**
+* @brief Releases the histograms of all the processes.
+*
+* @return none
+*/
+void trace_release(void)
+{
+   if (trace_table != NULL)
+   {
+      munmap(trace_table, (size_t)trace_processes * TRACE_HOPS * sizeof(histogram_t));
+   }
+   trace_table = NULL;
+   trace_mine = NULL;
+   trace_processes = 0;
+}
+
+/**
+* @brief Reads the monotonic clock.
+*
+* @return current time in nanoseconds
+*/
+uint64_t trace_now(void)
+{
+   return sysdep_now();
+}
+
+/**
+* @brief Marks a message as a new sample produced now.
+*
+* @param[inout] msg message to be stamped
+* @param[in]    seq sequence number of the sample
+*
+* @return none
+*/
+void trace_origin(message_t* msg, unsigned int seq)
+{
+   msg->seq = seq;
+   msg->t_origin = trace_now();
+   msg->t_hop = msg->t_origin;
+}
+
+/**
+* @brief Marks a message as leaving the current stage now.
+*
+* @param[inout] msg message to be stamped
+*
+* @return none
+*/
+void trace_stamp(message_t* msg)
+{
+   msg->t_hop = trace_now();
+}
+
+/**
+* @brief Records the time a message spent since it left the previous stage.
+*
+* @details The message is stamped again, so the next stage measures from now.
+*
+* @param[in]    hop leg of the path according to @ref def_hops "this" classification
+* @param[inout] msg received message
+*
+* @return none
+*/
+void trace_hop(int hop, message_t* msg)
+{
+   uint64_t now = trace_now();
+
+   trace_record(hop, now - msg->t_hop);
+   msg->t_hop = now;
+}
+
+/**
+* @brief Records a latency in the histogram of the calling process.
+*
+* @param[in] hop        leg of the path according to @ref def_hops "this" classification
+* @param[in] latency_ns latency in nanoseconds
+*
+* @return none
+*/
+void trace_record(int hop, uint64_t latency_ns)
+{
+   if ((trace_mine != NULL) && (hop >= 0) && (hop < TRACE_HOPS))
+   {
+      histogram_record(&trace_mine[hop], latency_ns);
+   }
+}
+
+/**
+* @brief Returns a printable name for a hop.
+*
+* @param[in] hop leg of the path according to @ref def_hops "this" classification
+*
+* @return name of the hop
+*/
+const char* trace_hop_name(int hop)
+{
+   return ((hop >= 0) && (hop < TRACE_HOPS)) ? trace_hop_names[hop] : "unknown";
+}
+
+/**
+* @brief Merges the histograms of a hop over all the processes.
+*
+* @param[in]  hop  leg of the path according to @ref def_hops "this" classification
+* @param[out] hist histogram receiving the merged occurrences
+*
+* @return none
+*/
+void trace_merge(int hop, histogram_t* hist)
+{
+   int i;
+
+   histogram_reset(hist);
+   for (i = 0; i < trace_processes; i++)
+   {
+      histogram_merge(hist, &trace_table[i * TRACE_HOPS + hop]);
+   }
+}
+
+/**
+* @brief Prints the latency percentiles of every hop that saw at least one sample.
+*
+* @param[in] out stream where the report is printed
+*
+* @return none
+*/
+void trace_report(FILE* out)
+{
+   static histogram_t hist;
+   int hop;
+
+   for (hop = 0; hop < TRACE_HOPS; hop++)
+   {
+      trace_merge(hop, &hist);
+      if (hist.count == 0)
+      {
+         continue;
+      }
+
+      fprintf(out, "[%i] latency %-18s samples %-6lu p50 %10.1fus p99 %10.1fus p99.9 %10.1fus max %10.1fus\n",
+         getpid(), trace_hop_names[hop], (unsigned long)hist.count,
+         histogram_percentile(&hist, 50.0) / 1000.0,
+         histogram_percentile(&hist, 99.0) / 1000.0,
+         histogram_percentile(&hist, 99.9) / 1000.0,
+         hist.max / 1000.0);
+   }
+}
@@ -0,0 +1,75 @@
+/**
+* @file trace.h
+* @brief Functions and data definitions for the end-to-end latency tracing
+* @anchor header_trace
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdint.h>
+
+#include "channel.h"
+#include "histogram.h"
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Hops
+ * @anchor def_hops
+ * @brief Legs of the path of a sample, each with its own latency histogram
+ * @{
+ */
+#define TRACE_HOP_VOTER       0     /**< sensor to voter */
+#define TRACE_HOP_CONTROL     1     /**< sensor or voter to control */
+#define TRACE_HOP_ACTUATOR    2     /**< control to actuator */
+#define TRACE_END_TO_END      3     /**< sensor to actuator */
+#define TRACE_HOPS            4
+/* @} */
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+void trace_init(int processes);
+void trace_attach(int slot);
+void trace_release(void);
+/* @} */
+
+/**
+ * @name Stamping
+ * @{
+ */
+uint64_t trace_now(void);
+void trace_origin(message_t* msg, unsigned int seq);
+void trace_stamp(message_t* msg);
+void trace_hop(int hop, message_t* msg);
+void trace_record(int hop, uint64_t latency_ns);
+/* @} */
+
+/**
+ * @name Reporting
+ * @{
+ */
+const char* trace_hop_name(int hop);
+void trace_merge(int hop, histogram_t* hist);
+void trace_report(FILE* out);
+/* @} */
+
+#endif /*TRACE_H*/
@@ -0,0 +1,543 @@
+/**
+* @file vclock.c
+* @brief Functions implementation of @ref header_vclock "vclock.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vclock.h"
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+// states of a process taking part in the simulation
+#define VCLOCK_UNSTARTED   0     // not attached yet, nothing runs before it is
+#define VCLOCK_READY       1     // may act at the current time, waits for its turn
+#define VCLOCK_RUNNING     2     // has the turn, the only one acting
+#define VCLOCK_SLEEPING    3     // waits for a time
+#define VCLOCK_WAITING     4     // waits for an event, or a time if not VCLOCK_NEVER
+#define VCLOCK_EXITED      5     // gone
+
+/**************************** Type Definitions ******************************/
+// a process taking part in the simulation
+typedef struct
+{
+   _Atomic uint32_t turn;           // futex bumped when the process gets the turn
+   int state;                       // according to VCLOCK_*
+   uint64_t wake_ns;                // virtual time the process waits for
+   uint64_t events;                 // events a waiting process is woken up by
+} vclock_slot_t;
+
+// virtual clock shared by all the processes, every field but turn under lock
+typedef struct
+{
+   atomic_flag lock;
+   _Atomic uint32_t turn;           // futex bumped whenever the turn goes to another process
+   uint32_t generation;             // bumped on every event
+   int outsiders;                   // processes out of the simulation sleeping on turn
+   int current;                     // slot having the turn, -1 if none
+   uint64_t now_ns;                 // virtual time
+   uint64_t steps;                  // times the clock moved forward
+   uint64_t real_start_ns;          // real time the simulation started at
+   int processes;                   // slots, the last one is the driver's
+   vclock_slot_t slot[];
+} vclock_t;
+
+/************************** Variable Definitions *****************************/
+// clock inherited by the processes forked after vclock_init(), NULL when the time is real
+static vclock_t* vclock = NULL;
+static size_t vclock_size = 0;
+
+// slot of the calling process, -1 if it does not take part in the simulation
+static int vclock_mine = -1;
+
+/************************** Private Functions *****************************/
+static void vclock_lock(void)
+{
+   while (atomic_flag_test_and_set_explicit(&vclock->lock, memory_order_acquire))
+   {
+      sched_yield();
+   }
+}
+
+static void vclock_unlock(void)
+{
+   atomic_flag_clear_explicit(&vclock->lock, memory_order_release);
+}
+
+static inline bool vclock_timed(const vclock_slot_t* slot)
+{
+   return (slot->state == VCLOCK_SLEEPING) || (slot->state == VCLOCK_WAITING);
+}
+
+/**
+* @brief Gives the turn to the next process, moving the clock if none can act at the current time.
+*
+* @details Called with the lock held whenever nobody has the turn. The ready process in
+*     the lowest slot goes first; when there is none, the clock jumps to the earliest
+*     wake-up and the processes due at that time become ready. Ties are always broken
+*     the same way, so the same run gives the same order of events every time.
+*/
+static void vclock_dispatch(void)
+{
+   uint64_t next = VCLOCK_NEVER;
+   int pick = -1;
+   int i;
+
+   if (vclock->current >= 0)
+   {
+      return;
+   }
+
+   for (i = 0; i < vclock->processes; i++)
+   {
+      if (vclock->slot[i].state == VCLOCK_UNSTARTED)
+      {
+         return;
+      }
+      if ((vclock->slot[i].state == VCLOCK_READY) && (pick < 0))
+      {
+         pick = i;
+      }
+      if (vclock_timed(&vclock->slot[i]) && (vclock->slot[i].wake_ns < next))
+      {
+         next = vclock->slot[i].wake_ns;
+      }
+   }
+
+   if (pick < 0)
+   {
+      // every process waits for an event from outside the simulation
+      if (next == VCLOCK_NEVER)
+      {
+         return;
+      }
+
+      vclock->now_ns = (next > vclock->now_ns) ? next : vclock->now_ns;
+      vclock->steps++;
+      for (i = 0; i < vclock->processes; i++)
+      {
+         if (vclock_timed(&vclock->slot[i]) && (vclock->slot[i].wake_ns <= vclock->now_ns))
+         {
+            vclock->slot[i].state = VCLOCK_READY;
+            pick = (pick < 0) ? i : pick;
+         }
+      }
+   }
+
+   // only the process having the turn is woken up, and whoever follows the time from outside
+   vclock->slot[pick].state = VCLOCK_RUNNING;
+   vclock->current = pick;
+   atomic_fetch_add_explicit(&vclock->slot[pick].turn, 1, memory_order_release);
+   sysdep_futex_wake(&vclock->slot[pick].turn);
+   atomic_fetch_add_explicit(&vclock->turn, 1, memory_order_release);
+   if (vclock->outsiders > 0)
+   {
+      sysdep_futex_wake(&vclock->turn);
+   }
+}
+
+// the processes waiting for one of the events check again, once they get their turn; called with the lock held
+static void vclock_event(uint64_t events)
+{
+   int i;
+
+   vclock->generation++;
+   for (i = 0; i < vclock->processes; i++)
+   {
+      if ((vclock->slot[i].state == VCLOCK_WAITING) && ((vclock->slot[i].events & events) != 0))
+      {
+         vclock->slot[i].state = VCLOCK_READY;
+      }
+   }
+   vclock_dispatch();
+}
+
+// waits for the turn of the calling process; called with the lock held, returns with the lock held
+static void vclock_wait_turn(void)
+{
+   _Atomic uint32_t* futex = &vclock->slot[vclock_mine].turn;
+   uint32_t turn;
+
+   while (vclock->current != vclock_mine)
+   {
+      turn = atomic_load_explicit(futex, memory_order_acquire);
+      vclock_unlock();
+      sysdep_futex_wait(futex, turn, NULL);
+      vclock_lock();
+   }
+}
+
+// a process out of the simulation waits for the next turn; called with the lock held, returns with the lock held
+static void vclock_follow(void)
+{
+   uint32_t turn = atomic_load_explicit(&vclock->turn, memory_order_acquire);
+
+   vclock->outsiders++;
+   vclock_unlock();
+   sysdep_futex_wait(&vclock->turn, turn, NULL);
+   vclock_lock();
+   vclock->outsiders--;
+}
+
+/**
+* @brief Gives up the turn until the calling process has it again.
+*
+* @details Called with the lock held, returns with the lock held.
+*/
+static void vclock_block(int state, uint64_t wake_ns, uint64_t events)
+{
+   vclock->slot[vclock_mine].state = state;
+   vclock->slot[vclock_mine].wake_ns = wake_ns;
+   vclock->slot[vclock_mine].events = events;
+   if (vclock->current == vclock_mine)
+   {
+      vclock->current = -1;
+   }
+   vclock_dispatch();
+   vclock_wait_turn();
+}
+
+// a process taking part in the simulation leaves it, so the clock does not wait for it
+static void vclock_detach(void)
+{
+   if ((vclock == NULL) || (vclock_mine < 0))
+   {
+      return;
+   }
+
+   vclock_lock();
+   vclock->slot[vclock_mine].state = VCLOCK_EXITED;
+   if (vclock->current == vclock_mine)
+   {
+      vclock->current = -1;
+   }
+   // whoever joins the process checks again
+   vclock_event(VCLOCK_ANY);
+   vclock_unlock();
+   vclock_mine = -1;
+}
+
+/**
+* @brief Switches to the virtual clock, for a simulation with a set of processes.
+*
+* @details The clock is inherited by the processes forked afterwards. It starts at 0
+*     and only moves when every process taking part in the simulation waits, straight
+*     to the earliest time one of them waits for: sleeps take no real time. The
+*     processes take turns, one at a time and always in the same order, so a run
+*     gives the same events in the same order every time. The caller takes part too,
+*     in a slot of its own, and has the first turn; each of the other processes shall
+*     call vclock_attach(), and nothing else runs before they all did.
+*
+* @param[in] processes number of processes taking part in the simulation, but the caller
+*
+* @return 0 on success, -1 if the clock could not be mapped
+*/
+int vclock_init(int processes)
+{
+   vclock_size = sizeof(vclock_t) + (size_t)(processes + 1) * sizeof(vclock_slot_t);
+   vclock = mmap(NULL, vclock_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (vclock == MAP_FAILED)
+   {
+      perror("mmap");
+      vclock = NULL;
+      return -1;
+   }
+
+   // every other slot starts unstarted, the mapping is zeroed
+   atomic_flag_clear(&vclock->lock);
+   vclock->processes = processes + 1;
+   vclock->real_start_ns = sysdep_now();
+   vclock_mine = processes;
+   vclock->slot[vclock_mine].state = VCLOCK_RUNNING;
+   vclock->current = vclock_mine;
+   return 0;
+}
+
+/**
+* @brief Takes part in the simulation from the calling process.
+*
+* @details Returns on the first turn of the process, which leaves the simulation
+*     when it exits.
+*
+* @param[in] slot slot of the process, between 0 and the number given to vclock_init()
+*
+* @return none
+*/
+void vclock_attach(int slot)
+{
+   if ((vclock == NULL) || (slot < 0) || (slot >= vclock->processes - 1))
+   {
+      return;
+   }
+
+   vclock_mine = slot;
+   atexit(vclock_detach);
+
+   vclock_lock();
+   vclock->slot[slot].state = VCLOCK_READY;
+   vclock_dispatch();
+   vclock_wait_turn();
+   vclock_unlock();
+}
+
+/**
+* @brief Waits for a range of processes to leave the simulation.
+*
+* @details Does nothing when the time is real: the caller then waits for them as usual.
+*
+* @param[in] first first slot of the range
+* @param[in] count number of slots in the range
+*
+* @return none
+*/
+void vclock_join(int first, int count)
+{
+   int i;
+
+   if ((vclock == NULL) || (vclock_mine < 0))
+   {
+      return;
+   }
+
+   vclock_lock();
+   for (i = first; i < first + count; i++)
+   {
+      while (vclock->slot[i].state != VCLOCK_EXITED)
+      {
+         vclock_block(VCLOCK_WAITING, VCLOCK_NEVER, VCLOCK_ANY);
+      }
+   }
+   vclock_unlock();
+}
+
+/**
+* @brief Prints how much time was simulated, and in how much real time.
+*
+* @param[in] out stream the report is printed on
+*
+* @return none
+*/
+void vclock_report(FILE* out)
+{
+   uint64_t real;
+
+   if (vclock == NULL)
+   {
+      return;
+   }
+
+   real = sysdep_now() - vclock->real_start_ns;
+   fprintf(out, "[%i] vclock: %lu.%03lu s simulated in %lu.%03lu s, %lu time steps\n", getpid(),
+      (unsigned long)(vclock->now_ns / 1000000000ULL), (unsigned long)(vclock->now_ns / 1000000ULL % 1000),
+      (unsigned long)(real / 1000000000ULL), (unsigned long)(real / 1000000ULL % 1000), (unsigned long)vclock->steps);
+}
+
+/**
+* @brief Leaves the simulation and unmaps the virtual clock, the time is real again.
+*
+* @return none
+*/
+void vclock_release(void)
+{
+   // the processes still running go on without the caller
+   vclock_detach();
+   if (vclock != NULL)
+   {
+      munmap(vclock, vclock_size);
+   }
+   vclock = NULL;
+}
+
+/**
+* @brief Tells whether the time is virtual.
+*
+* @return true in a simulation
+*/
+bool vclock_enabled(void)
+{
+   return vclock != NULL;
+}
+
+/**
+* @brief Reads the clock the processes schedule their work on.
+*
+* @return virtual time in a simulation, otherwise monotonic time, in ns
+*/
+uint64_t vclock_now(void)
+{
+   uint64_t now;
+
+   if (vclock == NULL)
+   {
+      return sysdep_now();
+   }
+
+   vclock_lock();
+   now = vclock->now_ns;
+   vclock_unlock();
+   return now;
+}
+
+/**
+* @brief Sleeps for a time.
+*
+* @param[in] ns time to sleep, in ns
+*
+* @return none
+*/
+void vclock_sleep(uint64_t ns)
+{
+   struct timespec sleep;
+
+   if (vclock == NULL)
+   {
+      sleep.tv_sec = ns / 1000000000ULL;
+      sleep.tv_nsec = ns % 1000000000ULL;
+      nanosleep(&sleep, NULL);
+      return;
+   }
+
+   vclock_sleep_until(vclock_now() + ns);
+}
+
+/**
+* @brief Sleeps until a time, signals do not cut the sleep short.
+*
+* @param[in] t_ns time to wake up at, on the clock of vclock_now()
+*
+* @return none
+*/
+void vclock_sleep_until(uint64_t t_ns)
+{
+   struct timespec release;
+
+   if (vclock == NULL)
+   {
+      release.tv_sec = t_ns / 1000000000ULL;
+      release.tv_nsec = t_ns % 1000000000ULL;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release, NULL) == EINTR)
+      {
+         // a signal does not move the release
+      }
+      return;
+   }
+
+   vclock_lock();
+   if (vclock_mine >= 0)
+   {
+      if (vclock->now_ns < t_ns)
+      {
+         vclock_block(VCLOCK_SLEEPING, t_ns, 0);
+      }
+   }
+   else
+   {
+      // a process out of the simulation only follows its time
+      while (vclock->now_ns < t_ns)
+      {
+         vclock_follow();
+      }
+   }
+   vclock_unlock();
+}
+
+/**
+* @brief Returns a counter bumped on every event, to be passed to vclock_wait().
+*
+* @details Shall be taken before checking for the event waited for, so an event
+*     arriving in between is not missed.
+*
+* @return current generation of the events
+*/
+uint32_t vclock_generation(void)
+{
+   uint32_t generation;
+
+   if (vclock == NULL)
+   {
+      return 0;
+   }
+
+   vclock_lock();
+   generation = vclock->generation;
+   vclock_unlock();
+   return generation;
+}
+
+/**
+* @brief Waits for one of a set of events after a given generation, or for a time, in a simulation.
+*
+* @details Returns right away when the time is real. The caller shall check again
+*     for the event it waits for, as any of the events or a time step ends the wait.
+*
+* @param[in] events      events waited for, e.g. VCLOCK_EVENT() of a channel, VCLOCK_ANY for all
+* @param[in] generation  value of vclock_generation() taken before the last check
+* @param[in] deadline_ns longest wait, on the clock of vclock_now(), VCLOCK_NEVER for none
+*
+* @return none
+*/
+void vclock_wait(uint64_t events, uint32_t generation, uint64_t deadline_ns)
+{
+   if (vclock == NULL)
+   {
+      return;
+   }
+
+   vclock_lock();
+   if ((vclock->generation == generation) && (vclock->now_ns < deadline_ns))
+   {
+      if (vclock_mine >= 0)
+      {
+         vclock_block(VCLOCK_WAITING, deadline_ns, events);
+      }
+      else
+      {
+         vclock_follow();
+      }
+   }
+   vclock_unlock();
+}
+
+/**
+* @brief Tells the processes waiting for some events that they happened, e.g. a message was pushed.
+*
+* @details The processes waiting for any of the events become ready, and check whether
+*     the event is theirs on their next turn, before the clock moves. Does nothing when
+*     the time is real.
+*
+* @param[in] events events that happened, e.g. VCLOCK_EVENT() of a channel
+*
+* @return none
+*/
+void vclock_notify(uint64_t events)
+{
+   if (vclock == NULL)
+   {
+      return;
+   }
+
+   vclock_lock();
+   vclock_event(events);
+   vclock_unlock();
+}
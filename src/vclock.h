@@ -0,0 +1,81 @@
+/**
+* @file vclock.h
+* @brief Functions and data definitions for the virtual clock of the simulation mode
+* @anchor header_vclock
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+/***************************** Include Files ********************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Deadline of a wait that only ends on an event
+ */
+#define VCLOCK_NEVER    UINT64_MAX
+
+/**
+ * @brief One second, in ns
+ */
+#define VCLOCK_SEC      1000000000ULL
+
+/**
+ * @brief Event of a numbered source, e.g. a channel seed; sources 64 apart share it
+ */
+#define VCLOCK_EVENT(id)   (1ULL << ((uint64_t)(id) % 64))
+
+/**
+ * @brief All the events
+ */
+#define VCLOCK_ANY      UINT64_MAX
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+int vclock_init(int processes);
+void vclock_attach(int slot);
+void vclock_join(int first, int count);
+void vclock_report(FILE* out);
+void vclock_release(void);
+/* @} */
+
+/**
+ * @name Time
+ * @{
+ */
+bool vclock_enabled(void);
+uint64_t vclock_now(void);
+void vclock_sleep(uint64_t ns);
+void vclock_sleep_until(uint64_t t_ns);
+/* @} */
+
+/**
+ * @name Events
+ * @{
+ */
+uint32_t vclock_generation(void);
+void vclock_wait(uint64_t events, uint32_t generation, uint64_t deadline_ns);
+void vclock_notify(uint64_t events);
+/* @} */
+
+#endif /*VCLOCK_H*/
@@ -0,0 +1,428 @@
+/**
+* @file watchdog.c
+* @brief Functions implementation of @ref header_watchdog "watchdog.h"
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+/***************************** Include Files ********************************/
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "watchdog.h"
+#include "sysdep.h"
+
+/************************** Constant Definitions *****************************/
+// size of a cache line, to keep the groups of different voters apart
+#define WATCHDOG_CACHE_LINE   64
+
+// states of a replica
+#define WATCHDOG_IDLE         0     // not watched yet
+#define WATCHDOG_ALIVE        1     // beating, in the alive mask
+#define WATCHDOG_FAILED       2     // crashed or late, out of the mask
+#define WATCHDOG_RESTARTED    3     // started again, back in the mask with its first beat
+#define WATCHDOG_DONE         4     // sent all its samples, no longer watched
+
+/**************************** Type Definitions ******************************/
+typedef struct
+{
+   _Atomic int state;
+   _Atomic int fault;                              // open fault, -1 if none
+   _Atomic uint32_t next;                          // sample the replica sends next
+   _Atomic uint64_t beat_ns;                       // time of the last beat
+   _Atomic uint64_t timeout_ns;                    // longest time between two beats
+} watchdog_replica_t;
+
+typedef struct
+{
+   _Alignas(WATCHDOG_CACHE_LINE) _Atomic uint32_t alive;    // mask of the replicas voted on
+   watchdog_replica_t replica[WATCHDOG_REPLICAS];
+} watchdog_group_t;
+
+typedef struct
+{
+   int group;
+   int replica;
+   bool crashed;                                   // dead rather than late
+   _Atomic uint64_t detected_ns;                   // set last, once the fault is filled in
+   _Atomic uint64_t degraded_ns;                   // the voter applied the mask without the replica
+   _Atomic int live;                               // replicas voted on from then on
+   _Atomic int quorum;                             // and agreeing replicas needed among them
+   _Atomic uint64_t recovered_ns;                  // the replica beat again
+} watchdog_fault_t;
+
+struct watchdog_s
+{
+   size_t size;
+   int groups;
+   uint64_t created_ns;
+   _Atomic int faults;
+   watchdog_fault_t fault[WATCHDOG_FAULTS];
+   watchdog_group_t group[];
+};
+
+/************************** Private Functions *****************************/
+static inline watchdog_replica_t* watchdog_replica(watchdog_t* watchdog, int group, int replica)
+{
+   return &watchdog->group[group].replica[replica];
+}
+
+// takes a replica out of its group and opens a fault on it, the replica shall be failed already
+static void watchdog_open(watchdog_t* watchdog, int group, int replica, bool crashed)
+{
+   watchdog_replica_t* rep = watchdog_replica(watchdog, group, replica);
+   watchdog_fault_t* fault;
+   int index;
+
+   index = atomic_fetch_add_explicit(&watchdog->faults, 1, memory_order_relaxed);
+   if (index < WATCHDOG_FAULTS)
+   {
+      fault = &watchdog->fault[index];
+      fault->group = group;
+      fault->replica = replica;
+      fault->crashed = crashed;
+      atomic_store_explicit(&fault->detected_ns, sysdep_now(), memory_order_release);
+   }
+   atomic_store_explicit(&rep->fault, (index < WATCHDOG_FAULTS) ? index : -1, memory_order_relaxed);
+
+   // the fault is written before the voter can see the replica gone
+   atomic_fetch_and_explicit(&watchdog->group[group].alive, ~(1u << replica), memory_order_seq_cst);
+}
+
+/**
+* @brief Creates an empty heartbeat table in shared memory.
+*
+* @details The table is inherited by the processes forked afterwards. Every group
+*     starts with no replica watched and an empty alive mask.
+*
+* @param[in] groups number of voter groups
+*
+* @return the table, NULL if it could not be mapped
+*/
+watchdog_t* watchdog_create(int groups)
+{
+   watchdog_t* watchdog;
+   size_t size;
+
+   size = sizeof(watchdog_t) + (size_t)groups * sizeof(watchdog_group_t);
+   watchdog = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (watchdog == MAP_FAILED)
+   {
+      perror("mmap");
+      return NULL;
+   }
+
+   // anonymous mappings are zero-filled: every replica starts idle
+   watchdog->size = size;
+   watchdog->groups = groups;
+   watchdog->created_ns = sysdep_now();
+   return watchdog;
+}
+
+/**
+* @brief Unmaps a heartbeat table from the calling process.
+*
+* @param[in] watchdog table returned by watchdog_create()
+*
+* @return none
+*/
+void watchdog_destroy(watchdog_t* watchdog)
+{
+   if (watchdog != NULL)
+   {
+      munmap(watchdog, watchdog->size);
+   }
+}
+
+/**
+* @brief Starts watching a replica.
+*
+* @details Shall be called before the replica process is started, so its voter never
+*     misses it. A new replica enters the alive mask of its group at once; one restarted
+*     after a fault waits for its first beat.
+*
+* @param[inout] watchdog   table returned by watchdog_create()
+* @param[in]    group      voter group of the replica
+* @param[in]    replica    replica within the group, below WATCHDOG_REPLICAS
+* @param[in]    timeout_ns longest time between two beats before the replica is late
+*
+* @return none
+*/
+void watchdog_watch(watchdog_t* watchdog, int group, int replica, uint64_t timeout_ns)
+{
+   watchdog_replica_t* rep = watchdog_replica(watchdog, group, replica);
+
+   atomic_store_explicit(&rep->timeout_ns, timeout_ns, memory_order_relaxed);
+   atomic_store_explicit(&rep->beat_ns, sysdep_now(), memory_order_relaxed);
+   if (atomic_load_explicit(&rep->state, memory_order_relaxed) == WATCHDOG_FAILED)
+   {
+      atomic_store_explicit(&rep->state, WATCHDOG_RESTARTED, memory_order_release);
+   }
+   else
+   {
+      atomic_store_explicit(&rep->fault, -1, memory_order_relaxed);
+      atomic_store_explicit(&rep->state, WATCHDOG_ALIVE, memory_order_release);
+      atomic_fetch_or_explicit(&watchdog->group[group].alive, 1u << replica, memory_order_seq_cst);
+   }
+}
+
+/**
+* @brief Beats for a replica, once it sent a sample.
+*
+* @details The first beat of a restarted replica puts it back in the alive mask and
+*     closes its fault.
+*
+* @param[inout] watchdog table returned by watchdog_create()
+* @param[in]    group    voter group of the replica
+* @param[in]    replica  replica within the group
+* @param[in]    seq      sequence number of the sample sent
+*
+* @return none
+*/
+void watchdog_beat(watchdog_t* watchdog, int group, int replica, unsigned int seq)
+{
+   watchdog_replica_t* rep = watchdog_replica(watchdog, group, replica);
+   int state = WATCHDOG_RESTARTED;
+   int fault;
+
+   atomic_store_explicit(&rep->next, seq + 1, memory_order_relaxed);
+   atomic_store_explicit(&rep->beat_ns, sysdep_now(), memory_order_relaxed);
+   if ((atomic_load_explicit(&rep->state, memory_order_relaxed) == WATCHDOG_RESTARTED)
+      && atomic_compare_exchange_strong_explicit(&rep->state, &state, WATCHDOG_ALIVE,
+         memory_order_acq_rel, memory_order_relaxed))
+   {
+      if ((fault = atomic_load_explicit(&rep->fault, memory_order_relaxed)) >= 0)
+      {
+         atomic_store_explicit(&watchdog->fault[fault].recovered_ns, sysdep_now(), memory_order_relaxed);
+      }
+      atomic_fetch_or_explicit(&watchdog->group[group].alive, 1u << replica, memory_order_seq_cst);
+   }
+}
+
+/**
+* @brief Stops watching a replica that sent all its samples.
+*
+* @details The replica stays in the alive mask: its voter has nothing left to wait for.
+*
+* @param[inout] watchdog table returned by watchdog_create()
+* @param[in]    group    voter group of the replica
+* @param[in]    replica  replica within the group
+*
+* @return none
+*/
+void watchdog_retire(watchdog_t* watchdog, int group, int replica)
+{
+   atomic_store_explicit(&watchdog_replica(watchdog, group, replica)->state, WATCHDOG_DONE, memory_order_release);
+}
+
+/**
+* @brief Looks for a replica whose last beat is older than its timeout.
+*
+* @details The replica found is declared failed, as if watchdog_fail() had been called,
+*     so it is returned once. Meant to be called until it returns false.
+*
+* @param[inout] watchdog table returned by watchdog_create()
+* @param[out]   group    voter group of the replica found
+* @param[out]   replica  replica found within the group
+*
+* @return true if a late replica was found
+*/
+bool watchdog_expired(watchdog_t* watchdog, int* group, int* replica)
+{
+   watchdog_replica_t* rep;
+   uint64_t now = sysdep_now();
+   int state;
+   int g;
+   int r;
+
+   for (g = 0; g < watchdog->groups; g++)
+   {
+      for (r = 0; r < WATCHDOG_REPLICAS; r++)
+      {
+         rep = watchdog_replica(watchdog, g, r);
+         state = atomic_load_explicit(&rep->state, memory_order_acquire);
+         if (((state != WATCHDOG_ALIVE) && (state != WATCHDOG_RESTARTED))
+            || (now - atomic_load_explicit(&rep->beat_ns, memory_order_relaxed)
+               <= atomic_load_explicit(&rep->timeout_ns, memory_order_relaxed)))
+         {
+            continue;
+         }
+
+         // a replica beating right now is not late after all
+         if (atomic_compare_exchange_strong_explicit(&rep->state, &state, WATCHDOG_FAILED,
+               memory_order_acq_rel, memory_order_relaxed))
+         {
+            watchdog_open(watchdog, g, r, false);
+            *group = g;
+            *replica = r;
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+/**
+* @brief Declares failed a replica found dead.
+*
+* @param[inout] watchdog table returned by watchdog_create()
+* @param[in]    group    voter group of the replica
+* @param[in]    replica  replica within the group
+* @param[in]    crashed  true if the process died, false if it is late
+*
+* @return true if the replica was watched and is now failed, false if it was failed, done or never watched
+*/
+bool watchdog_fail(watchdog_t* watchdog, int group, int replica, bool crashed)
+{
+   watchdog_replica_t* rep = watchdog_replica(watchdog, group, replica);
+   int state = atomic_load_explicit(&rep->state, memory_order_acquire);
+
+   if (((state != WATCHDOG_ALIVE) && (state != WATCHDOG_RESTARTED))
+      || !atomic_compare_exchange_strong_explicit(&rep->state, &state, WATCHDOG_FAILED,
+         memory_order_acq_rel, memory_order_relaxed))
+   {
+      return false;
+   }
+
+   watchdog_open(watchdog, group, replica, crashed);
+   return true;
+}
+
+/**
+* @brief Returns the sample a replica restarted in a group shall send first.
+*
+* @details The restarted replica skips the samples the others of its group already sent,
+*     which their votes were decided without.
+*
+* @param[in] watchdog table returned by watchdog_create()
+* @param[in] group    voter group of the replica
+*
+* @return sequence number of the next sample of the group
+*/
+unsigned int watchdog_resume(watchdog_t* watchdog, int group)
+{
+   uint32_t next = 0;
+   uint32_t seq;
+   int r;
+
+   for (r = 0; r < WATCHDOG_REPLICAS; r++)
+   {
+      seq = atomic_load_explicit(&watchdog_replica(watchdog, group, r)->next, memory_order_relaxed);
+      next = (seq > next) ? seq : next;
+   }
+   return next;
+}
+
+/**
+* @brief Prints every fault with the time the voter took to fail over and the replica to come back.
+*
+* @param[in] watchdog table returned by watchdog_create()
+* @param[in] out      stream the report is printed on
+*
+* @return none
+*/
+void watchdog_report(watchdog_t* watchdog, FILE* out)
+{
+   watchdog_fault_t* fault;
+   uint64_t detected;
+   uint64_t degraded;
+   uint64_t recovered;
+   int faults = atomic_load_explicit(&watchdog->faults, memory_order_acquire);
+   int i;
+
+   if (faults == 0)
+   {
+      fprintf(out, "watchdog: no replica failed\n");
+      return;
+   }
+
+   for (i = 0; i < faults && i < WATCHDOG_FAULTS; i++)
+   {
+      fault = &watchdog->fault[i];
+      detected = atomic_load_explicit(&fault->detected_ns, memory_order_acquire);
+      degraded = atomic_load_explicit(&fault->degraded_ns, memory_order_relaxed);
+      recovered = atomic_load_explicit(&fault->recovered_ns, memory_order_relaxed);
+      fprintf(out, "watchdog: group %i replica %i %s at %.3f s", fault->group, fault->replica,
+         fault->crashed ? "crashed" : "missed its heartbeat", (detected - watchdog->created_ns) / 1e9);
+      if (degraded != 0)
+      {
+         fprintf(out, ", voter on %i-out-of-%i after %.3f ms", atomic_load_explicit(&fault->quorum, memory_order_relaxed),
+            atomic_load_explicit(&fault->live, memory_order_relaxed), (degraded - detected) / 1e6);
+      }
+      else
+      {
+         fprintf(out, ", voter did not fail over");
+      }
+      if (recovered != 0)
+      {
+         fprintf(out, ", replica back after %.3f ms\n", (recovered - detected) / 1e6);
+      }
+      else
+      {
+         fprintf(out, ", replica not back\n");
+      }
+   }
+   if (faults > WATCHDOG_FAULTS)
+   {
+      fprintf(out, "watchdog: %i more faults not reported\n", faults - WATCHDOG_FAULTS);
+   }
+}
+
+/**
+* @brief Returns the replicas of a group its voter shall vote on.
+*
+* @param[in] watchdog table returned by watchdog_create()
+* @param[in] group    voter group
+*
+* @return mask of the replicas alive, bit i for replica i
+*/
+uint32_t watchdog_alive(watchdog_t* watchdog, int group)
+{
+   return atomic_load_explicit(&watchdog->group[group].alive, memory_order_acquire);
+}
+
+/**
+* @brief Acknowledges the alive mask a voter switched to.
+*
+* @details Closes the failover of the faults of the group whose replica the mask leaves out.
+*
+* @param[inout] watchdog table returned by watchdog_create()
+* @param[in]    group    voter group
+* @param[in]    alive    mask the voter votes on from now on, as returned by watchdog_alive()
+* @param[in]    quorum   agreeing replicas the voter needs among them
+*
+* @return none
+*/
+void watchdog_applied(watchdog_t* watchdog, int group, uint32_t alive, int quorum)
+{
+   watchdog_fault_t* fault;
+   int faults = atomic_load_explicit(&watchdog->faults, memory_order_acquire);
+   int i;
+
+   for (i = 0; i < faults && i < WATCHDOG_FAULTS; i++)
+   {
+      fault = &watchdog->fault[i];
+      if ((atomic_load_explicit(&fault->detected_ns, memory_order_acquire) == 0)
+         || (fault->group != group) || (alive & (1u << fault->replica))
+         || (atomic_load_explicit(&fault->degraded_ns, memory_order_relaxed) != 0))
+      {
+         continue;
+      }
+      atomic_store_explicit(&fault->live, __builtin_popcount(alive), memory_order_relaxed);
+      atomic_store_explicit(&fault->quorum, quorum, memory_order_relaxed);
+      atomic_store_explicit(&fault->degraded_ns, sysdep_now(), memory_order_relaxed);
+   }
+}
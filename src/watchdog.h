@@ -0,0 +1,96 @@
+/**
+* @file watchdog.h
+* @brief Definitions for the heartbeat table of the sensor replicas
+* @anchor header_watchdog
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2022 Antonio Riccio <hi@ariccio.me>.
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 3 of
+* the License, or any later version. This program is distributed in
+* the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details. You should
+* have received a copy of the GNU General Public License along with
+* this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+*/
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @brief Replicas watched in each voter group, as many as a voter takes
+ */
+#define WATCHDOG_REPLICAS  8
+
+/**
+ * @brief Faults kept for the report, the later ones are handled but not reported
+ */
+#define WATCHDOG_FAULTS    64
+
+/**
+ * @brief Default period of the checks and of the voters looking at the table, in ms
+ */
+#define WATCHDOG_PERIOD_MS 10
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Heartbeat of every sensor replica, in shared memory.
+ *
+ * @details Each replica beats after every sample it sends. The supervising process
+ *       declares failed a replica that crashed or whose last beat is older than its
+ *       timeout, which clears it from the alive mask of its voter group; the voter of
+ *       the group follows the mask, voting among the replicas left, and acknowledges
+ *       the mask it applied. A restarted replica joins the mask again with its first
+ *       beat. The detection, failover and recovery times of every fault are kept for
+ *       the report.
+ *
+ */
+typedef struct watchdog_s watchdog_t;
+
+/************************** Function Prototypes *****************************/
+
+/**
+ * @name Init functions
+ * @{
+ */
+watchdog_t* watchdog_create(int groups);
+void watchdog_destroy(watchdog_t* watchdog);
+/* @} */
+
+/**
+ * @name Replicas
+ * @{
+ */
+void watchdog_watch(watchdog_t* watchdog, int group, int replica, uint64_t timeout_ns);
+void watchdog_beat(watchdog_t* watchdog, int group, int replica, unsigned int seq);
+void watchdog_retire(watchdog_t* watchdog, int group, int replica);
+/* @} */
+
+/**
+ * @name Supervision
+ * @{
+ */
+bool watchdog_expired(watchdog_t* watchdog, int* group, int* replica);
+bool watchdog_fail(watchdog_t* watchdog, int group, int replica, bool crashed);
+unsigned int watchdog_resume(watchdog_t* watchdog, int group);
+void watchdog_report(watchdog_t* watchdog, FILE* out);
+/* @} */
+
+/**
+ * @name Voters
+ * @{
+ */
+uint32_t watchdog_alive(watchdog_t* watchdog, int group);
+void watchdog_applied(watchdog_t* watchdog, int group, uint32_t alive, int quorum);
+/* @} */
+
+#endif /*WATCHDOG_H*/